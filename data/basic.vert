@@ -1,21 +1,27 @@
 #version 450
-
-layout(location=0) in vec3 in_position;
-layout(location=1) in vec3 in_color;
-layout(location=2) in vec2 in_tex_coords;
+#extension GL_GOOGLE_include_directive : require
 
 layout(binding=0) uniform  UniformBufferObject{
-    mat4 model;
-    mat4 view;
-    mat4 projection;
+    mat4 mvp;
 }uni_mvp;
 
+// DEPTH_ONLY builds the variant of the depth prepass, which only reads the positions
+#ifndef DEPTH_ONLY
 layout(location=0) out vec3 out_color;
 layout(location=1) out vec2 out_tex_coords;
+#endif
+
+// the EQUAL depth test of the main subpass needs the exact depth of the prepass
+invariant gl_Position;
+
+#include "vertex_pulling.glsl"
 
 void main ()
 {
-    gl_Position = uni_mvp.projection * uni_mvp.view * uni_mvp.model * vec4(in_position, 1.0);
-    out_color = in_color;
-    out_tex_coords = in_tex_coords;
+    vec3 position = pullPosition(uint(gl_VertexIndex));
+#ifndef DEPTH_ONLY
+    pullAttributes(uint(gl_VertexIndex), out_color, out_tex_coords);
+#endif
+
+    gl_Position = uni_mvp.mvp * vec4(position, 1.0);
 }
@@ -0,0 +1,28 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+// world-view-projection matrix of each instance, combined on the CPU
+layout(std430, binding=2) readonly buffer InstanceTransforms{
+    mat4 mvp[];
+}instances;
+
+// DEPTH_ONLY builds the variant of the depth prepass, which only reads the positions
+#ifndef DEPTH_ONLY
+layout(location=0) out vec3 out_color;
+layout(location=1) out vec2 out_tex_coords;
+#endif
+
+// the EQUAL depth test of the main subpass needs the exact depth of the prepass
+invariant gl_Position;
+
+#include "vertex_pulling.glsl"
+
+void main ()
+{
+    vec3 position = pullPosition(uint(gl_VertexIndex));
+#ifndef DEPTH_ONLY
+    pullAttributes(uint(gl_VertexIndex), out_color, out_tex_coords);
+#endif
+
+    gl_Position = instances.mvp[gl_InstanceIndex] * vec4(position, 1.0);
+}
@@ -0,0 +1,45 @@
+// Vertex pulling from the geometry arena shared by the vertex shaders, the attributes are left out with DEPTH_ONLY
+
+// sb::VertexFormat, the vertex offset of the draws stores it above the vertex index
+const uint VERTEX_FORMAT_FULL = 0;
+const uint VERTEX_FORMAT_PACKED = 1;
+const uint VERTEX_FORMAT_SHIFT = 28;
+
+// streams of the geometry arena, the positions of every vertex and the attributes laid out as the vertex format
+layout(std430, binding=12) readonly buffer VertexPositions{
+    float data[];
+}positions;
+
+#ifndef DEPTH_ONLY
+// starts with the word of the attributes of vertex 0 of each format
+layout(std430, binding=13) readonly buffer VertexAttributes{
+    uint data[];
+}attributes;
+#endif
+
+vec3 pullPosition(uint vertex_idx)
+{
+    uint word = (vertex_idx & ((1u << VERTEX_FORMAT_SHIFT) - 1u)) * 3u;
+    return vec3(positions.data[word], positions.data[word + 1], positions.data[word + 2]);
+}
+
+#ifndef DEPTH_ONLY
+void pullAttributes(uint vertex_idx, out vec3 color, out vec2 tex_coords)
+{
+    uint format = vertex_idx >> VERTEX_FORMAT_SHIFT;
+    uint vertex = vertex_idx & ((1u << VERTEX_FORMAT_SHIFT) - 1u);
+
+    if (VERTEX_FORMAT_PACKED == format)
+    {
+        uint word = attributes.data[VERTEX_FORMAT_PACKED] + vertex * 2u;
+        color = unpackUnorm4x8(attributes.data[word]).rgb;
+        tex_coords = unpackHalf2x16(attributes.data[word + 1]);
+    }
+    else
+    {
+        uint word = attributes.data[VERTEX_FORMAT_FULL] + vertex * 5u;
+        color = uintBitsToFloat(uvec3(attributes.data[word], attributes.data[word + 1], attributes.data[word + 2]));
+        tex_coords = uintBitsToFloat(uvec2(attributes.data[word + 3], attributes.data[word + 4]));
+    }
+}
+#endif
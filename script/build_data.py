@@ -4,9 +4,10 @@ import os
 import os.path
 import shutil
 
-def buildShader(glslc, input, output):
+def buildShader(glslc, input, output, defines=[]):
    print("Buildling shader {0} ...".format(input))
-   shader_build_process = Popen([glslc, input, "-o", output], stdout=PIPE, stderr=PIPE, cwd=data_dir)
+   define_args = ["-D" + define for define in defines]
+   shader_build_process = Popen([glslc, input, "-o", output] + define_args, stdout=PIPE, stderr=PIPE, cwd=data_dir)
    (output, err) = shader_build_process.communicate()
    shader_build_process.wait()
 
@@ -32,7 +33,15 @@ if __name__ == "__main__":
       os.mkdir(build_dir)
 
    buildShader(glslc, "basic.vert", os.path.join(build_dir, "basic.vert"))
+   buildShader(glslc, "basic.vert", os.path.join(build_dir, "basic_depth.vert"), ["DEPTH_ONLY"])
    buildShader(glslc, "basic.frag", os.path.join(build_dir, "basic.frag"))
+   buildShader(glslc, "instanced.vert", os.path.join(build_dir, "instanced.vert"))
+   buildShader(glslc, "instanced.vert", os.path.join(build_dir, "instanced_depth.vert"), ["DEPTH_ONLY"])
+   buildShader(glslc, "cull_instances.comp", os.path.join(build_dir, "cull_instances.comp"))
+   buildShader(glslc, "cull_instances.comp", os.path.join(build_dir, "cull_instances_occlusion.comp"),
+               ["OCCLUSION_CULLING"])
+   buildShader(glslc, "depth_pyramid.comp", os.path.join(build_dir, "depth_pyramid.comp"))
+   buildShader(glslc, "cull_meshlets.comp", os.path.join(build_dir, "cull_meshlets.comp"))
 
    shutil.copyfile(os.path.join(data_dir, "texture.jpg"), os.path.join(build_dir, "texture.jpg"))
    shutil.copyfile(os.path.join(data_dir, "viking_room.png"), os.path.join(build_dir, "viking_room.png"))
@@ -0,0 +1,359 @@
+#include "culling.h"
+#include "simd.h"
+
+#include <sb_core/error/error.h>
+
+#include <sb_std/algorithm>
+
+#include <bit>
+#include <cmath>
+
+namespace {
+
+// Appends the slots of the bits set in 'lane_mask' to the visible list
+inline sb::u32 appendVisibleLanes(sb::u32 lane_mask, sb::u32 first_idx, sb::u32 * visible_indices,
+                                  sb::u32 visible_cnt)
+{
+    while (0 != lane_mask)
+    {
+        visible_indices[visible_cnt++] = first_idx + (sb::u32)std::countr_zero(lane_mask);
+        lane_mask &= lane_mask - 1;
+    }
+
+    return visible_cnt;
+}
+
+sb::u32 cullBoundingSpheresScalar(sb::BoundingSpheres const & spheres, sb::FrustumPlanes const & planes, sb::u32 first,
+                                  sb::u32 last, sb::u32 * visible_indices, sb::u32 visible_cnt)
+{
+    for (sb::u32 sphere_idx = first; sphere_idx != last; ++sphere_idx)
+    {
+        sb::f32 const center_x = spheres.center_x[sphere_idx];
+        sb::f32 const center_y = spheres.center_y[sphere_idx];
+        sb::f32 const center_z = spheres.center_z[sphere_idx];
+        sb::f32 const neg_radius = -spheres.radius[sphere_idx];
+
+        sb::b8 inside = true;
+        for (sb::u32 plane_idx = 0; plane_idx != sb::FrustumPlanes::PLANE_COUNT; ++plane_idx)
+        {
+            sb::f32 const dist = planes.a[plane_idx] * center_x + planes.b[plane_idx] * center_y +
+                                 planes.c[plane_idx] * center_z + planes.d[plane_idx];
+            inside = inside && (dist >= neg_radius);
+        }
+
+        if (inside)
+        {
+            visible_indices[visible_cnt++] = sphere_idx;
+        }
+    }
+
+    return visible_cnt;
+}
+
+#if SB_SIMD_X64
+
+// 8 spheres per iteration against every plane, the lanes left inside are appended from the sign mask
+SB_TARGET_AVX2 sb::u32 cullBoundingSpheresAvx2(sb::BoundingSpheres const & spheres, sb::FrustumPlanes const & planes,
+                                               sb::u32 first, sb::u32 last, sb::u32 * visible_indices,
+                                               sb::u32 & visible_cnt)
+{
+    __m256 plane_a[sb::FrustumPlanes::PLANE_COUNT];
+    __m256 plane_b[sb::FrustumPlanes::PLANE_COUNT];
+    __m256 plane_c[sb::FrustumPlanes::PLANE_COUNT];
+    __m256 plane_d[sb::FrustumPlanes::PLANE_COUNT];
+
+    for (sb::u32 plane_idx = 0; plane_idx != sb::FrustumPlanes::PLANE_COUNT; ++plane_idx)
+    {
+        plane_a[plane_idx] = _mm256_set1_ps(planes.a[plane_idx]);
+        plane_b[plane_idx] = _mm256_set1_ps(planes.b[plane_idx]);
+        plane_c[plane_idx] = _mm256_set1_ps(planes.c[plane_idx]);
+        plane_d[plane_idx] = _mm256_set1_ps(planes.d[plane_idx]);
+    }
+
+    __m256 const sign_mask = _mm256_set1_ps(-0.f);
+
+    sb::u32 sphere_idx = first;
+
+    for (sb::u32 const simd_last = first + ((last - first) & ~7U); sphere_idx != simd_last; sphere_idx += 8)
+    {
+        __m256 const center_x = _mm256_loadu_ps(&spheres.center_x[sphere_idx]);
+        __m256 const center_y = _mm256_loadu_ps(&spheres.center_y[sphere_idx]);
+        __m256 const center_z = _mm256_loadu_ps(&spheres.center_z[sphere_idx]);
+        __m256 const neg_radius = _mm256_xor_ps(_mm256_loadu_ps(&spheres.radius[sphere_idx]), sign_mask);
+
+        __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (sb::u32 plane_idx = 0; plane_idx != sb::FrustumPlanes::PLANE_COUNT; ++plane_idx)
+        {
+            __m256 const dist = _mm256_fmadd_ps(
+                plane_a[plane_idx], center_x,
+                _mm256_fmadd_ps(plane_b[plane_idx], center_y,
+                                _mm256_fmadd_ps(plane_c[plane_idx], center_z, plane_d[plane_idx])));
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(dist, neg_radius, _CMP_GE_OQ));
+        }
+
+        visible_cnt = appendVisibleLanes((sb::u32)_mm256_movemask_ps(inside), sphere_idx, visible_indices, visible_cnt);
+    }
+
+    return sphere_idx;
+}
+
+sb::u32 cullBoundingSpheresSse(sb::BoundingSpheres const & spheres, sb::FrustumPlanes const & planes, sb::u32 first,
+                               sb::u32 last, sb::u32 * visible_indices, sb::u32 & visible_cnt)
+{
+    __m128 const sign_mask = _mm_set1_ps(-0.f);
+
+    sb::u32 sphere_idx = first;
+
+    for (sb::u32 const simd_last = first + ((last - first) & ~3U); sphere_idx != simd_last; sphere_idx += 4)
+    {
+        __m128 const center_x = _mm_loadu_ps(&spheres.center_x[sphere_idx]);
+        __m128 const center_y = _mm_loadu_ps(&spheres.center_y[sphere_idx]);
+        __m128 const center_z = _mm_loadu_ps(&spheres.center_z[sphere_idx]);
+        __m128 const neg_radius = _mm_xor_ps(_mm_loadu_ps(&spheres.radius[sphere_idx]), sign_mask);
+
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (sb::u32 plane_idx = 0; plane_idx != sb::FrustumPlanes::PLANE_COUNT; ++plane_idx)
+        {
+            __m128 const dist =
+                _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(planes.a[plane_idx]), center_x),
+                                      _mm_mul_ps(_mm_set1_ps(planes.b[plane_idx]), center_y)),
+                           _mm_add_ps(_mm_mul_ps(_mm_set1_ps(planes.c[plane_idx]), center_z),
+                                      _mm_set1_ps(planes.d[plane_idx])));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(dist, neg_radius));
+        }
+
+        visible_cnt = appendVisibleLanes((sb::u32)_mm_movemask_ps(inside), sphere_idx, visible_indices, visible_cnt);
+    }
+
+    return sphere_idx;
+}
+
+#endif
+
+#if SB_SIMD_NEON
+
+sb::u32 cullBoundingSpheresNeon(sb::BoundingSpheres const & spheres, sb::FrustumPlanes const & planes, sb::u32 first,
+                                sb::u32 last, sb::u32 * visible_indices, sb::u32 & visible_cnt)
+{
+    sb::u32 const lane_bits_data[4] = {1, 2, 4, 8};
+    uint32x4_t const lane_bits = vld1q_u32(lane_bits_data);
+
+    sb::u32 sphere_idx = first;
+
+    for (sb::u32 const simd_last = first + ((last - first) & ~3U); sphere_idx != simd_last; sphere_idx += 4)
+    {
+        float32x4_t const center_x = vld1q_f32(&spheres.center_x[sphere_idx]);
+        float32x4_t const center_y = vld1q_f32(&spheres.center_y[sphere_idx]);
+        float32x4_t const center_z = vld1q_f32(&spheres.center_z[sphere_idx]);
+        float32x4_t const neg_radius = vnegq_f32(vld1q_f32(&spheres.radius[sphere_idx]));
+
+        uint32x4_t inside = vdupq_n_u32(~0U);
+        for (sb::u32 plane_idx = 0; plane_idx != sb::FrustumPlanes::PLANE_COUNT; ++plane_idx)
+        {
+            float32x4_t dist = vdupq_n_f32(planes.d[plane_idx]);
+            dist = vmlaq_n_f32(dist, center_x, planes.a[plane_idx]);
+            dist = vmlaq_n_f32(dist, center_y, planes.b[plane_idx]);
+            dist = vmlaq_n_f32(dist, center_z, planes.c[plane_idx]);
+            inside = vandq_u32(inside, vcgeq_f32(dist, neg_radius));
+        }
+
+        visible_cnt = appendVisibleLanes(vaddvq_u32(vandq_u32(inside, lane_bits)), sphere_idx, visible_indices,
+                                         visible_cnt);
+    }
+
+    return sphere_idx;
+}
+
+#endif
+
+enum class CullingKernel
+{
+    SCALAR,
+    SSE,
+    AVX2,
+    NEON
+};
+
+CullingKernel getCullingKernel()
+{
+#if SB_SIMD_X64
+    return sb::isAvx2Supported() ? CullingKernel::AVX2 : CullingKernel::SSE;
+#elif SB_SIMD_NEON
+    return CullingKernel::NEON;
+#else
+    return CullingKernel::SCALAR;
+#endif
+}
+
+} // namespace
+
+sb::MeshBounds sb::computeMeshBounds(f32 const * positions, u32 vtx_cnt, u32 stride)
+{
+    MeshBounds bounds;
+
+    if (0 == vtx_cnt)
+    {
+        return bounds;
+    }
+
+    auto const getPosition = [positions, stride](u32 vtx_idx) {
+        f32 const * const position =
+            reinterpret_cast<f32 const *>(reinterpret_cast<u8 const *>(positions) + vtx_idx * stride);
+        return glm::vec3(position[0], position[1], position[2]);
+    };
+
+    bounds.aabb_min = getPosition(0);
+    bounds.aabb_max = bounds.aabb_min;
+
+    for (u32 vtx_idx = 1; vtx_idx != vtx_cnt; ++vtx_idx)
+    {
+        glm::vec3 const position = getPosition(vtx_idx);
+        bounds.aabb_min = glm::min(bounds.aabb_min, position);
+        bounds.aabb_max = glm::max(bounds.aabb_max, position);
+    }
+
+    // centered on the box, a bit looser than the minimal sphere but computed in a single extra pass
+    bounds.sphere_center = (bounds.aabb_min + bounds.aabb_max) * 0.5f;
+
+    f32 max_dist_sqr = 0.f;
+    for (u32 vtx_idx = 0; vtx_idx != vtx_cnt; ++vtx_idx)
+    {
+        glm::vec3 const offset = getPosition(vtx_idx) - bounds.sphere_center;
+        max_dist_sqr = sbstd::max(max_dist_sqr, offset.x * offset.x + offset.y * offset.y + offset.z * offset.z);
+    }
+
+    bounds.sphere_radius = std::sqrt(max_dist_sqr);
+
+    return bounds;
+}
+
+void sb::extractFrustumPlanes(f32 const * view_proj, FrustumPlanes & planes)
+{
+    // a clip space point is inside when -w <= x <= w, -w <= y <= w and 0 <= z <= w
+    f32 rows[4][4];
+    for (u32 row_idx = 0; row_idx != 4; ++row_idx)
+    {
+        for (u32 col_idx = 0; col_idx != 4; ++col_idx)
+        {
+            rows[row_idx][col_idx] = view_proj[col_idx * 4 + row_idx];
+        }
+    }
+
+    for (u32 col_idx = 0; col_idx != 4; ++col_idx)
+    {
+        f32 const plane_coefs[FrustumPlanes::PLANE_COUNT] = {
+            rows[3][col_idx] + rows[0][col_idx], // left
+            rows[3][col_idx] - rows[0][col_idx], // right
+            rows[3][col_idx] + rows[1][col_idx], // bottom
+            rows[3][col_idx] - rows[1][col_idx], // top
+            rows[2][col_idx],                    // near
+            rows[3][col_idx] - rows[2][col_idx]  // far
+        };
+
+        f32 * const dst_coefs[4] = {planes.a, planes.b, planes.c, planes.d};
+        sbstd::copy(sbstd::begin(plane_coefs), sbstd::end(plane_coefs), dst_coefs[col_idx]);
+    }
+
+    for (u32 plane_idx = 0; plane_idx != FrustumPlanes::PLANE_COUNT; ++plane_idx)
+    {
+        f32 const inv_len = 1.f / std::sqrt(planes.a[plane_idx] * planes.a[plane_idx] +
+                                            planes.b[plane_idx] * planes.b[plane_idx] +
+                                            planes.c[plane_idx] * planes.c[plane_idx]);
+        planes.a[plane_idx] *= inv_len;
+        planes.b[plane_idx] *= inv_len;
+        planes.c[plane_idx] *= inv_len;
+        planes.d[plane_idx] *= inv_len;
+    }
+}
+
+char const * sb::getCullingKernelName()
+{
+    switch (getCullingKernel())
+    {
+        case CullingKernel::SSE:
+        {
+            return "SSE";
+        }
+        case CullingKernel::AVX2:
+        {
+            return "AVX2";
+        }
+        case CullingKernel::NEON:
+        {
+            return "NEON";
+        }
+        default:
+        {
+            return "scalar";
+        }
+    }
+}
+
+sb::u32 sb::cullBoundingSpheres(BoundingSpheres const & spheres, FrustumPlanes const & planes, u32 first, u32 last,
+                                u32 * visible_indices)
+{
+    sbAssert((first <= last) && (last <= spheres.center_x.size()));
+
+    u32 visible_cnt = 0;
+    u32 simd_last = first;
+
+#if SB_SIMD_X64
+    if (CullingKernel::AVX2 == getCullingKernel())
+    {
+        simd_last = cullBoundingSpheresAvx2(spheres, planes, first, last, visible_indices, visible_cnt);
+    }
+    else
+    {
+        simd_last = cullBoundingSpheresSse(spheres, planes, first, last, visible_indices, visible_cnt);
+    }
+#elif SB_SIMD_NEON
+    simd_last = cullBoundingSpheresNeon(spheres, planes, first, last, visible_indices, visible_cnt);
+#endif
+
+    return cullBoundingSpheresScalar(spheres, planes, simd_last, last, visible_indices, visible_cnt);
+}
+
+void sb::sortSpheresByLod(BoundingSpheres const & spheres, f32 const * view_proj, f32 pixel_scale,
+                          f32 max_pixel_error, f32 const * lod_errors, u32 lod_cnt, u32 * sphere_indices,
+                          u32 sphere_cnt, u32 * scratch, u32 * lod_sphere_cnts)
+{
+    sbAssert((0 != lod_cnt) && (lod_cnt <= MAX_SPHERE_LOD_COUNT));
+
+    // the clip space w of the center is its view space depth, the nearest point of the sphere bounds the error
+    auto const selectLod = [&](u32 sphere_idx) {
+        f32 const radius = spheres.radius[sphere_idx];
+        f32 const depth = view_proj[3] * spheres.center_x[sphere_idx] + view_proj[7] * spheres.center_y[sphere_idx] +
+                          view_proj[11] * spheres.center_z[sphere_idx] + view_proj[15];
+        f32 const max_error = max_pixel_error * (depth - radius) / (radius * pixel_scale);
+
+        u32 lod_idx = lod_cnt - 1;
+        while ((0 != lod_idx) && (lod_errors[lod_idx] > max_error))
+        {
+            --lod_idx;
+        }
+
+        return lod_idx;
+    };
+
+    sbstd::fill_n(lod_sphere_cnts, lod_cnt, 0U);
+    for (u32 idx = 0; idx != sphere_cnt; ++idx)
+    {
+        ++lod_sphere_cnts[selectLod(sphere_indices[idx])];
+    }
+
+    u32 lod_firsts[MAX_SPHERE_LOD_COUNT];
+    lod_firsts[0] = 0;
+    for (u32 lod_idx = 1; lod_idx != lod_cnt; ++lod_idx)
+    {
+        lod_firsts[lod_idx] = lod_firsts[lod_idx - 1] + lod_sphere_cnts[lod_idx - 1];
+    }
+
+    // the level is cheaper to compute again than to store
+    for (u32 idx = 0; idx != sphere_cnt; ++idx)
+    {
+        u32 const sphere_idx = sphere_indices[idx];
+        scratch[lod_firsts[selectLod(sphere_idx)]++] = sphere_idx;
+    }
+
+    sbstd::copy_n(scratch, sphere_cnt, sphere_indices);
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <sb_core/core.h>
+#include <sb_core/container/dynamic_array.h>
+
+#include <glm/vec3.hpp>
+
+namespace sb {
+
+// Object space bounds of a mesh, computed once at load time
+struct MeshBounds
+{
+    glm::vec3 aabb_min = glm::vec3(0.f);
+    glm::vec3 aabb_max = glm::vec3(0.f);
+    glm::vec3 sphere_center = glm::vec3(0.f);
+    f32 sphere_radius = 0.f;
+};
+
+// 'positions' points to the position of the first vertex, 'stride' is the vertex size in bytes
+MeshBounds computeMeshBounds(f32 const * positions, u32 vtx_cnt, u32 stride);
+
+// World space bounding spheres packed as separate streams so that several of them are tested at once
+struct BoundingSpheres
+{
+    DArray<f32> center_x;
+    DArray<f32> center_y;
+    DArray<f32> center_z;
+    DArray<f32> radius;
+};
+
+// ax + by + cz + d >= 0 inside of the frustum, the normals are normalized so that d is a distance
+struct FrustumPlanes
+{
+    static constexpr u32 PLANE_COUNT = 6;
+
+    f32 a[PLANE_COUNT];
+    f32 b[PLANE_COUNT];
+    f32 c[PLANE_COUNT];
+    f32 d[PLANE_COUNT];
+};
+
+// 'view_proj' is a column major 4x4 matrix with a [0, 1] clip space depth
+void extractFrustumPlanes(f32 const * view_proj, FrustumPlanes & planes);
+
+// Name of the SIMD kernel cullBoundingSpheres() runs, picked once from the CPU features
+char const * getCullingKernelName();
+
+// Appends the indices of the spheres in [first, last) touching the frustum to 'visible_indices' and returns their count
+// 'visible_indices' needs room for last - first indices
+u32 cullBoundingSpheres(BoundingSpheres const & spheres, FrustumPlanes const & planes, u32 first, u32 last,
+                        u32 * visible_indices);
+
+static constexpr u32 MAX_SPHERE_LOD_COUNT = 8;
+
+// Groups the 'sphere_cnt' indices of 'sphere_indices' by level of detail and writes the count of each level to
+// 'lod_sphere_cnts', a sphere takes the coarsest level whose error projects to at most 'max_pixel_error' pixels
+// 'lod_errors' holds the error of each of the 'lod_cnt' levels relative to the sphere radius, growing with the level
+// 'pixel_scale' turns a view space length at unit depth into pixels, 'scratch' needs room for 'sphere_cnt' indices
+void sortSpheresByLod(BoundingSpheres const & spheres, f32 const * view_proj, f32 pixel_scale, f32 max_pixel_error,
+                      f32 const * lod_errors, u32 lod_cnt, u32 * sphere_indices, u32 sphere_cnt, u32 * scratch,
+                      u32 * lod_sphere_cnts);
+
+} // namespace sb
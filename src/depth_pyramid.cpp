@@ -0,0 +1,436 @@
+#include "depth_pyramid.h"
+#include "frame_scheduler.h"
+
+#include <sb_core/error/error.h>
+#include <sb_core/log.h>
+#include <sb_core/enum.h>
+#include <sb_core/container/fix_array.h>
+
+#include <sb_std/algorithm>
+#include <sb_std/iterator>
+
+namespace {
+
+constexpr VkFormat PYRAMID_FORMAT = VK_FORMAT_R32_SFLOAT;
+
+} // namespace
+
+sb::b8 sb::DepthPyramid::initialize(VkPhysicalDevice phys_device, VkDevice device, VkShaderModule reduce_shader)
+{
+    sbAssert(VK_NULL_HANDLE == _vk_pipeline);
+
+    _vk_phys_device = phys_device;
+    _vk_device = device;
+
+    // every access is a texelFetch, the sampler is only there to complete the combined image samplers
+    VkSamplerCreateInfo sampler_info = {};
+    sampler_info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    sampler_info.magFilter = VK_FILTER_NEAREST;
+    sampler_info.minFilter = VK_FILTER_NEAREST;
+    sampler_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    sampler_info.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    sampler_info.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    sampler_info.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    sampler_info.minLod = 0.f;
+    sampler_info.maxLod = VK_LOD_CLAMP_NONE;
+
+    VkResult vk_res = vkCreateSampler(_vk_device, &sampler_info, nullptr, &_vk_sampler);
+    if (VK_SUCCESS != vk_res)
+    {
+        sbLogE("Failed to create depth pyramid sampler (error = '{}')", getEnumValue(vk_res));
+        return false;
+    }
+
+    // depth attachment, level below and level written
+    VkDescriptorSetLayoutBinding reduce_bindings[3] = {};
+    reduce_bindings[0].binding = 0;
+    reduce_bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    reduce_bindings[0].descriptorCount = 1;
+    reduce_bindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+    for (u32 binding_idx = 1; binding_idx != sbstd::size(reduce_bindings); ++binding_idx)
+    {
+        reduce_bindings[binding_idx].binding = binding_idx;
+        reduce_bindings[binding_idx].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        reduce_bindings[binding_idx].descriptorCount = 1;
+        reduce_bindings[binding_idx].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+
+    VkDescriptorSetLayoutCreateInfo desc_set_layout_info = {};
+    desc_set_layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    desc_set_layout_info.bindingCount = numericConv<u32>(sbstd::size(reduce_bindings));
+    desc_set_layout_info.pBindings = sbstd::data(reduce_bindings);
+
+    vk_res = vkCreateDescriptorSetLayout(_vk_device, &desc_set_layout_info, nullptr, &_vk_reduce_desc_set_layout);
+    if (VK_SUCCESS != vk_res)
+    {
+        sbLogE("Failed to create depth pyramid reduce descriptor set layout (error = '{}')", getEnumValue(vk_res));
+        return false;
+    }
+
+    VkDescriptorSetLayoutBinding sample_binding = {};
+    sample_binding.binding = 0;
+    sample_binding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    sample_binding.descriptorCount = 1;
+    sample_binding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+    desc_set_layout_info.bindingCount = 1;
+    desc_set_layout_info.pBindings = &sample_binding;
+
+    vk_res = vkCreateDescriptorSetLayout(_vk_device, &desc_set_layout_info, nullptr, &_vk_sample_desc_set_layout);
+    if (VK_SUCCESS != vk_res)
+    {
+        sbLogE("Failed to create depth pyramid sample descriptor set layout (error = '{}')", getEnumValue(vk_res));
+        return false;
+    }
+
+    VkPushConstantRange push_constant_range = {};
+    push_constant_range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    push_constant_range.offset = 0;
+    push_constant_range.size = sizeof(ReduceParams);
+
+    VkPipelineLayoutCreateInfo layout_info = {};
+    layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    layout_info.setLayoutCount = 1;
+    layout_info.pSetLayouts = &_vk_reduce_desc_set_layout;
+    layout_info.pushConstantRangeCount = 1;
+    layout_info.pPushConstantRanges = &push_constant_range;
+
+    vk_res = vkCreatePipelineLayout(_vk_device, &layout_info, nullptr, &_vk_pipeline_layout);
+    if (VK_SUCCESS != vk_res)
+    {
+        sbLogE("Failed to create depth pyramid pipeline layout (error = '{}')", getEnumValue(vk_res));
+        return false;
+    }
+
+    VkComputePipelineCreateInfo pipeline_info = {};
+    pipeline_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipeline_info.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipeline_info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipeline_info.stage.module = reduce_shader;
+    pipeline_info.stage.pName = "main";
+    pipeline_info.layout = _vk_pipeline_layout;
+    pipeline_info.basePipelineHandle = VK_NULL_HANDLE;
+    pipeline_info.basePipelineIndex = -1;
+
+    vk_res = vkCreateComputePipelines(_vk_device, VK_NULL_HANDLE, 1, &pipeline_info, nullptr, &_vk_pipeline);
+    if (VK_SUCCESS != vk_res)
+    {
+        sbLogE("Failed to create depth pyramid pipeline (error = '{}')", getEnumValue(vk_res));
+        return false;
+    }
+
+    return true;
+}
+
+void sb::DepthPyramid::terminate()
+{
+    destroy();
+
+    if (VK_NULL_HANDLE == _vk_device)
+    {
+        return;
+    }
+
+    vkDestroyPipeline(_vk_device, _vk_pipeline, nullptr);
+    _vk_pipeline = VK_NULL_HANDLE;
+    vkDestroyPipelineLayout(_vk_device, _vk_pipeline_layout, nullptr);
+    _vk_pipeline_layout = VK_NULL_HANDLE;
+    vkDestroyDescriptorSetLayout(_vk_device, _vk_sample_desc_set_layout, nullptr);
+    _vk_sample_desc_set_layout = VK_NULL_HANDLE;
+    vkDestroyDescriptorSetLayout(_vk_device, _vk_reduce_desc_set_layout, nullptr);
+    _vk_reduce_desc_set_layout = VK_NULL_HANDLE;
+    vkDestroySampler(_vk_device, _vk_sampler, nullptr);
+    _vk_sampler = VK_NULL_HANDLE;
+
+    _vk_device = VK_NULL_HANDLE;
+    _vk_phys_device = VK_NULL_HANDLE;
+}
+
+sb::b8 sb::DepthPyramid::create(VkImageView depth_view, VkExtent2D depth_ext, VkSampleCountFlagBits sample_cnt)
+{
+    sbAssert(VK_NULL_HANDLE != _vk_pipeline);
+    sbAssert(VK_NULL_HANDLE == _vk_image.image);
+
+    _depth_ext = depth_ext;
+    _level_0_ext = {sbstd::max(depth_ext.width / 2, 1U), sbstd::max(depth_ext.height / 2, 1U)};
+    _sample_cnt = numericConv<u32>(sample_cnt);
+
+    // full mip chain, level L is level 0 halved L times and rounded down
+    _level_cnt = 1;
+    while ((0 != (_level_0_ext.width >> _level_cnt)) || (0 != (_level_0_ext.height >> _level_cnt)))
+    {
+        ++_level_cnt;
+    }
+    sbAssert(_level_cnt <= MAX_LEVEL_COUNT);
+
+    VkResult vk_res = createVkImage(_vk_phys_device, _vk_device, _level_0_ext.width, _level_0_ext.height, _level_cnt,
+                                    VK_SAMPLE_COUNT_1_BIT, PYRAMID_FORMAT, VK_IMAGE_TILING_OPTIMAL,
+                                    VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+                                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &_vk_image);
+    if (VK_SUCCESS != vk_res)
+    {
+        sbLogE("Failed to create depth pyramid image (error = '{}')", getEnumValue(vk_res));
+        return false;
+    }
+
+    VkImageViewCreateInfo view_info = {};
+    view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    view_info.image = _vk_image.image;
+    view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    view_info.format = PYRAMID_FORMAT;
+    view_info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    view_info.subresourceRange.baseArrayLayer = 0;
+    view_info.subresourceRange.layerCount = 1;
+    view_info.subresourceRange.baseMipLevel = 0;
+    view_info.subresourceRange.levelCount = _level_cnt;
+
+    vk_res = vkCreateImageView(_vk_device, &view_info, nullptr, &_vk_image_view);
+    if (VK_SUCCESS != vk_res)
+    {
+        sbLogE("Failed to create depth pyramid image view (error = '{}')", getEnumValue(vk_res));
+        return false;
+    }
+
+    // storage images are bound one level at a time
+    view_info.subresourceRange.levelCount = 1;
+    for (u32 level_idx = 0; level_idx != _level_cnt; ++level_idx)
+    {
+        view_info.subresourceRange.baseMipLevel = level_idx;
+
+        vk_res = vkCreateImageView(_vk_device, &view_info, nullptr, &_vk_level_views[level_idx]);
+        if (VK_SUCCESS != vk_res)
+        {
+            sbLogE("Failed to create depth pyramid level view (error = '{}')", getEnumValue(vk_res));
+            return false;
+        }
+    }
+
+    VkDescriptorPoolSize pool_sizes[2] = {};
+    pool_sizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    pool_sizes[0].descriptorCount = _level_cnt + 1;
+    pool_sizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    pool_sizes[1].descriptorCount = _level_cnt * 2;
+
+    VkDescriptorPoolCreateInfo pool_info = {};
+    pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    pool_info.poolSizeCount = numericConv<u32>(sbstd::size(pool_sizes));
+    pool_info.pPoolSizes = sbstd::data(pool_sizes);
+    pool_info.maxSets = _level_cnt + 1;
+
+    vk_res = vkCreateDescriptorPool(_vk_device, &pool_info, nullptr, &_vk_desc_pool);
+    if (VK_SUCCESS != vk_res)
+    {
+        sbLogE("Failed to create depth pyramid descriptor pool (error = '{}')", getEnumValue(vk_res));
+        return false;
+    }
+
+    VkDescriptorSetLayout set_layouts[MAX_LEVEL_COUNT + 1] = {};
+    sbstd::fill_n(set_layouts, _level_cnt, _vk_reduce_desc_set_layout);
+    set_layouts[_level_cnt] = _vk_sample_desc_set_layout;
+
+    VkDescriptorSet desc_sets[MAX_LEVEL_COUNT + 1] = {};
+
+    VkDescriptorSetAllocateInfo desc_set_alloc_info = {};
+    desc_set_alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    desc_set_alloc_info.descriptorPool = _vk_desc_pool;
+    desc_set_alloc_info.descriptorSetCount = _level_cnt + 1;
+    desc_set_alloc_info.pSetLayouts = set_layouts;
+
+    vk_res = vkAllocateDescriptorSets(_vk_device, &desc_set_alloc_info, desc_sets);
+    if (VK_SUCCESS != vk_res)
+    {
+        sbLogE("Failed to allocate depth pyramid descriptor sets (error = '{}')", getEnumValue(vk_res));
+        return false;
+    }
+
+    sbstd::copy_n(desc_sets, _level_cnt, _vk_level_desc_sets);
+    _vk_sample_desc_set = desc_sets[_level_cnt];
+
+    VkDescriptorImageInfo depth_info = {};
+    depth_info.sampler = _vk_sampler;
+    depth_info.imageView = depth_view;
+    depth_info.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+
+    for (u32 level_idx = 0; level_idx != _level_cnt; ++level_idx)
+    {
+        // level 0 reads the depth attachment, its source binding is never accessed
+        VkDescriptorImageInfo src_info = {};
+        src_info.imageView = _vk_level_views[(0 == level_idx) ? 0 : (level_idx - 1)];
+        src_info.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+        VkDescriptorImageInfo dst_info = {};
+        dst_info.imageView = _vk_level_views[level_idx];
+        dst_info.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+        VkDescriptorImageInfo const * const img_infos[] = {&depth_info, &src_info, &dst_info};
+
+        VkWriteDescriptorSet write_infos[3] = {};
+        for (u32 write_idx = 0; write_idx != sbstd::size(write_infos); ++write_idx)
+        {
+            write_infos[write_idx].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            write_infos[write_idx].dstSet = _vk_level_desc_sets[level_idx];
+            write_infos[write_idx].dstBinding = write_idx;
+            write_infos[write_idx].dstArrayElement = 0;
+            write_infos[write_idx].descriptorCount = 1;
+            write_infos[write_idx].descriptorType =
+                (0 == write_idx) ? VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER : VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+            write_infos[write_idx].pImageInfo = img_infos[write_idx];
+        }
+
+        vkUpdateDescriptorSets(_vk_device, numericConv<u32>(sbstd::size(write_infos)), sbstd::data(write_infos), 0,
+                               nullptr);
+    }
+
+    VkDescriptorImageInfo pyramid_info = {};
+    pyramid_info.sampler = _vk_sampler;
+    pyramid_info.imageView = _vk_image_view;
+    pyramid_info.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+    VkWriteDescriptorSet sample_write_info = {};
+    sample_write_info.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    sample_write_info.dstSet = _vk_sample_desc_set;
+    sample_write_info.dstBinding = 0;
+    sample_write_info.dstArrayElement = 0;
+    sample_write_info.descriptorCount = 1;
+    sample_write_info.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    sample_write_info.pImageInfo = &pyramid_info;
+
+    vkUpdateDescriptorSets(_vk_device, 1, &sample_write_info, 0, nullptr);
+
+    return true;
+}
+
+void sb::DepthPyramid::retire(FrameScheduler & frame_scheduler)
+{
+    if (VK_NULL_HANDLE == _vk_image.image)
+    {
+        return;
+    }
+
+    VkDevice const device = _vk_device;
+    VkImageMem const image = _vk_image;
+    VkImageView const image_view = _vk_image_view;
+    VkDescriptorPool const desc_pool = _vk_desc_pool;
+
+    FArray<VkImageView, MAX_LEVEL_COUNT> level_views(_level_cnt, VK_NULL_HANDLE);
+    sbstd::copy_n(_vk_level_views, _level_cnt, level_views.data());
+
+    frame_scheduler.deferRelease([device, image, image_view, level_views, desc_pool]() {
+        vkDestroyDescriptorPool(device, desc_pool, nullptr);
+        for (VkImageView level_view : level_views)
+        {
+            vkDestroyImageView(device, level_view, nullptr);
+        }
+        vkDestroyImageView(device, image_view, nullptr);
+        destroyVkImage(device, image);
+    });
+
+    _vk_image = {};
+    _vk_image_view = VK_NULL_HANDLE;
+    sbstd::fill_n(_vk_level_views, MAX_LEVEL_COUNT, VK_NULL_HANDLE);
+    _vk_desc_pool = VK_NULL_HANDLE;
+    sbstd::fill_n(_vk_level_desc_sets, MAX_LEVEL_COUNT, VK_NULL_HANDLE);
+    _vk_sample_desc_set = VK_NULL_HANDLE;
+    _level_cnt = 0;
+}
+
+void sb::DepthPyramid::destroy()
+{
+    if (VK_NULL_HANDLE != _vk_desc_pool)
+    {
+        vkDestroyDescriptorPool(_vk_device, _vk_desc_pool, nullptr);
+        _vk_desc_pool = VK_NULL_HANDLE;
+    }
+
+    for (VkImageView & level_view : _vk_level_views)
+    {
+        if (VK_NULL_HANDLE != level_view)
+        {
+            vkDestroyImageView(_vk_device, level_view, nullptr);
+            level_view = VK_NULL_HANDLE;
+        }
+    }
+
+    if (VK_NULL_HANDLE != _vk_image_view)
+    {
+        vkDestroyImageView(_vk_device, _vk_image_view, nullptr);
+        _vk_image_view = VK_NULL_HANDLE;
+    }
+
+    if (VK_NULL_HANDLE != _vk_image.image)
+    {
+        destroyVkImage(_vk_device, _vk_image);
+        _vk_image = {};
+    }
+
+    sbstd::fill_n(_vk_level_desc_sets, MAX_LEVEL_COUNT, VK_NULL_HANDLE);
+    _vk_sample_desc_set = VK_NULL_HANDLE;
+    _level_cnt = 0;
+}
+
+void sb::DepthPyramid::recordReset(VkCommandBuffer cmd_buffer) const
+{
+    sbAssert(VK_NULL_HANDLE != _vk_image.image);
+
+    // every level is rewritten, the content left by the previous frame is discarded once its culling read it
+    VkImageMemoryBarrier discard_barrier = {};
+    discard_barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    discard_barrier.srcAccessMask = 0;
+    discard_barrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    discard_barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    discard_barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+    discard_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    discard_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    discard_barrier.image = _vk_image.image;
+    discard_barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    discard_barrier.subresourceRange.baseMipLevel = 0;
+    discard_barrier.subresourceRange.levelCount = _level_cnt;
+    discard_barrier.subresourceRange.baseArrayLayer = 0;
+    discard_barrier.subresourceRange.layerCount = 1;
+    vkCmdPipelineBarrier(cmd_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0,
+                         nullptr, 0, nullptr, 1, &discard_barrier);
+}
+
+void sb::DepthPyramid::recordBuild(VkCommandBuffer cmd_buffer, VkExtent2D render_ext) const
+{
+    sbAssert(VK_NULL_HANDLE != _vk_image.image);
+
+    vkCmdBindPipeline(cmd_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, _vk_pipeline);
+
+    // each level reads the one written right before
+    VkMemoryBarrier level_barrier = {};
+    level_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    level_barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    level_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+    ReduceParams params = {};
+    params.src_size[0] = numericConv<s32>(_depth_ext.width);
+    params.src_size[1] = numericConv<s32>(_depth_ext.height);
+    params.src_valid_size[0] = numericConv<s32>(sbstd::min(render_ext.width, _depth_ext.width));
+    params.src_valid_size[1] = numericConv<s32>(sbstd::min(render_ext.height, _depth_ext.height));
+    params.sample_cnt = _sample_cnt;
+
+    for (u32 level_idx = 0; level_idx != _level_cnt; ++level_idx)
+    {
+        u32 const level_width = sbstd::max(_level_0_ext.width >> level_idx, 1U);
+        u32 const level_height = sbstd::max(_level_0_ext.height >> level_idx, 1U);
+
+        params.level = level_idx;
+
+        vkCmdBindDescriptorSets(cmd_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, _vk_pipeline_layout, 0, 1,
+                                &_vk_level_desc_sets[level_idx], 0, nullptr);
+        vkCmdPushConstants(cmd_buffer, _vk_pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(params), &params);
+        vkCmdDispatch(cmd_buffer, (level_width + GROUP_SIZE - 1) / GROUP_SIZE,
+                      (level_height + GROUP_SIZE - 1) / GROUP_SIZE, 1);
+
+        vkCmdPipelineBarrier(cmd_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+                             1, &level_barrier, 0, nullptr, 0, nullptr);
+
+        // the levels above only hold depth where the level below does
+        params.src_size[0] = numericConv<s32>(level_width);
+        params.src_size[1] = numericConv<s32>(level_height);
+        params.src_valid_size[0] = params.src_size[0];
+        params.src_valid_size[1] = params.src_size[1];
+    }
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include "utility_vulkan.h"
+
+#include <vulkan/vulkan.h>
+
+#include <sb_core/core.h>
+
+namespace sb {
+
+class FrameScheduler;
+
+// Hierarchical depth of a multisampled depth attachment, built by compute for the occlusion culling
+// Level 0 holds the farthest depth of each 2x2 block of pixels and every level the farthest of each 2x2 block of the
+// level below, the last texel of a level also covering the row or column an odd size leaves over
+class DepthPyramid
+{
+public:
+    DepthPyramid() = default;
+    ~DepthPyramid() = default;
+
+    DepthPyramid(DepthPyramid const &) = delete;
+    DepthPyramid & operator=(DepthPyramid const &) = delete;
+
+    // 'reduce_shader' is depth_pyramid.comp, it can be destroyed once the pyramid is initialized
+    b8 initialize(VkPhysicalDevice phys_device, VkDevice device, VkShaderModule reduce_shader);
+    void terminate();
+
+    // Builds the pyramid images for a depth attachment of 'depth_ext', the previous ones must have been released
+    b8 create(VkImageView depth_view, VkExtent2D depth_ext, VkSampleCountFlagBits sample_cnt);
+    // Hands the images over to the frame scheduler, the frames in flight may still sample them
+    void retire(FrameScheduler & frame_scheduler);
+    void destroy();
+
+    // Discards the pyramid of the previous frame and moves it to the GENERAL layout its descriptors expect
+    // Recorded at the beginning of the frame, before any pipeline whose layout includes the sample set is dispatched
+    void recordReset(VkCommandBuffer cmd_buffer) const;
+
+    // The depth attachment must be in the DEPTH_STENCIL_READ_ONLY_OPTIMAL layout and only its top left 'render_ext'
+    // pixels hold the depth of the frame, the pyramid can be sampled by the compute shaders which follow
+    void recordBuild(VkCommandBuffer cmd_buffer, VkExtent2D render_ext) const;
+
+    // Set 1 of the shaders sampling the pyramid, the pyramid stays in the GENERAL layout
+    VkDescriptorSetLayout getSampleDescSetLayout() const
+    {
+        return _vk_sample_desc_set_layout;
+    }
+
+    VkDescriptorSet getSampleDescSet() const
+    {
+        return _vk_sample_desc_set;
+    }
+
+    u32 getLevelCount() const
+    {
+        return _level_cnt;
+    }
+
+private:
+    // a 16K attachment has 14 levels
+    static constexpr u32 MAX_LEVEL_COUNT = 16;
+    // local size of depth_pyramid.comp
+    static constexpr u32 GROUP_SIZE = 8;
+
+    // std430 push constants of depth_pyramid.comp
+    struct ReduceParams
+    {
+        s32 src_size[2];
+        s32 src_valid_size[2];
+        u32 level;
+        u32 sample_cnt;
+    };
+
+    VkPhysicalDevice _vk_phys_device = VK_NULL_HANDLE;
+    VkDevice _vk_device = VK_NULL_HANDLE;
+    VkSampler _vk_sampler = VK_NULL_HANDLE;
+    VkDescriptorSetLayout _vk_reduce_desc_set_layout = VK_NULL_HANDLE;
+    VkDescriptorSetLayout _vk_sample_desc_set_layout = VK_NULL_HANDLE;
+    VkPipelineLayout _vk_pipeline_layout = VK_NULL_HANDLE;
+    VkPipeline _vk_pipeline = VK_NULL_HANDLE;
+
+    VkImageMem _vk_image = {};
+    VkImageView _vk_image_view = VK_NULL_HANDLE;
+    VkImageView _vk_level_views[MAX_LEVEL_COUNT] = {};
+    // sets of the levels and of the sampling are freed along with the pool
+    VkDescriptorPool _vk_desc_pool = VK_NULL_HANDLE;
+    VkDescriptorSet _vk_level_desc_sets[MAX_LEVEL_COUNT] = {};
+    VkDescriptorSet _vk_sample_desc_set = VK_NULL_HANDLE;
+    VkExtent2D _depth_ext = {};
+    VkExtent2D _level_0_ext = {};
+    u32 _level_cnt = 0;
+    u32 _sample_cnt = 0;
+};
+
+} // namespace sb
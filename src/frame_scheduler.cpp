@@ -0,0 +1,385 @@
+#include "frame_scheduler.h"
+
+#include <sb_core/error/error.h>
+#include <sb_core/log.h>
+#include <sb_core/enum.h>
+
+#include <sb_std/algorithm>
+
+namespace {
+
+// A frame should never take that long, a timeout is reported before waiting again
+constexpr sb::u64 FRAME_WAIT_TIMEOUT_NS = 1'000'000'000;
+
+constexpr sb::f32 GPU_LAG_SMOOTHING = 0.1f;
+constexpr sb::f32 CPU_FRAME_TIME_SMOOTHING = 0.1f;
+
+// The completion observer wakes up at this period at most to check for exit
+constexpr sb::u64 OBSERVER_WAIT_TIMEOUT_NS = 50'000'000;
+
+// Fraction of the GPU frame time kept as margin so that the GPU does not starve on a misprediction
+constexpr sb::f32 PACING_MARGIN_RATIO = 0.15f;
+
+// Sleeping is imprecise, the end of the wait spins
+constexpr sb::f32 PACING_SPIN_MS = 1.f;
+
+auto toClockDuration(sb::f32 duration_ms)
+{
+    using Clock = std::chrono::high_resolution_clock;
+    return std::chrono::duration_cast<Clock::duration>(std::chrono::duration<sb::f32, std::milli>(duration_ms));
+}
+
+} // namespace
+
+sb::b8 sb::FrameScheduler::initialize(VkDevice device, u32 inflight_frame_cnt)
+{
+    sbAssert(VK_NULL_HANDLE == _vk_timeline_sem);
+    sbAssert(0 != inflight_frame_cnt);
+
+    _vk_device = device;
+    _inflight_frame_cnt = inflight_frame_cnt;
+    _frame_slot = 0;
+    _frame_value = INVALID_FRAME_VALUE;
+    _submitted_value = INVALID_FRAME_VALUE;
+    _gpu_lag = 0;
+    _avg_gpu_lag = 0.f;
+
+    VkSemaphoreTypeCreateInfo sem_type_info = {};
+    sem_type_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    sem_type_info.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    sem_type_info.initialValue = INVALID_FRAME_VALUE;
+
+    VkSemaphoreCreateInfo sem_info = {};
+    sem_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    sem_info.pNext = &sem_type_info;
+
+    VkResult const vk_res = vkCreateSemaphore(_vk_device, &sem_info, nullptr, &_vk_timeline_sem);
+    if (VK_SUCCESS != vk_res)
+    {
+        sbLogE("Failed to create Vulkan timeline semaphore (error = '{}')", getEnumValue(vk_res));
+        return false;
+    }
+
+    _completion_sample_cnt = 0;
+    _cpu_frame_ms = 0.f;
+    _pacing_sleep_ms = 0.f;
+
+    if (_low_latency_pacing)
+    {
+        startCompletionObserver();
+    }
+
+    return true;
+}
+
+void sb::FrameScheduler::terminate()
+{
+    stopCompletionObserver();
+    releaseAll();
+
+    if (VK_NULL_HANDLE != _vk_timeline_sem)
+    {
+        vkDestroySemaphore(_vk_device, _vk_timeline_sem, nullptr);
+        _vk_timeline_sem = VK_NULL_HANDLE;
+    }
+
+    _image_values.clear();
+    _vk_device = VK_NULL_HANDLE;
+}
+
+sb::b8 sb::FrameScheduler::beginFrame()
+{
+    u64 const completed_value = getCompletedValue();
+
+    _gpu_lag = _submitted_value - sbstd::min(completed_value, _submitted_value);
+    _avg_gpu_lag += ((f32)_gpu_lag - _avg_gpu_lag) * GPU_LAG_SMOOTHING;
+
+    // a frame which is not submitted gives its value and slot to the next one
+    _frame_value = _submitted_value + 1;
+    _frame_slot = _frame_value % _inflight_frame_cnt;
+
+    // the frame that used this slot before
+    if (_frame_value > _inflight_frame_cnt)
+    {
+        u64 const slot_value = _frame_value - _inflight_frame_cnt;
+
+        if (!waitForValue(slot_value))
+        {
+            return false;
+        }
+
+        releaseCompleted(sbstd::max(completed_value, slot_value));
+    }
+    else
+    {
+        releaseCompleted(completed_value);
+    }
+
+    if (_low_latency_pacing)
+    {
+        paceFrame();
+    }
+
+    _frame_start_time = Clock::now();
+
+    return true;
+}
+
+sb::b8 sb::FrameScheduler::acquireImage(u32 img_idx)
+{
+    sbAssert(img_idx < _image_values.size());
+
+    u64 & img_value = _image_values[img_idx];
+
+    if (!waitForValue(img_value))
+    {
+        return false;
+    }
+
+    img_value = _frame_value;
+
+    return true;
+}
+
+void sb::FrameScheduler::endFrame()
+{
+    sbAssert(_frame_value == (_submitted_value + 1));
+
+    _submitted_value = _frame_value;
+
+    f32 const frame_ms = std::chrono::duration<f32, std::milli>(Clock::now() - _frame_start_time).count();
+    _cpu_frame_ms += (frame_ms - _cpu_frame_ms) * CPU_FRAME_TIME_SMOOTHING;
+}
+
+void sb::FrameScheduler::setImageCount(u32 img_cnt)
+{
+    _image_values.clear();
+    _image_values.resize(img_cnt, INVALID_FRAME_VALUE);
+}
+
+sb::b8 sb::FrameScheduler::waitForValue(u64 value)
+{
+    if (INVALID_FRAME_VALUE == value)
+    {
+        return true;
+    }
+
+    VkSemaphoreWaitInfo wait_info = {};
+    wait_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+    wait_info.semaphoreCount = 1;
+    wait_info.pSemaphores = &_vk_timeline_sem;
+    wait_info.pValues = &value;
+
+    for (;;)
+    {
+        VkResult const vk_res = vkWaitSemaphores(_vk_device, &wait_info, FRAME_WAIT_TIMEOUT_NS);
+
+        if (VK_SUCCESS == vk_res)
+        {
+            return true;
+        }
+
+        if (VK_TIMEOUT != vk_res)
+        {
+            sbLogE("Failed to wait for frame {} (error = '{}')", value, getEnumValue(vk_res));
+            return false;
+        }
+
+        sbLogW("Frame {} still not completed by the GPU after {} ms (completed frame = {})", value,
+               FRAME_WAIT_TIMEOUT_NS / 1'000'000, getCompletedValue());
+    }
+}
+
+void sb::FrameScheduler::deferRelease(u64 value, ReleaseFunc func)
+{
+    // nothing has been submitted yet
+    if (INVALID_FRAME_VALUE == value)
+    {
+        func();
+        return;
+    }
+
+    // kept sorted so that the completed releases are always at the front
+    auto const insert_iter = sbstd::upper_bound(
+        begin(_deferred_releases), end(_deferred_releases), value,
+        [](u64 release_value, DeferredRelease const & release) { return release_value < release.value; });
+
+    _deferred_releases.insert(insert_iter, {value, sbstd::move(func)});
+}
+
+void sb::FrameScheduler::releaseCompleted(u64 completed_value)
+{
+    auto release_iter = begin(_deferred_releases);
+
+    while ((release_iter != end(_deferred_releases)) && (release_iter->value <= completed_value))
+    {
+        release_iter->func();
+        ++release_iter;
+    }
+
+    _deferred_releases.erase(begin(_deferred_releases), release_iter);
+}
+
+void sb::FrameScheduler::releaseAll()
+{
+    for (auto & release : _deferred_releases)
+    {
+        release.func();
+    }
+
+    _deferred_releases.clear();
+}
+
+void sb::FrameScheduler::setLowLatencyPacing(b8 enable)
+{
+    if (enable == _low_latency_pacing)
+    {
+        return;
+    }
+
+    _low_latency_pacing = enable;
+
+    if (VK_NULL_HANDLE == _vk_timeline_sem)
+    {
+        return;
+    }
+
+    if (enable)
+    {
+        startCompletionObserver();
+    }
+    else
+    {
+        stopCompletionObserver();
+    }
+}
+
+void sb::FrameScheduler::startCompletionObserver()
+{
+    sbAssert(!_completion_observer.joinable());
+
+    {
+        std::lock_guard<std::mutex> lock(_completion_history_mutex);
+        _completion_sample_cnt = 0;
+    }
+
+    _observer_exit_requested = false;
+    _completion_observer = std::thread([this]() { observeCompletions(); });
+}
+
+void sb::FrameScheduler::stopCompletionObserver()
+{
+    if (_completion_observer.joinable())
+    {
+        _observer_exit_requested = true;
+        _completion_observer.join();
+    }
+
+    _pacing_sleep_ms = 0.f;
+}
+
+void sb::FrameScheduler::observeCompletions()
+{
+    u64 next_value = getCompletedValue() + 1;
+
+    VkSemaphoreWaitInfo wait_info = {};
+    wait_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+    wait_info.semaphoreCount = 1;
+    wait_info.pSemaphores = &_vk_timeline_sem;
+    wait_info.pValues = &next_value;
+
+    while (!_observer_exit_requested.load())
+    {
+        VkResult const vk_res = vkWaitSemaphores(_vk_device, &wait_info, OBSERVER_WAIT_TIMEOUT_NS);
+        if (VK_TIMEOUT == vk_res)
+        {
+            continue;
+        }
+
+        if (VK_SUCCESS != vk_res)
+        {
+            sbLogE("Failed to observe frame completion (error = '{}')", getEnumValue(vk_res));
+            break;
+        }
+
+        auto const completion_time = Clock::now();
+
+        // several frames may have completed at once, the sample is only exact for the last one
+        u64 const completed_value = getCompletedValue();
+
+        {
+            std::lock_guard<std::mutex> lock(_completion_history_mutex);
+            _completion_history[_completion_sample_cnt % COMPLETION_HISTORY_SIZE] = {completed_value, completion_time};
+            ++_completion_sample_cnt;
+        }
+
+        next_value = completed_value + 1;
+    }
+}
+
+void sb::FrameScheduler::paceFrame()
+{
+    _pacing_sleep_ms = 0.f;
+
+    CompletionSample first_sample;
+    CompletionSample last_sample;
+
+    {
+        std::lock_guard<std::mutex> lock(_completion_history_mutex);
+
+        if (_completion_sample_cnt < 2)
+        {
+            return;
+        }
+
+        u32 const sample_cnt = sbstd::min(_completion_sample_cnt, COMPLETION_HISTORY_SIZE);
+        first_sample = _completion_history[(_completion_sample_cnt - sample_cnt) % COMPLETION_HISTORY_SIZE];
+        last_sample = _completion_history[(_completion_sample_cnt - 1) % COMPLETION_HISTORY_SIZE];
+    }
+
+    if ((last_sample.value <= first_sample.value) || (last_sample.value >= _frame_value))
+    {
+        // the GPU already caught up with the CPU, starting right away is the best we can do
+        return;
+    }
+
+    // when GPU bound, frames complete at the GPU frame rate
+    f32 const gpu_frame_ms = std::chrono::duration<f32, std::milli>(last_sample.time - first_sample.time).count() /
+                             (f32)(last_sample.value - first_sample.value);
+
+    // the new frame should be submitted right when the GPU is done with the frames already queued
+    u64 const queued_frame_cnt = _submitted_value - last_sample.value;
+    f32 const start_offset_ms = gpu_frame_ms * ((f32)queued_frame_cnt - PACING_MARGIN_RATIO) - _cpu_frame_ms;
+    auto const start_time = last_sample.time + toClockDuration(start_offset_ms);
+
+    auto const now = Clock::now();
+    if (start_time <= now)
+    {
+        return;
+    }
+
+    // never sleep longer than the frames queued would take in case the prediction went wrong
+    auto const max_start_time = now + toClockDuration(gpu_frame_ms * (f32)queued_frame_cnt);
+    auto const wakeup_time = sbstd::min(start_time, max_start_time);
+
+    auto const spin_duration = toClockDuration(PACING_SPIN_MS);
+    if ((wakeup_time - now) > spin_duration)
+    {
+        std::this_thread::sleep_until(wakeup_time - spin_duration);
+    }
+
+    while (Clock::now() < wakeup_time)
+    {
+        std::this_thread::yield();
+    }
+
+    _pacing_sleep_ms = std::chrono::duration<f32, std::milli>(Clock::now() - now).count();
+}
+
+sb::u64 sb::FrameScheduler::getCompletedValue() const
+{
+    u64 completed_value = INVALID_FRAME_VALUE;
+    vkGetSemaphoreCounterValue(_vk_device, _vk_timeline_sem, &completed_value);
+
+    return completed_value;
+}
@@ -0,0 +1,174 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <sb_core/core.h>
+#include <sb_core/container/dynamic_array.h>
+
+#include <sb_std/utility>
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace sb {
+
+// Paces the CPU against the GPU with a single timeline semaphore
+// Every submitted frame gets a monotonic value signaled by the GPU once the frame is done
+// so that any resource used by a frame can be recycled once the completed value reaches it
+class FrameScheduler
+{
+public:
+    static constexpr u64 INVALID_FRAME_VALUE = 0;
+
+    using ReleaseFunc = std::function<void()>;
+
+    FrameScheduler() = default;
+    ~FrameScheduler() = default;
+
+    FrameScheduler(FrameScheduler const &) = delete;
+    FrameScheduler & operator=(FrameScheduler const &) = delete;
+
+    b8 initialize(VkDevice device, u32 inflight_frame_cnt);
+    void terminate();
+
+    // Waits for the frame that last used the next frame slot and opens a new frame
+    // Its value and slot follow the last submitted frame and are only committed by endFrame(), a frame which returns
+    // before its submission leaves them to the next one
+    // With low latency pacing, it then sleeps until the frame can start just in time for the GPU
+    b8 beginFrame();
+
+    // Waits for the last frame which rendered to the swapchain image and tags it with the current frame
+    b8 acquireImage(u32 img_idx);
+
+    // The current frame has been submitted, signaling getFrameValue() on getTimelineSemaphore()
+    void endFrame();
+
+    // The swapchain has been (re)created, its images have never been rendered to
+    void setImageCount(u32 img_cnt);
+
+    // Blocks until the GPU timeline reaches the value
+    b8 waitForValue(u64 value);
+
+    // Runs the function once the GPU timeline reaches the value, releases are checked at the beginning of each frame
+    void deferRelease(u64 value, ReleaseFunc func);
+
+    // Defers the release until the current frame is done
+    void deferRelease(ReleaseFunc func)
+    {
+        deferRelease(_frame_value, sbstd::move(func));
+    }
+
+    // Runs every pending release, the device must be idle
+    void releaseAll();
+
+    u64 getCompletedValue() const;
+
+    VkSemaphore getTimelineSemaphore() const
+    {
+        return _vk_timeline_sem;
+    }
+
+    u64 getFrameValue() const
+    {
+        return _frame_value;
+    }
+
+    u32 getFrameSlot() const
+    {
+        return _frame_slot;
+    }
+
+    // Value of the last frame committed by endFrame(), it only changes once a frame has been submitted
+    u64 getSubmittedValue() const
+    {
+        return _submitted_value;
+    }
+
+    u32 getInflightFrameCount() const
+    {
+        return _inflight_frame_cnt;
+    }
+
+    // Number of submitted frames the GPU had not completed when the current frame began
+    u64 getGpuLag() const
+    {
+        return _gpu_lag;
+    }
+
+    // Exponential moving average of getGpuLag()
+    f32 getAverageGpuLag() const
+    {
+        return _avg_gpu_lag;
+    }
+
+    // Delays the beginning of the frames so that the inputs are sampled as late as possible
+    // A thread records when the GPU completes each frame to predict when the next submission can start
+    void setLowLatencyPacing(b8 enable);
+
+    b8 isLowLatencyPacingEnabled() const
+    {
+        return _low_latency_pacing;
+    }
+
+    // Time the CPU slept in the last beginFrame() to pace the frame
+    f32 getPacingSleepMs() const
+    {
+        return _pacing_sleep_ms;
+    }
+
+private:
+    struct DeferredRelease
+    {
+        u64 value;
+        ReleaseFunc func;
+    };
+
+    using Clock = std::chrono::high_resolution_clock;
+
+    struct CompletionSample
+    {
+        u64 value;
+        Clock::time_point time;
+    };
+
+    static constexpr u32 COMPLETION_HISTORY_SIZE = 16;
+
+    void releaseCompleted(u64 completed_value);
+
+    void startCompletionObserver();
+    void stopCompletionObserver();
+    void observeCompletions();
+    void paceFrame();
+
+    VkDevice _vk_device = VK_NULL_HANDLE;
+    VkSemaphore _vk_timeline_sem = VK_NULL_HANDLE;
+
+    u32 _inflight_frame_cnt = 0;
+    u32 _frame_slot = 0;
+    u64 _frame_value = INVALID_FRAME_VALUE;
+    u64 _submitted_value = INVALID_FRAME_VALUE;
+
+    // value of the last frame which rendered to each swapchain image
+    DArray<u64> _image_values;
+
+    DArray<DeferredRelease> _deferred_releases;
+
+    u64 _gpu_lag = 0;
+    f32 _avg_gpu_lag = 0.f;
+
+    b8 _low_latency_pacing = false;
+    std::thread _completion_observer;
+    std::atomic<b8> _observer_exit_requested = false;
+    std::mutex _completion_history_mutex;
+    CompletionSample _completion_history[COMPLETION_HISTORY_SIZE] = {};
+    u32 _completion_sample_cnt = 0;
+
+    Clock::time_point _frame_start_time;
+    f32 _cpu_frame_ms = 0.f;
+    f32 _pacing_sleep_ms = 0.f;
+};
+
+} // namespace sb
@@ -0,0 +1,250 @@
+#include "geometry_arena.h"
+#include "frame_scheduler.h"
+
+#include <sb_core/error/error.h>
+#include <sb_core/log.h>
+#include <sb_core/enum.h>
+
+#include <sb_std/algorithm>
+#include <sb_std/iterator>
+
+void sb::RangeAllocator::initialize(u32 capacity)
+{
+    _free_ranges.clear();
+    _free_ranges.push_back({0, capacity});
+}
+
+sb::u32 sb::RangeAllocator::allocate(u32 cnt)
+{
+    if (0 == cnt)
+    {
+        return 0;
+    }
+
+    auto const range_iter = sbstd::find_if(begin(_free_ranges), end(_free_ranges),
+                                           [cnt](FreeRange const & range) { return cnt <= range.cnt; });
+    if (range_iter == end(_free_ranges))
+    {
+        return INVALID_OFFSET;
+    }
+
+    u32 const offset = range_iter->offset;
+    range_iter->offset += cnt;
+    range_iter->cnt -= cnt;
+
+    if (0 == range_iter->cnt)
+    {
+        _free_ranges.erase(range_iter);
+    }
+
+    return offset;
+}
+
+void sb::RangeAllocator::release(u32 offset, u32 cnt)
+{
+    if (0 == cnt)
+    {
+        return;
+    }
+
+    auto const next_iter = sbstd::find_if(begin(_free_ranges), end(_free_ranges),
+                                          [offset](FreeRange const & range) { return offset < range.offset; });
+    sbAssert((next_iter == end(_free_ranges)) || ((offset + cnt) <= next_iter->offset));
+
+    // merged with the free ranges right before and right after it
+    b8 const merge_prev = (next_iter != begin(_free_ranges)) &&
+                          ((sbstd::prev(next_iter)->offset + sbstd::prev(next_iter)->cnt) == offset);
+    b8 const merge_next = (next_iter != end(_free_ranges)) && ((offset + cnt) == next_iter->offset);
+
+    if (merge_prev)
+    {
+        sbstd::prev(next_iter)->cnt += cnt + (merge_next ? next_iter->cnt : 0);
+        if (merge_next)
+        {
+            _free_ranges.erase(next_iter);
+        }
+    }
+    else if (merge_next)
+    {
+        next_iter->offset = offset;
+        next_iter->cnt += cnt;
+    }
+    else
+    {
+        _free_ranges.insert(next_iter, {offset, cnt});
+    }
+}
+
+sb::u32 sb::RangeAllocator::getFreeCount() const
+{
+    u32 free_cnt = 0;
+    for (FreeRange const & range : _free_ranges)
+    {
+        free_cnt += range.cnt;
+    }
+
+    return free_cnt;
+}
+
+sb::b8 sb::GeometryArena::initialize(VkPhysicalDevice phys_device, VkDevice device, VkCommandPool cmd_pool,
+                                     VkQueue queue, u32 const (&vtx_capacities)[VERTEX_FORMAT_COUNT],
+                                     u32 idx_capacity, VkBufferUsageFlags ib_usage)
+{
+    sbAssert(VK_NULL_HANDLE == _positions.buffer);
+
+    _vk_phys_device = phys_device;
+    _vk_device = device;
+
+    // the vertices of the formats follow each other, their attributes follow the table
+    u32 vtx_capacity = 0;
+    u32 attribute_word_capacity = VERTEX_FORMAT_COUNT;
+    for (u32 format = 0; format != VERTEX_FORMAT_COUNT; ++format)
+    {
+        _first_vertices[format] = vtx_capacity;
+        u32 const attribute_word_cnt = VERTEX_ATTRIBUTE_WORD_COUNTS[format];
+        _first_attribute_words[format] = attribute_word_capacity - vtx_capacity * attribute_word_cnt;
+        _vertex_ranges[format].initialize(vtx_capacities[format]);
+
+        vtx_capacity += vtx_capacities[format];
+        attribute_word_capacity += vtx_capacities[format] * attribute_word_cnt;
+    }
+
+    // any vertex index has to leave the format bits free
+    sbAssert(vtx_capacity <= (1U << VERTEX_FORMAT_SHIFT));
+
+    VkDeviceSize const position_size = VERTEX_POSITION_WORD_COUNT * sizeof(u32);
+    VkResult vk_res = createVkBuffer(_vk_phys_device, _vk_device, vtx_capacity * position_size,
+                                     VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &_positions);
+    if (VK_SUCCESS != vk_res)
+    {
+        sbLogE("Failed to create Vulkan geometry arena position buffer (error = '{}')", getEnumValue(vk_res));
+        return false;
+    }
+
+    vk_res = createVkBuffer(_vk_phys_device, _vk_device, (VkDeviceSize)attribute_word_capacity * sizeof(u32),
+                            VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &_attributes);
+    if (VK_SUCCESS != vk_res)
+    {
+        sbLogE("Failed to create Vulkan geometry arena attribute buffer (error = '{}')", getEnumValue(vk_res));
+        return false;
+    }
+
+    vk_res = uploadVkBufferDataToDevice(_vk_phys_device, _vk_device, _first_attribute_words,
+                                        sizeof(_first_attribute_words), cmd_pool, queue, _attributes.buffer);
+    if (VK_SUCCESS != vk_res)
+    {
+        sbLogE("Failed to upload Vulkan geometry arena attribute table (error = '{}')", getEnumValue(vk_res));
+        return false;
+    }
+
+    vk_res = createVkBuffer(_vk_phys_device, _vk_device, (VkDeviceSize)idx_capacity * sizeof(u32),
+                            VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT | ib_usage,
+                            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &_ib);
+    if (VK_SUCCESS != vk_res)
+    {
+        sbLogE("Failed to create Vulkan geometry arena IB (error = '{}')", getEnumValue(vk_res));
+        return false;
+    }
+
+    _index_ranges.initialize(idx_capacity);
+
+    return true;
+}
+
+void sb::GeometryArena::terminate()
+{
+    if (VK_NULL_HANDLE == _vk_device)
+    {
+        return;
+    }
+
+    destroyVkBuffer(_vk_device, _positions);
+    destroyVkBuffer(_vk_device, _attributes);
+    destroyVkBuffer(_vk_device, _ib);
+    _positions = {};
+    _attributes = {};
+    _ib = {};
+    _vk_device = VK_NULL_HANDLE;
+    _vk_phys_device = VK_NULL_HANDLE;
+}
+
+sb::b8 sb::GeometryArena::addMesh(VkCommandPool cmd_pool, VkQueue queue, VertexFormat format, f32 const * positions,
+                                  void const * attributes, u32 vtx_cnt, u32 const * indices, u32 idx_cnt,
+                                  GeometryMesh * mesh)
+{
+    sbAssert(nullptr != mesh);
+    sbAssert(format < VERTEX_FORMAT_COUNT);
+
+    u32 const format_vertex = _vertex_ranges[format].allocate(vtx_cnt);
+    if (RangeAllocator::INVALID_OFFSET == format_vertex)
+    {
+        sbLogE("Failed to allocate {} vertices from the geometry arena ({} free)", vtx_cnt,
+               _vertex_ranges[format].getFreeCount());
+        return false;
+    }
+
+    u32 const first_index = _index_ranges.allocate(idx_cnt);
+    if (RangeAllocator::INVALID_OFFSET == first_index)
+    {
+        sbLogE("Failed to allocate {} indices from the geometry arena ({} free)", idx_cnt,
+               _index_ranges.getFreeCount());
+        _vertex_ranges[format].release(format_vertex, vtx_cnt);
+        return false;
+    }
+
+    u32 const first_vertex = _first_vertices[format] + format_vertex;
+    *mesh = {first_vertex, vtx_cnt, first_index, idx_cnt, format,
+             numericConv<s32>(first_vertex | (format << VERTEX_FORMAT_SHIFT))};
+
+    VkDeviceSize const position_size = VERTEX_POSITION_WORD_COUNT * sizeof(u32);
+    VkResult vk_res = uploadVkBufferDataToDevice(_vk_phys_device, _vk_device, const_cast<f32 *>(positions),
+                                                 vtx_cnt * position_size, cmd_pool, queue, _positions.buffer,
+                                                 first_vertex * position_size);
+    if (VK_SUCCESS != vk_res)
+    {
+        sbLogE("Failed to upload Vulkan mesh positions (error = '{}')", getEnumValue(vk_res));
+        removeMesh(*mesh);
+        return false;
+    }
+
+    u32 const attribute_word_cnt = VERTEX_ATTRIBUTE_WORD_COUNTS[format];
+    VkDeviceSize const attribute_size = attribute_word_cnt * sizeof(u32);
+    u32 const first_attribute_word = _first_attribute_words[format] + first_vertex * attribute_word_cnt;
+    vk_res = uploadVkBufferDataToDevice(_vk_phys_device, _vk_device, const_cast<void *>(attributes),
+                                        vtx_cnt * attribute_size, cmd_pool, queue, _attributes.buffer,
+                                        first_attribute_word * sizeof(u32));
+    if (VK_SUCCESS != vk_res)
+    {
+        sbLogE("Failed to upload Vulkan mesh attributes (error = '{}')", getEnumValue(vk_res));
+        removeMesh(*mesh);
+        return false;
+    }
+
+    if (0 != idx_cnt)
+    {
+        vk_res = uploadVkBufferDataToDevice(_vk_phys_device, _vk_device, const_cast<u32 *>(indices),
+                                            idx_cnt * sizeof(u32), cmd_pool, queue, _ib.buffer,
+                                            first_index * sizeof(u32));
+        if (VK_SUCCESS != vk_res)
+        {
+            sbLogE("Failed to upload Vulkan mesh indices (error = '{}')", getEnumValue(vk_res));
+            removeMesh(*mesh);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void sb::GeometryArena::removeMesh(GeometryMesh const & mesh)
+{
+    _vertex_ranges[mesh.format].release(mesh.first_vertex - _first_vertices[mesh.format], mesh.vtx_cnt);
+    _index_ranges.release(mesh.first_index, mesh.idx_cnt);
+}
+
+void sb::GeometryArena::retireMesh(FrameScheduler & frame_scheduler, GeometryMesh const & mesh)
+{
+    frame_scheduler.deferRelease([this, mesh]() { removeMesh(mesh); });
+}
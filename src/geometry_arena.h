@@ -0,0 +1,127 @@
+#pragma once
+
+#include "utility_vulkan.h"
+
+#include <vulkan/vulkan.h>
+
+#include <sb_core/core.h>
+#include <sb_core/container/dynamic_array.h>
+
+namespace sb {
+
+class FrameScheduler;
+
+// First fit allocator of element ranges, the free ranges are sorted by offset and merged with their neighbours
+class RangeAllocator
+{
+public:
+    static constexpr u32 INVALID_OFFSET = ~0U;
+
+    void initialize(u32 capacity);
+
+    // Returns INVALID_OFFSET when no free range is large enough
+    u32 allocate(u32 cnt);
+    void release(u32 offset, u32 cnt);
+
+    u32 getFreeCount() const;
+
+private:
+    struct FreeRange
+    {
+        u32 offset;
+        u32 cnt;
+    };
+
+    DArray<FreeRange> _free_ranges;
+};
+
+// Layouts of the vertex attributes in a GeometryArena, decoded by the vertex shaders from the vertex index
+// The positions are stored apart as f32[3] whatever the format, for the passes reading only them
+// VERTEX_FORMAT_FULL: f32 color[3], f32 tex_coords[2]
+// VERTEX_FORMAT_PACKED: unorm8 color[4], f16 tex_coords[2]
+enum VertexFormat : u32
+{
+    VERTEX_FORMAT_FULL,
+    VERTEX_FORMAT_PACKED,
+    VERTEX_FORMAT_COUNT
+};
+
+static constexpr u32 VERTEX_POSITION_WORD_COUNT = 3;
+static constexpr u32 VERTEX_ATTRIBUTE_WORD_COUNTS[VERTEX_FORMAT_COUNT] = {5, 2};
+
+// The format of a mesh is stored above the vertex index bits, a vertex index and its format fit in a s32
+static constexpr u32 VERTEX_FORMAT_SHIFT = 28;
+
+// Vertex and index ranges of a mesh in the buffers of a GeometryArena
+// The indices are relative to the first vertex, the draws pass 'vertex_offset' as their vertex offset
+struct GeometryMesh
+{
+    u32 first_vertex = 0; // in the vertex range of the mesh format
+    u32 vtx_cnt = 0;
+    u32 first_index = 0;
+    u32 idx_cnt = 0; // 0 for non indexed meshes
+    VertexFormat format = VERTEX_FORMAT_FULL;
+    s32 vertex_offset = 0; // first vertex with the format in the high bits
+};
+
+// Position, attribute and index buffers shared by every mesh, the vertices of any format are pulled by the vertex
+// shaders from the storage buffers so that a single pipeline draws them all
+// Each format owns a range of the vertices, whose attributes follow a table of VERTEX_FORMAT_COUNT words in the
+// attribute buffer: the word of the attributes of vertex 0 of each format, modulo 2^32
+// Meshes are sub-allocated from free lists, they are added and removed while no frame is rendered, at startup and
+// shutdown, only retireMesh() removes one while rendering
+class GeometryArena
+{
+public:
+    GeometryArena() = default;
+    ~GeometryArena() = default;
+
+    GeometryArena(GeometryArena const &) = delete;
+    GeometryArena & operator=(GeometryArena const &) = delete;
+
+    // 'vtx_capacities' holds the vertex count of each format, the table of the attribute buffer is uploaded with
+    // 'cmd_pool' and 'queue'
+    // 'ib_usage' is added to the usage of the index buffer, for the passes reading the indices from storage buffers
+    b8 initialize(VkPhysicalDevice phys_device, VkDevice device, VkCommandPool cmd_pool, VkQueue queue,
+                  u32 const (&vtx_capacities)[VERTEX_FORMAT_COUNT], u32 idx_capacity, VkBufferUsageFlags ib_usage);
+    void terminate();
+
+    // Uploads the mesh through a staging buffer and waits for the copy, 'attributes' are laid out as 'format' and
+    // 'idx_cnt' can be 0
+    // Startup only: the copy is submitted to 'queue' from 'cmd_pool' without the locks of the rendering and present
+    // threads
+    b8 addMesh(VkCommandPool cmd_pool, VkQueue queue, VertexFormat format, f32 const * positions,
+               void const * attributes, u32 vtx_cnt, u32 const * indices, u32 idx_cnt, GeometryMesh * mesh);
+    // The ranges are free right away, no frame in flight may draw the mesh anymore
+    void removeMesh(GeometryMesh const & mesh);
+    // Frees the ranges once the current frame of 'frame_scheduler' is done, from the thread rendering
+    void retireMesh(FrameScheduler & frame_scheduler, GeometryMesh const & mesh);
+
+    VkBuffer getPositionBuffer() const
+    {
+        return _positions.buffer;
+    }
+
+    VkBuffer getAttributeBuffer() const
+    {
+        return _attributes.buffer;
+    }
+
+    VkBuffer getIndexBuffer() const
+    {
+        return _ib.buffer;
+    }
+
+private:
+    VkPhysicalDevice _vk_phys_device = VK_NULL_HANDLE;
+    VkDevice _vk_device = VK_NULL_HANDLE;
+    VkBufferMem _positions = {};
+    VkBufferMem _attributes = {};
+    VkBufferMem _ib = {};
+    u32 _first_vertices[VERTEX_FORMAT_COUNT] = {};
+    u32 _first_attribute_words[VERTEX_FORMAT_COUNT] = {}; // the table of the attribute buffer
+    RangeAllocator _vertex_ranges[VERTEX_FORMAT_COUNT]; // relative to the first vertex of each format
+    RangeAllocator _index_ranges;
+};
+
+} // namespace sb
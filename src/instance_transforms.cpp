@@ -0,0 +1,427 @@
+#include "instance_transforms.h"
+#include "simd.h"
+
+#include <sb_core/error/error.h>
+#include <sb_core/conversion.h>
+
+#include <cmath>
+
+namespace {
+
+constexpr sb::u32 MATRIX_FLOAT_CNT = 16;
+
+void computeSpinningTransformsScalar(sb::SpinningInstances const & instances, sb::f32 angle_cos, sb::f32 angle_sin,
+                                     sb::f32 const * view_proj, sb::u32 const * instance_indices, sb::u32 first,
+                                     sb::u32 last, sb::f32 * transforms)
+{
+    for (sb::u32 slot_idx = first; slot_idx != last; ++slot_idx)
+    {
+        sb::u32 const instance_idx = (nullptr != instance_indices) ? instance_indices[slot_idx] : slot_idx;
+        sb::f32 const phase_cos = instances.phase_cos[instance_idx];
+        sb::f32 const phase_sin = instances.phase_sin[instance_idx];
+        sb::f32 const scale = instances.scale[instance_idx];
+        sb::f32 const rot_cos = (angle_cos * phase_cos - angle_sin * phase_sin) * scale;
+        sb::f32 const rot_sin = (angle_sin * phase_cos + angle_cos * phase_sin) * scale;
+        sb::f32 const pos_x = instances.pos_x[instance_idx];
+        sb::f32 const pos_y = instances.pos_y[instance_idx];
+        sb::f32 const pos_z = instances.pos_z[instance_idx];
+
+        // world = [rot_cos, rot_sin, 0, 0 | -rot_sin, rot_cos, 0, 0 | 0, 0, scale, 0 | pos_x, pos_y, pos_z, 1]
+        sb::f32 * const transform = transforms + slot_idx * MATRIX_FLOAT_CNT;
+
+        for (sb::u32 row_idx = 0; row_idx != 4; ++row_idx)
+        {
+            sb::f32 const vp0 = view_proj[row_idx];
+            sb::f32 const vp1 = view_proj[4 + row_idx];
+            sb::f32 const vp2 = view_proj[8 + row_idx];
+            sb::f32 const vp3 = view_proj[12 + row_idx];
+
+            transform[row_idx] = vp0 * rot_cos + vp1 * rot_sin;
+            transform[4 + row_idx] = vp1 * rot_cos - vp0 * rot_sin;
+            transform[8 + row_idx] = vp2 * scale;
+            transform[12 + row_idx] = vp0 * pos_x + vp1 * pos_y + vp2 * pos_z + vp3;
+        }
+    }
+}
+
+#if SB_SIMD_X64
+
+// Loads the 8 values of 'stream' read by the slots starting at 'slot_idx'
+SB_TARGET_AVX2 inline __m256 loadStreamAvx2(sb::DArray<sb::f32> const & stream, sb::u32 const * instance_indices,
+                                           sb::u32 slot_idx)
+{
+    if (nullptr == instance_indices)
+    {
+        return _mm256_loadu_ps(&stream[slot_idx]);
+    }
+
+    __m256i const indices = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(instance_indices + slot_idx));
+    return _mm256_i32gather_ps(stream.data(), indices, sizeof(sb::f32));
+}
+
+inline __m128 loadStreamSse(sb::DArray<sb::f32> const & stream, sb::u32 const * instance_indices, sb::u32 slot_idx)
+{
+    if (nullptr == instance_indices)
+    {
+        return _mm_loadu_ps(&stream[slot_idx]);
+    }
+
+    sb::u32 const * const indices = instance_indices + slot_idx;
+    return _mm_setr_ps(stream[indices[0]], stream[indices[1]], stream[indices[2]], stream[indices[3]]);
+}
+
+// 8 instances per iteration, each of the 16 outputs is computed for all the lanes then transposed to a matrix per lane
+SB_TARGET_AVX2 sb::u32 computeSpinningTransformsAvx2(sb::SpinningInstances const & instances, sb::f32 angle_cos,
+                                                     sb::f32 angle_sin, sb::f32 const * view_proj,
+                                                     sb::u32 const * instance_indices, sb::u32 first, sb::u32 last,
+                                                     sb::f32 * transforms)
+{
+    __m256 const angle_cos8 = _mm256_set1_ps(angle_cos);
+    __m256 const angle_sin8 = _mm256_set1_ps(angle_sin);
+
+    __m256 vp[MATRIX_FLOAT_CNT];
+    for (sb::u32 elem_idx = 0; elem_idx != MATRIX_FLOAT_CNT; ++elem_idx)
+    {
+        vp[elem_idx] = _mm256_set1_ps(view_proj[elem_idx]);
+    }
+
+    sb::u32 slot_idx = first;
+
+    for (sb::u32 const simd_last = first + ((last - first) & ~7U); slot_idx != simd_last; slot_idx += 8)
+    {
+        __m256 const phase_cos = loadStreamAvx2(instances.phase_cos, instance_indices, slot_idx);
+        __m256 const phase_sin = loadStreamAvx2(instances.phase_sin, instance_indices, slot_idx);
+        __m256 const scale = loadStreamAvx2(instances.scale, instance_indices, slot_idx);
+        __m256 const pos_x = loadStreamAvx2(instances.pos_x, instance_indices, slot_idx);
+        __m256 const pos_y = loadStreamAvx2(instances.pos_y, instance_indices, slot_idx);
+        __m256 const pos_z = loadStreamAvx2(instances.pos_z, instance_indices, slot_idx);
+
+        __m256 const rot_cos =
+            _mm256_mul_ps(_mm256_fmsub_ps(angle_cos8, phase_cos, _mm256_mul_ps(angle_sin8, phase_sin)), scale);
+        __m256 const rot_sin =
+            _mm256_mul_ps(_mm256_fmadd_ps(angle_sin8, phase_cos, _mm256_mul_ps(angle_cos8, phase_sin)), scale);
+
+        // rows[elem] holds the element 'elem' of the 8 matrices
+        __m256 rows[MATRIX_FLOAT_CNT];
+        for (sb::u32 row_idx = 0; row_idx != 4; ++row_idx)
+        {
+            __m256 const vp0 = vp[row_idx];
+            __m256 const vp1 = vp[4 + row_idx];
+            __m256 const vp2 = vp[8 + row_idx];
+            __m256 const vp3 = vp[12 + row_idx];
+
+            rows[row_idx] = _mm256_fmadd_ps(vp0, rot_cos, _mm256_mul_ps(vp1, rot_sin));
+            rows[4 + row_idx] = _mm256_fmsub_ps(vp1, rot_cos, _mm256_mul_ps(vp0, rot_sin));
+            rows[8 + row_idx] = _mm256_mul_ps(vp2, scale);
+            rows[12 + row_idx] =
+                _mm256_fmadd_ps(vp0, pos_x, _mm256_fmadd_ps(vp1, pos_y, _mm256_fmadd_ps(vp2, pos_z, vp3)));
+        }
+
+        // two 8x8 transposes, the first half of every matrix then the second one
+        for (sb::u32 half_idx = 0; half_idx != 2; ++half_idx)
+        {
+            __m256 const * const src = rows + half_idx * 8;
+
+            __m256 const t0 = _mm256_unpacklo_ps(src[0], src[1]);
+            __m256 const t1 = _mm256_unpackhi_ps(src[0], src[1]);
+            __m256 const t2 = _mm256_unpacklo_ps(src[2], src[3]);
+            __m256 const t3 = _mm256_unpackhi_ps(src[2], src[3]);
+            __m256 const t4 = _mm256_unpacklo_ps(src[4], src[5]);
+            __m256 const t5 = _mm256_unpackhi_ps(src[4], src[5]);
+            __m256 const t6 = _mm256_unpacklo_ps(src[6], src[7]);
+            __m256 const t7 = _mm256_unpackhi_ps(src[6], src[7]);
+
+            __m256 const s0 = _mm256_shuffle_ps(t0, t2, 0x44);
+            __m256 const s1 = _mm256_shuffle_ps(t0, t2, 0xEE);
+            __m256 const s2 = _mm256_shuffle_ps(t1, t3, 0x44);
+            __m256 const s3 = _mm256_shuffle_ps(t1, t3, 0xEE);
+            __m256 const s4 = _mm256_shuffle_ps(t4, t6, 0x44);
+            __m256 const s5 = _mm256_shuffle_ps(t4, t6, 0xEE);
+            __m256 const s6 = _mm256_shuffle_ps(t5, t7, 0x44);
+            __m256 const s7 = _mm256_shuffle_ps(t5, t7, 0xEE);
+
+            __m256 const lanes[8] = {
+                _mm256_permute2f128_ps(s0, s4, 0x20), _mm256_permute2f128_ps(s1, s5, 0x20),
+                _mm256_permute2f128_ps(s2, s6, 0x20), _mm256_permute2f128_ps(s3, s7, 0x20),
+                _mm256_permute2f128_ps(s0, s4, 0x31), _mm256_permute2f128_ps(s1, s5, 0x31),
+                _mm256_permute2f128_ps(s2, s6, 0x31), _mm256_permute2f128_ps(s3, s7, 0x31)};
+
+            sb::f32 * const transform = transforms + slot_idx * MATRIX_FLOAT_CNT + half_idx * 8;
+            for (sb::u32 lane_idx = 0; lane_idx != 8; ++lane_idx)
+            {
+                _mm256_stream_ps(transform + lane_idx * MATRIX_FLOAT_CNT, lanes[lane_idx]);
+            }
+        }
+    }
+
+    _mm_sfence();
+
+    return slot_idx;
+}
+
+// Same as the AVX2 kernel with 4 lanes, SSE2 is always available on x64
+sb::u32 computeSpinningTransformsSse(sb::SpinningInstances const & instances, sb::f32 angle_cos, sb::f32 angle_sin,
+                                     sb::f32 const * view_proj, sb::u32 const * instance_indices, sb::u32 first,
+                                     sb::u32 last, sb::f32 * transforms)
+{
+    __m128 const angle_cos4 = _mm_set1_ps(angle_cos);
+    __m128 const angle_sin4 = _mm_set1_ps(angle_sin);
+
+    sb::u32 slot_idx = first;
+
+    for (sb::u32 const simd_last = first + ((last - first) & ~3U); slot_idx != simd_last; slot_idx += 4)
+    {
+        __m128 const phase_cos = loadStreamSse(instances.phase_cos, instance_indices, slot_idx);
+        __m128 const phase_sin = loadStreamSse(instances.phase_sin, instance_indices, slot_idx);
+        __m128 const scale = loadStreamSse(instances.scale, instance_indices, slot_idx);
+        __m128 const pos_x = loadStreamSse(instances.pos_x, instance_indices, slot_idx);
+        __m128 const pos_y = loadStreamSse(instances.pos_y, instance_indices, slot_idx);
+        __m128 const pos_z = loadStreamSse(instances.pos_z, instance_indices, slot_idx);
+
+        __m128 const rot_cos =
+            _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(angle_cos4, phase_cos), _mm_mul_ps(angle_sin4, phase_sin)), scale);
+        __m128 const rot_sin =
+            _mm_mul_ps(_mm_add_ps(_mm_mul_ps(angle_sin4, phase_cos), _mm_mul_ps(angle_cos4, phase_sin)), scale);
+
+        __m128 rows[MATRIX_FLOAT_CNT];
+        for (sb::u32 row_idx = 0; row_idx != 4; ++row_idx)
+        {
+            __m128 const vp0 = _mm_set1_ps(view_proj[row_idx]);
+            __m128 const vp1 = _mm_set1_ps(view_proj[4 + row_idx]);
+            __m128 const vp2 = _mm_set1_ps(view_proj[8 + row_idx]);
+            __m128 const vp3 = _mm_set1_ps(view_proj[12 + row_idx]);
+
+            rows[row_idx] = _mm_add_ps(_mm_mul_ps(vp0, rot_cos), _mm_mul_ps(vp1, rot_sin));
+            rows[4 + row_idx] = _mm_sub_ps(_mm_mul_ps(vp1, rot_cos), _mm_mul_ps(vp0, rot_sin));
+            rows[8 + row_idx] = _mm_mul_ps(vp2, scale);
+            rows[12 + row_idx] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vp0, pos_x), _mm_mul_ps(vp1, pos_y)),
+                                            _mm_add_ps(_mm_mul_ps(vp2, pos_z), vp3));
+        }
+
+        // one 4x4 transpose per column
+        for (sb::u32 col_idx = 0; col_idx != 4; ++col_idx)
+        {
+            __m128 * const col = rows + col_idx * 4;
+            _MM_TRANSPOSE4_PS(col[0], col[1], col[2], col[3]);
+
+            for (sb::u32 lane_idx = 0; lane_idx != 4; ++lane_idx)
+            {
+                _mm_stream_ps(transforms + (slot_idx + lane_idx) * MATRIX_FLOAT_CNT + col_idx * 4, col[lane_idx]);
+            }
+        }
+    }
+
+    _mm_sfence();
+
+    return slot_idx;
+}
+
+#endif
+
+#if SB_SIMD_NEON
+
+inline float32x4_t loadStreamNeon(sb::DArray<sb::f32> const & stream, sb::u32 const * instance_indices,
+                                  sb::u32 slot_idx)
+{
+    if (nullptr == instance_indices)
+    {
+        return vld1q_f32(&stream[slot_idx]);
+    }
+
+    sb::u32 const * const indices = instance_indices + slot_idx;
+    sb::f32 const lanes[4] = {stream[indices[0]], stream[indices[1]], stream[indices[2]], stream[indices[3]]};
+    return vld1q_f32(lanes);
+}
+
+sb::u32 computeSpinningTransformsNeon(sb::SpinningInstances const & instances, sb::f32 angle_cos, sb::f32 angle_sin,
+                                      sb::f32 const * view_proj, sb::u32 const * instance_indices, sb::u32 first,
+                                      sb::u32 last, sb::f32 * transforms)
+{
+    float32x4_t const angle_cos4 = vdupq_n_f32(angle_cos);
+    float32x4_t const angle_sin4 = vdupq_n_f32(angle_sin);
+
+    sb::u32 slot_idx = first;
+
+    for (sb::u32 const simd_last = first + ((last - first) & ~3U); slot_idx != simd_last; slot_idx += 4)
+    {
+        float32x4_t const phase_cos = loadStreamNeon(instances.phase_cos, instance_indices, slot_idx);
+        float32x4_t const phase_sin = loadStreamNeon(instances.phase_sin, instance_indices, slot_idx);
+        float32x4_t const scale = loadStreamNeon(instances.scale, instance_indices, slot_idx);
+        float32x4_t const pos_x = loadStreamNeon(instances.pos_x, instance_indices, slot_idx);
+        float32x4_t const pos_y = loadStreamNeon(instances.pos_y, instance_indices, slot_idx);
+        float32x4_t const pos_z = loadStreamNeon(instances.pos_z, instance_indices, slot_idx);
+
+        float32x4_t const rot_cos =
+            vmulq_f32(vmlsq_f32(vmulq_f32(angle_cos4, phase_cos), angle_sin4, phase_sin), scale);
+        float32x4_t const rot_sin =
+            vmulq_f32(vmlaq_f32(vmulq_f32(angle_sin4, phase_cos), angle_cos4, phase_sin), scale);
+
+        float32x4_t rows[MATRIX_FLOAT_CNT];
+        for (sb::u32 row_idx = 0; row_idx != 4; ++row_idx)
+        {
+            float32x4_t const vp0 = vdupq_n_f32(view_proj[row_idx]);
+            float32x4_t const vp1 = vdupq_n_f32(view_proj[4 + row_idx]);
+            float32x4_t const vp2 = vdupq_n_f32(view_proj[8 + row_idx]);
+            float32x4_t const vp3 = vdupq_n_f32(view_proj[12 + row_idx]);
+
+            rows[row_idx] = vmlaq_f32(vmulq_f32(vp0, rot_cos), vp1, rot_sin);
+            rows[4 + row_idx] = vmlsq_f32(vmulq_f32(vp1, rot_cos), vp0, rot_sin);
+            rows[8 + row_idx] = vmulq_f32(vp2, scale);
+            rows[12 + row_idx] = vmlaq_f32(vmlaq_f32(vmlaq_f32(vp3, vp0, pos_x), vp1, pos_y), vp2, pos_z);
+        }
+
+        // one 4x4 transpose per column
+        for (sb::u32 col_idx = 0; col_idx != 4; ++col_idx)
+        {
+            float32x4_t const * const col = rows + col_idx * 4;
+            float32x4x2_t const col01 = vtrnq_f32(col[0], col[1]);
+            float32x4x2_t const col23 = vtrnq_f32(col[2], col[3]);
+
+            float32x4_t const lanes[4] = {vcombine_f32(vget_low_f32(col01.val[0]), vget_low_f32(col23.val[0])),
+                                          vcombine_f32(vget_low_f32(col01.val[1]), vget_low_f32(col23.val[1])),
+                                          vcombine_f32(vget_high_f32(col01.val[0]), vget_high_f32(col23.val[0])),
+                                          vcombine_f32(vget_high_f32(col01.val[1]), vget_high_f32(col23.val[1]))};
+
+            for (sb::u32 lane_idx = 0; lane_idx != 4; ++lane_idx)
+            {
+                vst1q_f32(transforms + (slot_idx + lane_idx) * MATRIX_FLOAT_CNT + col_idx * 4, lanes[lane_idx]);
+            }
+        }
+    }
+
+    return slot_idx;
+}
+
+#endif
+
+enum class TransformKernel
+{
+    SCALAR,
+    SSE,
+    AVX2,
+    NEON
+};
+
+TransformKernel getTransformKernel()
+{
+#if SB_SIMD_X64
+    static TransformKernel const kernel = sb::isAvx2Supported() ? TransformKernel::AVX2 : TransformKernel::SSE;
+    return kernel;
+#elif SB_SIMD_NEON
+    return TransformKernel::NEON;
+#else
+    return TransformKernel::SCALAR;
+#endif
+}
+
+} // namespace
+
+void sb::initializeSpinningInstances(u32 instance_cnt, f32 spacing, f32 scale, SpinningInstances & instances)
+{
+    instances.pos_x.resize(instance_cnt);
+    instances.pos_y.resize(instance_cnt);
+    instances.pos_z.resize(instance_cnt, 0.f);
+    instances.phase_cos.resize(instance_cnt);
+    instances.phase_sin.resize(instance_cnt);
+    instances.scale.resize(instance_cnt);
+
+    u32 const grid_side = (u32)std::ceil(std::sqrt((f32)instance_cnt));
+    instances.extent = grid_side * spacing;
+
+    f32 const grid_origin = -0.5f * (grid_side - 1) * spacing;
+
+    for (u32 instance_idx = 0; instance_idx != instance_cnt; ++instance_idx)
+    {
+        instances.pos_x[instance_idx] = grid_origin + (instance_idx % grid_side) * spacing;
+        instances.pos_y[instance_idx] = grid_origin + (instance_idx / grid_side) * spacing;
+
+        // golden angle so that neighbours never spin in sync
+        f32 const phase = instance_idx * 2.39996323f;
+        instances.phase_cos[instance_idx] = std::cos(phase);
+        instances.phase_sin[instance_idx] = std::sin(phase);
+
+        f32 const scale_jitter = instance_idx * 0.618034f - std::floor(instance_idx * 0.618034f);
+        instances.scale[instance_idx] = scale * (0.8f + 0.4f * scale_jitter);
+    }
+}
+
+char const * sb::getTransformKernelName()
+{
+    switch (getTransformKernel())
+    {
+        case TransformKernel::SSE:
+        {
+            return "SSE";
+        }
+        case TransformKernel::AVX2:
+        {
+            return "AVX2";
+        }
+        case TransformKernel::NEON:
+        {
+            return "NEON";
+        }
+        default:
+        {
+            return "scalar";
+        }
+    }
+}
+
+void sb::computeSpinningTransforms(SpinningInstances const & instances, f32 angle, f32 const * view_proj,
+                                   u32 const * instance_indices, u32 first, u32 last, f32 * transforms)
+{
+    sbAssert(first <= last);
+    sbAssert((nullptr != instance_indices) || (last <= instances.pos_x.size()));
+
+    f32 const angle_cos = std::cos(angle);
+    f32 const angle_sin = std::sin(angle);
+
+    u32 simd_last = first;
+
+#if SB_SIMD_X64
+    // non temporal stores need aligned addresses, matrices are 64 bytes so every matrix is aligned like the first one
+    sbAssert(0 == (reinterpret_cast<uintptr_t>(transforms) & 0x1F));
+
+    if (TransformKernel::AVX2 == getTransformKernel())
+    {
+        simd_last = computeSpinningTransformsAvx2(instances, angle_cos, angle_sin, view_proj, instance_indices, first,
+                                                  last, transforms);
+    }
+    else
+    {
+        simd_last = computeSpinningTransformsSse(instances, angle_cos, angle_sin, view_proj, instance_indices, first,
+                                                 last, transforms);
+    }
+#elif SB_SIMD_NEON
+    simd_last = computeSpinningTransformsNeon(instances, angle_cos, angle_sin, view_proj, instance_indices, first, last,
+                                              transforms);
+#endif
+
+    computeSpinningTransformsScalar(instances, angle_cos, angle_sin, view_proj, instance_indices, simd_last, last,
+                                    transforms);
+}
+
+void sb::computeSpinningBounds(SpinningInstances const & instances, MeshBounds const & mesh, BoundingSpheres & bounds)
+{
+    u32 const instance_cnt = numericConv<u32>(instances.pos_x.size());
+
+    bounds.center_x.resize(instance_cnt);
+    bounds.center_y.resize(instance_cnt);
+    bounds.center_z.resize(instance_cnt);
+    bounds.radius.resize(instance_cnt);
+
+    // the instances spin around Z through their origin, only the height of the mesh sphere center is kept
+    f32 const center_dist = std::sqrt(mesh.sphere_center.x * mesh.sphere_center.x +
+                                      mesh.sphere_center.y * mesh.sphere_center.y);
+
+    for (u32 instance_idx = 0; instance_idx != instance_cnt; ++instance_idx)
+    {
+        f32 const scale = instances.scale[instance_idx];
+
+        bounds.center_x[instance_idx] = instances.pos_x[instance_idx];
+        bounds.center_y[instance_idx] = instances.pos_y[instance_idx];
+        bounds.center_z[instance_idx] = instances.pos_z[instance_idx] + mesh.sphere_center.z * scale;
+        bounds.radius[instance_idx] = (center_dist + mesh.sphere_radius) * scale;
+    }
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "culling.h"
+
+#include <sb_core/core.h>
+#include <sb_core/container/dynamic_array.h>
+
+namespace sb {
+
+// Instances laid out on a square grid of the XY plane, each spinning around Z with its own phase
+// Translation, rotation and scale are stored as separate streams so that the transforms of several instances are
+// computed at once
+struct SpinningInstances
+{
+    DArray<f32> pos_x;
+    DArray<f32> pos_y;
+    DArray<f32> pos_z;
+    // cos/sin of the phase of each instance, the rotation of the frame is added with the angle sum identities
+    DArray<f32> phase_cos;
+    DArray<f32> phase_sin;
+    DArray<f32> scale;
+    // side of the square covered by the grid
+    f32 extent = 0.f;
+};
+
+void initializeSpinningInstances(u32 instance_cnt, f32 spacing, f32 scale, SpinningInstances & instances);
+
+// Name of the SIMD kernel computeSpinningTransforms() runs, picked once from the CPU features
+char const * getTransformKernelName();
+
+// Writes the column major world-view-projection matrices of the slots in [first, last) rotated by 'angle' radians
+// Slot i holds the matrix of the instance instance_indices[i], or of the instance i when instance_indices is null
+// 'view_proj' is a column major 4x4 matrix and 'transforms' holds the matrices of all the slots, not only the range
+// The world matrices only live in registers, the output may be write-combined memory as it is never read back
+void computeSpinningTransforms(SpinningInstances const & instances, f32 angle, f32 const * view_proj,
+                               u32 const * instance_indices, u32 first, u32 last, f32 * transforms);
+
+// World space spheres bounding the instances of 'mesh' whatever their rotation
+void computeSpinningBounds(SpinningInstances const & instances, MeshBounds const & mesh, BoundingSpheres & bounds);
+
+} // namespace sb
@@ -0,0 +1,461 @@
+#include "job_system.h"
+
+#include <sb_core/error/error.h>
+#include <sb_core/log.h>
+
+#include <sb_std/algorithm>
+
+namespace {
+
+thread_local sb::u32 t_thread_slot = sb::JobSystem::INVALID_THREAD_SLOT;
+
+// Number of unsuccessful job lookups before a worker goes to sleep
+constexpr sb::u32 WORKER_SPIN_CNT = 64;
+
+} // namespace
+
+sb::b8 sb::JobDeque::push(Job * job)
+{
+    s64 const bottom = _bottom.load(std::memory_order_relaxed);
+    s64 const top = _top.load(std::memory_order_acquire);
+
+    if ((bottom - top) >= CAPACITY)
+    {
+        return false;
+    }
+
+    _jobs[bottom & INDEX_MASK].store(job, std::memory_order_relaxed);
+    _bottom.store(bottom + 1, std::memory_order_release);
+
+    return true;
+}
+
+sb::Job * sb::JobDeque::pop()
+{
+    s64 const bottom = _bottom.load(std::memory_order_relaxed) - 1;
+    _bottom.store(bottom, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    s64 top = _top.load(std::memory_order_relaxed);
+
+    if (top > bottom)
+    {
+        // empty
+        _bottom.store(bottom + 1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    Job * job = _jobs[bottom & INDEX_MASK].load(std::memory_order_relaxed);
+
+    if (top == bottom)
+    {
+        // last job: race against thieves
+        if (!_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+        {
+            job = nullptr;
+        }
+        _bottom.store(bottom + 1, std::memory_order_relaxed);
+    }
+
+    return job;
+}
+
+sb::Job * sb::JobDeque::steal()
+{
+    s64 top = _top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    s64 const bottom = _bottom.load(std::memory_order_acquire);
+
+    if (top >= bottom)
+    {
+        return nullptr;
+    }
+
+    Job * const job = _jobs[top & INDEX_MASK].load(std::memory_order_relaxed);
+    if (!_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+    {
+        // lost the race against the owner or another thief
+        return nullptr;
+    }
+
+    return job;
+}
+
+sb::JobSystem::~JobSystem()
+{
+    if (nullptr != _slots)
+    {
+        terminate();
+    }
+}
+
+sb::b8 sb::JobSystem::initialize(u32 worker_cnt)
+{
+    sbAssert(nullptr == _slots);
+
+    _exit_requested = false;
+    _queued_job_cnt = 0;
+    _sleeping_worker_cnt = 0;
+
+    _slot_cnt = worker_cnt + MAX_ATTACHED_THREADS;
+    _slots = std::make_unique<ThreadSlot[]>(_slot_cnt);
+
+    // the first slots belong to the workers, the remaining ones are claimed by attached threads
+    for (u32 worker_idx = 0; worker_idx != worker_cnt; ++worker_idx)
+    {
+        _slots[worker_idx].attached = true;
+    }
+
+    _workers.reserve(worker_cnt);
+    for (u32 worker_idx = 0; worker_idx != worker_cnt; ++worker_idx)
+    {
+        _workers.emplace_back([this, worker_idx]() { runWorker(worker_idx); });
+    }
+
+    return attachCurrentThread();
+}
+
+void sb::JobSystem::terminate()
+{
+    if (nullptr == _slots)
+    {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(_sleep_mutex);
+        _exit_requested = true;
+    }
+    _wakeup_cond.notify_all();
+
+    // workers drain the runnable jobs before exiting
+    for (auto & worker : _workers)
+    {
+        worker.join();
+    }
+    _workers.clear();
+
+    // jobs pushed by attached threads and never waited on
+    for (u32 slot_idx = 0; slot_idx != _slot_cnt; ++slot_idx)
+    {
+        while (Job * const job = _slots[slot_idx].deque.steal())
+        {
+            _queued_job_cnt.fetch_sub(1);
+            runJob(job);
+        }
+    }
+
+    detachCurrentThread();
+
+    _slots.reset();
+    _slot_cnt = 0;
+}
+
+sb::b8 sb::JobSystem::attachCurrentThread()
+{
+    sbAssert(INVALID_THREAD_SLOT == t_thread_slot, "Thread already attached to the job system");
+
+    for (u32 slot_idx = getWorkerCount(); slot_idx != _slot_cnt; ++slot_idx)
+    {
+        b8 expected = false;
+        if (_slots[slot_idx].attached.compare_exchange_strong(expected, true))
+        {
+            t_thread_slot = slot_idx;
+            return true;
+        }
+    }
+
+    sbLogE("Failed to attach thread to the job system, all the {} slots are in use", MAX_ATTACHED_THREADS);
+    return false;
+}
+
+void sb::JobSystem::detachCurrentThread()
+{
+    if (INVALID_THREAD_SLOT == t_thread_slot)
+    {
+        return;
+    }
+
+    ThreadSlot & slot = _slots[t_thread_slot];
+
+    // the slot may be claimed by another thread afterward
+    while (Job * const job = slot.deque.pop())
+    {
+        _queued_job_cnt.fetch_sub(1);
+        runJob(job);
+    }
+
+    slot.attached = false;
+    t_thread_slot = INVALID_THREAD_SLOT;
+}
+
+sb::u32 sb::JobSystem::getCurrentThreadSlot()
+{
+    return t_thread_slot;
+}
+
+sb::u32 sb::JobSystem::getDefaultWorkerCount()
+{
+    // the main thread runs jobs too while waiting on them
+    u32 const hw_thread_cnt = std::thread::hardware_concurrency();
+
+    return (hw_thread_cnt > 1) ? (hw_thread_cnt - 1) : 1;
+}
+
+sb::Job * sb::JobSystem::allocateJob(JobFunc && func, JobCounter * counter)
+{
+    if (INVALID_THREAD_SLOT == t_thread_slot)
+    {
+        // no deque to push to, the caller runs the job itself
+        return nullptr;
+    }
+
+    ThreadSlot & slot = _slots[t_thread_slot];
+    Job & job = slot.job_pool[slot.job_pool_idx % JOB_POOL_SIZE];
+
+    if (job.in_use.load(std::memory_order_acquire))
+    {
+        // more than JOB_POOL_SIZE jobs in flight from this thread
+        return nullptr;
+    }
+
+    ++slot.job_pool_idx;
+
+    job.func = sbstd::move(func);
+    job.counter = counter;
+    job.next_dependent = nullptr;
+    job.in_use.store(true, std::memory_order_relaxed);
+
+    return &job;
+}
+
+void sb::JobSystem::pushJob(Job * job)
+{
+    // counted before being visible to the thieves which uncount it once stolen
+    _queued_job_cnt.fetch_add(1);
+
+    if (!_slots[t_thread_slot].deque.push(job))
+    {
+        _queued_job_cnt.fetch_sub(1);
+        runJob(job);
+        return;
+    }
+
+    if (0 != _sleeping_worker_cnt.load())
+    {
+        // taking the lock guarantees the sleeping worker is either waiting or about to see the new job
+        {
+            std::lock_guard<std::mutex> lock(_sleep_mutex);
+        }
+        _wakeup_cond.notify_one();
+    }
+}
+
+void sb::JobSystem::submit(JobFunc func, JobCounter * counter)
+{
+    if (nullptr != counter)
+    {
+        counter->value.fetch_add(1);
+    }
+
+    Job * const job = allocateJob(sbstd::move(func), counter);
+    if (nullptr == job)
+    {
+        func();
+        releaseDependents(counter);
+        return;
+    }
+
+    pushJob(job);
+}
+
+void sb::JobSystem::submitAfter(JobCounter & dependency, JobFunc func, JobCounter * counter)
+{
+    if (nullptr != counter)
+    {
+        counter->value.fetch_add(1);
+    }
+
+    Job * const job = allocateJob(sbstd::move(func), counter);
+    if (nullptr == job)
+    {
+        wait(dependency);
+        func();
+        releaseDependents(counter);
+        return;
+    }
+
+    while (dependency.dependents_lock.test_and_set(std::memory_order_acquire))
+    {
+        std::this_thread::yield();
+    }
+
+    b8 const dependency_done = (0 == dependency.value.load());
+    if (!dependency_done)
+    {
+        job->next_dependent = dependency.dependents;
+        dependency.dependents = job;
+    }
+
+    dependency.dependents_lock.clear(std::memory_order_release);
+
+    if (dependency_done)
+    {
+        pushJob(job);
+    }
+}
+
+void sb::JobSystem::releaseDependents(JobCounter * counter)
+{
+    if (nullptr == counter)
+    {
+        return;
+    }
+
+    // the decrement happens under the lock and wait() does not return before the lock is released
+    // so that the counter is never accessed once its owner stopped waiting on it
+    while (counter->dependents_lock.test_and_set(std::memory_order_acquire))
+    {
+        std::this_thread::yield();
+    }
+
+    if (1 != counter->value.fetch_sub(1))
+    {
+        counter->dependents_lock.clear(std::memory_order_release);
+        return;
+    }
+
+    Job * dependent = counter->dependents;
+    counter->dependents = nullptr;
+
+    counter->dependents_lock.clear(std::memory_order_release);
+
+    while (nullptr != dependent)
+    {
+        Job * const next_dependent = dependent->next_dependent;
+
+        if (INVALID_THREAD_SLOT != t_thread_slot)
+        {
+            pushJob(dependent);
+        }
+        else
+        {
+            runJob(dependent);
+        }
+
+        dependent = next_dependent;
+    }
+}
+
+void sb::JobSystem::runJob(Job * job)
+{
+    JobFunc func = sbstd::move(job->func);
+    JobCounter * const counter = job->counter;
+
+    job->func = nullptr;
+    job->in_use.store(false, std::memory_order_release);
+
+    func();
+
+    releaseDependents(counter);
+}
+
+sb::Job * sb::JobSystem::findJob(u32 slot_idx)
+{
+    Job * job = _slots[slot_idx].deque.pop();
+
+    if (nullptr == job)
+    {
+        // steal starting from the next slot so that thieves do not all target the same victim
+        for (u32 victim_offset = 1; (victim_offset != _slot_cnt) && (nullptr == job); ++victim_offset)
+        {
+            job = _slots[(slot_idx + victim_offset) % _slot_cnt].deque.steal();
+        }
+    }
+
+    if (nullptr != job)
+    {
+        _queued_job_cnt.fetch_sub(1);
+    }
+
+    return job;
+}
+
+void sb::JobSystem::wait(JobCounter const & counter)
+{
+    u32 const slot_idx = t_thread_slot;
+
+    while ((0 != counter.value.load()) || counter.dependents_lock.test(std::memory_order_acquire))
+    {
+        Job * const job = (INVALID_THREAD_SLOT != slot_idx) ? findJob(slot_idx) : nullptr;
+
+        if (nullptr != job)
+        {
+            runJob(job);
+        }
+        else
+        {
+            std::this_thread::yield();
+        }
+    }
+}
+
+void sb::JobSystem::parallelFor(u32 count, u32 min_batch_size, JobRangeFunc const & func)
+{
+    if (0 == count)
+    {
+        return;
+    }
+
+    // a few batches per thread for load balancing but no more
+    u32 const max_batch_cnt = _slot_cnt * 4;
+    u32 const batch_size = sbstd::max(sbstd::max(min_batch_size, 1U), (count + max_batch_cnt - 1) / max_batch_cnt);
+
+    JobCounter counter;
+
+    // the calling thread takes the first batch itself
+    for (u32 batch_begin = batch_size; batch_begin < count; batch_begin += batch_size)
+    {
+        u32 const batch_end = sbstd::min(count, batch_begin + batch_size);
+        submit([&func, batch_begin, batch_end]() { func(batch_begin, batch_end); }, &counter);
+    }
+
+    func(0, sbstd::min(count, batch_size));
+
+    wait(counter);
+}
+
+void sb::JobSystem::runWorker(u32 slot_idx)
+{
+    t_thread_slot = slot_idx;
+
+    u32 spin_cnt = 0;
+
+    for (;;)
+    {
+        if (Job * const job = findJob(slot_idx))
+        {
+            runJob(job);
+            spin_cnt = 0;
+            continue;
+        }
+
+        if (_exit_requested.load())
+        {
+            break;
+        }
+
+        if (++spin_cnt < WORKER_SPIN_CNT)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(_sleep_mutex);
+        _sleeping_worker_cnt.fetch_add(1);
+        _wakeup_cond.wait(lock, [this]() { return _exit_requested.load() || (0 < _queued_job_cnt.load()); });
+        _sleeping_worker_cnt.fetch_sub(1);
+        spin_cnt = 0;
+    }
+
+    t_thread_slot = INVALID_THREAD_SLOT;
+}
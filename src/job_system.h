@@ -0,0 +1,137 @@
+#pragma once
+
+#include <sb_core/core.h>
+#include <sb_core/conversion.h>
+#include <sb_core/container/dynamic_array.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace sb {
+
+struct Job;
+
+// Number of jobs still pending in a batch, it reaches 0 once every job of the batch has run
+// Jobs submitted with a counter as dependency are parked in the counter until it reaches 0
+struct JobCounter
+{
+    std::atomic<u32> value = 0;
+    std::atomic_flag dependents_lock = ATOMIC_FLAG_INIT;
+    Job * dependents = nullptr;
+};
+
+using JobFunc = std::function<void()>;
+using JobRangeFunc = std::function<void(u32 begin, u32 end)>;
+
+struct Job
+{
+    JobFunc func;
+    JobCounter * counter = nullptr;
+    Job * next_dependent = nullptr;
+    std::atomic<b8> in_use = false;
+};
+
+// Chase-Lev work-stealing deque: the owner thread pushes/pops at the bottom, other threads steal from the top
+class JobDeque
+{
+public:
+    static constexpr s64 CAPACITY = 4096;
+
+    b8 push(Job * job);
+    Job * pop();
+    Job * steal();
+
+private:
+    static constexpr s64 INDEX_MASK = CAPACITY - 1;
+    static_assert(0 == (CAPACITY & INDEX_MASK), "Capacity must be a power of two");
+
+    alignas(64) std::atomic<s64> _top = 0;
+    alignas(64) std::atomic<s64> _bottom = 0;
+    std::atomic<Job *> _jobs[CAPACITY] = {};
+};
+
+class JobSystem
+{
+public:
+    // Threads which are not job workers but submit/wait on jobs (main thread, render thread, ...)
+    static constexpr u32 MAX_ATTACHED_THREADS = 4;
+    static constexpr u32 INVALID_THREAD_SLOT = UINT32_MAX;
+
+    JobSystem() = default;
+    ~JobSystem();
+
+    JobSystem(JobSystem const &) = delete;
+    JobSystem & operator=(JobSystem const &) = delete;
+
+    // worker_cnt == 0 runs every job on the thread waiting for it
+    // The calling thread is attached to the job system
+    b8 initialize(u32 worker_cnt);
+    void terminate();
+
+    // Gives the calling thread its own deque so that it can submit jobs and help while waiting
+    b8 attachCurrentThread();
+    void detachCurrentThread();
+
+    // Runs the job right away when called from a thread which is not attached
+    void submit(JobFunc func, JobCounter * counter);
+
+    // The job only becomes runnable once 'dependency' reaches 0
+    void submitAfter(JobCounter & dependency, JobFunc func, JobCounter * counter);
+
+    // Runs pending jobs on the calling thread until the counter reaches 0
+    void wait(JobCounter const & counter);
+
+    // Splits [0, count) in batches of at least min_batch_size elements and waits for all of them
+    void parallelFor(u32 count, u32 min_batch_size, JobRangeFunc const & func);
+
+    u32 getWorkerCount() const
+    {
+        return numericConv<u32>(_workers.size());
+    }
+
+    // Every thread running jobs (workers and attached threads) owns a slot in [0, getThreadSlotCount())
+    u32 getThreadSlotCount() const
+    {
+        return _slot_cnt;
+    }
+
+    static u32 getCurrentThreadSlot();
+
+    static u32 getDefaultWorkerCount();
+
+private:
+    static constexpr u32 JOB_POOL_SIZE = 4096;
+
+    struct ThreadSlot
+    {
+        JobDeque deque;
+        Job job_pool[JOB_POOL_SIZE];
+        u32 job_pool_idx = 0;
+        std::atomic<b8> attached = false;
+    };
+
+    Job * allocateJob(JobFunc && func, JobCounter * counter);
+    void pushJob(Job * job);
+    void releaseDependents(JobCounter * counter);
+    void runJob(Job * job);
+    Job * findJob(u32 slot_idx);
+    void runWorker(u32 slot_idx);
+
+    DArray<std::thread> _workers;
+    // a slot holds its whole job pool, too large to be moved around
+    std::unique_ptr<ThreadSlot[]> _slots;
+    u32 _slot_cnt = 0;
+
+    // signed so that a job popped right after being pushed never wraps it around
+    std::atomic<s32> _queued_job_cnt = 0;
+    std::atomic<u32> _sleeping_worker_cnt = 0;
+    std::atomic<b8> _exit_requested = false;
+    std::mutex _sleep_mutex;
+    std::condition_variable _wakeup_cond;
+};
+
+} // namespace sb
@@ -1,5 +1,16 @@
 #include "utility_vulkan.h"
 #include "utility.h"
+#include "job_system.h"
+#include "frame_scheduler.h"
+#include "triple_buffer.h"
+#include "spsc_queue.h"
+#include "instance_transforms.h"
+#include "culling.h"
+#include "depth_pyramid.h"
+#include "geometry_arena.h"
+#include "occlusion_rasterizer.h"
+#include "meshlets.h"
+#include "mesh_simplifier.h"
 
 #include <sb_core/core.h>
 #include <sb_core/error/error.h>
@@ -17,12 +28,14 @@
 #include <sb_std/algorithm>
 #include <sb_std/span>
 #include <sb_std/iterator>
+#include <sb_std/utility>
 
 #include <glm/glm.hpp>
 #include <glm/vec4.hpp>
 #include <glm/mat4x4.hpp>
 #include <glm/ext/matrix_transform.hpp>
 #include <glm/ext/matrix_clip_space.hpp>
+#include <glm/gtc/packing.hpp>
 
 #include <glfw/glfw3.h>
 
@@ -32,7 +45,11 @@
 
 #include <vulkan/vulkan.h>
 
+#include <atomic>
 #include <chrono>
+#include <mutex>
+#include <string_view>
+#include <thread>
 
 using namespace sb;
 
@@ -43,42 +60,432 @@ public:
     {
         TRIANGLE,
         QUAD,
-        MODEL
+        MODEL,
+        // copies of the model with per-instance transforms read from a storage buffer
+        INSTANCED
     };
 
+    struct Settings
+    {
+        // Number of threads the draws are recorded from in secondary command buffers, 1 records them inline
+        // Only applies without reuse_cmd_buffers, the frames are then recorded every frame
+        u32 recording_thread_cnt = 1;
+        // Submits the command buffers recorded in a previous frame until the scene changes, they are recorded inline
+        // since the secondary command buffers are recycled with the per-frame pools
+        b8 reuse_cmd_buffers = true;
+        // 1 for the lowest latency, more lets the CPU run ahead of a GPU bound frame
+        u32 inflight_frame_cnt = 2;
+        // Falls back to FIFO when not supported by the surface
+        VkPresentModeKHR present_mode = VK_PRESENT_MODE_MAILBOX_KHR;
+        // 0 uses one more image than the minimum required by the surface
+        u32 swapchain_img_cnt = 0;
+        // Sleeps before sampling the inputs so that the frame is submitted just in time for the GPU
+        b8 low_latency_pacing = false;
+        // Only renders when something changed on screen, see needsRedraw()
+        b8 render_on_demand = false;
+        b8 animate = true;
+        // Renders from a dedicated thread once the benchmarks are done, see startRenderThread()
+        b8 render_thread = false;
+        // Presents from a dedicated thread once the benchmarks are done, see startPresentThread()
+        b8 present_thread = false;
+        // Number of model copies drawn by DemoMode::INSTANCED, clamped to MAX_INSTANCE_COUNT
+        u32 instance_cnt = 10'000;
+        // Only the instances whose bounding sphere touches the view frustum are drawn
+        b8 frustum_culling = true;
+        // Culls and transforms the instances in a compute pass which writes the indirect draw, chosen at startup
+        b8 gpu_culling = false;
+        // Two phase culling of the hidden instances against a depth pyramid, implies gpu_culling when supported by the
+        // device, chosen at startup
+        b8 occlusion_culling = false;
+        // Culls the instances hidden by the nearest ones with a software depth rasterizer before recording, CPU culling
+        // only, the instances have to pass the frustum culling first
+        b8 software_occlusion_culling = false;
+        // Culls the meshlets of DemoMode::MODEL by frustum and normal cone in a compute pass which compacts the indices
+        // of the visible ones for an indirect draw, chosen at startup
+        b8 meshlet_culling = false;
+        // Draws the instances with the coarsest level of detail of the model whose error stays under a pixel, CPU
+        // culling only, chosen at startup
+        b8 lod_selection = false;
+        // Lays the depth in a first subpass with position only pipelines so that the main subpass shades each pixel
+        // once with an EQUAL depth test, chosen at startup and toggled at runtime by setDepthPrepass()
+        b8 depth_prepass = false;
+    };
+
+    // Instance counts of the last frame whose culling results reached the CPU
+    struct CullingStats
+    {
+        u32 instance_cnt = 0;
+        u32 frustum_culled_cnt = 0;
+        u32 occlusion_culled_cnt = 0;
+        u32 drawn_cnt = 0;
+        u32 drawn_triangle_cnt = 0;
+    };
+
+    static constexpr u32 MAX_INSTANCE_COUNT = 1'000'000;
+
     VulkanApp() = default;
     ~VulkanApp() = default;
 
-    b8 initialize(b8 enable_dbg_layers, GLFWwindow * wnd, DemoMode mode);
+    b8 initialize(b8 enable_dbg_layers, GLFWwindow * wnd, DemoMode mode, Settings const & settings);
     void terminate();
+
+    // Samples the inputs and publishes the next frame packet, renders it right away without a render thread
+    b8 update();
+
+    // Renders the last published frame packet, without a render thread the packet is updated first
     b8 render();
 
+    // Once started, render() is called from the render thread for every published frame packet
+    // Every other method has to be called from the thread calling update() and the benchmarks cannot run anymore
+    void startRenderThread();
+    void stopRenderThread();
+
+    // Once started, the frames are handed to the present thread instead of being presented by render()
+    // Has to be started before the render thread and stopped after it
+    void startPresentThread();
+    void stopPresentThread();
+
+    void benchmarkCommandRecording();
+    void benchmarkInflightFrames();
+    // GPU time of the frames with and without the depth prepass, needs Settings::depth_prepass
+    void benchmarkDepthPrepass();
+
+    void setDemoMode(DemoMode mode);
+
+    DemoMode getDemoMode() const
+    {
+        return _demo_mode;
+    }
+
+    // The swapchain is recreated at the beginning of the next frame
+    void setPresentMode(VkPresentModeKHR present_mode);
+    void setSwapchainImageCount(u32 img_cnt);
+    void cyclePresentMode();
+
+    VkPresentModeKHR getPresentMode() const
+    {
+        return _vk_present_mode;
+    }
+
+    // Updated by the thread rendering once the swapchain is recreated
+    u32 getSwapchainImageCount() const
+    {
+        return _swapchain_img_cnt.load();
+    }
+
+    void benchmarkPresentModes();
+
+    // Per-instance cost of the instance transform update, on the calling thread and spread over the job system
+    void benchmarkInstanceTransforms();
+
+    void setLowLatencyPacing(b8 enable);
+
+    b8 isLowLatencyPacingEnabled() const
+    {
+        return _next_frame.low_latency_pacing;
+    }
+
+    // Waits for the device to be idle and rebuilds the per-frame resources, only without a render thread
+    b8 setInflightFrameCount(u32 inflight_frame_cnt);
+
     void notifyTargetFrameBufferResized(VkExtent2D frame_buffer_ext);
 
+    // The window contents are lost or what is displayed changed, the next frame has to be rendered
+    void requestRedraw()
+    {
+        _redraw_requested = true;
+    }
+
+    // A minimized window has a 0x0 frame buffer and nothing can be presented to it
+    b8 isMinimized() const
+    {
+        return (0 == _next_frame.frame_buffer_ext.width) || (0 == _next_frame.frame_buffer_ext.height);
+    }
+
+    // Always true unless rendering on demand, otherwise only when the scene is animated or a redraw was requested
+    b8 needsRedraw() const
+    {
+        return !isMinimized() && (!_settings.render_on_demand || _settings.animate || _redraw_requested);
+    }
+
+    void setAnimationEnabled(b8 enable);
+
+    void setFrustumCulling(b8 enable);
+
+    b8 isFrustumCullingEnabled() const
+    {
+        return _next_frame.frustum_culling;
+    }
+
+    // Only has an effect with Settings::occlusion_culling or Settings::software_occlusion_culling
+    void setOcclusionCulling(b8 enable);
+
+    b8 isOcclusionCullingEnabled() const
+    {
+        return _next_frame.occlusion_culling;
+    }
+
+    // Only has an effect with Settings::depth_prepass
+    void setDepthPrepass(b8 enable);
+
+    b8 isDepthPrepassEnabled() const
+    {
+        return _next_frame.depth_prepass;
+    }
+
+    CullingStats getCullingStats() const;
+
+    b8 isAnimationEnabled() const
+    {
+        return _settings.animate;
+    }
+
 private:
-    struct Vertex
+    // VERTEX_FORMAT_FULL, the positions are a separate stream of glm::vec3
+    struct VertexAttributes
     {
-        glm::vec3 position;
         glm::vec3 color;
         glm::vec2 tex_coords;
     };
 
+    static_assert(sizeof(VertexAttributes) == VERTEX_ATTRIBUTE_WORD_COUNTS[VERTEX_FORMAT_FULL] * sizeof(u32));
+
+    // VERTEX_FORMAT_PACKED, the color and the texture coordinates of the model do not need full floats
+    struct PackedVertexAttributes
+    {
+        u32 color; // unorm8 rgba
+        u32 tex_coords; // f16 uv
+    };
+
+    static_assert(sizeof(PackedVertexAttributes) ==
+                  VERTEX_ATTRIBUTE_WORD_COUNTS[VERTEX_FORMAT_PACKED] * sizeof(u32));
+
     struct DemoModel
     {
         VkImageMem image;
         VkImageView image_view;
-        VkBufferMem vb;
-        VkBufferMem ib;
-        usize vtx_cnt;
-        usize idx_cnt;
+        GeometryMesh mesh; // the indices of every level of detail
         u32 mip_cnt;
+        MeshBounds bounds;
+        // index ranges of the levels of detail in the IB, the first one is the full model
+        MeshLod lods[MAX_MESH_LOD_COUNT];
+        u32 lod_cnt;
+        // read by the meshlet culling, only with Settings::meshlet_culling
+        VkBufferMem meshlets;
+        u32 meshlet_cnt;
+    };
+
+    enum DecodedImageSlot : u32
+    {
+        DECODED_TEST_TEXTURE,
+        DECODED_MODEL_TEXTURE,
+        DECODED_IMAGE_COUNT
+    };
+
+    // Image decoded by a job, the pixels are handed over to the upload path once the counter reaches 0
+    struct DecodedImage
+    {
+        JobCounter counter;
+        u8 * pixels = nullptr;
+        int width = 0;
+        int height = 0;
+    };
+
+    // Model geometry parsed by a job, handed over to the upload path once the counter reaches 0
+    struct ModelGeometry
+    {
+        JobCounter counter;
+        DArray<glm::vec3> positions;
+        DArray<PackedVertexAttributes> attributes;
+        DArray<u32> indices; // full model ordered by meshlet, followed by the coarser levels of detail
+        MeshBounds bounds;
+        DArray<Meshlet> meshlets;
+        MeshLod lods[MAX_MESH_LOD_COUNT];
+        u32 lod_cnt = 0;
+    };
+
+    struct DrawCmd
+    {
+        GeometryMesh mesh; // non indexed draws for meshes without indices
+        u32 element_cnt; // from the first vertex or index of the mesh
+        u32 instance_cnt = 1;
+        VkPipeline pipeline = VK_NULL_HANDLE; // VK_NULL_HANDLE for the default graphics pipeline
+        // instance_cnt is ignored, the draw reads the indirect command render() writes for the frame
+        b8 indirect = false;
+        // the indices of the mesh and element_cnt are ignored, the draw reads the indices and the indirect command
+        // written by the meshlet culling of the frame
+        b8 meshlets = false;
+
+        // indexed draw of the geometry arena whose command is known when recording, see MAX_MULTI_DRAW_COUNT
+        b8 isMultiDrawable() const
+        {
+            return !indirect && !meshlets && (0 != mesh.idx_cnt);
+        }
+    };
+
+    // Everything the rendering of a frame needs from the window and the simulation
+    // Built by update() and handed over to render() so that both can run on different threads
+    struct FramePacket
+    {
+        VkExtent2D frame_buffer_ext = {};
+        VkPresentModeKHR present_mode = VK_PRESENT_MODE_FIFO_KHR;
+        u32 swapchain_img_cnt = 0;
+        b8 low_latency_pacing = false;
+
+        // when the inputs of the frame have been sampled
+        std::chrono::high_resolution_clock::time_point input_sample_time;
+        f32 animation_time = 0.f;
+        glm::mat4 view = glm::mat4(1.f);
+        f32 z_far = 100.f;
+        // instances the transforms are computed for, 0 unless the draw list has instanced draws
+        u32 instance_cnt = 0;
+        b8 frustum_culling = true;
+        b8 occlusion_culling = true;
+        b8 depth_prepass = false;
+        // the frames keep coming without new packets, the render thread renders the packet again if none arrives
+        b8 continuous = true;
+        // model transform of each draw of the draw list
+        DArray<glm::mat4> object_transforms;
+        DArray<DrawCmd> draw_list;
+        // Bumped whenever the draw list changes, starts at 1 so that a zeroed RecordedFrame is never valid
+        u64 scene_version = 1;
+    };
+
+    struct PresentRequest
+    {
+        // VK_NULL_HANDLE stops the present thread
+        VkSwapchainKHR swapchain;
+        u32 img_idx;
+        VkSemaphore wait_sem;
+        u64 present_id;
+    };
+
+    // Per thread and per frame pool secondary command buffers are allocated from
+    struct RecordingPool
+    {
+        VkCommandPool cmd_pool = VK_NULL_HANDLE;
+        DArray<VkCommandBuffer> cmd_buffers;
+        u32 used_cnt = 0;
+    };
+
+    // Primary recorded for a frame slot and swapchain image, valid while scene_version matches
+    struct RecordedFrame
+    {
+        VkCommandBuffer cmd_buffer = VK_NULL_HANDLE;
+        u64 scene_version = 0;
+    };
+
+    // std140 parameters of cull_instances.comp
+    struct UniformCullParams
+    {
+        glm::mat4 view_proj;
+        glm::vec4 frustum_planes[FrustumPlanes::PLANE_COUNT];
+        glm::vec2 rotation; // cos and sin of the rotation shared by all the instances
+        u32 instance_cnt;
+        u32 frustum_culling;
+        glm::vec2 viewport_size; // area of the depth attachment the depth pyramid is built from
+        u32 occlusion_culling;
+        u32 depth_pyramid_level_cnt;
+    };
+
+    // std430 instance read by cull_instances.comp, packed once from the instance and bounding sphere streams
+    struct GpuInstance
+    {
+        glm::vec4 position_scale;
+        glm::vec4 bounding_sphere;
+        glm::vec4 phase; // cos and sin of the phase, zw unused
+    };
+
+    // Indirect draw followed by its draw count, the draw count is only written by the GPU culling
+    struct IndirectDraw
+    {
+        VkDrawIndexedIndirectCommand cmd;
+        u32 draw_cnt;
+    };
+
+    // Dispatches of the GPU culling, the late one only runs with the occlusion culling
+    enum CullPhase : u32
+    {
+        CULL_PHASE_EARLY,
+        CULL_PHASE_LATE,
+        CULL_PHASE_COUNT
     };
 
+    // The indirect buffer holds a draw per culling phase followed by the counters of the GPU culling
+    // Without the GPU culling, it holds the packed draws of the levels of detail of the instances instead
+    struct IndirectDraws
+    {
+        IndirectDraw draws[CULL_PHASE_COUNT];
+        u32 frustum_culled_cnt;
+        u32 occlusion_culled_cnt;
+    };
+
+    static constexpr VkDeviceSize INDIRECT_BUFFER_SIZE =
+        sbstd::max(sizeof(IndirectDraws), MAX_MESH_LOD_COUNT * sizeof(VkDrawIndexedIndirectCommand));
+
+    // consecutive indexed draws of a draw list sharing a pipeline are merged into a multi-draw indirect, longer draw
+    // lists are drawn one by one
+    static constexpr u32 MAX_MULTI_DRAW_COUNT = 256;
+
+    // std140 parameters of cull_meshlets.comp, in the object space of the model
+    struct UniformMeshletCullParams
+    {
+        glm::vec4 frustum_planes[FrustumPlanes::PLANE_COUNT];
+        glm::vec4 camera_position; // w unused
+        u32 frustum_culling;
+        u32 model_first_index; // the meshlet index ranges are relative to the model range in the geometry arena
+    };
+
+    // Level of detail selection of updateInstanceTransforms()
+    struct InstanceLodSelection
+    {
+        f32 pixel_scale; // pixels covered by a view space length at unit depth
+        u32 instance_cnts[MAX_MESH_LOD_COUNT]; // written, transforms of each level of the model in order
+    };
+
+    // Everything owned by a frame slot, reused once the GPU is done with the previous frame of the slot
+    struct FrameContext
+    {
+        VkSemaphore image_available_sem = VK_NULL_HANDLE;
+        VkSemaphore render_finished_sem = VK_NULL_HANDLE;
+        VkCommandBuffer cmd_buffer = VK_NULL_HANDLE;
+        VkBufferMem mvp_buffer = {};
+        // persistently mapped, rewritten every frame
+        VkBufferMem instance_buffer = {};
+        glm::mat4 * instance_transforms = nullptr;
+        // persistently mapped, an indirect draw per level of detail of the instances once they are culled
+        VkBufferMem indirect_buffer = {};
+        VkDrawIndexedIndirectCommand * indirect_cmds = nullptr;
+        // persistently mapped, the command of each draw of the draw list being recorded at the index of the draw,
+        // only with multiDrawIndirect
+        VkBufferMem multi_draw_buffer = {};
+        VkDrawIndexedIndirectCommand * multi_draw_cmds = nullptr;
+        u32 multi_draw_cnt = 0; // 0 when the draws of the list are drawn one by one
+        // with the GPU culling, the two buffers above are device local and left unmapped, they are written by the
+        // culling pass which reads its parameters from this persistently mapped buffer
+        VkBufferMem cull_params_buffer = {};
+        UniformCullParams * cull_params = nullptr;
+        // persistently mapped copy of the indirect buffer taken at the end of the culling, for the counters
+        VkBufferMem cull_stats_buffer = {};
+        IndirectDraws const * cull_stats = nullptr;
+        // with the meshlet culling, indices of the visible meshlets and the indirect draw reading them, both written
+        // by the culling pass which reads its parameters from the persistently mapped buffer
+        VkBufferMem meshlet_ib = {};
+        VkBufferMem meshlet_draw_buffer = {};
+        VkBufferMem meshlet_cull_params_buffer = {};
+        UniformMeshletCullParams * meshlet_cull_params = nullptr;
+        // GPU timestamps of the start and the end of the frame, read back once the slot is reused
+        VkQueryPool timestamp_pool = VK_NULL_HANDLE;
+        b8 timestamps_written = false;
+        VkDescriptorSet desc_set = VK_NULL_HANDLE;
+        DArray<RecordingPool> recording_pools; // one per job system thread slot
+        DArray<RecordedFrame> recorded_frames; // one per swapchain image
+    };
+
+    // projection * view * model, combined once on the CPU rather than for every vertex
     struct UniformMVP
     {
-        glm::mat4 model;
-        glm::mat4 view;
-        glm::mat4 projection;
+        glm::mat4 mvp;
     };
 
     b8 initializeVulkanCore(GLFWwindow * wnd);
@@ -86,6 +493,13 @@ private:
 
     b8 createSwapChain(VkExtent2D frame_buffer_ext);
     b8 createGraphicsPipeline();
+    // Depth pyramid pipeline and occlusion variant of the culling pipeline
+    b8 createOcclusionCullPipeline();
+    b8 createMeshletCullPipeline();
+    // Position only pipelines of the prepass and EQUAL depth test variants of the graphics pipelines, created from the
+    // state of the graphics pipelines
+    b8 createDepthPrepassPipelines(VkGraphicsPipelineCreateInfo const & graphics_pipeline_info,
+                                   VkShaderModule instanced_vert_shader);
 
     b8 createTriangle();
     void destroyTriangle();
@@ -96,8 +510,14 @@ private:
     b8 isDeviceSuitable(VkPhysicalDevice device, sbstd::span<char const * const> required_exts,
                         EnumMask<VkQueueFamilyFeature> queue_features);
 
-    b8 createUniformBuffers();
-    void destroyUniformBuffers();
+    b8 createFrameContexts();
+    void destroyFrameContexts();
+
+    void startImageDecodes();
+    void releaseDecodedImages();
+
+    void startModelGeometryLoad();
+    static b8 loadModelGeometry(ModelGeometry * geometry);
 
     b8 loadTestTexture();
     void unloadTestTexture();
@@ -105,9 +525,16 @@ private:
     b8 loadModel();
     void unloadModel();
 
+    // Instances read by the GPU culling, only with Settings::gpu_culling
+    b8 createGpuInstances();
+    void destroyGpuInstances();
+
     b8 createDepthImage();
     void destroyDepthImage();
 
+    // Pyramid of the depth image, only with Settings::occlusion_culling
+    b8 createDepthPyramid();
+
     b8 createColorImage();
     void destroyColorImage();
 
@@ -115,17 +542,117 @@ private:
     void destroyDescriptors();
 
     b8 createCommandBuffers();
+    void destroyCommandBuffers();
     b8 createFrameBuffers();
 
+    void buildDrawList();
+    void publishFramePacket();
+    void applyFramePacket(FramePacket const & packet);
+    void runRenderThread();
+
+    glm::mat4 getInstancedView(f32 animation_time) const;
+
+    // Returns the number of transforms written, the visible instances only when culling
+    // The occlusion culling only applies to the instances which passed the frustum culling
+    // With a LOD selection, the transforms are grouped by level of detail of the model, frustum culling only
+    u32 updateInstanceTransforms(f32 animation_time, glm::mat4 const & view_proj, u32 instance_cnt,
+                                 b8 frustum_culling, b8 occlusion_culling, glm::mat4 * transforms, b8 use_job_system,
+                                 u32 * occlusion_culled_cnt = nullptr, InstanceLodSelection * lod_selection = nullptr);
+    // Draws the occluders picked by the previous update with the transforms of this one
+    void rasterizeOccluders(f32 animation_time, f32 const * view_proj, b8 use_job_system);
+    // Keeps the nearest of the drawn instances in the candidates of the calling thread
+    void pickOccluderCandidates(f32 const * view_proj, u32 const * instance_indices, u32 instance_cnt);
+    // Occluders of the next update, merged from the candidates of every thread
+    void selectOccluders();
+
+    VkResult presentFrame(PresentRequest const & request);
+    void waitForPresent(u64 present_id);
+    // Hands back the image acquired by a frame which failed before its submission and leaves the image available
+    // semaphore of the frame slot without any pending operation, the value and slot go to the next frame
+    void releaseAcquiredImage();
+    void runPresentThread();
+
+    void resetRecordingPools(u32 frame_idx);
+    VkCommandBuffer allocateSecondaryCommandBuffer(u32 frame_idx);
+    void recordInstanceCulling(VkCommandBuffer cmd_buffer, u32 frame_idx, sbstd::span<DrawCmd const> draws,
+                               CullPhase phase);
+    void recordMeshletCulling(VkCommandBuffer cmd_buffer, u32 frame_idx, sbstd::span<DrawCmd const> draws);
+    // The late phase only records the indirect draws, the other draws are complete after the early one
+    // 'depth_only' records the draws of the depth prepass with the position only pipelines
+    // 'first_draw_idx' is the index of the first of 'draws' in the draw list recorded by recordFrame()
+    void recordDraws(VkCommandBuffer cmd_buffer, u32 frame_idx, sbstd::span<DrawCmd const> draws, u32 first_draw_idx,
+                     CullPhase phase = CULL_PHASE_EARLY, b8 depth_only = false);
+    // More than one thread records the draws in secondary command buffers, force_secondaries does it from one thread
+    b8 recordFrame(VkCommandBuffer cmd_buffer, u32 frame_idx, u32 img_idx, sbstd::span<DrawCmd const> draws,
+                   u32 thread_cnt, VkCommandBufferUsageFlags usage_flags, b8 force_secondaries = false);
+    VkCommandBuffer getRecordedFrame(u32 frame_idx, u32 img_idx);
+    void destroyRecordedFrames();
+
     void cleanupSwapChainRelatedData();
-    void recreateSwapChainRelatedData(VkExtent2D frame_buffer_ext);
+    void retireSwapChainRelatedData();
+    void retireAttachments();
+    void updateAttachmentExtent();
+    // Keeps the current swapchain when the new one cannot be created
+    b8 recreateSwapChainRelatedData(VkExtent2D frame_buffer_ext);
 
     static VKAPI_ATTR VkBool32 VKAPI_CALL debugVulkanCallback(VkDebugUtilsMessageSeverityFlagBitsEXT msg_severity,
                                                               VkDebugUtilsMessageTypeFlagsEXT msg_type,
                                                               VkDebugUtilsMessengerCallbackDataEXT const * data,
                                                               void * user_data);
 
-    static constexpr u32 MAX_INFLIGHT_FRAMES = 2;
+    static constexpr u32 MAX_INFLIGHT_FRAMES = 3;
+    static constexpr u32 ATTACHMENT_SIZE_BUCKET = 256;
+    // the acquire holds the present lock, which the present thread needs to free an image, for that long at most
+    static constexpr u64 ACQUIRE_TIMEOUT_NS = 1'000'000;
+    // the render thread renders the last packet again when the main thread stalls for that long
+    static constexpr std::chrono::milliseconds FRAME_PACKET_TIMEOUT{20};
+    // distance between neighbour instances of DemoMode::INSTANCED, the model is about 2 units wide
+    static constexpr f32 INSTANCE_SPACING = 2.5f;
+    // widest SIMD kernel of computeSpinningTransforms()
+    static constexpr u32 INSTANCE_TRANSFORM_GROUP_SIZE = 8;
+    // below that many instances per batch the job overhead outweighs the transform cost
+    static constexpr u32 INSTANCE_TRANSFORM_BATCH_GROUP_CNT = 512;
+    // the LOD selection splits the instances in fixed batches so that the counts of a batch are found between passes
+    static constexpr u32 INSTANCE_LOD_BATCH_SIZE = INSTANCE_TRANSFORM_GROUP_SIZE * INSTANCE_TRANSFORM_BATCH_GROUP_CNT;
+    // projected error of the level of detail drawn for an instance
+    static constexpr f32 MAX_LOD_PIXEL_ERROR = 1.f;
+    // room for a few models of the size of the demo one, 5.5 MB of vertices and 4 MB of indices
+    // the full vertex format only holds the test meshes
+    static constexpr u32 GEOMETRY_ARENA_VERTEX_CAPACITIES[VERTEX_FORMAT_COUNT] = {16 * 1024, 256 * 1024};
+    static constexpr u32 GEOMETRY_ARENA_INDEX_CAPACITY = 1024 * 1024;
+    // local size of cull_instances.comp
+    static constexpr u32 CULL_GROUP_SIZE = 64;
+    // instances drawn by the software occlusion culling, a few near ones hide most of the grid
+    static constexpr u32 OCCLUDER_COUNT = 8;
+
+    static_assert(OCCLUDER_COUNT <= OcclusionRasterizer::MAX_OCCLUDER_COUNT);
+
+    // Nearest instances drawn by the batches a thread ran, sorted by increasing clip space w
+    struct OccluderCandidates
+    {
+        u32 instance_indices[OCCLUDER_COUNT];
+        f32 depths[OCCLUDER_COUNT];
+        u32 cnt = 0;
+
+        void insert(u32 instance_idx, f32 depth)
+        {
+            if ((OCCLUDER_COUNT == cnt) && (depth >= depths[OCCLUDER_COUNT - 1]))
+            {
+                return;
+            }
+
+            u32 insert_idx = sbstd::min(cnt, OCCLUDER_COUNT - 1);
+            for (; (0 != insert_idx) && (depth < depths[insert_idx - 1]); --insert_idx)
+            {
+                instance_indices[insert_idx] = instance_indices[insert_idx - 1];
+                depths[insert_idx] = depths[insert_idx - 1];
+            }
+
+            instance_indices[insert_idx] = instance_idx;
+            depths[insert_idx] = depth;
+            cnt = sbstd::min(cnt + 1, OCCLUDER_COUNT);
+        }
+    };
 
     b8 _enable_dbg_layers = false;
     VkSampleCountFlagBits _vk_sample_count = VK_SAMPLE_COUNT_1_BIT;
@@ -141,20 +668,61 @@ private:
     DArray<VkImage> _vk_swapchain_imgs;
     DArray<VkImageView> _vk_swapchain_imgs_view;
     VkExtent2D _vk_swapchain_ext = {};
+    // High-water mark of the swapchain extent rounded up to ATTACHMENT_SIZE_BUCKET
+    // the frames only render to the top left corner of the attachments
+    VkExtent2D _vk_attachment_ext = {};
     VkFormat _vk_swapchain_fmt = VK_FORMAT_UNDEFINED;
+    std::atomic<VkPresentModeKHR> _vk_present_mode = VK_PRESENT_MODE_FIFO_KHR;
+    std::atomic<u32> _swapchain_img_cnt = 0;
+    // queried once, the surface present modes do not change over its lifetime
+    DArray<VkPresentModeKHR> _vk_supported_present_modes;
+    b8 _swapchain_settings_changed = false;
+    b8 _present_wait_supported = false;
+    // lets the GPU culling skip the draws it emptied, the draws are submitted and read an instance count of 0 otherwise
+    b8 _draw_indirect_count_supported = false;
+    // required by the late draw of the occlusion culling, whose instances follow the ones of the early draw
+    b8 _draw_indirect_first_instance_supported = false;
+    b8 _multi_draw_indirect_supported = false;
+    // the frames are timed on the GPU only when every graphics queue supports timestamps
+    b8 _gpu_timestamps_supported = false;
+    f32 _gpu_timestamp_period_ns = 0.f;
+    // the timestamps of the graphics queue wrap around past their valid bits
+    u64 _gpu_timestamp_mask = 0;
+    // GPU time of the frames read back since the last reset, for the benchmarks
+    f64 _gpu_frame_time_total_ms = 0.;
+    u32 _gpu_timed_frame_cnt = 0;
+    PFN_vkWaitForPresentKHR _vk_wait_for_present = nullptr;
+    // when the inputs of the frame being rendered have been sampled
+    std::chrono::high_resolution_clock::time_point _input_sample_time;
     VkPipelineLayout _vk_pipeline_layout = VK_NULL_HANDLE;
     VkDescriptorSetLayout _vk_desc_set_layout = VK_NULL_HANDLE;
     VkDescriptorPool _vk_desc_pool = VK_NULL_HANDLE;
-    DArray<VkDescriptorSet> _vk_desc_sets;
     VkRenderPass _vk_render_pass = VK_NULL_HANDLE;
+    // continues the frame after the depth pyramid is built, only with the occlusion culling
+    VkRenderPass _vk_late_render_pass = VK_NULL_HANDLE;
     VkPipeline _vk_graphics_pipeline = VK_NULL_HANDLE;
+    VkPipeline _vk_instanced_pipeline = VK_NULL_HANDLE;
+    // with Settings::depth_prepass, position only pipelines of the first subpass and EQUAL depth test variants of
+    // the pipelines above for the main subpass, which keeps the ones above while the prepass is toggled off
+    VkPipeline _vk_depth_pipeline = VK_NULL_HANDLE;
+    VkPipeline _vk_instanced_depth_pipeline = VK_NULL_HANDLE;
+    VkPipeline _vk_graphics_equal_pipeline = VK_NULL_HANDLE;
+    VkPipeline _vk_instanced_equal_pipeline = VK_NULL_HANDLE;
+    // subpass of the render passes drawing the color, 1 after the depth prepass
+    u32 _vk_main_subpass = 0;
+    // applied from the frame packet, whether the recorded frames draw the depth prepass
+    b8 _draw_depth_prepass = false;
+    VkPipeline _vk_cull_pipeline = VK_NULL_HANDLE;
+    // the occlusion variant pushes the culling phase and samples the depth pyramid from set 1
+    VkPipelineLayout _vk_occlusion_cull_pipeline_layout = VK_NULL_HANDLE;
+    VkPipeline _vk_occlusion_cull_pipeline = VK_NULL_HANDLE;
+    VkPipeline _vk_meshlet_cull_pipeline = VK_NULL_HANDLE;
     DArray<VkFramebuffer> _vk_frame_buffers;
     VkCommandPool _vk_graphics_cmd_pool = VK_NULL_HANDLE;
-    DArray<VkCommandBuffer> _vk_cmd_buffers;
-    VkSemaphore _vk_image_available_sems[MAX_INFLIGHT_FRAMES] = {};
-    VkSemaphore _vk_render_finished_sems[MAX_INFLIGHT_FRAMES] = {};
-    VkFence _vk_inflight_fences[MAX_INFLIGHT_FRAMES] = {};
-    DArray<VkFence> _vk_inuse_fences;
+    DArray<VkCommandBuffer> _secondary_cmd_buffers;
+    VkCommandPool _vk_static_cmd_pool = VK_NULL_HANDLE;
+    DArray<FrameContext> _frames;
+    FrameScheduler _frame_scheduler;
 
     VkImageMem _vk_color_image = {};
     VkImageView _vk_color_image_view = VK_NULL_HANDLE;
@@ -164,28 +732,76 @@ private:
     VkSampler _vk_test_sampler = VK_NULL_HANDLE;
 
     DemoModel _model = {};
+    // never modified once initialized
+    SpinningInstances _instances;
+    BoundingSpheres _instance_bounds;
+    // indices of the instances which passed the culling, per batch of the update, only used by the thread rendering
+    DArray<u32> _visible_instances;
+    // levels of detail of the model drawn for the instances, 1 without the LOD selection
+    u32 _instance_lod_cnt = 1;
+    // errors of the levels relative to the radius of the instance bounding spheres
+    f32 _instance_lod_errors[MAX_MESH_LOD_COUNT] = {};
+    // with the LOD selection, instance count of each level for each batch and room to sort the visible instances
+    DArray<u32> _instance_lod_batch_cnts;
+    DArray<u32> _instance_lod_scratch;
+    VkBufferMem _vk_gpu_instances = {};
+    // 1 for the instances visible at the end of the last frame, only with the occlusion culling
+    VkBufferMem _vk_instance_visibility = {};
+    // only with Settings::software_occlusion_culling, draws the model of the occluders
+    OcclusionRasterizer _occlusion_rasterizer;
+    DArray<OccluderCandidates> _occluder_candidates; // one per job system thread slot
+    u32 _occluder_instances[OCCLUDER_COUNT] = {};
+    u32 _occluder_cnt = 0;
 
     VkFormat _vk_depth_fmt = VK_FORMAT_UNDEFINED;
     VkImageMem _vk_depth_image = {};
     VkImageView _vk_depth_image_view = VK_NULL_HANDLE;
+    // built from the depth of the early render pass, follows the depth image
+    DepthPyramid _depth_pyramid;
 
-    VkBuffer _vk_triangle_vb = VK_NULL_HANDLE;
-    VkDeviceMemory _vk_triangle_vb_mem = VK_NULL_HANDLE;
-
-    VkBuffer _vk_quad_vb = VK_NULL_HANDLE;
-    VkDeviceMemory _vk_quad_vb_mem = VK_NULL_HANDLE;
-    VkBuffer _vk_quad_ib = VK_NULL_HANDLE;
-    VkDeviceMemory _vk_quad_ib_mem = VK_NULL_HANDLE;
-
-    DArray<VkBufferMem> _vk_mvp_buffers;
+    // vertices and indices of every mesh, bound once for all the draws
+    GeometryArena _geometry_arena;
+    GeometryMesh _triangle_mesh = {};
+    GeometryMesh _quad_mesh = {};
+    MeshBounds _triangle_bounds = {};
+    MeshBounds _quad_bounds = {};
 
     VkExtent2D _target_frame_buffer_ext = {};
+    // last frame buffer extent reported by the window, the swapchain is only resized when it changes
+    VkExtent2D _window_frame_buffer_ext = {};
+    Settings _settings = {};
     u32 _current_frame = 0U;
-    DemoMode _demo_mode = DemoMode::TRIANGLE;
-    std::chrono::high_resolution_clock::time_point _start_time;
 
-    VkVertexInputBindingDescription _vk_vertex_binding_desc = {};
-    VkVertexInputAttributeDescription _vk_vertex_attributes_desc[3] = {};
+    // State owned by the thread calling update(), copied to the published frame packets
+    FramePacket _next_frame;
+    DemoMode _demo_mode = DemoMode::TRIANGLE;
+    // the animation time only advances while animating so that it resumes where it stopped
+    f32 _animation_time = 0.f;
+    std::chrono::high_resolution_clock::time_point _animation_sample_time;
+    std::atomic<b8> _redraw_requested = true;
+
+    TripleBuffer<FramePacket> _frame_packets;
+    std::thread _render_thread;
+    std::atomic<b8> _render_thread_exit_requested = false;
+
+    // never more than MAX_INFLIGHT_FRAMES frames wait for their present
+    SpscQueue<PresentRequest, 4> _present_requests;
+    std::thread _present_thread;
+    // host access to the swapchain and to the present queue has to be externally synchronized
+    std::mutex _present_mutex;
+    // id of the last frame handed to vkQueuePresentKHR
+    std::atomic<u64> _presented_value = 0;
+    // the present thread found the swapchain out of date or suboptimal
+    std::atomic<b8> _swapchain_out_of_date = false;
+
+    // written by the thread rendering
+    mutable std::mutex _culling_stats_mutex;
+    CullingStats _culling_stats;
+
+
+    DecodedImage _decoded_images[DECODED_IMAGE_COUNT];
+    ModelGeometry _model_geometry;
+    JobSystem _job_system;
 };
 VKAPI_ATTR VkBool32 VKAPI_CALL VulkanApp::debugVulkanCallback(VkDebugUtilsMessageSeverityFlagBitsEXT msg_severity,
                                                               VkDebugUtilsMessageTypeFlagsEXT msg_type,
@@ -233,7 +849,8 @@ VKAPI_ATTR VkBool32 VKAPI_CALL VulkanApp::debugVulkanCallback(VkDebugUtilsMessag
 
 void VulkanApp::notifyTargetFrameBufferResized(VkExtent2D frame_buffer_ext)
 {
-    _target_frame_buffer_ext = frame_buffer_ext;
+    _next_frame.frame_buffer_ext = frame_buffer_ext;
+    _redraw_requested = true;
 }
 
 b8 VulkanApp::initializeVulkanCore(GLFWwindow * wnd)
@@ -283,7 +900,7 @@ b8 VulkanApp::initializeVulkanCore(GLFWwindow * wnd)
     app_info.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
     app_info.pEngineName = "Sunburst";
     app_info.engineVersion = VK_MAKE_VERSION(0, 0, 1);
-    app_info.apiVersion = VK_API_VERSION_1_1;
+    app_info.apiVersion = VK_API_VERSION_1_2;
 
     u32 glfw_ext_cnt = 0;
     const char ** glfw_exts = glfwGetRequiredInstanceExtensions(&glfw_ext_cnt);
@@ -437,13 +1054,67 @@ b8 VulkanApp::initializeVulkanCore(GLFWwindow * wnd)
     VkPhysicalDeviceFeatures device_features = {};
     device_features.samplerAnisotropy = VK_TRUE;
 
+    VkPhysicalDeviceVulkan12Features supported_features_12 = {};
+    supported_features_12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+
+    VkPhysicalDeviceFeatures2 supported_features = {};
+    supported_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    supported_features.pNext = &supported_features_12;
+    vkGetPhysicalDeviceFeatures2(_vk_phys_device, &supported_features);
+
+    // optional, vkCmdDrawIndexedIndirect is used instead
+    _draw_indirect_count_supported = (VK_TRUE == supported_features_12.drawIndirectCount);
+
+    // optional, the occlusion culling and the LOD selection are disabled without it
+    _draw_indirect_first_instance_supported = (VK_TRUE == supported_features.features.drawIndirectFirstInstance);
+    device_features.drawIndirectFirstInstance = supported_features.features.drawIndirectFirstInstance;
+
+    // optional, the levels of detail of the instances are drawn by separate indirect draws without it
+    _multi_draw_indirect_supported = (VK_TRUE == supported_features.features.multiDrawIndirect);
+    device_features.multiDrawIndirect = supported_features.features.multiDrawIndirect;
+
+    VkPhysicalDeviceVulkan12Features device_features_12 = {};
+    device_features_12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    device_features_12.timelineSemaphore = VK_TRUE;
+    device_features_12.drawIndirectCount = supported_features_12.drawIndirectCount;
+
+    SArray<char const *, 8> device_exts(begin(required_device_extensions), end(required_device_extensions));
+
+    // optional, used to measure when frames actually reach the screen
+    char const * const present_wait_exts[] = {VK_KHR_PRESENT_ID_EXTENSION_NAME, VK_KHR_PRESENT_WAIT_EXTENSION_NAME};
+
+    VkPhysicalDevicePresentWaitFeaturesKHR present_wait_features = {};
+    present_wait_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+
+    VkPhysicalDevicePresentIdFeaturesKHR present_id_features = {};
+    present_id_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+    present_id_features.pNext = &present_wait_features;
+
+    _present_wait_supported = false;
+    if (checkDeviceExtensionsSupport(_vk_phys_device, present_wait_exts))
+    {
+        VkPhysicalDeviceFeatures2 features_2 = {};
+        features_2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        features_2.pNext = &present_id_features;
+        vkGetPhysicalDeviceFeatures2(_vk_phys_device, &features_2);
+
+        _present_wait_supported = present_id_features.presentId && present_wait_features.presentWait;
+    }
+
+    if (_present_wait_supported)
+    {
+        device_exts.insert(end(device_exts), begin(present_wait_exts), end(present_wait_exts));
+        device_features_12.pNext = &present_id_features;
+    }
+
     VkDeviceCreateInfo device_info = {};
     device_info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+    device_info.pNext = &device_features_12;
     device_info.pQueueCreateInfos = sbstd::data(queues_info);
     device_info.queueCreateInfoCount = numericConv<u32>(queues_info.size());
     device_info.pEnabledFeatures = &device_features;
-    device_info.ppEnabledExtensionNames = required_device_extensions;
-    device_info.enabledExtensionCount = numericConv<u32>(sbstd::size(required_device_extensions));
+    device_info.ppEnabledExtensionNames = device_exts.data();
+    device_info.enabledExtensionCount = numericConv<u32>(device_exts.size());
 
     if (_enable_dbg_layers)
     {
@@ -464,6 +1135,13 @@ b8 VulkanApp::initializeVulkanCore(GLFWwindow * wnd)
         return false;
     }
 
+    if (_present_wait_supported)
+    {
+        _vk_wait_for_present =
+            reinterpret_cast<PFN_vkWaitForPresentKHR>(vkGetDeviceProcAddr(_vk_device, "vkWaitForPresentKHR"));
+        _present_wait_supported = (nullptr != _vk_wait_for_present);
+    }
+
     vkGetDeviceQueue(_vk_device, best_queue_desc.graphics, 0, &_vk_graphics_queue);
     if (VK_NULL_HANDLE == _vk_graphics_queue)
     {
@@ -480,6 +1158,19 @@ b8 VulkanApp::initializeVulkanCore(GLFWwindow * wnd)
 
     VkPhysicalDeviceProperties phys_device_props = {};
     vkGetPhysicalDeviceProperties(_vk_phys_device, &phys_device_props);
+    _gpu_timestamp_period_ns = phys_device_props.limits.timestampPeriod;
+
+    u32 queue_family_cnt = 0;
+    SArray<VkQueueFamilyProperties, 10> queue_family_props;
+    vkGetPhysicalDeviceQueueFamilyProperties(_vk_phys_device, &queue_family_cnt, nullptr);
+
+    queue_family_props.resize(queue_family_cnt);
+    vkGetPhysicalDeviceQueueFamilyProperties(_vk_phys_device, &queue_family_cnt, queue_family_props.data());
+
+    u32 const timestamp_valid_bits = queue_family_props[best_queue_desc.graphics].timestampValidBits;
+    _gpu_timestamps_supported =
+        (VK_TRUE == phys_device_props.limits.timestampComputeAndGraphics) && (0 != timestamp_valid_bits);
+    _gpu_timestamp_mask = (64 <= timestamp_valid_bits) ? ~0ULL : ((1ULL << timestamp_valid_bits) - 1);
     auto const sample_cnt =
         phys_device_props.limits.framebufferColorSampleCounts & phys_device_props.limits.framebufferDepthSampleCounts;
 
@@ -533,32 +1224,6 @@ b8 VulkanApp::initializeVulkanCore(GLFWwindow * wnd)
         return false;
     }
 
-    VkSemaphoreCreateInfo sem_info = {};
-    sem_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
-    sem_info.flags = 0;
-
-    VkFenceCreateInfo fence_info = {};
-    fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-    fence_info.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-
-    for (u32 sem_idx = 0; MAX_INFLIGHT_FRAMES != sem_idx; ++sem_idx)
-    {
-        if ((VK_SUCCESS != vkCreateSemaphore(_vk_device, &sem_info, nullptr, &_vk_image_available_sems[sem_idx])) ||
-            (VK_SUCCESS != vkCreateSemaphore(_vk_device, &sem_info, nullptr, &_vk_render_finished_sems[sem_idx])))
-        {
-            sbLogE("Failed to create Vulkan sync semaphores");
-            return false;
-        }
-
-        if (VK_SUCCESS != vkCreateFence(_vk_device, &fence_info, nullptr, &_vk_inflight_fences[sem_idx]))
-        {
-            sbLogE("Failed to create Vulkan sync fences");
-            return false;
-        }
-    }
-
-    _vk_inuse_fences.resize(_vk_swapchain_imgs.size());
-
     return true;
 }
 
@@ -572,6 +1237,26 @@ b8 VulkanApp::isDeviceSuitable(VkPhysicalDevice phys_device, sbstd::span<char co
         return false;
     }
 
+    // frames are paced with a timeline semaphore, the Vulkan 1.2 features can only be queried from a 1.2 device
+    VkPhysicalDeviceProperties props;
+    vkGetPhysicalDeviceProperties(phys_device, &props);
+    if (props.apiVersion < VK_API_VERSION_1_2)
+    {
+        return false;
+    }
+
+    VkPhysicalDeviceVulkan12Features features_12 = {};
+    features_12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+
+    VkPhysicalDeviceFeatures2 features_2 = {};
+    features_2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features_2.pNext = &features_12;
+    vkGetPhysicalDeviceFeatures2(phys_device, &features_2);
+    if (!features_12.timelineSemaphore)
+    {
+        return false;
+    }
+
     if (!checkDeviceExtensionsSupport(phys_device, required_exts))
     {
         return false;
@@ -599,10 +1284,31 @@ void VulkanApp::terminateVulkanCore()
 
     vkDestroyPipeline(_vk_device, _vk_graphics_pipeline, nullptr);
     _vk_graphics_pipeline = VK_NULL_HANDLE;
+    vkDestroyPipeline(_vk_device, _vk_instanced_pipeline, nullptr);
+    _vk_instanced_pipeline = VK_NULL_HANDLE;
+    vkDestroyPipeline(_vk_device, _vk_depth_pipeline, nullptr);
+    _vk_depth_pipeline = VK_NULL_HANDLE;
+    vkDestroyPipeline(_vk_device, _vk_instanced_depth_pipeline, nullptr);
+    _vk_instanced_depth_pipeline = VK_NULL_HANDLE;
+    vkDestroyPipeline(_vk_device, _vk_graphics_equal_pipeline, nullptr);
+    _vk_graphics_equal_pipeline = VK_NULL_HANDLE;
+    vkDestroyPipeline(_vk_device, _vk_instanced_equal_pipeline, nullptr);
+    _vk_instanced_equal_pipeline = VK_NULL_HANDLE;
+    vkDestroyPipeline(_vk_device, _vk_cull_pipeline, nullptr);
+    _vk_cull_pipeline = VK_NULL_HANDLE;
+    vkDestroyPipeline(_vk_device, _vk_occlusion_cull_pipeline, nullptr);
+    _vk_occlusion_cull_pipeline = VK_NULL_HANDLE;
+    vkDestroyPipeline(_vk_device, _vk_meshlet_cull_pipeline, nullptr);
+    _vk_meshlet_cull_pipeline = VK_NULL_HANDLE;
+    vkDestroyPipelineLayout(_vk_device, _vk_occlusion_cull_pipeline_layout, nullptr);
+    _vk_occlusion_cull_pipeline_layout = VK_NULL_HANDLE;
+    _depth_pyramid.terminate();
     vkDestroyPipelineLayout(_vk_device, _vk_pipeline_layout, nullptr);
     _vk_pipeline_layout = VK_NULL_HANDLE;
     vkDestroyRenderPass(_vk_device, _vk_render_pass, nullptr);
     _vk_render_pass = VK_NULL_HANDLE;
+    vkDestroyRenderPass(_vk_device, _vk_late_render_pass, nullptr);
+    _vk_late_render_pass = VK_NULL_HANDLE;
 
     if (_vk_desc_set_layout != VK_NULL_HANDLE)
     {
@@ -610,28 +1316,6 @@ void VulkanApp::terminateVulkanCore()
         _vk_desc_set_layout = VK_NULL_HANDLE;
     }
 
-    for (u32 sem_idx = 0; sem_idx != MAX_INFLIGHT_FRAMES; ++sem_idx)
-    {
-        if (VK_NULL_HANDLE != _vk_image_available_sems[sem_idx])
-        {
-            vkDestroySemaphore(_vk_device, _vk_image_available_sems[sem_idx], nullptr);
-        }
-
-        if (VK_NULL_HANDLE != _vk_render_finished_sems[sem_idx])
-        {
-            vkDestroySemaphore(_vk_device, _vk_render_finished_sems[sem_idx], nullptr);
-        }
-
-        if (VK_NULL_HANDLE != _vk_inflight_fences[sem_idx])
-        {
-            vkDestroyFence(_vk_device, _vk_inflight_fences[sem_idx], nullptr);
-        }
-
-        _vk_image_available_sems[sem_idx] = VK_NULL_HANDLE;
-        _vk_render_finished_sems[sem_idx] = VK_NULL_HANDLE;
-        _vk_inflight_fences[sem_idx] = VK_NULL_HANDLE;
-    }
-
     if (VK_NULL_HANDLE != _vk_graphics_cmd_pool)
     {
         vkDestroyCommandPool(_vk_device, _vk_graphics_cmd_pool, nullptr);
@@ -685,148 +1369,60 @@ void VulkanApp::cleanupSwapChainRelatedData()
 
     destroyColorImage();
     destroyDepthImage();
+    _depth_pyramid.destroy();
+    _vk_attachment_ext = {};
 }
 
 b8 VulkanApp::createQuad()
 {
-    Vertex const quad_data[] = {{{-0.5f, -0.5f, 0.0f}, {1.0f, 0.0f, 0.0f}, {0.0f, 0.0f}},
-                                {{0.5f, -0.5f, 0.0f}, {0.0f, 1.0f, 0.0f}, {1.0f, 0.0f}},
-                                {{0.5f, 0.5f, 0.0f}, {0.0f, 0.0f, 1.0f}, {1.0f, 1.0f}},
-                                {{-0.5f, 0.5f, 0.0f}, {1.0f, 1.0f, 1.0f}, {0.0f, 1.0f}},
-                                {{-0.5f, -0.5f, -0.5f}, {1.0f, 0.0f, 0.0f}, {0.0f, 0.0f}},
-                                {{0.5f, -0.5f, -0.5f}, {0.0f, 1.0f, 0.0f}, {1.0f, 0.0f}},
-                                {{0.5f, 0.5f, -0.5f}, {0.0f, 0.0f, 1.0f}, {1.0f, 1.0f}},
-                                {{-0.5f, 0.5f, -0.5f}, {1.0f, 1.0f, 1.0f}, {0.0f, 1.0f}}};
+    glm::vec3 const quad_positions[] = {{-0.5f, -0.5f, 0.0f},  {0.5f, -0.5f, 0.0f},  {0.5f, 0.5f, 0.0f},
+                                        {-0.5f, 0.5f, 0.0f},   {-0.5f, -0.5f, -0.5f}, {0.5f, -0.5f, -0.5f},
+                                        {0.5f, 0.5f, -0.5f},   {-0.5f, 0.5f, -0.5f}};
+    VertexAttributes const quad_attributes[] = {{{1.0f, 0.0f, 0.0f}, {0.0f, 0.0f}}, {{0.0f, 1.0f, 0.0f}, {1.0f, 0.0f}},
+                                                {{0.0f, 0.0f, 1.0f}, {1.0f, 1.0f}}, {{1.0f, 1.0f, 1.0f}, {0.0f, 1.0f}},
+                                                {{1.0f, 0.0f, 0.0f}, {0.0f, 0.0f}}, {{0.0f, 1.0f, 0.0f}, {1.0f, 0.0f}},
+                                                {{0.0f, 0.0f, 1.0f}, {1.0f, 1.0f}}, {{1.0f, 1.0f, 1.0f}, {0.0f, 1.0f}}};
     u32 const quad_indices[] = {0, 1, 2, 2, 3, 0, 4, 5, 6, 6, 7, 4};
-    VkDeviceSize const ib_size = sizeof(quad_indices);
-    VkDeviceSize const vb_size = sizeof(quad_data);
-
-    {
-        VkBufferMem final_ib_mem;
-        auto vk_res = createVkBuffer(_vk_phys_device, _vk_device, ib_size,
-                                     VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
-                                     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &final_ib_mem);
-
-        if (VK_SUCCESS != vk_res)
-        {
-            sbLogE("Failed to create Vulkan final quad IB (error = '{}')", getEnumValue(vk_res));
-            return false;
-        }
-
-        _vk_quad_ib = final_ib_mem.buffer;
-        _vk_quad_ib_mem = final_ib_mem.memory;
-
-        vk_res = uploadVkBufferDataToDevice(_vk_phys_device, _vk_device, (void *)sbstd::data(quad_indices), ib_size,
-                                            _vk_graphics_cmd_pool, _vk_graphics_queue, _vk_quad_ib);
-        if (VK_SUCCESS != vk_res)
-        {
-            sbLogE("Failed to upload Vulkan quad data (error = '{}')", getEnumValue(vk_res));
-            return false;
-        }
-    }
-
-    {
-        VkBufferMem final_vb_mem;
-        auto vk_res = createVkBuffer(_vk_phys_device, _vk_device, vb_size,
-                                     VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-                                     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &final_vb_mem);
-
-        if (VK_SUCCESS != vk_res)
-        {
-            sbLogE("Failed to create Vulkan final quad VB (error = '{}')", getEnumValue(vk_res));
-            return false;
-        }
-
-        _vk_quad_vb = final_vb_mem.buffer;
-        _vk_quad_vb_mem = final_vb_mem.memory;
 
-        vk_res = uploadVkBufferDataToDevice(_vk_phys_device, _vk_device, (void *)sbstd::data(quad_data), vb_size,
-                                            _vk_graphics_cmd_pool, _vk_graphics_queue, _vk_quad_vb);
-        if (VK_SUCCESS != vk_res)
-        {
-            sbLogE("Failed to upload Vulkan quad data (error = '{}')", getEnumValue(vk_res));
-            return false;
-        }
-    }
+    _quad_bounds = computeMeshBounds(&quad_positions[0].x, numericConv<u32>(sbstd::size(quad_positions)),
+                                     sizeof(glm::vec3));
 
-    return true;
+    return _geometry_arena.addMesh(_vk_graphics_cmd_pool, _vk_graphics_queue, VERTEX_FORMAT_FULL,
+                                   &quad_positions[0].x, quad_attributes, numericConv<u32>(sbstd::size(quad_positions)),
+                                   quad_indices, numericConv<u32>(sbstd::size(quad_indices)), &_quad_mesh);
 }
 
 void VulkanApp::destroyQuad()
 {
-    if (_vk_quad_ib_mem != VK_NULL_HANDLE)
-    {
-        vkFreeMemory(_vk_device, _vk_quad_ib_mem, nullptr);
-        _vk_quad_ib_mem = VK_NULL_HANDLE;
-    }
-
-    if (_vk_quad_vb_mem != VK_NULL_HANDLE)
-    {
-        vkFreeMemory(_vk_device, _vk_quad_vb_mem, nullptr);
-        _vk_quad_vb_mem = VK_NULL_HANDLE;
-    }
-
-    if (_vk_quad_ib != VK_NULL_HANDLE)
-    {
-        vkDestroyBuffer(_vk_device, _vk_quad_ib, nullptr);
-        _vk_quad_ib = VK_NULL_HANDLE;
-    }
-
-    if (_vk_quad_vb != VK_NULL_HANDLE)
-    {
-        vkDestroyBuffer(_vk_device, _vk_quad_vb, nullptr);
-        _vk_quad_vb = VK_NULL_HANDLE;
-    }
+    _geometry_arena.removeMesh(_quad_mesh);
+    _quad_mesh = {};
+    _quad_bounds = {};
 }
 
 b8 VulkanApp::createTriangle()
 {
-    Vertex const triangle_data[] = {
-        {{-0.5f, 0.5f, 0.f}, {1.f, 0.f, 0.f}, {0.0, 1.0}},  {{0.f, -0.5f, 0.f}, {0.f, 1.f, 0.f}, {0.5, 0.0}},
-        {{0.5f, 0.5f, 0.f}, {0.f, 0.f, 1.f}, {1.0, 1.0}},   {{-0.5f, 0.5f, -0.5f}, {1.f, 0.f, 0.f}, {0.0, 1.0}},
-        {{0.f, -0.5f, -0.5f}, {0.f, 1.f, 0.f}, {0.5, 0.0}}, {{0.5f, 0.5f, -0.5f}, {0.f, 0.f, 1.f}, {1.0, 1.0}}};
-
-    auto const triangle_data_size = sizeof(triangle_data);
-
-    VkBufferMem final_buffer_mem = {};
-    auto vk_res = createVkBuffer(_vk_phys_device, _vk_device, triangle_data_size,
-                                 VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-                                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &final_buffer_mem);
-
-    if (VK_SUCCESS != vk_res)
-    {
-        sbLogE("Failed to create Vulkan final buffer for test triangle (error = '{}')", getEnumValue(vk_res));
-        return false;
-    }
-
-    _vk_triangle_vb = final_buffer_mem.buffer;
-    _vk_triangle_vb_mem = final_buffer_mem.memory;
-
-    vk_res = uploadVkBufferDataToDevice(_vk_phys_device, _vk_device, (void *)sbstd::data(triangle_data),
-                                        triangle_data_size, _vk_graphics_cmd_pool, _vk_graphics_queue, _vk_triangle_vb);
-
-    if (VK_SUCCESS != vk_res)
-    {
-        sbLogE("Failed to upload Vulkan triangle data to the device (error = '{}')", getEnumValue(vk_res));
-        return false;
-    }
-
-    return true;
+    glm::vec3 const triangle_positions[] = {{-0.5f, 0.5f, 0.f},   {0.f, -0.5f, 0.f},   {0.5f, 0.5f, 0.f},
+                                            {-0.5f, 0.5f, -0.5f}, {0.f, -0.5f, -0.5f}, {0.5f, 0.5f, -0.5f}};
+    VertexAttributes const triangle_attributes[] = {{{1.f, 0.f, 0.f}, {0.0, 1.0}}, {{0.f, 1.f, 0.f}, {0.5, 0.0}},
+                                                    {{0.f, 0.f, 1.f}, {1.0, 1.0}}, {{1.f, 0.f, 0.f}, {0.0, 1.0}},
+                                                    {{0.f, 1.f, 0.f}, {0.5, 0.0}}, {{0.f, 0.f, 1.f}, {1.0, 1.0}}};
+    // indexed like the other meshes so that its draws can join a multi-draw indirect
+    u32 const triangle_indices[] = {0, 1, 2, 3, 4, 5};
+
+    _triangle_bounds = computeMeshBounds(&triangle_positions[0].x, numericConv<u32>(sbstd::size(triangle_positions)),
+                                         sizeof(glm::vec3));
+
+    return _geometry_arena.addMesh(_vk_graphics_cmd_pool, _vk_graphics_queue, VERTEX_FORMAT_FULL,
+                                   &triangle_positions[0].x, triangle_attributes,
+                                   numericConv<u32>(sbstd::size(triangle_positions)), triangle_indices,
+                                   numericConv<u32>(sbstd::size(triangle_indices)), &_triangle_mesh);
 }
 
 void VulkanApp::destroyTriangle()
 {
-    if (_vk_triangle_vb_mem != VK_NULL_HANDLE)
-    {
-        vkFreeMemory(_vk_device, _vk_triangle_vb_mem, nullptr);
-        _vk_triangle_vb_mem = VK_NULL_HANDLE;
-    }
-
-    if (_vk_triangle_vb != VK_NULL_HANDLE)
-    {
-        vkDestroyBuffer(_vk_device, _vk_triangle_vb, nullptr);
-        _vk_triangle_vb = VK_NULL_HANDLE;
-    }
+    _geometry_arena.removeMesh(_triangle_mesh);
+    _triangle_mesh = {};
+    _triangle_bounds = {};
 }
 
 b8 VulkanApp::createSwapChain(VkExtent2D frame_buffer_ext)
@@ -847,14 +1443,17 @@ b8 VulkanApp::createSwapChain(VkExtent2D frame_buffer_ext)
         swapchain_surface_fmt = surface_swapchain_props.formats[0];
     }
 
+    // FIFO is the only mode guaranteed to be supported
     VkPresentModeKHR swapchain_present_mode = VK_PRESENT_MODE_FIFO_KHR;
-    for (auto mode_iter : surface_swapchain_props.present_modes)
+    auto const present_mode_iter = sbstd::find(begin(surface_swapchain_props.present_modes),
+                                               end(surface_swapchain_props.present_modes), _settings.present_mode);
+    if (present_mode_iter != end(surface_swapchain_props.present_modes))
     {
-        if (mode_iter == VK_PRESENT_MODE_MAILBOX_KHR)
-        {
-            swapchain_present_mode = VK_PRESENT_MODE_MAILBOX_KHR;
-            break;
-        }
+        swapchain_present_mode = _settings.present_mode;
+    }
+    else
+    {
+        sbLogW("Present mode '{}' is not supported, falling back to FIFO", getVkPresentModeName(_settings.present_mode));
     }
 
     VkExtent2D swapchain_ext = {};
@@ -872,16 +1471,24 @@ b8 VulkanApp::createSwapChain(VkExtent2D frame_buffer_ext)
                        sbstd::min(frame_buffer_ext.height, surface_swapchain_props.caps.maxImageExtent.height));
     }
 
-    u32 swapchain_img_cnt = surface_swapchain_props.caps.minImageCount + 1;
-    if ((surface_swapchain_props.caps.minImageCount > 0) &&
+    // every frame in flight needs its own image
+    u32 const min_img_cnt = sbstd::max(surface_swapchain_props.caps.minImageCount, _settings.inflight_frame_cnt);
+    u32 swapchain_img_cnt = (0 != _settings.swapchain_img_cnt)
+                                ? sbstd::max(_settings.swapchain_img_cnt, min_img_cnt)
+                                : sbstd::max(min_img_cnt, surface_swapchain_props.caps.minImageCount + 1);
+
+    // a max image count of 0 means there is no limit
+    if ((surface_swapchain_props.caps.maxImageCount > 0) &&
         (swapchain_img_cnt > surface_swapchain_props.caps.maxImageCount))
     {
         swapchain_img_cnt = surface_swapchain_props.caps.maxImageCount;
     }
 
-    if (swapchain_img_cnt < MAX_INFLIGHT_FRAMES)
+    // checked before the old swapchain is retired so that it is kept
+    if (swapchain_img_cnt < _settings.inflight_frame_cnt)
     {
-        sbLogE("Failed to create swapchain because the minimum of {} images cannot be fulfilled", MAX_INFLIGHT_FRAMES);
+        sbLogE("Failed to create swapchain because the minimum of {} images cannot be fulfilled",
+               _settings.inflight_frame_cnt);
         return false;
     }
 
@@ -914,25 +1521,58 @@ b8 VulkanApp::createSwapChain(VkExtent2D frame_buffer_ext)
     swapchain_info.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
     swapchain_info.presentMode = swapchain_present_mode;
     swapchain_info.clipped = VK_TRUE;
-    swapchain_info.oldSwapchain = VK_NULL_HANDLE;
+    // lets the driver reuse the old swapchain resources and keep presenting the images already queued
+    swapchain_info.oldSwapchain = _vk_swapchain;
 
-    VkResult vk_res = vkCreateSwapchainKHR(_vk_device, &swapchain_info, nullptr, &_vk_swapchain);
-    if (VK_SUCCESS != vk_res)
+    VkSwapchainKHR const old_swapchain = _vk_swapchain;
+    VkResult vk_res = VK_SUCCESS;
+
+    {
+        // the present thread may still present the frames queued to the old swapchain
+        std::lock_guard<std::mutex> lock(_present_mutex);
+        _vk_swapchain = VK_NULL_HANDLE;
+        vk_res = vkCreateSwapchainKHR(_vk_device, &swapchain_info, nullptr, &_vk_swapchain);
+    }
+
+    if (VK_SUCCESS != vk_res)
     {
+        // the old swapchain is retired even if the creation failed, its next acquire reports it out of date
+        std::lock_guard<std::mutex> lock(_present_mutex);
+        _vk_swapchain = old_swapchain;
         sbLogE("Failed to create Vulkan swapchain (error = '{}')", getEnumValue(vk_res));
         return false;
     }
 
+    if (VK_NULL_HANDLE != old_swapchain)
+    {
+        // presentation has no completion signal, once the frames following the ones in flight are done
+        // the images of the old swapchain are no longer presented
+        VkDevice const device = _vk_device;
+        _frame_scheduler.deferRelease(
+            _frame_scheduler.getFrameValue() + _frame_scheduler.getInflightFrameCount(),
+            [device, old_swapchain]() { vkDestroySwapchainKHR(device, old_swapchain, nullptr); });
+    }
+
+    // no device wait: the old resources are retired and the frames keep flowing while the window is resized
+    retireSwapChainRelatedData();
+
     _vk_swapchain_ext = swapchain_ext;
     _target_frame_buffer_ext = swapchain_ext;
     _vk_swapchain_fmt = swapchain_surface_fmt.format;
+    _vk_present_mode = swapchain_present_mode;
+
+    if (_vk_supported_present_modes.empty())
+    {
+        _vk_supported_present_modes = surface_swapchain_props.present_modes;
+    }
 
     //_vk_swapchain_imgs
     u32 img_cnt = 0;
     vkGetSwapchainImagesKHR(_vk_device, _vk_swapchain, &img_cnt, nullptr);
-    sbAssert(img_cnt == swapchain_img_cnt);
+    sbAssert(img_cnt >= swapchain_img_cnt);
     _vk_swapchain_imgs.resize(img_cnt);
     vkGetSwapchainImagesKHR(_vk_device, _vk_swapchain, &img_cnt, _vk_swapchain_imgs.data());
+    _swapchain_img_cnt = img_cnt;
 
     _vk_swapchain_imgs_view.reserve(img_cnt);
     for (auto const img : _vk_swapchain_imgs)
@@ -966,18 +1606,86 @@ b8 VulkanApp::createSwapChain(VkExtent2D frame_buffer_ext)
     return true;
 }
 
-void VulkanApp::recreateSwapChainRelatedData(VkExtent2D frame_buffer_ext)
+void VulkanApp::retireSwapChainRelatedData()
 {
-    vkDeviceWaitIdle(_vk_device);
+    // frames in flight may still render to these so they are released once they are done
+    VkDevice const device = _vk_device;
 
-    cleanupSwapChainRelatedData();
+    for (auto frame_buffer : _vk_frame_buffers)
+    {
+        _frame_scheduler.deferRelease([device, frame_buffer]() { vkDestroyFramebuffer(device, frame_buffer, nullptr); });
+    }
+    _vk_frame_buffers.clear();
+
+    for (auto image_view : _vk_swapchain_imgs_view)
+    {
+        _frame_scheduler.deferRelease([device, image_view]() { vkDestroyImageView(device, image_view, nullptr); });
+    }
+    _vk_swapchain_imgs_view.clear();
+    _vk_swapchain_imgs.clear();
+}
+
+void VulkanApp::retireAttachments()
+{
+    VkDevice const device = _vk_device;
+
+    VkImageMem const color_image = _vk_color_image;
+    VkImageView const color_image_view = _vk_color_image_view;
+    VkImageMem const depth_image = _vk_depth_image;
+    VkImageView const depth_image_view = _vk_depth_image_view;
+
+    _frame_scheduler.deferRelease([device, color_image, color_image_view, depth_image, depth_image_view]() {
+        vkDestroyImageView(device, color_image_view, nullptr);
+        destroyVkImage(device, color_image);
+        vkDestroyImageView(device, depth_image_view, nullptr);
+        destroyVkImage(device, depth_image);
+    });
+
+    _vk_color_image = {};
+    _vk_color_image_view = VK_NULL_HANDLE;
+    _vk_depth_image = {};
+    _vk_depth_image_view = VK_NULL_HANDLE;
+    _vk_depth_fmt = VK_FORMAT_UNDEFINED;
+
+    _depth_pyramid.retire(_frame_scheduler);
+}
+
+void VulkanApp::updateAttachmentExtent()
+{
+    auto const roundUpToBucket = [](u32 size) {
+        return ((size + ATTACHMENT_SIZE_BUCKET - 1) / ATTACHMENT_SIZE_BUCKET) * ATTACHMENT_SIZE_BUCKET;
+    };
+
+    _vk_attachment_ext.width = sbstd::max(_vk_attachment_ext.width, roundUpToBucket(_vk_swapchain_ext.width));
+    _vk_attachment_ext.height = sbstd::max(_vk_attachment_ext.height, roundUpToBucket(_vk_swapchain_ext.height));
+}
+
+b8 VulkanApp::recreateSwapChainRelatedData(VkExtent2D frame_buffer_ext)
+{
+    // the swapchain related data stays untouched when the new swapchain cannot be created
+    if (!createSwapChain(frame_buffer_ext))
+    {
+        return false;
+    }
+
+    _frame_scheduler.setImageCount(numericConv<u32>(_vk_swapchain_imgs.size()));
+
+    // the attachments are only reallocated when the window grows past them
+    if ((_vk_swapchain_ext.width > _vk_attachment_ext.width) || (_vk_swapchain_ext.height > _vk_attachment_ext.height))
+    {
+        retireAttachments();
+        updateAttachmentExtent();
+        createColorImage();
+        createDepthImage();
+        createDepthPyramid();
+    }
 
-    createSwapChain(frame_buffer_ext);
-    createColorImage();
-    createDepthImage();
     createFrameBuffers();
-    // createGraphicsPipeline();
-    // createCommandBuffers();
+
+    // recorded frames reference the old framebuffers and extent
+    destroyRecordedFrames();
+
+    return true;
 }
 
 b8 VulkanApp::createDescriptors()
@@ -996,7 +1704,8 @@ b8 VulkanApp::createDescriptors()
     sampler_info.compareOp = VK_COMPARE_OP_EQUAL;
     sampler_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
     sampler_info.mipLodBias = 0.f;
-    if (_demo_mode == DemoMode::MODEL)
+    b8 const use_model_texture = (_demo_mode == DemoMode::MODEL) || (_demo_mode == DemoMode::INSTANCED);
+    if (use_model_texture)
     {
         // sampler_info.minLod = (float)_model.mip_cnt/2.f;
         sampler_info.maxLod = (float)_model.mip_cnt;
@@ -1014,17 +1723,21 @@ b8 VulkanApp::createDescriptors()
         return false;
     }
 
-    VkDescriptorPoolSize pool_sizes[2] = {};
+    u32 const frame_cnt = numericConv<u32>(_frames.size());
+
+    VkDescriptorPoolSize pool_sizes[3] = {};
     pool_sizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    pool_sizes[0].descriptorCount = MAX_INFLIGHT_FRAMES;
+    pool_sizes[0].descriptorCount = frame_cnt * 3;
     pool_sizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    pool_sizes[1].descriptorCount = MAX_INFLIGHT_FRAMES;
+    pool_sizes[1].descriptorCount = frame_cnt;
+    pool_sizes[2].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    pool_sizes[2].descriptorCount = frame_cnt * 10;
 
     VkDescriptorPoolCreateInfo pool_info = {};
     pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
     pool_info.poolSizeCount = numericConv<u32>(sbstd::size(pool_sizes));
     pool_info.pPoolSizes = sbstd::data(pool_sizes);
-    pool_info.maxSets = MAX_INFLIGHT_FRAMES;
+    pool_info.maxSets = frame_cnt;
 
     vk_res = vkCreateDescriptorPool(_vk_device, &pool_info, nullptr, &_vk_desc_pool);
     if (VK_SUCCESS != vk_res)
@@ -1033,7 +1746,8 @@ b8 VulkanApp::createDescriptors()
         return false;
     }
 
-    FArray<VkDescriptorSetLayout, MAX_INFLIGHT_FRAMES> layouts(MAX_INFLIGHT_FRAMES, _vk_desc_set_layout);
+    FArray<VkDescriptorSetLayout, MAX_INFLIGHT_FRAMES> layouts(frame_cnt, _vk_desc_set_layout);
+    FArray<VkDescriptorSet, MAX_INFLIGHT_FRAMES> desc_sets(frame_cnt, VK_NULL_HANDLE);
 
     VkDescriptorSetAllocateInfo desc_set_alloc_info = {};
     desc_set_alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
@@ -1042,29 +1756,44 @@ b8 VulkanApp::createDescriptors()
     desc_set_alloc_info.descriptorPool = _vk_desc_pool;
 
     // descriptor sets are cleaned up automatically with the pool
-    _vk_desc_sets.resize(MAX_INFLIGHT_FRAMES);
-    vk_res = vkAllocateDescriptorSets(_vk_device, &desc_set_alloc_info, _vk_desc_sets.data());
+    vk_res = vkAllocateDescriptorSets(_vk_device, &desc_set_alloc_info, desc_sets.data());
     if (VK_SUCCESS != vk_res)
     {
         sbLogE("Failed to allocate Vulkan descriptor sets (error = '{}')", getEnumValue(vk_res));
         return false;
     }
 
-    for (u32 frame_idx = 0; frame_idx != MAX_INFLIGHT_FRAMES; ++frame_idx)
+    for (u32 frame_idx = 0; frame_idx != frame_cnt; ++frame_idx)
     {
+        FrameContext & frame = _frames[frame_idx];
+        frame.desc_set = desc_sets[frame_idx];
+
         VkDescriptorBufferInfo buffer_info = {};
-        buffer_info.buffer = _vk_mvp_buffers[frame_idx].buffer;
+        buffer_info.buffer = frame.mvp_buffer.buffer;
         buffer_info.offset = 0;
         buffer_info.range = VK_WHOLE_SIZE;
 
+        VkDescriptorBufferInfo instance_buffer_info = {};
+        instance_buffer_info.buffer = frame.instance_buffer.buffer;
+        instance_buffer_info.offset = 0;
+        instance_buffer_info.range = VK_WHOLE_SIZE;
+
+        VkDescriptorBufferInfo vertex_buffer_infos[2] = {};
+        vertex_buffer_infos[0].buffer = _geometry_arena.getPositionBuffer();
+        vertex_buffer_infos[0].offset = 0;
+        vertex_buffer_infos[0].range = VK_WHOLE_SIZE;
+        vertex_buffer_infos[1].buffer = _geometry_arena.getAttributeBuffer();
+        vertex_buffer_infos[1].offset = 0;
+        vertex_buffer_infos[1].range = VK_WHOLE_SIZE;
+
         VkDescriptorImageInfo img_info = {};
-        img_info.imageView = _demo_mode == DemoMode::MODEL ? _model.image_view : _vk_test_texture_view;
+        img_info.imageView = use_model_texture ? _model.image_view : _vk_test_texture_view;
         img_info.sampler = _vk_test_sampler;
         img_info.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 
-        VkWriteDescriptorSet descs_write_info[2] = {};
+        VkWriteDescriptorSet descs_write_info[4] = {};
         descs_write_info[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        descs_write_info[0].dstSet = _vk_desc_sets[frame_idx];
+        descs_write_info[0].dstSet = frame.desc_set;
         descs_write_info[0].dstBinding = 0;
         descs_write_info[0].dstArrayElement = 0;
         descs_write_info[0].descriptorCount = 1;
@@ -1072,15 +1801,114 @@ b8 VulkanApp::createDescriptors()
         descs_write_info[0].pBufferInfo = &buffer_info;
 
         descs_write_info[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        descs_write_info[1].dstSet = _vk_desc_sets[frame_idx];
+        descs_write_info[1].dstSet = frame.desc_set;
         descs_write_info[1].dstBinding = 1;
         descs_write_info[1].dstArrayElement = 0;
         descs_write_info[1].descriptorCount = 1;
         descs_write_info[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
         descs_write_info[1].pImageInfo = &img_info;
 
+        descs_write_info[2].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descs_write_info[2].dstSet = frame.desc_set;
+        descs_write_info[2].dstBinding = 2;
+        descs_write_info[2].dstArrayElement = 0;
+        descs_write_info[2].descriptorCount = 1;
+        descs_write_info[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        descs_write_info[2].pBufferInfo = &instance_buffer_info;
+
+        descs_write_info[3].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descs_write_info[3].dstSet = frame.desc_set;
+        descs_write_info[3].dstBinding = 12;
+        descs_write_info[3].dstArrayElement = 0;
+        descs_write_info[3].descriptorCount = 2; // consecutive bindings 12 and 13
+        descs_write_info[3].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        descs_write_info[3].pBufferInfo = sbstd::data(vertex_buffer_infos);
+
         vkUpdateDescriptorSets(_vk_device, numericConv<u32>(sbstd::size(descs_write_info)),
                                sbstd::data(descs_write_info), 0, nullptr);
+
+        if (_settings.meshlet_culling)
+        {
+            VkDescriptorBufferInfo meshlet_buffer_infos[5] = {};
+            meshlet_buffer_infos[0].buffer = frame.meshlet_cull_params_buffer.buffer;
+            meshlet_buffer_infos[1].buffer = _model.meshlets.buffer;
+            meshlet_buffer_infos[2].buffer = _geometry_arena.getIndexBuffer();
+            meshlet_buffer_infos[3].buffer = frame.meshlet_ib.buffer;
+            meshlet_buffer_infos[4].buffer = frame.meshlet_draw_buffer.buffer;
+
+            VkWriteDescriptorSet meshlet_write_infos[5] = {};
+            for (u32 write_idx = 0; write_idx != sbstd::size(meshlet_write_infos); ++write_idx)
+            {
+                meshlet_buffer_infos[write_idx].offset = 0;
+                meshlet_buffer_infos[write_idx].range = VK_WHOLE_SIZE;
+
+                meshlet_write_infos[write_idx].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                meshlet_write_infos[write_idx].dstSet = frame.desc_set;
+                meshlet_write_infos[write_idx].dstBinding = 7 + write_idx;
+                meshlet_write_infos[write_idx].dstArrayElement = 0;
+                meshlet_write_infos[write_idx].descriptorCount = 1;
+                meshlet_write_infos[write_idx].descriptorType =
+                    (0 == write_idx) ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+                meshlet_write_infos[write_idx].pBufferInfo = &meshlet_buffer_infos[write_idx];
+            }
+
+            vkUpdateDescriptorSets(_vk_device, numericConv<u32>(sbstd::size(meshlet_write_infos)),
+                                   sbstd::data(meshlet_write_infos), 0, nullptr);
+        }
+
+        // the culling bindings are left empty otherwise, the culling pipeline is never bound then
+        if (!_settings.gpu_culling)
+        {
+            continue;
+        }
+
+        VkDescriptorBufferInfo cull_buffer_infos[3] = {};
+        cull_buffer_infos[0].buffer = frame.cull_params_buffer.buffer;
+        cull_buffer_infos[0].offset = 0;
+        cull_buffer_infos[0].range = VK_WHOLE_SIZE;
+        cull_buffer_infos[1].buffer = _vk_gpu_instances.buffer;
+        cull_buffer_infos[1].offset = 0;
+        cull_buffer_infos[1].range = VK_WHOLE_SIZE;
+        cull_buffer_infos[2].buffer = frame.indirect_buffer.buffer;
+        cull_buffer_infos[2].offset = 0;
+        cull_buffer_infos[2].range = VK_WHOLE_SIZE;
+
+        VkWriteDescriptorSet cull_write_infos[3] = {};
+        for (u32 write_idx = 0; write_idx != sbstd::size(cull_write_infos); ++write_idx)
+        {
+            cull_write_infos[write_idx].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            cull_write_infos[write_idx].dstSet = frame.desc_set;
+            cull_write_infos[write_idx].dstBinding = 3 + write_idx;
+            cull_write_infos[write_idx].dstArrayElement = 0;
+            cull_write_infos[write_idx].descriptorCount = 1;
+            cull_write_infos[write_idx].descriptorType =
+                (0 == write_idx) ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            cull_write_infos[write_idx].pBufferInfo = &cull_buffer_infos[write_idx];
+        }
+
+        vkUpdateDescriptorSets(_vk_device, numericConv<u32>(sbstd::size(cull_write_infos)),
+                               sbstd::data(cull_write_infos), 0, nullptr);
+
+        if (!_settings.occlusion_culling)
+        {
+            continue;
+        }
+
+        VkDescriptorBufferInfo visibility_buffer_info = {};
+        visibility_buffer_info.buffer = _vk_instance_visibility.buffer;
+        visibility_buffer_info.offset = 0;
+        visibility_buffer_info.range = VK_WHOLE_SIZE;
+
+        VkWriteDescriptorSet visibility_write_info = {};
+        visibility_write_info.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        visibility_write_info.dstSet = frame.desc_set;
+        visibility_write_info.dstBinding = 6;
+        visibility_write_info.dstArrayElement = 0;
+        visibility_write_info.descriptorCount = 1;
+        visibility_write_info.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        visibility_write_info.pBufferInfo = &visibility_buffer_info;
+
+        vkUpdateDescriptorSets(_vk_device, 1, &visibility_write_info, 0, nullptr);
     }
 
     return true;
@@ -1094,7 +1922,10 @@ void VulkanApp::destroyDescriptors()
         _vk_desc_pool = VK_NULL_HANDLE;
     }
 
-    _vk_desc_sets.clear();
+    for (auto & frame : _frames)
+    {
+        frame.desc_set = VK_NULL_HANDLE;
+    }
 
     if (VK_NULL_HANDLE != _vk_test_sampler)
     {
@@ -1103,155 +1934,589 @@ void VulkanApp::destroyDescriptors()
     }
 }
 
-b8 VulkanApp::createUniformBuffers()
+b8 VulkanApp::createFrameContexts()
 {
+    sbAssert(_frames.empty());
+
+    u32 const frame_cnt = _settings.inflight_frame_cnt;
+    _frames.resize(frame_cnt);
+
+    VkSemaphoreCreateInfo sem_info = {};
+    sem_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    sem_info.flags = 0;
+
     VkDeviceSize const uni_mvp_size = sizeof(UniformMVP);
+    VkDeviceSize const instance_buffer_size = sizeof(glm::mat4) * _settings.instance_cnt;
+
+    // the GPU culling writes the transforms and the indirect draw itself, they never leave the device
+    b8 const gpu_culling = _settings.gpu_culling;
+    VkMemoryPropertyFlags const culled_mem_props =
+        gpu_culling ? VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+                    : (VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
 
-    _vk_mvp_buffers.resize(MAX_INFLIGHT_FRAMES);
-    for (auto & buffer : _vk_mvp_buffers)
+    for (auto & frame : _frames)
     {
+        // binary semaphores are still required by the swapchain acquire and present
+        if ((VK_SUCCESS != vkCreateSemaphore(_vk_device, &sem_info, nullptr, &frame.image_available_sem)) ||
+            (VK_SUCCESS != vkCreateSemaphore(_vk_device, &sem_info, nullptr, &frame.render_finished_sem)))
+        {
+            sbLogE("Failed to create Vulkan sync semaphores");
+            return false;
+        }
+
         VkResult vk_res =
             createVkBuffer(_vk_phys_device, _vk_device, uni_mvp_size, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-                           VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, &buffer);
+                           VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+                           &frame.mvp_buffer);
         if (VK_SUCCESS != vk_res)
         {
             sbLogE("Failed to create Vulkan uniform buffer (error = '{}')", getEnumValue(vk_res));
             return false;
         }
-    }
 
-    return true;
-}
+        vk_res = createVkBuffer(_vk_phys_device, _vk_device, instance_buffer_size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                culled_mem_props, &frame.instance_buffer);
+        if (VK_SUCCESS != vk_res)
+        {
+            sbLogE("Failed to create Vulkan instance buffer (error = '{}')", getEnumValue(vk_res));
+            return false;
+        }
 
-void VulkanApp::destroyUniformBuffers()
-{
-    for (auto buffer : _vk_mvp_buffers)
-    {
-        destroyVkBuffer(_vk_device, buffer);
-    }
-    _vk_mvp_buffers.clear();
-}
+        vk_res = createVkBuffer(_vk_phys_device, _vk_device, INDIRECT_BUFFER_SIZE,
+                                VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                                    VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                culled_mem_props, &frame.indirect_buffer);
+        if (VK_SUCCESS != vk_res)
+        {
+            sbLogE("Failed to create Vulkan indirect buffer (error = '{}')", getEnumValue(vk_res));
+            return false;
+        }
 
-b8 VulkanApp::createGraphicsPipeline()
-{
-    VkDescriptorSetLayoutBinding desc_set_binding[2] = {};
+        if (gpu_culling)
+        {
+            vk_res = createVkBuffer(_vk_phys_device, _vk_device, sizeof(UniformCullParams),
+                                    VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                                    VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+                                    &frame.cull_params_buffer);
+            if (VK_SUCCESS != vk_res)
+            {
+                sbLogE("Failed to create Vulkan culling parameters buffer (error = '{}')", getEnumValue(vk_res));
+                return false;
+            }
 
-    desc_set_binding[0].binding = 0; // binding index in the sader
-    desc_set_binding[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER; // same type as is shader (uniform)
-    desc_set_binding[0].descriptorCount = 1; // > 1 when specifying an array of uniform e.g. skinning matrices
-    desc_set_binding[0].stageFlags = VK_SHADER_STAGE_VERTEX_BIT; // uniform used by vertex shader
-    desc_set_binding[0].pImmutableSamplers = nullptr; // only useful for images
+            void * cull_params_data = nullptr;
+            vk_res = vkMapMemory(_vk_device, frame.cull_params_buffer.memory, 0, sizeof(UniformCullParams), 0,
+                                 &cull_params_data);
+            if (VK_SUCCESS != vk_res)
+            {
+                sbLogE("Failed to map Vulkan culling parameters buffer (error = '{}')", getEnumValue(vk_res));
+                return false;
+            }
 
-    desc_set_binding[1].binding = 1;
-    desc_set_binding[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    desc_set_binding[1].descriptorCount = 1;
-    desc_set_binding[1].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
-    desc_set_binding[1].pImmutableSamplers = nullptr;
+            frame.cull_params = static_cast<UniformCullParams *>(cull_params_data);
 
-    // Describe the descriptors binding for the whole pipeline
-    VkDescriptorSetLayoutCreateInfo desc_set_layout_info = {};
-    desc_set_layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-    desc_set_layout_info.bindingCount = numericConv<u32>(sbstd::size(desc_set_binding));
-    desc_set_layout_info.pBindings = sbstd::data(desc_set_binding);
+            vk_res = createVkBuffer(_vk_phys_device, _vk_device, sizeof(IndirectDraws),
+                                    VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                    VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+                                    &frame.cull_stats_buffer);
+            if (VK_SUCCESS != vk_res)
+            {
+                sbLogE("Failed to create Vulkan culling statistics buffer (error = '{}')", getEnumValue(vk_res));
+                return false;
+            }
 
-    VkResult vk_res = vkCreateDescriptorSetLayout(_vk_device, &desc_set_layout_info, nullptr, &_vk_desc_set_layout);
-    if (VK_SUCCESS != vk_res)
-    {
-        sbLogE("Failed to create Vulkan descriptor set (error = '{}')", getEnumValue(vk_res));
-        return false;
-    }
+            void * cull_stats_data = nullptr;
+            vk_res = vkMapMemory(_vk_device, frame.cull_stats_buffer.memory, 0, sizeof(IndirectDraws), 0,
+                                 &cull_stats_data);
+            if (VK_SUCCESS != vk_res)
+            {
+                sbLogE("Failed to map Vulkan culling statistics buffer (error = '{}')", getEnumValue(vk_res));
+                return false;
+            }
 
-    VkShaderModule vert_shader = VK_NULL_HANDLE;
-    VkShaderModule frag_shader = VK_NULL_HANDLE;
+            // read before the first frame of the slot reaches the GPU
+            memset(cull_stats_data, 0, sizeof(IndirectDraws));
+            frame.cull_stats = static_cast<IndirectDraws const *>(cull_stats_data);
+        }
+        else
+        {
+            void * instance_data = nullptr;
+            vk_res = vkMapMemory(_vk_device, frame.instance_buffer.memory, 0, instance_buffer_size, 0, &instance_data);
+            if (VK_SUCCESS != vk_res)
+            {
+                sbLogE("Failed to map Vulkan instance buffer (error = '{}')", getEnumValue(vk_res));
+                return false;
+            }
 
-    DArray<u8> shader_byte_code;
-    FileStream shader_file(VFS::openFileRead("/basic.vert", FileFormat::BIN));
-    if (!shader_file.isValid())
-    {
-        sbLogE("Failed to open vertex shader 'basic_vert'");
-        return false;
-    }
-    shader_byte_code.resize(shader_file.getLength());
-    shader_file.read(shader_byte_code);
-    vk_res = createVkShaderModule(_vk_device, shader_byte_code, &vert_shader);
-    if (VK_SUCCESS != vk_res)
-    {
-        sbLogE("Failed to create vertex shader (error = '{}')", getEnumValue(vk_res));
-        return false;
-    }
+            frame.instance_transforms = static_cast<glm::mat4 *>(instance_data);
 
-    shader_file.reset(VFS::openFileRead("/basic.frag", FileFormat::BIN));
-    if (!shader_file.isValid())
-    {
-        sbLogE("Failed to open vertex shader 'basic_vert'");
-        return false;
-    }
-    shader_byte_code.resize(shader_file.getLength());
-    shader_file.read(shader_byte_code);
-    vk_res = createVkShaderModule(_vk_device, shader_byte_code, &frag_shader);
-    if (VK_SUCCESS != vk_res)
-    {
-        sbLogE("Failed to create fragment shader (error = '{}')", getEnumValue(vk_res));
-        return false;
-    }
+            void * indirect_data = nullptr;
+            vk_res = vkMapMemory(_vk_device, frame.indirect_buffer.memory, 0, INDIRECT_BUFFER_SIZE, 0, &indirect_data);
+            if (VK_SUCCESS != vk_res)
+            {
+                sbLogE("Failed to map Vulkan indirect buffer (error = '{}')", getEnumValue(vk_res));
+                return false;
+            }
 
-    shader_file.reset();
+            frame.indirect_cmds = static_cast<VkDrawIndexedIndirectCommand *>(indirect_data);
+            memset(frame.indirect_cmds, 0, MAX_MESH_LOD_COUNT * sizeof(VkDrawIndexedIndirectCommand));
+        }
 
-    VkPipelineShaderStageCreateInfo prog_shaders_info[2] = {};
+        if (_settings.meshlet_culling)
+        {
+            // every meshlet may be visible
+            vk_res = createVkBuffer(_vk_phys_device, _vk_device, _model.lods[0].index_cnt * sizeof(u32),
+                                    VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &frame.meshlet_ib);
+            if (VK_SUCCESS != vk_res)
+            {
+                sbLogE("Failed to create Vulkan meshlet index buffer (error = '{}')", getEnumValue(vk_res));
+                return false;
+            }
 
-    prog_shaders_info[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-    prog_shaders_info[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
-    prog_shaders_info[0].module = vert_shader;
-    prog_shaders_info[0].pName = "main"; // shader entry point
-    prog_shaders_info[0].pSpecializationInfo = nullptr; // used to define pipeline creation time shader constants
+            vk_res = createVkBuffer(_vk_phys_device, _vk_device, sizeof(VkDrawIndexedIndirectCommand),
+                                    VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                                        VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &frame.meshlet_draw_buffer);
+            if (VK_SUCCESS != vk_res)
+            {
+                sbLogE("Failed to create Vulkan meshlet draw buffer (error = '{}')", getEnumValue(vk_res));
+                return false;
+            }
 
-    prog_shaders_info[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-    prog_shaders_info[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-    prog_shaders_info[1].module = frag_shader;
-    prog_shaders_info[1].pName = "main"; // shader entry point
-    prog_shaders_info[1].pSpecializationInfo = nullptr; // used to define pipeline creation time shader constants
+            vk_res = createVkBuffer(_vk_phys_device, _vk_device, sizeof(UniformMeshletCullParams),
+                                    VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                                    VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+                                    &frame.meshlet_cull_params_buffer);
+            if (VK_SUCCESS != vk_res)
+            {
+                sbLogE("Failed to create Vulkan meshlet culling parameters buffer (error = '{}')",
+                       getEnumValue(vk_res));
+                return false;
+            }
 
-    VkPipelineVertexInputStateCreateInfo vertex_input_info = {};
-    vertex_input_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-    vertex_input_info.vertexBindingDescriptionCount = 0;
-    vertex_input_info.pVertexBindingDescriptions = nullptr;
-    vertex_input_info.vertexAttributeDescriptionCount = 0;
-    vertex_input_info.pVertexAttributeDescriptions = nullptr;
-    vertex_input_info.vertexBindingDescriptionCount = 1;
-    vertex_input_info.pVertexBindingDescriptions = &_vk_vertex_binding_desc;
-    vertex_input_info.vertexAttributeDescriptionCount = numericConv<u32>(sbstd::size(_vk_vertex_attributes_desc));
-    vertex_input_info.pVertexAttributeDescriptions = sbstd::data(_vk_vertex_attributes_desc);
+            void * meshlet_cull_params_data = nullptr;
+            vk_res = vkMapMemory(_vk_device, frame.meshlet_cull_params_buffer.memory, 0,
+                                 sizeof(UniformMeshletCullParams), 0, &meshlet_cull_params_data);
+            if (VK_SUCCESS != vk_res)
+            {
+                sbLogE("Failed to map Vulkan meshlet culling parameters buffer (error = '{}')", getEnumValue(vk_res));
+                return false;
+            }
 
-    VkPipelineInputAssemblyStateCreateInfo input_assembly_info = {};
-    input_assembly_info.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-    input_assembly_info.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+            frame.meshlet_cull_params = static_cast<UniformMeshletCullParams *>(meshlet_cull_params_data);
+        }
 
-    VkPipelineDepthStencilStateCreateInfo depth_stencil_info = {};
-    depth_stencil_info.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
-    depth_stencil_info.depthTestEnable = VK_TRUE;
-    depth_stencil_info.depthWriteEnable = VK_TRUE;
-    depth_stencil_info.depthCompareOp = VK_COMPARE_OP_LESS;
-    depth_stencil_info.depthBoundsTestEnable = VK_FALSE;
+        if (_multi_draw_indirect_supported)
+        {
+            VkDeviceSize const multi_draw_buffer_size = MAX_MULTI_DRAW_COUNT * sizeof(VkDrawIndexedIndirectCommand);
 
-    // Defines render image transformation
-    VkViewport view_port = {};
-    view_port.width = (float)_vk_swapchain_ext.width;
-    view_port.height = (float)_vk_swapchain_ext.height;
-    view_port.x = 0;
-    view_port.y = 0;
-    view_port.minDepth = 0.f;
-    view_port.maxDepth = 1.f;
+            vk_res = createVkBuffer(_vk_phys_device, _vk_device, multi_draw_buffer_size,
+                                    VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                                    VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+                                    &frame.multi_draw_buffer);
+            if (VK_SUCCESS != vk_res)
+            {
+                sbLogE("Failed to create Vulkan multi-draw buffer (error = '{}')", getEnumValue(vk_res));
+                return false;
+            }
 
-    // Defines render image cut
-    VkRect2D scissor = {};
-    scissor.extent = _vk_swapchain_ext;
-    scissor.offset = {0, 0};
+            void * multi_draw_data = nullptr;
+            vk_res = vkMapMemory(_vk_device, frame.multi_draw_buffer.memory, 0, multi_draw_buffer_size, 0,
+                                 &multi_draw_data);
+            if (VK_SUCCESS != vk_res)
+            {
+                sbLogE("Failed to map Vulkan multi-draw buffer (error = '{}')", getEnumValue(vk_res));
+                return false;
+            }
 
-    VkPipelineViewportStateCreateInfo view_port_info = {};
-    view_port_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-    view_port_info.viewportCount = 1;
-    view_port_info.pViewports = &view_port;
-    view_port_info.scissorCount = 1;
+            frame.multi_draw_cmds = static_cast<VkDrawIndexedIndirectCommand *>(multi_draw_data);
+        }
+
+        // secondary command buffers are recorded by any job thread so each thread gets its own pool per frame
+        frame.recording_pools.resize(_job_system.getThreadSlotCount());
+        for (auto & recording_pool : frame.recording_pools)
+        {
+            VkCommandPoolCreateInfo cmd_pool_info = {};
+            cmd_pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+            cmd_pool_info.queueFamilyIndex = _queue_families.graphics;
+            cmd_pool_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+            vk_res = vkCreateCommandPool(_vk_device, &cmd_pool_info, nullptr, &recording_pool.cmd_pool);
+            if (VK_SUCCESS != vk_res)
+            {
+                sbLogE("Failed to create Vulkan recording command pool (error = '{}')", getEnumValue(vk_res));
+                return false;
+            }
+        }
+
+        if (_gpu_timestamps_supported)
+        {
+            VkQueryPoolCreateInfo query_pool_info = {};
+            query_pool_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+            query_pool_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+            query_pool_info.queryCount = 2;
+
+            vk_res = vkCreateQueryPool(_vk_device, &query_pool_info, nullptr, &frame.timestamp_pool);
+            if (VK_SUCCESS != vk_res)
+            {
+                sbLogE("Failed to create Vulkan timestamp query pool (error = '{}')", getEnumValue(vk_res));
+                return false;
+            }
+        }
+    }
+
+    _frame_scheduler.setLowLatencyPacing(_settings.low_latency_pacing);
+
+    if (!_frame_scheduler.initialize(_vk_device, frame_cnt))
+    {
+        return false;
+    }
+
+    _frame_scheduler.setImageCount(numericConv<u32>(_vk_swapchain_imgs.size()));
+    _current_frame = 0;
+
+    return true;
+}
+
+void VulkanApp::destroyFrameContexts()
+{
+    destroyRecordedFrames();
+
+    for (auto & frame : _frames)
+    {
+        if (VK_NULL_HANDLE != frame.image_available_sem)
+        {
+            vkDestroySemaphore(_vk_device, frame.image_available_sem, nullptr);
+        }
+
+        if (VK_NULL_HANDLE != frame.render_finished_sem)
+        {
+            vkDestroySemaphore(_vk_device, frame.render_finished_sem, nullptr);
+        }
+
+        if (VK_NULL_HANDLE != frame.cmd_buffer)
+        {
+            vkFreeCommandBuffers(_vk_device, _vk_graphics_cmd_pool, 1, &frame.cmd_buffer);
+        }
+
+        if (VK_NULL_HANDLE != frame.mvp_buffer.buffer)
+        {
+            destroyVkBuffer(_vk_device, frame.mvp_buffer);
+        }
+
+        if (VK_NULL_HANDLE != frame.timestamp_pool)
+        {
+            vkDestroyQueryPool(_vk_device, frame.timestamp_pool, nullptr);
+        }
+
+        if (VK_NULL_HANDLE != frame.instance_buffer.buffer)
+        {
+            if (nullptr != frame.instance_transforms)
+            {
+                vkUnmapMemory(_vk_device, frame.instance_buffer.memory);
+            }
+
+            destroyVkBuffer(_vk_device, frame.instance_buffer);
+        }
+
+        if (VK_NULL_HANDLE != frame.indirect_buffer.buffer)
+        {
+            if (nullptr != frame.indirect_cmds)
+            {
+                vkUnmapMemory(_vk_device, frame.indirect_buffer.memory);
+            }
+
+            destroyVkBuffer(_vk_device, frame.indirect_buffer);
+        }
+
+        if (VK_NULL_HANDLE != frame.multi_draw_buffer.buffer)
+        {
+            if (nullptr != frame.multi_draw_cmds)
+            {
+                vkUnmapMemory(_vk_device, frame.multi_draw_buffer.memory);
+            }
+
+            destroyVkBuffer(_vk_device, frame.multi_draw_buffer);
+        }
+
+        if (VK_NULL_HANDLE != frame.cull_params_buffer.buffer)
+        {
+            if (nullptr != frame.cull_params)
+            {
+                vkUnmapMemory(_vk_device, frame.cull_params_buffer.memory);
+            }
+
+            destroyVkBuffer(_vk_device, frame.cull_params_buffer);
+        }
+
+        if (VK_NULL_HANDLE != frame.cull_stats_buffer.buffer)
+        {
+            if (nullptr != frame.cull_stats)
+            {
+                vkUnmapMemory(_vk_device, frame.cull_stats_buffer.memory);
+            }
+
+            destroyVkBuffer(_vk_device, frame.cull_stats_buffer);
+        }
+
+        if (VK_NULL_HANDLE != frame.meshlet_ib.buffer)
+        {
+            destroyVkBuffer(_vk_device, frame.meshlet_ib);
+        }
+
+        if (VK_NULL_HANDLE != frame.meshlet_draw_buffer.buffer)
+        {
+            destroyVkBuffer(_vk_device, frame.meshlet_draw_buffer);
+        }
+
+        if (VK_NULL_HANDLE != frame.meshlet_cull_params_buffer.buffer)
+        {
+            if (nullptr != frame.meshlet_cull_params)
+            {
+                vkUnmapMemory(_vk_device, frame.meshlet_cull_params_buffer.memory);
+            }
+
+            destroyVkBuffer(_vk_device, frame.meshlet_cull_params_buffer);
+        }
+
+        // command buffers are freed along with their pool
+        for (auto & recording_pool : frame.recording_pools)
+        {
+            if (VK_NULL_HANDLE != recording_pool.cmd_pool)
+            {
+                vkDestroyCommandPool(_vk_device, recording_pool.cmd_pool, nullptr);
+            }
+        }
+    }
+
+    _frames.clear();
+    _secondary_cmd_buffers.clear();
+
+    _frame_scheduler.terminate();
+}
+
+b8 VulkanApp::setInflightFrameCount(u32 inflight_frame_cnt)
+{
+    inflight_frame_cnt = sbstd::clamp(inflight_frame_cnt, 1U, MAX_INFLIGHT_FRAMES);
+    if (inflight_frame_cnt == _frames.size())
+    {
+        return true;
+    }
+
+    vkDeviceWaitIdle(_vk_device);
+
+    destroyDescriptors();
+    destroyFrameContexts();
+
+    _settings.inflight_frame_cnt = inflight_frame_cnt;
+
+    return createFrameContexts() && createDescriptors();
+}
+
+b8 VulkanApp::createGraphicsPipeline()
+{
+    VkDescriptorSetLayoutBinding desc_set_binding[14] = {};
+
+    desc_set_binding[0].binding = 0; // binding index in the sader
+    desc_set_binding[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER; // same type as is shader (uniform)
+    desc_set_binding[0].descriptorCount = 1; // > 1 when specifying an array of uniform e.g. skinning matrices
+    desc_set_binding[0].stageFlags = VK_SHADER_STAGE_VERTEX_BIT; // uniform used by vertex shader
+    desc_set_binding[0].pImmutableSamplers = nullptr; // only useful for images
+
+    desc_set_binding[1].binding = 1;
+    desc_set_binding[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    desc_set_binding[1].descriptorCount = 1;
+    desc_set_binding[1].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+    desc_set_binding[1].pImmutableSamplers = nullptr;
+
+    // per-instance transforms of the instanced pipeline, written by the culling pass with the GPU culling
+    desc_set_binding[2].binding = 2;
+    desc_set_binding[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    desc_set_binding[2].descriptorCount = 1;
+    desc_set_binding[2].stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
+    desc_set_binding[2].pImmutableSamplers = nullptr;
+
+    // parameters, instances and indirect draw of the culling pass, only written with the GPU culling
+    desc_set_binding[3].binding = 3;
+    desc_set_binding[3].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    desc_set_binding[3].descriptorCount = 1;
+    desc_set_binding[3].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    desc_set_binding[3].pImmutableSamplers = nullptr;
+
+    desc_set_binding[4].binding = 4;
+    desc_set_binding[4].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    desc_set_binding[4].descriptorCount = 1;
+    desc_set_binding[4].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    desc_set_binding[4].pImmutableSamplers = nullptr;
+
+    desc_set_binding[5].binding = 5;
+    desc_set_binding[5].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    desc_set_binding[5].descriptorCount = 1;
+    desc_set_binding[5].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    desc_set_binding[5].pImmutableSamplers = nullptr;
+
+    // visibility of the instances kept by the occlusion culling from a frame to the next
+    desc_set_binding[6].binding = 6;
+    desc_set_binding[6].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    desc_set_binding[6].descriptorCount = 1;
+    desc_set_binding[6].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    desc_set_binding[6].pImmutableSamplers = nullptr;
+
+    // parameters, meshlets, model indices, visible indices and indirect draw of the meshlet culling, only written
+    // with the meshlet culling
+    for (u32 binding_idx = 7; binding_idx != 12; ++binding_idx)
+    {
+        desc_set_binding[binding_idx].binding = binding_idx;
+        desc_set_binding[binding_idx].descriptorType =
+            (7 == binding_idx) ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        desc_set_binding[binding_idx].descriptorCount = 1;
+        desc_set_binding[binding_idx].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        desc_set_binding[binding_idx].pImmutableSamplers = nullptr;
+    }
+
+    // vertex positions and attributes of the geometry arena, pulled by the vertex shaders
+    for (u32 binding_idx = 12; binding_idx != 14; ++binding_idx)
+    {
+        desc_set_binding[binding_idx].binding = binding_idx;
+        desc_set_binding[binding_idx].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        desc_set_binding[binding_idx].descriptorCount = 1;
+        desc_set_binding[binding_idx].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+        desc_set_binding[binding_idx].pImmutableSamplers = nullptr;
+    }
+
+    // Describe the descriptors binding for the whole pipeline
+    VkDescriptorSetLayoutCreateInfo desc_set_layout_info = {};
+    desc_set_layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    desc_set_layout_info.bindingCount = numericConv<u32>(sbstd::size(desc_set_binding));
+    desc_set_layout_info.pBindings = sbstd::data(desc_set_binding);
+
+    VkResult vk_res = vkCreateDescriptorSetLayout(_vk_device, &desc_set_layout_info, nullptr, &_vk_desc_set_layout);
+    if (VK_SUCCESS != vk_res)
+    {
+        sbLogE("Failed to create Vulkan descriptor set (error = '{}')", getEnumValue(vk_res));
+        return false;
+    }
+
+    VkShaderModule vert_shader = VK_NULL_HANDLE;
+    VkShaderModule instanced_vert_shader = VK_NULL_HANDLE;
+    VkShaderModule frag_shader = VK_NULL_HANDLE;
+    VkShaderModule cull_shader = VK_NULL_HANDLE;
+
+    DArray<u8> shader_byte_code;
+    FileStream shader_file(VFS::openFileRead("/basic.vert", FileFormat::BIN));
+    if (!shader_file.isValid())
+    {
+        sbLogE("Failed to open vertex shader 'basic_vert'");
+        return false;
+    }
+    shader_byte_code.resize(shader_file.getLength());
+    shader_file.read(shader_byte_code);
+    vk_res = createVkShaderModule(_vk_device, shader_byte_code, &vert_shader);
+    if (VK_SUCCESS != vk_res)
+    {
+        sbLogE("Failed to create vertex shader (error = '{}')", getEnumValue(vk_res));
+        return false;
+    }
+
+    shader_file.reset(VFS::openFileRead("/basic.frag", FileFormat::BIN));
+    if (!shader_file.isValid())
+    {
+        sbLogE("Failed to open vertex shader 'basic_vert'");
+        return false;
+    }
+    shader_byte_code.resize(shader_file.getLength());
+    shader_file.read(shader_byte_code);
+    vk_res = createVkShaderModule(_vk_device, shader_byte_code, &frag_shader);
+    if (VK_SUCCESS != vk_res)
+    {
+        sbLogE("Failed to create fragment shader (error = '{}')", getEnumValue(vk_res));
+        return false;
+    }
+
+    shader_file.reset(VFS::openFileRead("/instanced.vert", FileFormat::BIN));
+    if (!shader_file.isValid())
+    {
+        sbLogE("Failed to open vertex shader 'instanced_vert'");
+        return false;
+    }
+    shader_byte_code.resize(shader_file.getLength());
+    shader_file.read(shader_byte_code);
+    vk_res = createVkShaderModule(_vk_device, shader_byte_code, &instanced_vert_shader);
+    if (VK_SUCCESS != vk_res)
+    {
+        sbLogE("Failed to create instanced vertex shader (error = '{}')", getEnumValue(vk_res));
+        return false;
+    }
+
+    shader_file.reset(VFS::openFileRead("/cull_instances.comp", FileFormat::BIN));
+    if (!shader_file.isValid())
+    {
+        sbLogE("Failed to open compute shader 'cull_instances_comp'");
+        return false;
+    }
+    shader_byte_code.resize(shader_file.getLength());
+    shader_file.read(shader_byte_code);
+    vk_res = createVkShaderModule(_vk_device, shader_byte_code, &cull_shader);
+    if (VK_SUCCESS != vk_res)
+    {
+        sbLogE("Failed to create culling compute shader (error = '{}')", getEnumValue(vk_res));
+        return false;
+    }
+
+    shader_file.reset();
+
+    VkPipelineShaderStageCreateInfo prog_shaders_info[2] = {};
+
+    prog_shaders_info[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    prog_shaders_info[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+    prog_shaders_info[0].module = vert_shader;
+    prog_shaders_info[0].pName = "main"; // shader entry point
+    prog_shaders_info[0].pSpecializationInfo = nullptr; // used to define pipeline creation time shader constants
+
+    prog_shaders_info[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    prog_shaders_info[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+    prog_shaders_info[1].module = frag_shader;
+    prog_shaders_info[1].pName = "main"; // shader entry point
+    prog_shaders_info[1].pSpecializationInfo = nullptr; // used to define pipeline creation time shader constants
+
+    VkPipelineVertexInputStateCreateInfo vertex_input_info = {};
+    vertex_input_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    vertex_input_info.vertexBindingDescriptionCount = 0;
+    vertex_input_info.pVertexBindingDescriptions = nullptr;
+    vertex_input_info.vertexAttributeDescriptionCount = 0;
+    vertex_input_info.pVertexAttributeDescriptions = nullptr; // the vertex shaders pull the vertices themselves
+
+    VkPipelineInputAssemblyStateCreateInfo input_assembly_info = {};
+    input_assembly_info.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    input_assembly_info.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+    VkPipelineDepthStencilStateCreateInfo depth_stencil_info = {};
+    depth_stencil_info.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    depth_stencil_info.depthTestEnable = VK_TRUE;
+    depth_stencil_info.depthWriteEnable = VK_TRUE;
+    depth_stencil_info.depthCompareOp = VK_COMPARE_OP_LESS;
+    depth_stencil_info.depthBoundsTestEnable = VK_FALSE;
+
+    // Defines render image transformation
+    VkViewport view_port = {};
+    view_port.width = (float)_vk_swapchain_ext.width;
+    view_port.height = (float)_vk_swapchain_ext.height;
+    view_port.x = 0;
+    view_port.y = 0;
+    view_port.minDepth = 0.f;
+    view_port.maxDepth = 1.f;
+
+    // Defines render image cut
+    VkRect2D scissor = {};
+    scissor.extent = _vk_swapchain_ext;
+    scissor.offset = {0, 0};
+
+    VkPipelineViewportStateCreateInfo view_port_info = {};
+    view_port_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    view_port_info.viewportCount = 1;
+    view_port_info.pViewports = &view_port;
+    view_port_info.scissorCount = 1;
     view_port_info.pScissors = &scissor;
 
     VkPipelineRasterizationStateCreateInfo rasterizer_info = {};
@@ -1289,8 +2554,9 @@ b8 VulkanApp::createGraphicsPipeline()
     blend_info.pAttachments = &attach_blend;
 
     // Values which can be updated without re-creating the pipeline
+    // The scissor follows the swapchain extent inside the larger attachments
     VkDynamicState const dyn_states[] = {
-        VK_DYNAMIC_STATE_VIEWPORT
+        VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR
         //    , VK_DYNAMIC_STATE_LINE_WIDTH
     };
 
@@ -1369,6 +2635,13 @@ b8 VulkanApp::createGraphicsPipeline()
     sub_pass_desc.pDepthStencilAttachment = &depth_attach_ref;
     sub_pass_desc.pResolveAttachments = &color_resolve_attach_ref;
 
+    // With the depth prepass, a first subpass lays the depth without any color attachment before the main one
+    VkSubpassDescription prepass_sub_pass_descs[2] = {};
+    prepass_sub_pass_descs[0].pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    prepass_sub_pass_descs[0].pDepthStencilAttachment = &depth_attach_ref;
+    prepass_sub_pass_descs[1] = sub_pass_desc;
+    _vk_main_subpass = _settings.depth_prepass ? 1 : 0;
+
     VkRenderPassCreateInfo rndr_pass_info = {};
     rndr_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
     rndr_pass_info.attachmentCount = (u32)sbstd::size(attachments);
@@ -1390,12 +2663,128 @@ b8 VulkanApp::createGraphicsPipeline()
     rndr_pass_info.dependencyCount = 1;
     rndr_pass_info.pDependencies = &subpass_dep;
 
-    vk_res = vkCreateRenderPass(_vk_device, &rndr_pass_info, nullptr, &_vk_render_pass);
-    if (VK_SUCCESS != vk_res)
-    {
-        sbLogE("Failed to create Vulkan Render Pass (error = '{}')", getEnumValue(vk_res));
-        return false;
-    }
+    // the dependencies of the single subpass apply to both subpasses of the depth prepass and the main subpass waits
+    // for the depth of the prepass
+    DArray<VkSubpassDependency> prepass_deps;
+    auto const addDepthPrepass = [&](VkRenderPassCreateInfo & pass_info) {
+        if (!_settings.depth_prepass)
+        {
+            return;
+        }
+
+        prepass_deps.clear();
+        for (u32 dep_idx = 0; dep_idx != pass_info.dependencyCount; ++dep_idx)
+        {
+            VkSubpassDependency dep = pass_info.pDependencies[dep_idx];
+            prepass_deps.push_back(dep);
+            ((VK_SUBPASS_EXTERNAL == dep.srcSubpass) ? dep.dstSubpass : dep.srcSubpass) = 1;
+            prepass_deps.push_back(dep);
+        }
+
+        VkSubpassDependency prepass_dep = {};
+        prepass_dep.srcSubpass = 0;
+        prepass_dep.dstSubpass = 1;
+        prepass_dep.srcStageMask =
+            VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+        prepass_dep.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        prepass_dep.dstStageMask =
+            VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+        prepass_dep.dstAccessMask =
+            VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        prepass_dep.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+        prepass_deps.push_back(prepass_dep);
+
+        pass_info.subpassCount = numericConv<u32>(sbstd::size(prepass_sub_pass_descs));
+        pass_info.pSubpasses = sbstd::data(prepass_sub_pass_descs);
+        pass_info.dependencyCount = numericConv<u32>(prepass_deps.size());
+        pass_info.pDependencies = prepass_deps.data();
+    };
+
+    // With the occlusion culling, the frame is split in an early and a late render pass around the depth pyramid
+    // build, both resolve to the swapchain image to stay compatible with the framebuffers but only the late one keeps
+    // the result
+    VkSubpassDependency early_deps[2] = {};
+    VkAttachmentDescription late_attachments[3] = {attachments[0], attachments[1], attachments[2]};
+
+    if (_settings.occlusion_culling)
+    {
+        depth_attach_desc.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+        depth_attach_desc.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+        color_resolve_attach_desc.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        color_resolve_attach_desc.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        color_resolve_attach_desc.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+        // the attachments are shared with the late render pass and the depth pyramid build of the previous frame
+        early_deps[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+        early_deps[0].dstSubpass = 0;
+        early_deps[0].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+                                     VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+        early_deps[0].srcAccessMask =
+            VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        early_deps[0].dstStageMask =
+            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+        early_deps[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+                                      VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+                                      VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+        // the depth pyramid build reads the stored depth
+        early_deps[1].srcSubpass = 0;
+        early_deps[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+        early_deps[1].srcStageMask = VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+        early_deps[1].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        early_deps[1].dstStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+        early_deps[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+        rndr_pass_info.dependencyCount = numericConv<u32>(sbstd::size(early_deps));
+        rndr_pass_info.pDependencies = sbstd::data(early_deps);
+    }
+
+    addDepthPrepass(rndr_pass_info);
+
+    vk_res = vkCreateRenderPass(_vk_device, &rndr_pass_info, nullptr, &_vk_render_pass);
+    if (VK_SUCCESS != vk_res)
+    {
+        sbLogE("Failed to create Vulkan Render Pass (error = '{}')", getEnumValue(vk_res));
+        return false;
+    }
+
+    if (_settings.occlusion_culling)
+    {
+        // only the multisampled attachments carry over, the swapchain image is fully written by the resolve
+        late_attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+        late_attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        late_attachments[0].initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        late_attachments[1].loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+        late_attachments[1].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        late_attachments[1].initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+        late_attachments[2].loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        late_attachments[2].initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+        // waits for the early render pass and for the depth pyramid build to be done with the depth
+        VkSubpassDependency late_dep = {};
+        late_dep.srcSubpass = VK_SUBPASS_EXTERNAL;
+        late_dep.dstSubpass = 0;
+        late_dep.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+                                VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+        late_dep.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        late_dep.dstStageMask =
+            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+        late_dep.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+                                 VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+                                 VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+        rndr_pass_info.pAttachments = sbstd::data(late_attachments);
+        rndr_pass_info.dependencyCount = 1;
+        rndr_pass_info.pDependencies = &late_dep;
+        addDepthPrepass(rndr_pass_info);
+
+        vk_res = vkCreateRenderPass(_vk_device, &rndr_pass_info, nullptr, &_vk_late_render_pass);
+        if (VK_SUCCESS != vk_res)
+        {
+            sbLogE("Failed to create Vulkan late Render Pass (error = '{}')", getEnumValue(vk_res));
+            return false;
+        }
+    }
 
     VkGraphicsPipelineCreateInfo pipeline_info = {};
     pipeline_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
@@ -1414,7 +2803,7 @@ b8 VulkanApp::createGraphicsPipeline()
     pipeline_info.pDynamicState = &dyn_info;
     // Defines in which sub render pass this pipeline will be used
     pipeline_info.renderPass = _vk_render_pass;
-    pipeline_info.subpass = 0;
+    pipeline_info.subpass = _vk_main_subpass;
     // Inheritance
     pipeline_info.basePipelineHandle = VK_NULL_HANDLE;
     pipeline_info.basePipelineIndex = -1;
@@ -1428,11 +2817,299 @@ b8 VulkanApp::createGraphicsPipeline()
         return false;
     }
 
+    // only the vertex shader differs, the model transform is read from the instance buffer
+    prog_shaders_info[0].module = instanced_vert_shader;
+
+    vk_res = vkCreateGraphicsPipelines(_vk_device, VK_NULL_HANDLE, 1, &pipeline_info, nullptr, &_vk_instanced_pipeline);
+    if (VK_SUCCESS != vk_res)
+    {
+        sbLogE("Failed to create Vulkan instanced pipeline (error = '{}')", getEnumValue(vk_res));
+        return false;
+    }
+
+    if (_settings.depth_prepass)
+    {
+        prog_shaders_info[0].module = vert_shader;
+        if (!createDepthPrepassPipelines(pipeline_info, instanced_vert_shader))
+        {
+            return false;
+        }
+    }
+
+    // shares the layout of the graphics pipelines so that a single descriptor set per frame is bound
+    VkComputePipelineCreateInfo cull_pipeline_info = {};
+    cull_pipeline_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    cull_pipeline_info.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    cull_pipeline_info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    cull_pipeline_info.stage.module = cull_shader;
+    cull_pipeline_info.stage.pName = "main";
+    cull_pipeline_info.layout = _vk_pipeline_layout;
+    cull_pipeline_info.basePipelineHandle = VK_NULL_HANDLE;
+    cull_pipeline_info.basePipelineIndex = -1;
+
+    vk_res = vkCreateComputePipelines(_vk_device, VK_NULL_HANDLE, 1, &cull_pipeline_info, nullptr, &_vk_cull_pipeline);
+    if (VK_SUCCESS != vk_res)
+    {
+        sbLogE("Failed to create Vulkan culling pipeline (error = '{}')", getEnumValue(vk_res));
+        return false;
+    }
+
+    if (_settings.occlusion_culling && !createOcclusionCullPipeline())
+    {
+        return false;
+    }
+
+    if (_settings.meshlet_culling && !createMeshletCullPipeline())
+    {
+        return false;
+    }
+
     createFrameBuffers();
 
     // shader module are 'copied' by the pipeline
     vkDestroyShaderModule(_vk_device, vert_shader, nullptr);
+    vkDestroyShaderModule(_vk_device, instanced_vert_shader, nullptr);
     vkDestroyShaderModule(_vk_device, frag_shader, nullptr);
+    vkDestroyShaderModule(_vk_device, cull_shader, nullptr);
+
+    return true;
+}
+
+b8 VulkanApp::createDepthPrepassPipelines(VkGraphicsPipelineCreateInfo const & graphics_pipeline_info,
+                                            VkShaderModule instanced_vert_shader)
+{
+    VkShaderModule depth_vert_shader = VK_NULL_HANDLE;
+    VkShaderModule instanced_depth_vert_shader = VK_NULL_HANDLE;
+
+    DArray<u8> shader_byte_code;
+    FileStream shader_file(VFS::openFileRead("/basic_depth.vert", FileFormat::BIN));
+    if (!shader_file.isValid())
+    {
+        sbLogE("Failed to open vertex shader 'basic_depth_vert'");
+        return false;
+    }
+    shader_byte_code.resize(shader_file.getLength());
+    shader_file.read(shader_byte_code);
+    VkResult vk_res = createVkShaderModule(_vk_device, shader_byte_code, &depth_vert_shader);
+    if (VK_SUCCESS != vk_res)
+    {
+        sbLogE("Failed to create depth vertex shader (error = '{}')", getEnumValue(vk_res));
+        return false;
+    }
+
+    shader_file.reset(VFS::openFileRead("/instanced_depth.vert", FileFormat::BIN));
+    if (!shader_file.isValid())
+    {
+        sbLogE("Failed to open vertex shader 'instanced_depth_vert'");
+        return false;
+    }
+    shader_byte_code.resize(shader_file.getLength());
+    shader_file.read(shader_byte_code);
+    vk_res = createVkShaderModule(_vk_device, shader_byte_code, &instanced_depth_vert_shader);
+    if (VK_SUCCESS != vk_res)
+    {
+        sbLogE("Failed to create instanced depth vertex shader (error = '{}')", getEnumValue(vk_res));
+        return false;
+    }
+
+    shader_file.reset();
+
+    // the prepass only runs the vertex shaders, which compute the same invariant position in both subpasses
+    VkPipelineShaderStageCreateInfo shaders_info[2] = {graphics_pipeline_info.pStages[0],
+                                                       graphics_pipeline_info.pStages[1]};
+    shaders_info[0].module = depth_vert_shader;
+
+    VkPipelineDepthStencilStateCreateInfo depth_stencil_info = *graphics_pipeline_info.pDepthStencilState;
+
+    VkGraphicsPipelineCreateInfo pipeline_info = graphics_pipeline_info;
+    pipeline_info.stageCount = 1;
+    pipeline_info.pStages = sbstd::data(shaders_info);
+    pipeline_info.pDepthStencilState = &depth_stencil_info;
+    pipeline_info.pColorBlendState = nullptr; // the prepass has no color attachment
+    pipeline_info.subpass = 0;
+
+    vk_res = vkCreateGraphicsPipelines(_vk_device, VK_NULL_HANDLE, 1, &pipeline_info, nullptr, &_vk_depth_pipeline);
+    if (VK_SUCCESS != vk_res)
+    {
+        sbLogE("Failed to create Vulkan depth pipeline (error = '{}')", getEnumValue(vk_res));
+        return false;
+    }
+
+    shaders_info[0].module = instanced_depth_vert_shader;
+
+    vk_res = vkCreateGraphicsPipelines(_vk_device, VK_NULL_HANDLE, 1, &pipeline_info, nullptr,
+                                       &_vk_instanced_depth_pipeline);
+    if (VK_SUCCESS != vk_res)
+    {
+        sbLogE("Failed to create Vulkan instanced depth pipeline (error = '{}')", getEnumValue(vk_res));
+        return false;
+    }
+
+    // the depth is complete once in the main subpass, only the closest surface of each pixel is shaded
+    depth_stencil_info.depthWriteEnable = VK_FALSE;
+    depth_stencil_info.depthCompareOp = VK_COMPARE_OP_EQUAL;
+
+    shaders_info[0].module = graphics_pipeline_info.pStages[0].module;
+    pipeline_info = graphics_pipeline_info;
+    pipeline_info.pStages = sbstd::data(shaders_info);
+    pipeline_info.pDepthStencilState = &depth_stencil_info;
+
+    vk_res = vkCreateGraphicsPipelines(_vk_device, VK_NULL_HANDLE, 1, &pipeline_info, nullptr,
+                                       &_vk_graphics_equal_pipeline);
+    if (VK_SUCCESS != vk_res)
+    {
+        sbLogE("Failed to create Vulkan EQUAL depth graphics pipeline (error = '{}')", getEnumValue(vk_res));
+        return false;
+    }
+
+    shaders_info[0].module = instanced_vert_shader;
+
+    vk_res = vkCreateGraphicsPipelines(_vk_device, VK_NULL_HANDLE, 1, &pipeline_info, nullptr,
+                                       &_vk_instanced_equal_pipeline);
+    if (VK_SUCCESS != vk_res)
+    {
+        sbLogE("Failed to create Vulkan EQUAL depth instanced pipeline (error = '{}')", getEnumValue(vk_res));
+        return false;
+    }
+
+    vkDestroyShaderModule(_vk_device, depth_vert_shader, nullptr);
+    vkDestroyShaderModule(_vk_device, instanced_depth_vert_shader, nullptr);
+
+    return true;
+}
+
+b8 VulkanApp::createOcclusionCullPipeline()
+{
+    VkShaderModule occlusion_cull_shader = VK_NULL_HANDLE;
+    VkShaderModule depth_pyramid_shader = VK_NULL_HANDLE;
+
+    DArray<u8> shader_byte_code;
+    FileStream shader_file(VFS::openFileRead("/cull_instances_occlusion.comp", FileFormat::BIN));
+    if (!shader_file.isValid())
+    {
+        sbLogE("Failed to open compute shader 'cull_instances_occlusion_comp'");
+        return false;
+    }
+    shader_byte_code.resize(shader_file.getLength());
+    shader_file.read(shader_byte_code);
+    VkResult vk_res = createVkShaderModule(_vk_device, shader_byte_code, &occlusion_cull_shader);
+    if (VK_SUCCESS != vk_res)
+    {
+        sbLogE("Failed to create occlusion culling compute shader (error = '{}')", getEnumValue(vk_res));
+        return false;
+    }
+
+    shader_file.reset(VFS::openFileRead("/depth_pyramid.comp", FileFormat::BIN));
+    if (!shader_file.isValid())
+    {
+        sbLogE("Failed to open compute shader 'depth_pyramid_comp'");
+        return false;
+    }
+    shader_byte_code.resize(shader_file.getLength());
+    shader_file.read(shader_byte_code);
+    vk_res = createVkShaderModule(_vk_device, shader_byte_code, &depth_pyramid_shader);
+    if (VK_SUCCESS != vk_res)
+    {
+        sbLogE("Failed to create depth pyramid compute shader (error = '{}')", getEnumValue(vk_res));
+        return false;
+    }
+
+    shader_file.reset();
+
+    if (!_depth_pyramid.initialize(_vk_phys_device, _vk_device, depth_pyramid_shader))
+    {
+        return false;
+    }
+
+    // set 0 is the frame descriptor set, the phase selects what the dispatch draws
+    VkDescriptorSetLayout const set_layouts[] = {_vk_desc_set_layout, _depth_pyramid.getSampleDescSetLayout()};
+
+    VkPushConstantRange phase_range = {};
+    phase_range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    phase_range.offset = 0;
+    phase_range.size = sizeof(u32);
+
+    VkPipelineLayoutCreateInfo layout_info = {};
+    layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    layout_info.setLayoutCount = numericConv<u32>(sbstd::size(set_layouts));
+    layout_info.pSetLayouts = sbstd::data(set_layouts);
+    layout_info.pushConstantRangeCount = 1;
+    layout_info.pPushConstantRanges = &phase_range;
+
+    vk_res = vkCreatePipelineLayout(_vk_device, &layout_info, nullptr, &_vk_occlusion_cull_pipeline_layout);
+    if (VK_SUCCESS != vk_res)
+    {
+        sbLogE("Failed to create Vulkan occlusion culling pipeline layout (error = '{}')", getEnumValue(vk_res));
+        return false;
+    }
+
+    VkComputePipelineCreateInfo pipeline_info = {};
+    pipeline_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipeline_info.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipeline_info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipeline_info.stage.module = occlusion_cull_shader;
+    pipeline_info.stage.pName = "main";
+    pipeline_info.layout = _vk_occlusion_cull_pipeline_layout;
+    pipeline_info.basePipelineHandle = VK_NULL_HANDLE;
+    pipeline_info.basePipelineIndex = -1;
+
+    vk_res = vkCreateComputePipelines(_vk_device, VK_NULL_HANDLE, 1, &pipeline_info, nullptr,
+                                      &_vk_occlusion_cull_pipeline);
+    if (VK_SUCCESS != vk_res)
+    {
+        sbLogE("Failed to create Vulkan occlusion culling pipeline (error = '{}')", getEnumValue(vk_res));
+        return false;
+    }
+
+    vkDestroyShaderModule(_vk_device, occlusion_cull_shader, nullptr);
+    vkDestroyShaderModule(_vk_device, depth_pyramid_shader, nullptr);
+
+    return true;
+}
+
+b8 VulkanApp::createMeshletCullPipeline()
+{
+    VkShaderModule meshlet_cull_shader = VK_NULL_HANDLE;
+
+    DArray<u8> shader_byte_code;
+    FileStream shader_file(VFS::openFileRead("/cull_meshlets.comp", FileFormat::BIN));
+    if (!shader_file.isValid())
+    {
+        sbLogE("Failed to open compute shader 'cull_meshlets_comp'");
+        return false;
+    }
+    shader_byte_code.resize(shader_file.getLength());
+    shader_file.read(shader_byte_code);
+    VkResult vk_res = createVkShaderModule(_vk_device, shader_byte_code, &meshlet_cull_shader);
+    if (VK_SUCCESS != vk_res)
+    {
+        sbLogE("Failed to create meshlet culling compute shader (error = '{}')", getEnumValue(vk_res));
+        return false;
+    }
+
+    shader_file.reset();
+
+    // like the instance culling, the frame descriptor set holds the bindings of the meshlet culling
+    VkComputePipelineCreateInfo pipeline_info = {};
+    pipeline_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipeline_info.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipeline_info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipeline_info.stage.module = meshlet_cull_shader;
+    pipeline_info.stage.pName = "main";
+    pipeline_info.layout = _vk_pipeline_layout;
+    pipeline_info.basePipelineHandle = VK_NULL_HANDLE;
+    pipeline_info.basePipelineIndex = -1;
+
+    vk_res =
+        vkCreateComputePipelines(_vk_device, VK_NULL_HANDLE, 1, &pipeline_info, nullptr, &_vk_meshlet_cull_pipeline);
+
+    vkDestroyShaderModule(_vk_device, meshlet_cull_shader, nullptr);
+
+    if (VK_SUCCESS != vk_res)
+    {
+        sbLogE("Failed to create Vulkan meshlet culling pipeline (error = '{}')", getEnumValue(vk_res));
+        return false;
+    }
 
     return true;
 }
@@ -1469,389 +3146,2319 @@ b8 VulkanApp::createFrameBuffers()
 
 b8 VulkanApp::createCommandBuffers()
 {
-    _vk_cmd_buffers.resize(MAX_INFLIGHT_FRAMES, VK_NULL_HANDLE);
-    /*
-        _vk_cmd_buffers.resize(_vk_swapchain_imgs.size(), VK_NULL_HANDLE);
-        VkCommandBufferAllocateInfo alloc_info = {};
-        alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-        alloc_info.commandPool = _vk_graphics_cmd_pool;
-        alloc_info.commandBufferCount = numericConv<u32>(_vk_cmd_buffers.size());
-        alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-
-        VkResult vk_res = vkAllocateCommandBuffers(_vk_device, &alloc_info, _vk_cmd_buffers.data());
-        if (VK_SUCCESS != vk_res)
-        {
-            sbLogE("Failed to allocate Vulkan Command Buffers (error = '{}')", getEnumValue(vk_res));
-            return false;
-        }
-
-        u32 buffer_idx = 0;
-        for (auto cmd_buffer : _vk_cmd_buffers)
-        {
-            VkCommandBufferBeginInfo cmd_begin_info = {};
-            cmd_begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-            cmd_begin_info.flags = 0;
-            cmd_begin_info.pInheritanceInfo = nullptr;
-            vk_res = vkBeginCommandBuffer(cmd_buffer, &cmd_begin_info);
-            if (VK_SUCCESS != vk_res)
-            {
-                sbLogE("Failed to record Vulkan begin command (error = '{}')", getEnumValue(vk_res));
-                return false;
-            }
-
-            VkClearValue const clear_value = {0.f, 0.f, 0.f, 1.f};
-            VkRenderPassBeginInfo cmd_pass_begin_info = {};
-            cmd_pass_begin_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-            cmd_pass_begin_info.renderPass = _vk_render_pass;
-            cmd_pass_begin_info.framebuffer = _vk_frame_buffers[buffer_idx];
-            cmd_pass_begin_info.renderArea.offset = {0, 0};
-            cmd_pass_begin_info.renderArea.extent = _vk_swapchain_ext;
-            cmd_pass_begin_info.clearValueCount = 1;
-            cmd_pass_begin_info.pClearValues = &clear_value;
-            vkCmdBeginRenderPass(cmd_buffer, &cmd_pass_begin_info, VK_SUBPASS_CONTENTS_INLINE);
+    // primaries recorded once and submitted again as long as the scene does not change
+    VkCommandPoolCreateInfo static_pool_info = {};
+    static_pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    static_pool_info.queueFamilyIndex = _queue_families.graphics;
+    static_pool_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
 
-            vkCmdBindPipeline(cmd_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, _vk_graphics_pipeline);
-
-            vkCmdDraw(cmd_buffer, 3, 1, 0, 0);
-
-            vkCmdEndRenderPass(cmd_buffer);
-
-            vkEndCommandBuffer(cmd_buffer);
+    VkResult const vk_res = vkCreateCommandPool(_vk_device, &static_pool_info, nullptr, &_vk_static_cmd_pool);
+    if (VK_SUCCESS != vk_res)
+    {
+        sbLogE("Failed to create Vulkan static command pool (error = '{}')", getEnumValue(vk_res));
+        return false;
+    }
 
-            ++buffer_idx;
-        }
-    */
     return true;
 }
 
-b8 VulkanApp::initialize(b8 enable_dbg_layers, GLFWwindow * wnd, DemoMode mode)
+void VulkanApp::destroyCommandBuffers()
+{
+    // the cached frames must have been freed with the frame contexts
+    if (VK_NULL_HANDLE != _vk_static_cmd_pool)
+    {
+        vkDestroyCommandPool(_vk_device, _vk_static_cmd_pool, nullptr);
+        _vk_static_cmd_pool = VK_NULL_HANDLE;
+    }
+}
+
+b8 VulkanApp::initialize(b8 enable_dbg_layers, GLFWwindow * wnd, DemoMode mode, Settings const & settings)
 {
     _enable_dbg_layers = enable_dbg_layers;
     _current_frame = 0;
     _demo_mode = mode;
+    _settings = settings;
+
+    if (sbDontExpect(!_job_system.initialize(JobSystem::getDefaultWorkerCount()), "failed to initialize job system"))
+    {
+        return false;
+    }
+
+    _settings.recording_thread_cnt =
+        sbstd::clamp(_settings.recording_thread_cnt, 1U, _job_system.getWorkerCount() + 1);
 
-    _vk_vertex_binding_desc.binding = 0;
-    _vk_vertex_binding_desc.stride = sizeof(Vertex);
-    _vk_vertex_binding_desc.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+    if (_settings.reuse_cmd_buffers && (1 < _settings.recording_thread_cnt))
+    {
+        sbLogW("Recording threads ignored, the reused command buffers are recorded inline (see --no-cmd-reuse)");
+        _settings.recording_thread_cnt = 1;
+    }
 
-    _vk_vertex_attributes_desc[0].binding = 0;
-    _vk_vertex_attributes_desc[0].format = VK_FORMAT_R32G32B32_SFLOAT;
-    _vk_vertex_attributes_desc[0].location = 0; // location from the vertex shader code
-    _vk_vertex_attributes_desc[0].offset = offsetof(Vertex, position);
+    _settings.inflight_frame_cnt = sbstd::clamp(_settings.inflight_frame_cnt, 1U, MAX_INFLIGHT_FRAMES);
+    _settings.instance_cnt = sbstd::clamp(_settings.instance_cnt, 1U, MAX_INSTANCE_COUNT);
+    _occluder_candidates.resize(_job_system.getThreadSlotCount());
 
-    _vk_vertex_attributes_desc[1].binding = 0;
-    _vk_vertex_attributes_desc[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-    _vk_vertex_attributes_desc[1].location = 1; // location from the vertex shader code
-    _vk_vertex_attributes_desc[1].offset = offsetof(Vertex, color);
+    // Assets are decoded while the Vulkan device and pipeline are being created
+    startImageDecodes();
+    startModelGeometryLoad();
 
-    _vk_vertex_attributes_desc[2].binding = 0;
-    _vk_vertex_attributes_desc[2].format = VK_FORMAT_R32G32_SFLOAT;
-    _vk_vertex_attributes_desc[2].location = 2; // location from the vertex shader code
-    _vk_vertex_attributes_desc[2].offset = offsetof(Vertex, tex_coords);
+    initializeSpinningInstances(_settings.instance_cnt, INSTANCE_SPACING, 1.f, _instances);
 
     if (sbDontExpect(!initializeVulkanCore(wnd), "failed to initialize Vulkan"))
     {
         return false;
     }
 
-    if (sbDontExpect(!createColorImage()))
+    if (_settings.occlusion_culling)
     {
-        return false;
+        // the depth pyramid is built from the multisampled depth attachment
+        VkFormatProperties depth_fmt_props = {};
+        vkGetPhysicalDeviceFormatProperties(_vk_phys_device, findVkDepthImageFormat(_vk_phys_device),
+                                            &depth_fmt_props);
+        b8 const depth_sampled = (0 != (depth_fmt_props.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT));
+
+        if (!depth_sampled || (VK_SAMPLE_COUNT_1_BIT == _vk_sample_count) || !_draw_indirect_first_instance_supported)
+        {
+            sbLogW("Occlusion culling not supported by the device, ignored");
+            _settings.occlusion_culling = false;
+        }
     }
 
-    if (sbDontExpect(!createDepthImage()))
+    // the occlusion culling extends the culling pass of the GPU culling, once the device is known to support it
+    _settings.gpu_culling = _settings.gpu_culling || _settings.occlusion_culling;
+
+    if (_settings.software_occlusion_culling && _settings.gpu_culling)
     {
-        return false;
+        sbLogW("Software occlusion culling ignored, the instances are culled on the GPU");
+        _settings.software_occlusion_culling = false;
     }
 
-    if (sbDontExpect(!createGraphicsPipeline()))
+    updateAttachmentExtent();
+
+    if (sbDontExpect(!createColorImage()))
     {
         return false;
     }
 
-    if (sbDontExpect(!createCommandBuffers()))
+    if (sbDontExpect(!createDepthImage()))
     {
         return false;
     }
 
-    if (sbDontExpect(!loadTestTexture()))
+    if (sbDontExpect(!createGraphicsPipeline()))
     {
         return false;
     }
 
-    if (sbDontExpect(!loadModel()))
+    if (sbDontExpect(!createDepthPyramid()))
     {
         return false;
     }
 
-    if (sbDontExpect(!createTriangle()))
+    if (sbDontExpect(!createCommandBuffers()))
     {
         return false;
     }
 
-    if (sbDontExpect(!createQuad()))
+    if (sbDontExpect(!loadTestTexture()))
     {
         return false;
     }
 
-    if (sbDontExpect(!createUniformBuffers()))
+    // the meshlet culling copies the indices of the visible meshlets of the model from the arena
+    VkBufferUsageFlags const arena_ib_usage = _settings.meshlet_culling ? VK_BUFFER_USAGE_STORAGE_BUFFER_BIT : 0;
+    if (sbDontExpect(!_geometry_arena.initialize(_vk_phys_device, _vk_device, _vk_graphics_cmd_pool,
+                                                 _vk_graphics_queue, GEOMETRY_ARENA_VERTEX_CAPACITIES,
+                                                 GEOMETRY_ARENA_INDEX_CAPACITY, arena_ib_usage)))
     {
         return false;
     }
 
-    if (sbDontExpect(!createDescriptors()))
+    if (sbDontExpect(!loadModel()))
     {
         return false;
     }
 
-    _start_time = std::chrono::high_resolution_clock::now();
-
-    return true;
-}
+    computeSpinningBounds(_instances, _model.bounds, _instance_bounds);
+    _visible_instances.resize(_settings.instance_cnt);
 
-void VulkanApp::terminate()
-{
-    if (VK_NULL_HANDLE != _vk_device)
+    if (_settings.lod_selection && (1 < _model.lod_cnt))
+    {
+        if (_settings.gpu_culling || !_draw_indirect_first_instance_supported)
+        {
+            sbLogW("LOD selection not supported with the GPU culling or by the device, the full model is drawn");
+        }
+        else
+        {
+            _instance_lod_cnt = _model.lod_cnt;
+
+            // the instance bounding spheres scale with the instances
+            f32 const bounds_radius = _instance_bounds.radius[0] / _instances.scale[0];
+            for (u32 lod_idx = 0; lod_idx != _instance_lod_cnt; ++lod_idx)
+            {
+                _instance_lod_errors[lod_idx] = _model.lods[lod_idx].error / bounds_radius;
+            }
+
+            u32 const lod_batch_cnt = (_settings.instance_cnt + INSTANCE_LOD_BATCH_SIZE - 1) / INSTANCE_LOD_BATCH_SIZE;
+            _instance_lod_batch_cnts.resize(lod_batch_cnt * MAX_MESH_LOD_COUNT);
+            _instance_lod_scratch.resize(_settings.instance_cnt);
+        }
+    }
+
+    if (_settings.gpu_culling && sbDontExpect(!createGpuInstances()))
+    {
+        return false;
+    }
+
+    if (sbDontExpect(!createTriangle()))
+    {
+        return false;
+    }
+
+    if (sbDontExpect(!createQuad()))
+    {
+        return false;
+    }
+
+    if (sbDontExpect(!createFrameContexts()))
+    {
+        return false;
+    }
+
+    if (sbDontExpect(!createDescriptors()))
+    {
+        return false;
+    }
+
+    _next_frame.frame_buffer_ext = _target_frame_buffer_ext;
+    _next_frame.present_mode = _settings.present_mode;
+    _next_frame.swapchain_img_cnt = _settings.swapchain_img_cnt;
+    _next_frame.low_latency_pacing = _settings.low_latency_pacing;
+    _next_frame.frustum_culling = _settings.frustum_culling;
+    _next_frame.occlusion_culling = _settings.occlusion_culling || _settings.software_occlusion_culling;
+    _next_frame.depth_prepass = _settings.depth_prepass;
+    _window_frame_buffer_ext = _target_frame_buffer_ext;
+
+    buildDrawList();
+
+    _animation_sample_time = std::chrono::high_resolution_clock::now();
+
+    return true;
+}
+
+void VulkanApp::terminate()
+{
+    stopRenderThread();
+    stopPresentThread();
+
+    if (VK_NULL_HANDLE != _vk_device)
     {
         vkDeviceWaitIdle(_vk_device);
     }
 
+    if (0 != _frame_scheduler.getFrameValue())
+    {
+        sbLogI("Average GPU lag: {:.2f} frame(s) for {} frame(s) in flight", _frame_scheduler.getAverageGpuLag(),
+               _frame_scheduler.getInflightFrameCount());
+    }
+
     destroyDescriptors();
-    destroyUniformBuffers();
+    destroyFrameContexts();
     unloadTestTexture();
     unloadModel();
+    destroyGpuInstances();
     destroyQuad();
     destroyTriangle();
+    _geometry_arena.terminate();
+    destroyCommandBuffers();
     cleanupSwapChainRelatedData();
+
     terminateVulkanCore();
+
+    releaseDecodedImages();
+    _job_system.wait(_model_geometry.counter);
+    _job_system.terminate();
 }
 
-b8 VulkanApp::render()
+void VulkanApp::startImageDecodes()
 {
-    if ((_target_frame_buffer_ext.width == 0) || (_target_frame_buffer_ext.height == 0))
+    char const * const image_paths[DECODED_IMAGE_COUNT] = {"/texture.jpg", "/viking_room.png"};
+
+    for (u32 img_idx = 0; img_idx != DECODED_IMAGE_COUNT; ++img_idx)
     {
-        return false;
+        DecodedImage & decoded_img = _decoded_images[img_idx];
+
+        auto file_content = VFS::readFile(image_paths[img_idx], GHEAP);
+        if (file_content.size() == 0)
+        {
+            sbLogE("Failed to load image content '{}'", image_paths[img_idx]);
+            continue;
+        }
+
+        _job_system.submit(
+            [&decoded_img, file_content]() mutable {
+                int channel_cnt;
+                decoded_img.pixels = stbi_load_from_memory(file_content.data(), (int)file_content.size(),
+                                                           &decoded_img.width, &decoded_img.height, &channel_cnt,
+                                                           STBI_rgb_alpha);
+
+                GHEAP.deallocate(file_content.data());
+            },
+            &decoded_img.counter);
     }
+}
 
-    vkWaitForFences(_vk_device, 1, &_vk_inflight_fences[_current_frame], VK_TRUE, UINT64_MAX);
+void VulkanApp::releaseDecodedImages()
+{
+    for (auto & decoded_img : _decoded_images)
+    {
+        _job_system.wait(decoded_img.counter);
 
-    u32 img_idx = 0;
-    VkResult vk_res = vkAcquireNextImageKHR(_vk_device, _vk_swapchain, UINT64_MAX,
-                                            _vk_image_available_sems[_current_frame], VK_NULL_HANDLE, &img_idx);
+        if (nullptr != decoded_img.pixels)
+        {
+            stbi_image_free(decoded_img.pixels);
+            decoded_img.pixels = nullptr;
+        }
+    }
+}
 
-    if (vk_res == VK_ERROR_OUT_OF_DATE_KHR)
+b8 VulkanApp::update()
+{
+    if (!_render_thread.joinable())
     {
-        recreateSwapChainRelatedData(_vk_swapchain_ext);
+        return render();
     }
-    else if ((vk_res != VK_SUCCESS) && (vk_res != VK_SUBOPTIMAL_KHR))
+
+    // the simulation never runs more than a frame ahead of the render thread
+    _frame_packets.waitForConsumption();
+    publishFramePacket();
+
+    return true;
+}
+
+void VulkanApp::publishFramePacket()
+{
+    auto const sample_time = std::chrono::high_resolution_clock::now();
+
+    if (_settings.animate)
     {
-        return false;
+        auto const elapsed_time = sample_time - _animation_sample_time;
+        _animation_time += std::chrono::duration<float, std::chrono::seconds::period>(elapsed_time).count();
     }
+    _animation_sample_time = sample_time;
+
+    _next_frame.input_sample_time = sample_time;
+    _next_frame.animation_time = _animation_time;
 
-    if (_vk_inuse_fences[img_idx] != VK_NULL_HANDLE)
+    if (0 != _next_frame.instance_cnt)
+    {
+        _next_frame.view = getInstancedView(_animation_time);
+        _next_frame.z_far = _instances.extent;
+    }
+    else
     {
-        vkWaitForFences(_vk_device, 1, &_vk_inuse_fences[img_idx], VK_TRUE, UINT64_MAX);
+        _next_frame.view =
+            glm::lookAt(glm::vec3(2.f, 2.f, 2.f), glm::vec3(0.f, 0.f, 0.f), glm::vec3(0.f, 0.f, 1.f));
+        _next_frame.z_far = 100.f;
     }
 
-    _vk_inuse_fences[img_idx] = _vk_inflight_fences[_current_frame];
+    glm::mat4 const model_transform =
+        glm::rotate(glm::mat4(1.f), _animation_time * glm::radians(_animation_time), glm::vec3(0.f, 0.f, 1.f));
+    sbstd::fill(begin(_next_frame.object_transforms), end(_next_frame.object_transforms), model_transform);
 
-    auto const time_from_start = std::chrono::duration<float, std::chrono::seconds::period>(
-                                     std::chrono::high_resolution_clock::now() - _start_time)
-                                     .count();
-    UniformMVP mvp;
-    mvp.model = glm::rotate(glm::mat4(1.f), time_from_start * glm::radians(time_from_start), glm::vec3(0.f, 0.f, 1.f));
-    mvp.view = glm::lookAt(glm::vec3(2.f, 2.f, 2.f), glm::vec3(0.f, 0.f, 0.f), glm::vec3(0.f, 0.f, 1.f));
-    mvp.projection =
-        glm::perspective(glm::radians(45.f), _vk_swapchain_ext.width / ((float)_vk_swapchain_ext.height), 0.1f, 100.f);
-    mvp.projection[1][1] *= -1.f;
+    _redraw_requested = false;
+    _next_frame.continuous = !_settings.render_on_demand || _settings.animate;
 
-    auto & curr_mvp_buffer = _vk_mvp_buffers[_current_frame];
-    void * mvp_data = nullptr;
-    vkMapMemory(_vk_device, curr_mvp_buffer.memory, 0, sizeof(UniformMVP), 0, &mvp_data);
-    memcpy(mvp_data, &mvp, sizeof(mvp));
-    vkUnmapMemory(_vk_device, curr_mvp_buffer.memory);
+    _frame_packets.getWriteBuffer() = _next_frame;
+    _frame_packets.publish();
+}
+
+glm::mat4 VulkanApp::getInstancedView(f32 animation_time) const
+{
+    // looks around from the middle of the grid, most of the instances are out of view at any time
+    f32 const look_angle = animation_time * 0.2f;
+    glm::vec3 const eye(0.f, 0.f, INSTANCE_SPACING * 4.f);
+    glm::vec3 const look_dir(std::cos(look_angle), std::sin(look_angle), -0.3f);
+
+    return glm::lookAt(eye, eye + look_dir, glm::vec3(0.f, 0.f, 1.f));
+}
+
+u32 VulkanApp::updateInstanceTransforms(f32 animation_time, glm::mat4 const & view_proj, u32 instance_cnt,
+                                        b8 frustum_culling, b8 occlusion_culling, glm::mat4 * transforms,
+                                        b8 use_job_system, u32 * occlusion_culled_cnt,
+                                        InstanceLodSelection * lod_selection)
+{
+    f32 const * const view_proj_data = &view_proj[0][0];
+    f32 * const transforms_data = &transforms[0][0][0];
 
-    VkCommandBuffer & cmd_buffer = _vk_cmd_buffers[_current_frame];
+    FrustumPlanes frustum_planes;
+    extractFrustumPlanes(view_proj_data, frustum_planes);
 
+    occlusion_culling = occlusion_culling && frustum_culling && _occlusion_rasterizer.isInitialized();
+    if (occlusion_culling)
     {
-        if (cmd_buffer != VK_NULL_HANDLE)
-        {
-            vkFreeCommandBuffers(_vk_device, _vk_graphics_cmd_pool, 1, &cmd_buffer);
-            cmd_buffer = VK_NULL_HANDLE;
-        }
+        rasterizeOccluders(animation_time, view_proj_data, use_job_system);
+    }
 
-        VkCommandBufferAllocateInfo alloc_info = {};
-        alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-        alloc_info.commandPool = _vk_graphics_cmd_pool;
-        alloc_info.commandBufferCount = 1;
-        alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    // each batch culls its instances into its own range of the visible list then reserves contiguous slots for them
+    std::atomic<u32> drawn_instance_cnt = 0;
+    std::atomic<u32> occluded_instance_cnt = 0;
 
-        vk_res = vkAllocateCommandBuffers(_vk_device, &alloc_info, &cmd_buffer);
-        if (VK_SUCCESS != vk_res)
+    auto const cullBatch = [&](u32 first, u32 last) {
+        u32 * const visible_indices = _visible_instances.data() + first;
+        u32 visible_cnt = cullBoundingSpheres(_instance_bounds, frustum_planes, first, last, visible_indices);
+
+        if (occlusion_culling)
         {
-            sbLogE("Failed to allocate Vulkan Command Buffers (error = '{}')", getEnumValue(vk_res));
-            return false;
+            u32 const unoccluded_cnt = _occlusion_rasterizer.cullOccludedSpheres(_instance_bounds, view_proj_data,
+                                                                                 visible_indices, visible_cnt);
+            occluded_instance_cnt.fetch_add(visible_cnt - unoccluded_cnt);
+            visible_cnt = unoccluded_cnt;
+
+            pickOccluderCandidates(view_proj_data, visible_indices, visible_cnt);
         }
 
-        VkCommandBufferBeginInfo cmd_begin_info = {};
-        cmd_begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-        cmd_begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-        cmd_begin_info.pInheritanceInfo = nullptr;
-        vk_res = vkBeginCommandBuffer(cmd_buffer, &cmd_begin_info);
-        if (VK_SUCCESS != vk_res)
+        return visible_cnt;
+    };
+
+    auto const updateBatch = [&](u32 first, u32 last) {
+        if (!frustum_culling)
         {
-            sbLogE("Failed to record Vulkan begin command (error = '{}')", getEnumValue(vk_res));
-            return false;
+            computeSpinningTransforms(_instances, animation_time, view_proj_data, nullptr, first, last,
+                                      transforms_data);
+            return;
         }
 
-        VkClearValue clear_values[3];
-        clear_values[0].color = {0.f, 0.f, 0.f, 1.f};
-        clear_values[1].depthStencil = {1.f, 0};
-        clear_values[2].color = {0.f, 0.f, 0.f, 1.f};
+        u32 * const visible_indices = _visible_instances.data() + first;
+        u32 const visible_cnt = cullBatch(first, last);
+        u32 const first_slot = drawn_instance_cnt.fetch_add(visible_cnt);
 
-        VkRenderPassBeginInfo cmd_pass_begin_info = {};
-        cmd_pass_begin_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-        cmd_pass_begin_info.renderPass = _vk_render_pass;
-        cmd_pass_begin_info.framebuffer = _vk_frame_buffers[img_idx];
-        cmd_pass_begin_info.renderArea.offset = {0, 0};
-        cmd_pass_begin_info.renderArea.extent = _vk_swapchain_ext;
-        cmd_pass_begin_info.clearValueCount = (u32)sbstd::size(clear_values);
-        cmd_pass_begin_info.pClearValues = sbstd::data(clear_values);
-        vkCmdBeginRenderPass(cmd_buffer, &cmd_pass_begin_info, VK_SUBPASS_CONTENTS_INLINE);
-
-        vkCmdBindPipeline(cmd_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, _vk_graphics_pipeline);
+        computeSpinningTransforms(_instances, animation_time, view_proj_data, visible_indices, 0, visible_cnt,
+                                  &transforms[first_slot][0][0]);
+    };
 
-        VkViewport view_port = {};
-        view_port.width = (float)_vk_swapchain_ext.width;
-        view_port.height = (float)_vk_swapchain_ext.height;
-        view_port.x = 0;
-        view_port.y = 0;
-        view_port.minDepth = 0.f;
-        view_port.maxDepth = 1.f;
-        vkCmdSetViewport(cmd_buffer, 0, 1, &view_port);
+    b8 const select_lods = frustum_culling && (nullptr != lod_selection);
 
-        VkRect2D scissor = {};
-        scissor.extent = _vk_swapchain_ext;
-        scissor.offset = {0, 0};
-        vkCmdSetScissor(cmd_buffer, 0, 1, &scissor);
+    if (select_lods)
+    {
+        u32 const lod_cnt = _instance_lod_cnt;
+        u32 const batch_cnt = (instance_cnt + INSTANCE_LOD_BATCH_SIZE - 1) / INSTANCE_LOD_BATCH_SIZE;
 
-        VkDeviceSize offsets = 0;
+        auto const runBatches = [&](auto const & func) {
+            if (!use_job_system)
+            {
+                for (u32 batch_idx = 0; batch_idx != batch_cnt; ++batch_idx)
+                {
+                    func(batch_idx);
+                }
+                return;
+            }
 
-        vkCmdBindDescriptorSets(cmd_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, _vk_pipeline_layout, 0, 1,
-                                &_vk_desc_sets[_current_frame], 0, nullptr);
+            _job_system.parallelFor(batch_cnt, 1, [&func](u32 batch_begin, u32 batch_end) {
+                for (u32 batch_idx = batch_begin; batch_idx != batch_end; ++batch_idx)
+                {
+                    func(batch_idx);
+                }
+            });
+        };
 
-        switch (_demo_mode)
-        {
-            case DemoMode::TRIANGLE:
-            {
-                vkCmdBindVertexBuffers(cmd_buffer, 0, 1, &_vk_triangle_vb, &offsets);
-                vkCmdDraw(cmd_buffer, 3, 1, 0, 0);
+        // the slots of a level follow the ones of the finer levels, they are only known once every batch has culled
+        // and sorted its instances by level
+        std::atomic<u32> lod_instance_cnts[MAX_MESH_LOD_COUNT] = {};
 
-                break;
-            }
+        runBatches([&](u32 batch_idx) {
+            u32 const first = batch_idx * INSTANCE_LOD_BATCH_SIZE;
+            u32 const visible_cnt = cullBatch(first, sbstd::min(first + INSTANCE_LOD_BATCH_SIZE, instance_cnt));
+            u32 * const batch_lod_cnts = _instance_lod_batch_cnts.data() + batch_idx * MAX_MESH_LOD_COUNT;
 
-            case DemoMode::QUAD:
-            {
-                vkCmdBindVertexBuffers(cmd_buffer, 0, 1, &_vk_quad_vb, &offsets);
-                vkCmdBindIndexBuffer(cmd_buffer, _vk_quad_ib, 0, VK_INDEX_TYPE_UINT32);
-                vkCmdDrawIndexed(cmd_buffer, 12, 1, 0, 0, 0);
+            sortSpheresByLod(_instance_bounds, view_proj_data, lod_selection->pixel_scale, MAX_LOD_PIXEL_ERROR,
+                             _instance_lod_errors, lod_cnt, _visible_instances.data() + first, visible_cnt,
+                             _instance_lod_scratch.data() + first, batch_lod_cnts);
 
-                break;
-            }
-            case DemoMode::MODEL:
+            for (u32 lod_idx = 0; lod_idx != lod_cnt; ++lod_idx)
             {
-                vkCmdBindVertexBuffers(cmd_buffer, 0, 1, &_model.vb.buffer, &offsets);
-                vkCmdBindIndexBuffer(cmd_buffer, _model.ib.buffer, 0, VK_INDEX_TYPE_UINT32);
-                vkCmdDrawIndexed(cmd_buffer, (u32)_model.idx_cnt, 1, 0, 0, 0);
-                break;
+                lod_instance_cnts[lod_idx].fetch_add(batch_lod_cnts[lod_idx]);
             }
-            default:
+        });
+
+        std::atomic<u32> lod_next_slots[MAX_MESH_LOD_COUNT] = {};
+        for (u32 lod_idx = 0; lod_idx != MAX_MESH_LOD_COUNT; ++lod_idx)
+        {
+            lod_selection->instance_cnts[lod_idx] = (lod_idx < lod_cnt) ? lod_instance_cnts[lod_idx].load() : 0;
+            lod_next_slots[lod_idx] = drawn_instance_cnt.load();
+            drawn_instance_cnt += lod_selection->instance_cnts[lod_idx];
+        }
+
+        // each batch reserves contiguous slots in every level for its instances
+        runBatches([&](u32 batch_idx) {
+            u32 const * visible_indices = _visible_instances.data() + batch_idx * INSTANCE_LOD_BATCH_SIZE;
+            u32 const * const batch_lod_cnts = _instance_lod_batch_cnts.data() + batch_idx * MAX_MESH_LOD_COUNT;
+
+            for (u32 lod_idx = 0; lod_idx != lod_cnt; ++lod_idx)
             {
-                sbAssert(false, "Unsupported demo mode");
-                break;
+                u32 const lod_instance_cnt = batch_lod_cnts[lod_idx];
+                if (0 == lod_instance_cnt)
+                {
+                    continue;
+                }
+
+                u32 const first_slot = lod_next_slots[lod_idx].fetch_add(lod_instance_cnt);
+                computeSpinningTransforms(_instances, animation_time, view_proj_data, visible_indices, 0,
+                                          lod_instance_cnt, &transforms[first_slot][0][0]);
+                visible_indices += lod_instance_cnt;
             }
-        };
+        });
+    }
+    else if (!use_job_system)
+    {
+        updateBatch(0, instance_cnt);
+    }
+    else
+    {
+        // batches are split on whole SIMD groups so that only the last one culls a scalar tail, the transforms of the
+        // visible instances of every batch may still end with one
+        u32 const group_cnt = (instance_cnt + INSTANCE_TRANSFORM_GROUP_SIZE - 1) / INSTANCE_TRANSFORM_GROUP_SIZE;
 
-        vkCmdEndRenderPass(cmd_buffer);
+        _job_system.parallelFor(group_cnt, INSTANCE_TRANSFORM_BATCH_GROUP_CNT, [&](u32 group_begin, u32 group_end) {
+            updateBatch(group_begin * INSTANCE_TRANSFORM_GROUP_SIZE,
+                        sbstd::min(group_end * INSTANCE_TRANSFORM_GROUP_SIZE, instance_cnt));
+        });
+    }
 
-        vkEndCommandBuffer(cmd_buffer);
+    if (occlusion_culling)
+    {
+        selectOccluders();
     }
 
-    // The command has to wait for the image to be ready when we start wrinting to the image
-    VkPipelineStageFlags const wait_stage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    if (nullptr != occlusion_culled_cnt)
+    {
+        *occlusion_culled_cnt = occluded_instance_cnt.load();
+    }
 
-    VkSubmitInfo submit_info = {};
-    submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    // There is a 1:1 correspondance between wait stages and semaphores
-    submit_info.waitSemaphoreCount = 1;
-    submit_info.pWaitSemaphores = &_vk_image_available_sems[_current_frame];
-    submit_info.pWaitDstStageMask = &wait_stage;
-    submit_info.commandBufferCount = 1;
-    submit_info.pCommandBuffers = &cmd_buffer;
-    submit_info.signalSemaphoreCount = 1;
-    submit_info.pSignalSemaphores = &_vk_render_finished_sems[_current_frame];
+    u32 const transform_cnt = frustum_culling ? drawn_instance_cnt.load() : instance_cnt;
 
-    vkResetFences(_vk_device, 1, &_vk_inflight_fences[_current_frame]);
+    if ((nullptr != lod_selection) && !select_lods)
+    {
+        // everything is drawn with the full model
+        sbstd::fill(sbstd::begin(lod_selection->instance_cnts), sbstd::end(lod_selection->instance_cnts), 0U);
+        lod_selection->instance_cnts[0] = transform_cnt;
+    }
 
-    vk_res = vkQueueSubmit(_vk_graphics_queue, 1, &submit_info, _vk_inflight_fences[_current_frame]);
-    if (VK_SUCCESS != vk_res)
+    return transform_cnt;
+}
+
+void VulkanApp::rasterizeOccluders(f32 animation_time, f32 const * view_proj, b8 use_job_system)
+{
+    // aligned for the non temporal stores of the transform kernels
+    alignas(64) glm::mat4 occluder_mvps[OCCLUDER_COUNT];
+    computeSpinningTransforms(_instances, animation_time, view_proj, _occluder_instances, 0, _occluder_cnt,
+                              &occluder_mvps[0][0][0]);
+
+    _occlusion_rasterizer.beginFrame(_occluder_cnt);
+
+    auto const setupOccluders = [&](u32 first, u32 last) {
+        for (u32 occluder_idx = first; occluder_idx != last; ++occluder_idx)
+        {
+            _occlusion_rasterizer.setupOccluder(occluder_idx, &occluder_mvps[occluder_idx][0][0]);
+        }
+    };
+
+    // the tile rows are split between the threads, every thread goes through all the triangles
+    auto const rasterizeRows = [&](u32 first_row, u32 last_row) {
+        _occlusion_rasterizer.rasterize(first_row, last_row);
+    };
+
+    if (!use_job_system)
     {
-        sbLogE("Failed to submit the Vulkan command buffer to the graphics queue (error = '{}'", getEnumValue(vk_res));
+        setupOccluders(0, _occluder_cnt);
+        rasterizeRows(0, OcclusionRasterizer::TILE_ROW_COUNT);
+    }
+    else
+    {
+        _job_system.parallelFor(_occluder_cnt, 1, setupOccluders);
+        _job_system.parallelFor(OcclusionRasterizer::TILE_ROW_COUNT, 1, rasterizeRows);
+    }
+}
+
+void VulkanApp::pickOccluderCandidates(f32 const * view_proj, u32 const * instance_indices, u32 instance_cnt)
+{
+    u32 const slot_idx = JobSystem::getCurrentThreadSlot();
+    sbAssert(JobSystem::INVALID_THREAD_SLOT != slot_idx);
+
+    OccluderCandidates & candidates = _occluder_candidates[slot_idx];
+
+    for (u32 idx = 0; idx != instance_cnt; ++idx)
+    {
+        u32 const instance_idx = instance_indices[idx];
+
+        // clip space w is the distance along the view direction
+        f32 const depth = view_proj[3] * _instance_bounds.center_x[instance_idx] +
+                          view_proj[7] * _instance_bounds.center_y[instance_idx] +
+                          view_proj[11] * _instance_bounds.center_z[instance_idx] + view_proj[15];
+
+        // the instances crossing the eye plane would lose most of their triangles to the near plane
+        if (depth >= _instance_bounds.radius[instance_idx])
+        {
+            candidates.insert(instance_idx, depth);
+        }
+    }
+}
+
+void VulkanApp::selectOccluders()
+{
+    OccluderCandidates merged;
+
+    for (OccluderCandidates & candidates : _occluder_candidates)
+    {
+        for (u32 idx = 0; idx != candidates.cnt; ++idx)
+        {
+            merged.insert(candidates.instance_indices[idx], candidates.depths[idx]);
+        }
+
+        candidates.cnt = 0;
+    }
+
+    sbstd::copy(merged.instance_indices, merged.instance_indices + merged.cnt, _occluder_instances);
+    _occluder_cnt = merged.cnt;
+}
+
+void VulkanApp::applyFramePacket(FramePacket const & packet)
+{
+    if ((packet.frame_buffer_ext.width != _window_frame_buffer_ext.width) ||
+        (packet.frame_buffer_ext.height != _window_frame_buffer_ext.height))
+    {
+        _window_frame_buffer_ext = packet.frame_buffer_ext;
+        _target_frame_buffer_ext = packet.frame_buffer_ext;
+    }
+
+    if ((packet.present_mode != _settings.present_mode) || (packet.swapchain_img_cnt != _settings.swapchain_img_cnt))
+    {
+        _settings.present_mode = packet.present_mode;
+        _settings.swapchain_img_cnt = packet.swapchain_img_cnt;
+        _swapchain_settings_changed = true;
+    }
+
+    _settings.low_latency_pacing = packet.low_latency_pacing;
+    _frame_scheduler.setLowLatencyPacing(packet.low_latency_pacing);
+
+    // the recorded frames are invalidated along with the scene version
+    _draw_depth_prepass = packet.depth_prepass;
+
+    _input_sample_time = packet.input_sample_time;
+}
+
+void VulkanApp::startRenderThread()
+{
+    sbAssert(!_render_thread.joinable());
+
+    _render_thread_exit_requested = false;
+    _render_thread = std::thread([this]() { runRenderThread(); });
+}
+
+void VulkanApp::stopRenderThread()
+{
+    if (!_render_thread.joinable())
+    {
+        return;
+    }
+
+    _render_thread_exit_requested = true;
+
+    // wakes up the render thread if it is waiting for a packet
+    _frame_packets.publish();
+    _render_thread.join();
+}
+
+void VulkanApp::runRenderThread()
+{
+    // the draws are recorded from jobs submitted by the render thread
+    if (!_job_system.attachCurrentThread())
+    {
+        return;
+    }
+
+    for (;;)
+    {
+        // a main thread stalled in a modal loop or a long event does not stop the frames
+        b8 const published = _frame_packets.waitForPublish(FRAME_PACKET_TIMEOUT);
+
+        if (_render_thread_exit_requested.load())
+        {
+            break;
+        }
+
+        if (published || _frame_packets.getReadBuffer().continuous)
+        {
+            render();
+        }
+    }
+
+    _job_system.detachCurrentThread();
+}
+
+b8 VulkanApp::render()
+{
+    if (!_frame_scheduler.beginFrame())
+    {
+        // consumed anyway so that the render thread waits for the next packet instead of spinning on this one
+        if (_frame_packets.acquire())
+        {
+            applyFramePacket(_frame_packets.getReadBuffer());
+        }
+
         return false;
     }
 
-    VkPresentInfoKHR present_info = {};
-    present_info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
-    present_info.swapchainCount = 1;
-    present_info.pSwapchains = &_vk_swapchain;
-    present_info.pImageIndices = &img_idx;
-    present_info.waitSemaphoreCount = 1;
-    present_info.pWaitSemaphores = &_vk_render_finished_sems[_current_frame];
-    present_info.pResults = nullptr;
+    // without a render thread, the simulation runs after the frame pacing so that the inputs are sampled late
+    if (!_render_thread.joinable())
+    {
+        publishFramePacket();
+    }
 
-    vk_res = vkQueuePresentKHR(_vk_present_queue, &present_info);
-    if ((vk_res == VK_ERROR_OUT_OF_DATE_KHR) || (vk_res == VK_SUBOPTIMAL_KHR) ||
-        (_target_frame_buffer_ext.width != _vk_swapchain_ext.width) ||
-        (_target_frame_buffer_ext.height != _vk_swapchain_ext.height))
+    if (_frame_packets.acquire())
     {
-        recreateSwapChainRelatedData(_target_frame_buffer_ext);
+        applyFramePacket(_frame_packets.getReadBuffer());
     }
-    else if (vk_res != VK_SUCCESS)
+
+    FramePacket const & packet = _frame_packets.getReadBuffer();
+
+    // minimized, nothing is submitted and the next frame takes over the value and slot of this one
+    if ((0 == _target_frame_buffer_ext.width) || (0 == _target_frame_buffer_ext.height))
     {
-        sbLogE("Failed to present Vulkan frame buffer (error = '{}')", getEnumValue(vk_res));
         return false;
     }
 
-    // vkQueueWaitIdle(_vk_present_queue);
+    b8 const swapchain_out_of_date = _swapchain_out_of_date.exchange(false) ||
+                                     (_target_frame_buffer_ext.width != _vk_swapchain_ext.width) ||
+                                     (_target_frame_buffer_ext.height != _vk_swapchain_ext.height);
+
+    if (_swapchain_settings_changed || swapchain_out_of_date)
+    {
+        _swapchain_settings_changed = false;
+        recreateSwapChainRelatedData(_target_frame_buffer_ext);
+        _redraw_requested = true;
+    }
+
+    _current_frame = _frame_scheduler.getFrameSlot();
+    FrameContext & frame = _frames[_current_frame];
+
+    // the previous frame of the slot is complete, its timestamps are available
+    if (frame.timestamps_written)
+    {
+        u64 timestamps[2] = {};
+        VkResult const query_res =
+            vkGetQueryPoolResults(_vk_device, frame.timestamp_pool, 0, 2, sizeof(timestamps), timestamps, sizeof(u64),
+                                  VK_QUERY_RESULT_64_BIT);
+        if (VK_SUCCESS == query_res)
+        {
+            // the difference stays right across a wrap around once masked to the valid bits
+            u64 const gpu_ticks = (timestamps[1] - timestamps[0]) & _gpu_timestamp_mask;
+            _gpu_frame_time_total_ms += (f64)gpu_ticks * _gpu_timestamp_period_ns * 1e-6;
+            ++_gpu_timed_frame_cnt;
+        }
+
+        frame.timestamps_written = false;
+    }
+
+    // everything which does not depend on the swapchain image happens before the acquire, which may have to wait
+    // for the present thread to release the swapchain
+    glm::mat4 projection = glm::perspective(
+        glm::radians(45.f), _vk_swapchain_ext.width / ((float)_vk_swapchain_ext.height), 0.1f, packet.z_far);
+    projection[1][1] *= -1.f;
+
+    glm::mat4 const view_proj = projection * packet.view;
+
+    UniformMVP mvp;
+    mvp.mvp = view_proj * packet.object_transforms[0];
+
+    auto & curr_mvp_buffer = frame.mvp_buffer;
+    void * mvp_data = nullptr;
+    vkMapMemory(_vk_device, curr_mvp_buffer.memory, 0, sizeof(UniformMVP), 0, &mvp_data);
+    memcpy(mvp_data, &mvp, sizeof(mvp));
+    vkUnmapMemory(_vk_device, curr_mvp_buffer.memory);
+
+    if (_settings.meshlet_culling)
+    {
+        // the meshlets are culled in the object space of the model, the planes of the MVP are the frustum in it
+        FrustumPlanes frustum_planes;
+        extractFrustumPlanes(&mvp.mvp[0][0], frustum_planes);
+
+        UniformMeshletCullParams & meshlet_cull_params = *frame.meshlet_cull_params;
+        for (u32 plane_idx = 0; plane_idx != FrustumPlanes::PLANE_COUNT; ++plane_idx)
+        {
+            meshlet_cull_params.frustum_planes[plane_idx] = {frustum_planes.a[plane_idx], frustum_planes.b[plane_idx],
+                                                             frustum_planes.c[plane_idx], frustum_planes.d[plane_idx]};
+        }
+        meshlet_cull_params.camera_position =
+            glm::inverse(packet.view * packet.object_transforms[0]) * glm::vec4(0.f, 0.f, 0.f, 1.f);
+        meshlet_cull_params.frustum_culling = packet.frustum_culling ? 1 : 0;
+        meshlet_cull_params.model_first_index = _model.mesh.first_index;
+    }
+
+    if ((0 != packet.instance_cnt) && _settings.gpu_culling)
+    {
+        // the recorded culling pass reads everything which changes from a frame to the next from its parameters
+        FrustumPlanes frustum_planes;
+        extractFrustumPlanes(&view_proj[0][0], frustum_planes);
+
+        UniformCullParams & cull_params = *frame.cull_params;
+        cull_params.view_proj = view_proj;
+        for (u32 plane_idx = 0; plane_idx != FrustumPlanes::PLANE_COUNT; ++plane_idx)
+        {
+            cull_params.frustum_planes[plane_idx] = {frustum_planes.a[plane_idx], frustum_planes.b[plane_idx],
+                                                     frustum_planes.c[plane_idx], frustum_planes.d[plane_idx]};
+        }
+        cull_params.rotation = {std::cos(packet.animation_time), std::sin(packet.animation_time)};
+        cull_params.instance_cnt = packet.instance_cnt;
+        cull_params.frustum_culling = packet.frustum_culling ? 1 : 0;
+        cull_params.viewport_size = {(f32)_vk_swapchain_ext.width, (f32)_vk_swapchain_ext.height};
+        cull_params.occlusion_culling = packet.occlusion_culling ? 1 : 0;
+        cull_params.depth_pyramid_level_cnt = _depth_pyramid.getLevelCount();
+
+        // copied by the previous frame of the slot, which the GPU is done with
+        IndirectDraws const & cull_stats = *frame.cull_stats;
+        CullingStats stats;
+        stats.instance_cnt = packet.instance_cnt;
+        stats.frustum_culled_cnt = cull_stats.frustum_culled_cnt;
+        stats.occlusion_culled_cnt = cull_stats.occlusion_culled_cnt;
+        stats.drawn_cnt = cull_stats.draws[CULL_PHASE_EARLY].cmd.instanceCount +
+                          cull_stats.draws[CULL_PHASE_LATE].cmd.instanceCount;
+        stats.drawn_triangle_cnt = stats.drawn_cnt * (_model.lods[0].index_cnt / 3);
+
+        std::lock_guard<std::mutex> lock(_culling_stats_mutex);
+        _culling_stats = stats;
+    }
+    else if (0 != packet.instance_cnt)
+    {
+        // the GPU is done with the previous frame of this slot so its instance buffer can be overwritten
+        u32 occlusion_culled_cnt = 0;
+        InstanceLodSelection lod_selection;
+        // the Y axis of the projection is flipped for Vulkan
+        lod_selection.pixel_scale = _vk_swapchain_ext.height * -0.5f * projection[1][1];
+
+        u32 const drawn_instance_cnt = updateInstanceTransforms(
+            packet.animation_time, view_proj, packet.instance_cnt, packet.frustum_culling, packet.occlusion_culling,
+            frame.instance_transforms, true, &occlusion_culled_cnt, (1 < _instance_lod_cnt) ? &lod_selection : nullptr);
+
+        if (1 == _instance_lod_cnt)
+        {
+            lod_selection.instance_cnts[0] = drawn_instance_cnt;
+        }
+
+        // the recorded command buffers stay valid, only the instance counts of the indirect draws change
+        u32 drawn_triangle_cnt = 0;
+        u32 first_instance = 0;
+        for (u32 lod_idx = 0; lod_idx != _instance_lod_cnt; ++lod_idx)
+        {
+            MeshLod const & lod = _model.lods[lod_idx];
+            u32 const lod_instance_cnt = lod_selection.instance_cnts[lod_idx];
+
+            frame.indirect_cmds[lod_idx] = {lod.index_cnt, lod_instance_cnt, _model.mesh.first_index + lod.first_index,
+                                            _model.mesh.vertex_offset, first_instance};
+            first_instance += lod_instance_cnt;
+            drawn_triangle_cnt += lod_instance_cnt * (lod.index_cnt / 3);
+        }
+
+        CullingStats stats;
+        stats.instance_cnt = packet.instance_cnt;
+        stats.frustum_culled_cnt = packet.instance_cnt - drawn_instance_cnt - occlusion_culled_cnt;
+        stats.occlusion_culled_cnt = occlusion_culled_cnt;
+        stats.drawn_cnt = drawn_instance_cnt;
+        stats.drawn_triangle_cnt = drawn_triangle_cnt;
+
+        std::lock_guard<std::mutex> lock(_culling_stats_mutex);
+        _culling_stats = stats;
+    }
+
+    // the only wait on the present thread: at most inflight_frame_cnt - 1 frames are acquired and not presented yet,
+    // and the previous present of the frame slot has waited on its render finished semaphore
+    u64 const frame_value = _frame_scheduler.getFrameValue();
+    if (frame_value > _frame_scheduler.getInflightFrameCount())
+    {
+        waitForPresent(frame_value - _frame_scheduler.getInflightFrameCount());
+    }
+
+    u32 img_idx = 0;
+    VkResult vk_res = VK_SUCCESS;
+
+    // the acquire never blocks while holding the present lock: the present thread may need it to free an image
+    for (;;)
+    {
+        {
+            std::lock_guard<std::mutex> lock(_present_mutex);
+            vk_res = vkAcquireNextImageKHR(_vk_device, _vk_swapchain, ACQUIRE_TIMEOUT_NS, frame.image_available_sem,
+                                           VK_NULL_HANDLE, &img_idx);
+        }
+
+        if ((VK_TIMEOUT != vk_res) && (VK_NOT_READY != vk_res))
+        {
+            break;
+        }
+
+        std::this_thread::yield();
+    }
+
+    if (vk_res == VK_ERROR_OUT_OF_DATE_KHR)
+    {
+        // nothing is submitted, the next frame takes over the value and slot of this one
+        recreateSwapChainRelatedData(_target_frame_buffer_ext);
+        _redraw_requested = true;
+        return true;
+    }
+    else if ((vk_res != VK_SUCCESS) && (vk_res != VK_SUBOPTIMAL_KHR))
+    {
+        return false;
+    }
+
+    // from here on, a failing frame has to release the image and the semaphore signaled by the acquire
+    if (!_frame_scheduler.acquireImage(img_idx))
+    {
+        releaseAcquiredImage();
+        return false;
+    }
+
+    VkCommandBuffer submit_cmd_buffer = VK_NULL_HANDLE;
+
+    if (_settings.reuse_cmd_buffers)
+    {
+        submit_cmd_buffer = getRecordedFrame(_current_frame, img_idx);
+        if (VK_NULL_HANDLE == submit_cmd_buffer)
+        {
+            releaseAcquiredImage();
+            return false;
+        }
+    }
+    else
+    {
+        VkCommandBuffer & cmd_buffer = frame.cmd_buffer;
+
+        if (cmd_buffer != VK_NULL_HANDLE)
+        {
+            vkFreeCommandBuffers(_vk_device, _vk_graphics_cmd_pool, 1, &cmd_buffer);
+            cmd_buffer = VK_NULL_HANDLE;
+        }
+
+        VkCommandBufferAllocateInfo alloc_info = {};
+        alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        alloc_info.commandPool = _vk_graphics_cmd_pool;
+        alloc_info.commandBufferCount = 1;
+        alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+
+        vk_res = vkAllocateCommandBuffers(_vk_device, &alloc_info, &cmd_buffer);
+        if (VK_SUCCESS != vk_res)
+        {
+            sbLogE("Failed to allocate Vulkan Command Buffers (error = '{}')", getEnumValue(vk_res));
+            cmd_buffer = VK_NULL_HANDLE;
+            releaseAcquiredImage();
+            return false;
+        }
+
+        resetRecordingPools(_current_frame);
+
+        if (!recordFrame(cmd_buffer, _current_frame, img_idx, packet.draw_list, _settings.recording_thread_cnt,
+                         VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT))
+        {
+            releaseAcquiredImage();
+            return false;
+        }
+
+        submit_cmd_buffer = cmd_buffer;
+    }
+
+    // The command has to wait for the image to be ready when we start wrinting to the image
+    VkPipelineStageFlags const wait_stage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+
+    VkSubmitInfo submit_info = {};
+    submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    // There is a 1:1 correspondance between wait stages and semaphores
+    submit_info.waitSemaphoreCount = 1;
+    submit_info.pWaitSemaphores = &frame.image_available_sem;
+    submit_info.pWaitDstStageMask = &wait_stage;
+    submit_info.commandBufferCount = 1;
+    submit_info.pCommandBuffers = &submit_cmd_buffer;
+
+    // the binary semaphore values are ignored
+    VkSemaphore const signal_sems[2] = {frame.render_finished_sem, _frame_scheduler.getTimelineSemaphore()};
+    u64 const signal_values[2] = {0, _frame_scheduler.getFrameValue()};
+    u64 const wait_value = 0;
+
+    VkTimelineSemaphoreSubmitInfo timeline_info = {};
+    timeline_info.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timeline_info.waitSemaphoreValueCount = 1;
+    timeline_info.pWaitSemaphoreValues = &wait_value;
+    timeline_info.signalSemaphoreValueCount = (u32)sbstd::size(signal_values);
+    timeline_info.pSignalSemaphoreValues = sbstd::data(signal_values);
+
+    submit_info.pNext = &timeline_info;
+    submit_info.signalSemaphoreCount = (u32)sbstd::size(signal_sems);
+    submit_info.pSignalSemaphores = sbstd::data(signal_sems);
+
+    if (_vk_graphics_queue == _vk_present_queue)
+    {
+        std::lock_guard<std::mutex> lock(_present_mutex);
+        vk_res = vkQueueSubmit(_vk_graphics_queue, 1, &submit_info, VK_NULL_HANDLE);
+    }
+    else
+    {
+        vk_res = vkQueueSubmit(_vk_graphics_queue, 1, &submit_info, VK_NULL_HANDLE);
+    }
+
+    if (VK_SUCCESS != vk_res)
+    {
+        sbLogE("Failed to submit the Vulkan command buffer to the graphics queue (error = '{}'", getEnumValue(vk_res));
+        releaseAcquiredImage();
+        return false;
+    }
+
+    frame.timestamps_written = (VK_NULL_HANDLE != frame.timestamp_pool);
+
+    _frame_scheduler.endFrame();
+
+    // frame values are strictly increasing so they are valid present ids
+    PresentRequest const present_request = {_vk_swapchain, img_idx, frame.render_finished_sem, frame_value};
+
+    if (_present_thread.joinable())
+    {
+        // never full as the frames wait for the present of the previous frames in their slot
+        while (!_present_requests.push(present_request))
+        {
+            std::this_thread::yield();
+        }
+
+        return true;
+    }
+
+    vk_res = presentFrame(present_request);
+    if ((vk_res == VK_ERROR_OUT_OF_DATE_KHR) || (vk_res == VK_SUBOPTIMAL_KHR) ||
+        (_target_frame_buffer_ext.width != _vk_swapchain_ext.width) ||
+        (_target_frame_buffer_ext.height != _vk_swapchain_ext.height))
+    {
+        recreateSwapChainRelatedData(_target_frame_buffer_ext);
+        _redraw_requested = true;
+    }
+    else if (vk_res != VK_SUCCESS)
+    {
+        sbLogE("Failed to present Vulkan frame buffer (error = '{}')", getEnumValue(vk_res));
+        return false;
+    }
+
+    // vkQueueWaitIdle(_vk_present_queue);
+
+    return true;
+}
+
+VkResult VulkanApp::presentFrame(PresentRequest const & request)
+{
+    VkPresentInfoKHR present_info = {};
+    present_info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+    present_info.swapchainCount = 1;
+    present_info.pSwapchains = &request.swapchain;
+    present_info.pImageIndices = &request.img_idx;
+    present_info.waitSemaphoreCount = 1;
+    present_info.pWaitSemaphores = &request.wait_sem;
+    present_info.pResults = nullptr;
+
+    VkPresentIdKHR present_id_info = {};
+    present_id_info.sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR;
+    present_id_info.swapchainCount = 1;
+    present_id_info.pPresentIds = &request.present_id;
+
+    if (_present_wait_supported)
+    {
+        present_info.pNext = &present_id_info;
+    }
+
+    VkResult vk_res = VK_SUCCESS;
+
+    {
+        std::lock_guard<std::mutex> lock(_present_mutex);
+        vk_res = vkQueuePresentKHR(_vk_present_queue, &present_info);
+
+        // a frame queued before the swapchain was recreated says nothing about the new swapchain
+        if ((request.swapchain != _vk_swapchain) && (VK_ERROR_OUT_OF_DATE_KHR == vk_res))
+        {
+            vk_res = VK_SUCCESS;
+        }
+    }
+
+    _presented_value = request.present_id;
+    _presented_value.notify_all();
+
+    return vk_res;
+}
+
+void VulkanApp::releaseAcquiredImage()
+{
+    FrameContext & frame = _frames[_current_frame];
+
+    // an empty batch consumes the signal of the acquire, waiting for it leaves the semaphore free for the next acquire
+    VkPipelineStageFlags const wait_stage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+
+    VkSubmitInfo submit_info = {};
+    submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submit_info.waitSemaphoreCount = 1;
+    submit_info.pWaitSemaphores = &frame.image_available_sem;
+    submit_info.pWaitDstStageMask = &wait_stage;
+
+    VkResult vk_res = VK_SUCCESS;
+
+    {
+        std::unique_lock<std::mutex> lock(_present_mutex, std::defer_lock);
+        if (_vk_graphics_queue == _vk_present_queue)
+        {
+            lock.lock();
+        }
+
+        vk_res = vkQueueSubmit(_vk_graphics_queue, 1, &submit_info, VK_NULL_HANDLE);
+        if (VK_SUCCESS == vk_res)
+        {
+            vk_res = vkQueueWaitIdle(_vk_graphics_queue);
+        }
+    }
+
+    if (VK_SUCCESS != vk_res)
+    {
+        // the semaphore keeps its pending signal, it is replaced and destroyed along with the next frame of the value
+        VkSemaphoreCreateInfo sem_info = {};
+        sem_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+        VkSemaphore image_available_sem = VK_NULL_HANDLE;
+        vk_res = vkCreateSemaphore(_vk_device, &sem_info, nullptr, &image_available_sem);
+        if (VK_SUCCESS == vk_res)
+        {
+            _frame_scheduler.deferRelease([device = _vk_device, sem = frame.image_available_sem]() {
+                vkDestroySemaphore(device, sem, nullptr);
+            });
+            frame.image_available_sem = image_available_sem;
+        }
+        else
+        {
+            sbLogE("Failed to replace Vulkan image available semaphore (error = '{}')", getEnumValue(vk_res));
+        }
+    }
+
+    // the image has not been rendered to and cannot be presented, the swapchain it belongs to is retired instead
+    recreateSwapChainRelatedData(_target_frame_buffer_ext);
+    _redraw_requested = true;
+}
+
+void VulkanApp::waitForPresent(u64 present_id)
+{
+    u64 presented_value = _presented_value.load();
+
+    while (presented_value < present_id)
+    {
+        _presented_value.wait(presented_value);
+        presented_value = _presented_value.load();
+    }
+}
+
+void VulkanApp::startPresentThread()
+{
+    sbAssert(!_present_thread.joinable());
+    sbAssert(!_render_thread.joinable(), "The present thread has to be started before the render thread");
+
+    _present_thread = std::thread([this]() { runPresentThread(); });
+}
+
+void VulkanApp::stopPresentThread()
+{
+    if (!_present_thread.joinable())
+    {
+        return;
+    }
+
+    sbAssert(!_render_thread.joinable(), "The present thread has to be stopped after the render thread");
+
+    while (!_present_requests.push({VK_NULL_HANDLE, 0, VK_NULL_HANDLE, 0}))
+    {
+        std::this_thread::yield();
+    }
+
+    _present_thread.join();
+}
+
+void VulkanApp::runPresentThread()
+{
+    for (;;)
+    {
+        _present_requests.waitForPush();
+
+        PresentRequest request;
+        while (_present_requests.pop(request))
+        {
+            if (VK_NULL_HANDLE == request.swapchain)
+            {
+                return;
+            }
+
+            VkResult const vk_res = presentFrame(request);
+
+            // the swapchain is recreated by the next frame
+            if ((vk_res == VK_ERROR_OUT_OF_DATE_KHR) || (vk_res == VK_SUBOPTIMAL_KHR))
+            {
+                _swapchain_out_of_date = true;
+            }
+            else if (vk_res != VK_SUCCESS)
+            {
+                sbLogE("Failed to present Vulkan frame buffer (error = '{}')", getEnumValue(vk_res));
+            }
+        }
+    }
+}
+
+void VulkanApp::setPresentMode(VkPresentModeKHR present_mode)
+{
+    _next_frame.present_mode = present_mode;
+    _redraw_requested = true;
+}
+
+void VulkanApp::setSwapchainImageCount(u32 img_cnt)
+{
+    _next_frame.swapchain_img_cnt = img_cnt;
+    _redraw_requested = true;
+}
+
+void VulkanApp::setAnimationEnabled(b8 enable)
+{
+    _settings.animate = enable;
+    _redraw_requested = true;
+}
+
+void VulkanApp::setLowLatencyPacing(b8 enable)
+{
+    _next_frame.low_latency_pacing = enable;
+}
+
+void VulkanApp::setFrustumCulling(b8 enable)
+{
+    _next_frame.frustum_culling = enable;
+    _redraw_requested = true;
+}
+
+void VulkanApp::setOcclusionCulling(b8 enable)
+{
+    _next_frame.occlusion_culling = enable && (_settings.occlusion_culling || _settings.software_occlusion_culling);
+    _redraw_requested = true;
+}
+
+void VulkanApp::setDepthPrepass(b8 enable)
+{
+    _next_frame.depth_prepass = enable && _settings.depth_prepass;
+    // the pipelines and the subpasses of the draws are baked in the recorded frames
+    ++_next_frame.scene_version;
+    _redraw_requested = true;
+}
+
+VulkanApp::CullingStats VulkanApp::getCullingStats() const
+{
+    std::lock_guard<std::mutex> lock(_culling_stats_mutex);
+    return _culling_stats;
+}
+
+void VulkanApp::cyclePresentMode()
+{
+    VkPresentModeKHR const present_modes[] = {VK_PRESENT_MODE_FIFO_KHR, VK_PRESENT_MODE_FIFO_RELAXED_KHR,
+                                              VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_IMMEDIATE_KHR};
+
+    auto const curr_mode_iter = sbstd::find(begin(present_modes), end(present_modes), _next_frame.present_mode);
+    usize const curr_mode_idx = (curr_mode_iter != end(present_modes)) ? (curr_mode_iter - begin(present_modes)) : 0;
+
+    // next mode supported by the surface
+    for (usize mode_offset = 1; mode_offset != sbstd::size(present_modes); ++mode_offset)
+    {
+        VkPresentModeKHR const present_mode = present_modes[(curr_mode_idx + mode_offset) % sbstd::size(present_modes)];
+
+        if (end(_vk_supported_present_modes) !=
+            sbstd::find(begin(_vk_supported_present_modes), end(_vk_supported_present_modes), present_mode))
+        {
+            sbLogI("Switching to present mode '{}'", getVkPresentModeName(present_mode));
+            setPresentMode(present_mode);
+            return;
+        }
+    }
+}
+
+void VulkanApp::buildDrawList()
+{
+    DArray<DrawCmd> & draw_list = _next_frame.draw_list;
+
+    draw_list.clear();
+    ++_next_frame.scene_version;
+
+    switch (_demo_mode)
+    {
+        case DemoMode::TRIANGLE:
+        {
+            draw_list.push_back({_triangle_mesh, 3});
+            break;
+        }
+        case DemoMode::QUAD:
+        {
+            draw_list.push_back({_quad_mesh, 12});
+            break;
+        }
+        case DemoMode::MODEL:
+        {
+            draw_list.push_back(
+                {_model.mesh, _model.lods[0].index_cnt, 1, VK_NULL_HANDLE, false, _settings.meshlet_culling});
+            break;
+        }
+        case DemoMode::INSTANCED:
+        {
+            draw_list.push_back(
+                {_model.mesh, _model.lods[0].index_cnt, _settings.instance_cnt, _vk_instanced_pipeline, true});
+            break;
+        }
+        default:
+        {
+            sbAssert(false, "Unsupported demo mode");
+            break;
+        }
+    };
+
+    _next_frame.object_transforms.resize(draw_list.size(), glm::mat4(1.f));
+    _next_frame.instance_cnt = (DemoMode::INSTANCED == _demo_mode) ? _settings.instance_cnt : 0;
+}
+
+void VulkanApp::setDemoMode(DemoMode mode)
+{
+    if (mode == _demo_mode)
+    {
+        return;
+    }
+
+    _demo_mode = mode;
+    buildDrawList();
+    _redraw_requested = true;
+}
+
+VkCommandBuffer VulkanApp::getRecordedFrame(u32 frame_idx, u32 img_idx)
+{
+    FramePacket const & packet = _frame_packets.getReadBuffer();
+
+    FrameContext & frame = _frames[frame_idx];
+
+    if (frame.recorded_frames.size() != _vk_swapchain_imgs.size())
+    {
+        destroyRecordedFrames();
+    }
+
+    // each frame slot binds its own uniform buffer so the cache is keyed on both the frame slot and the image
+    RecordedFrame & recorded_frame = frame.recorded_frames[img_idx];
+
+    if (recorded_frame.scene_version == packet.scene_version)
+    {
+        return recorded_frame.cmd_buffer;
+    }
+
+    VkResult vk_res = VK_SUCCESS;
+
+    if (VK_NULL_HANDLE == recorded_frame.cmd_buffer)
+    {
+        VkCommandBufferAllocateInfo alloc_info = {};
+        alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        alloc_info.commandPool = _vk_static_cmd_pool;
+        alloc_info.commandBufferCount = 1;
+        alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+
+        vk_res = vkAllocateCommandBuffers(_vk_device, &alloc_info, &recorded_frame.cmd_buffer);
+        if (VK_SUCCESS != vk_res)
+        {
+            sbLogE("Failed to allocate Vulkan static Command Buffer (error = '{}')", getEnumValue(vk_res));
+            recorded_frame.cmd_buffer = VK_NULL_HANDLE;
+            return VK_NULL_HANDLE;
+        }
+    }
+    else
+    {
+        // the previous frame of this slot has been waited on, its submission is done
+        vkResetCommandBuffer(recorded_frame.cmd_buffer, 0);
+    }
+
+    // recorded inline: secondaries would be recycled with the per-frame pools
+    if (!recordFrame(recorded_frame.cmd_buffer, frame_idx, img_idx, packet.draw_list, 1, 0))
+    {
+        recorded_frame.scene_version = 0;
+        return VK_NULL_HANDLE;
+    }
+
+    recorded_frame.scene_version = packet.scene_version;
+
+    return recorded_frame.cmd_buffer;
+}
+
+void VulkanApp::destroyRecordedFrames()
+{
+    VkDevice const device = _vk_device;
+    VkCommandPool const cmd_pool = _vk_static_cmd_pool;
+
+    for (auto & frame : _frames)
+    {
+        for (auto & recorded_frame : frame.recorded_frames)
+        {
+            // may still be executed by a frame in flight
+            if (VK_NULL_HANDLE != recorded_frame.cmd_buffer)
+            {
+                VkCommandBuffer const cmd_buffer = recorded_frame.cmd_buffer;
+                _frame_scheduler.deferRelease(
+                    [device, cmd_pool, cmd_buffer]() { vkFreeCommandBuffers(device, cmd_pool, 1, &cmd_buffer); });
+            }
+        }
+
+        // empty entries for the current swapchain, recorded again on first use
+        frame.recorded_frames.clear();
+        frame.recorded_frames.resize(_vk_swapchain_imgs.size());
+    }
+}
+
+void VulkanApp::resetRecordingPools(u32 frame_idx)
+{
+    for (auto & recording_pool : _frames[frame_idx].recording_pools)
+    {
+        if (0 != recording_pool.used_cnt)
+        {
+            vkResetCommandPool(_vk_device, recording_pool.cmd_pool, 0);
+            recording_pool.used_cnt = 0;
+        }
+    }
+}
+
+VkCommandBuffer VulkanApp::allocateSecondaryCommandBuffer(u32 frame_idx)
+{
+    u32 const slot_idx = JobSystem::getCurrentThreadSlot();
+    sbAssert(JobSystem::INVALID_THREAD_SLOT != slot_idx);
+
+    RecordingPool & recording_pool = _frames[frame_idx].recording_pools[slot_idx];
+
+    // command buffers are kept across frames and recycled by the pool reset
+    if (recording_pool.used_cnt == recording_pool.cmd_buffers.size())
+    {
+        VkCommandBufferAllocateInfo alloc_info = {};
+        alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        alloc_info.commandPool = recording_pool.cmd_pool;
+        alloc_info.commandBufferCount = 1;
+        alloc_info.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+
+        VkCommandBuffer cmd_buffer = VK_NULL_HANDLE;
+        VkResult const vk_res = vkAllocateCommandBuffers(_vk_device, &alloc_info, &cmd_buffer);
+        if (VK_SUCCESS != vk_res)
+        {
+            sbLogE("Failed to allocate Vulkan secondary Command Buffer (error = '{}')", getEnumValue(vk_res));
+            return VK_NULL_HANDLE;
+        }
+
+        recording_pool.cmd_buffers.push_back(cmd_buffer);
+    }
+
+    return recording_pool.cmd_buffers[recording_pool.used_cnt++];
+}
+
+void VulkanApp::recordInstanceCulling(VkCommandBuffer cmd_buffer, u32 frame_idx, sbstd::span<DrawCmd const> draws,
+                                      CullPhase phase)
+{
+    // the indirect buffer of the frame holds a single draw per phase
+    auto const draw_iter = sbstd::find_if(begin(draws), end(draws), [](DrawCmd const & draw) { return draw.indirect; });
+    if (draw_iter == end(draws))
+    {
+        return;
+    }
+
+    FrameContext const & frame = _frames[frame_idx];
+    b8 const occlusion_culling = _settings.occlusion_culling;
+
+    if (CULL_PHASE_EARLY == phase)
+    {
+        // the index counts never change while the command buffer is reused, the rest is accumulated by the culling
+        IndirectDraws draws_reset = {};
+        for (IndirectDraw & draw_reset : draws_reset.draws)
+        {
+            draw_reset.cmd.indexCount = draw_iter->element_cnt;
+            draw_reset.cmd.firstIndex = draw_iter->mesh.first_index;
+            draw_reset.cmd.vertexOffset = draw_iter->mesh.vertex_offset;
+        }
+        vkCmdUpdateBuffer(cmd_buffer, frame.indirect_buffer.buffer, 0, sizeof(draws_reset), &draws_reset);
+
+        // the instance visibility and the depth pyramid are also used by the culling of the previous frame
+        VkMemoryBarrier reset_barrier = {};
+        reset_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        reset_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        reset_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        vkCmdPipelineBarrier(cmd_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                             VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &reset_barrier, 0, nullptr, 0, nullptr);
+
+        if (occlusion_culling)
+        {
+            _depth_pyramid.recordReset(cmd_buffer);
+        }
+    }
+    else
+    {
+        // the late phase tests the instances against the depth of the ones drawn by the early phase
+        _depth_pyramid.recordBuild(cmd_buffer, _vk_swapchain_ext);
+    }
+
+    if (occlusion_culling)
+    {
+        VkDescriptorSet const desc_sets[] = {frame.desc_set, _depth_pyramid.getSampleDescSet()};
+        u32 const late_phase = (CULL_PHASE_LATE == phase) ? 1 : 0;
+
+        vkCmdBindPipeline(cmd_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, _vk_occlusion_cull_pipeline);
+        vkCmdBindDescriptorSets(cmd_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, _vk_occlusion_cull_pipeline_layout, 0,
+                                numericConv<u32>(sbstd::size(desc_sets)), sbstd::data(desc_sets), 0, nullptr);
+        vkCmdPushConstants(cmd_buffer, _vk_occlusion_cull_pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                           sizeof(late_phase), &late_phase);
+    }
+    else
+    {
+        vkCmdBindPipeline(cmd_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, _vk_cull_pipeline);
+        vkCmdBindDescriptorSets(cmd_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, _vk_pipeline_layout, 0, 1,
+                                &frame.desc_set, 0, nullptr);
+    }
+
+    vkCmdDispatch(cmd_buffer, (draw_iter->instance_cnt + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+
+    // the draw reads the counts and the instanced vertex shader the transforms written by the culling
+    // the early draws of the occlusion culling also have to be written before the late phase adds to them
+    VkMemoryBarrier cull_barrier = {};
+    cull_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    cull_barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    cull_barrier.dstAccessMask =
+        VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+    vkCmdPipelineBarrier(cmd_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+                             VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         0, 1, &cull_barrier, 0, nullptr, 0, nullptr);
+
+    // the counters are complete once the last phase is done
+    if (!occlusion_culling || (CULL_PHASE_LATE == phase))
+    {
+        VkBufferCopy stats_copy = {};
+        stats_copy.size = sizeof(IndirectDraws);
+        vkCmdCopyBuffer(cmd_buffer, frame.indirect_buffer.buffer, frame.cull_stats_buffer.buffer, 1, &stats_copy);
+
+        VkMemoryBarrier stats_barrier = {};
+        stats_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        stats_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        stats_barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+        vkCmdPipelineBarrier(cmd_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1,
+                             &stats_barrier, 0, nullptr, 0, nullptr);
+    }
+}
+
+void VulkanApp::recordMeshletCulling(VkCommandBuffer cmd_buffer, u32 frame_idx, sbstd::span<DrawCmd const> draws)
+{
+    // the frame holds the visible indices of a single meshlet draw
+    if (sbstd::none_of(begin(draws), end(draws), [](DrawCmd const & draw) { return draw.meshlets; }))
+    {
+        return;
+    }
+
+    FrameContext const & frame = _frames[frame_idx];
+
+    // the index count is accumulated by the culling, the visible indices still refer to the vertices of the model
+    VkDrawIndexedIndirectCommand const draw_reset = {0, 1, 0, _model.mesh.vertex_offset, 0};
+    vkCmdUpdateBuffer(cmd_buffer, frame.meshlet_draw_buffer.buffer, 0, sizeof(draw_reset), &draw_reset);
+
+    VkMemoryBarrier reset_barrier = {};
+    reset_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    reset_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    reset_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(cmd_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1,
+                         &reset_barrier, 0, nullptr, 0, nullptr);
+
+    vkCmdBindPipeline(cmd_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, _vk_meshlet_cull_pipeline);
+    vkCmdBindDescriptorSets(cmd_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, _vk_pipeline_layout, 0, 1, &frame.desc_set,
+                            0, nullptr);
+    vkCmdDispatch(cmd_buffer, _model.meshlet_cnt, 1, 1);
+
+    // the draw reads the index count and the indices written by the culling
+    VkMemoryBarrier cull_barrier = {};
+    cull_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    cull_barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    cull_barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+    vkCmdPipelineBarrier(cmd_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 1,
+                         &cull_barrier, 0, nullptr, 0, nullptr);
+}
+
+void VulkanApp::recordDraws(VkCommandBuffer cmd_buffer, u32 frame_idx, sbstd::span<DrawCmd const> draws,
+                            u32 first_draw_idx, CullPhase phase, b8 depth_only)
+{
+    // the draws name the pipelines of the main subpass without the depth prepass
+    auto const selectPipeline = [this, depth_only](VkPipeline pipeline) {
+        b8 const instanced = (_vk_instanced_pipeline == pipeline);
+        if (depth_only)
+        {
+            return instanced ? _vk_instanced_depth_pipeline : _vk_depth_pipeline;
+        }
+
+        if (_draw_depth_prepass)
+        {
+            return instanced ? _vk_instanced_equal_pipeline : _vk_graphics_equal_pipeline;
+        }
+
+        return (VK_NULL_HANDLE != pipeline) ? pipeline : _vk_graphics_pipeline;
+    };
+
+    VkPipeline bound_pipeline = selectPipeline(VK_NULL_HANDLE);
+    vkCmdBindPipeline(cmd_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, bound_pipeline);
+
+    VkViewport view_port = {};
+    view_port.width = (float)_vk_swapchain_ext.width;
+    view_port.height = (float)_vk_swapchain_ext.height;
+    view_port.x = 0;
+    view_port.y = 0;
+    view_port.minDepth = 0.f;
+    view_port.maxDepth = 1.f;
+    vkCmdSetViewport(cmd_buffer, 0, 1, &view_port);
+
+    VkRect2D scissor = {};
+    scissor.extent = _vk_swapchain_ext;
+    scissor.offset = {0, 0};
+    vkCmdSetScissor(cmd_buffer, 0, 1, &scissor);
+
+    vkCmdBindDescriptorSets(cmd_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, _vk_pipeline_layout, 0, 1,
+                            &_frames[frame_idx].desc_set, 0, nullptr);
+
+    // every mesh lives in the geometry arena, only the meshlet draws index another buffer
+    // the vertices are pulled by the vertex shaders from the arena buffers bound to the frame descriptor set
+    VkBuffer const arena_ib = _geometry_arena.getIndexBuffer();
+    vkCmdBindIndexBuffer(cmd_buffer, arena_ib, 0, VK_INDEX_TYPE_UINT32);
+    VkBuffer bound_ib = arena_ib;
+
+    FrameContext const & frame = _frames[frame_idx];
+
+    for (usize span_idx = 0; span_idx != draws.size(); ++span_idx)
+    {
+        DrawCmd const & draw = draws[span_idx];
+
+        if ((CULL_PHASE_LATE == phase) && !draw.indirect)
+        {
+            continue;
+        }
+
+        VkPipeline const pipeline = selectPipeline(draw.pipeline);
+        if (pipeline != bound_pipeline)
+        {
+            vkCmdBindPipeline(cmd_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+            bound_pipeline = pipeline;
+        }
+
+        if (0 == draw.mesh.idx_cnt)
+        {
+            vkCmdDraw(cmd_buffer, draw.element_cnt, draw.instance_cnt, numericConv<u32>(draw.mesh.vertex_offset),
+                      0);
+            continue;
+        }
+
+        if (draw.meshlets)
+        {
+            if (frame.meshlet_ib.buffer != bound_ib)
+            {
+                vkCmdBindIndexBuffer(cmd_buffer, frame.meshlet_ib.buffer, 0, VK_INDEX_TYPE_UINT32);
+                bound_ib = frame.meshlet_ib.buffer;
+            }
+
+            vkCmdDrawIndexedIndirect(cmd_buffer, frame.meshlet_draw_buffer.buffer, 0, 1,
+                                     sizeof(VkDrawIndexedIndirectCommand));
+            continue;
+        }
+
+        if (arena_ib != bound_ib)
+        {
+            vkCmdBindIndexBuffer(cmd_buffer, arena_ib, 0, VK_INDEX_TYPE_UINT32);
+            bound_ib = arena_ib;
+        }
+
+        if (draw.indirect)
+        {
+            VkBuffer const indirect_buffer = frame.indirect_buffer.buffer;
+            VkDeviceSize const draw_offset = offsetof(IndirectDraws, draws) + phase * sizeof(IndirectDraw);
+
+            if (_settings.gpu_culling && _draw_indirect_count_supported)
+            {
+                vkCmdDrawIndexedIndirectCount(cmd_buffer, indirect_buffer, draw_offset, indirect_buffer,
+                                              draw_offset + offsetof(IndirectDraw, draw_cnt), 1, sizeof(IndirectDraw));
+            }
+            else if (_settings.gpu_culling)
+            {
+                vkCmdDrawIndexedIndirect(cmd_buffer, indirect_buffer, draw_offset, 1, sizeof(IndirectDraw));
+            }
+            else if (_multi_draw_indirect_supported)
+            {
+                // a draw per level of detail, the levels without instances are empty draws
+                vkCmdDrawIndexedIndirect(cmd_buffer, indirect_buffer, 0, _instance_lod_cnt,
+                                         sizeof(VkDrawIndexedIndirectCommand));
+            }
+            else
+            {
+                for (u32 lod_idx = 0; lod_idx != _instance_lod_cnt; ++lod_idx)
+                {
+                    vkCmdDrawIndexedIndirect(cmd_buffer, indirect_buffer,
+                                             lod_idx * sizeof(VkDrawIndexedIndirectCommand), 1,
+                                             sizeof(VkDrawIndexedIndirectCommand));
+                }
+            }
+            continue;
+        }
+
+        u32 const draw_idx = first_draw_idx + numericConv<u32>(span_idx);
+        if (draw_idx < frame.multi_draw_cnt)
+        {
+            // the following draws of the same pipeline join the multi-draw indirect of this one
+            usize run_end = span_idx + 1;
+            while ((run_end != draws.size()) && draws[run_end].isMultiDrawable() &&
+                   (selectPipeline(draws[run_end].pipeline) == pipeline))
+            {
+                ++run_end;
+            }
+
+            vkCmdDrawIndexedIndirect(cmd_buffer, frame.multi_draw_buffer.buffer,
+                                     draw_idx * sizeof(VkDrawIndexedIndirectCommand),
+                                     numericConv<u32>(run_end - span_idx), sizeof(VkDrawIndexedIndirectCommand));
+            span_idx = run_end - 1;
+            continue;
+        }
+
+        vkCmdDrawIndexed(cmd_buffer, draw.element_cnt, draw.instance_cnt, draw.mesh.first_index,
+                         draw.mesh.vertex_offset, 0);
+    }
+}
+
+b8 VulkanApp::recordFrame(VkCommandBuffer cmd_buffer, u32 frame_idx, u32 img_idx, sbstd::span<DrawCmd const> draws,
+                          u32 thread_cnt, VkCommandBufferUsageFlags usage_flags, b8 force_secondaries)
+{
+    VkCommandBufferBeginInfo cmd_begin_info = {};
+    cmd_begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    cmd_begin_info.flags = usage_flags;
+    cmd_begin_info.pInheritanceInfo = nullptr;
+    VkResult vk_res = vkBeginCommandBuffer(cmd_buffer, &cmd_begin_info);
+    if (VK_SUCCESS != vk_res)
+    {
+        sbLogE("Failed to record Vulkan begin command (error = '{}')", getEnumValue(vk_res));
+        return false;
+    }
+
+    VkClearValue clear_values[3];
+    clear_values[0].color = {0.f, 0.f, 0.f, 1.f};
+    clear_values[1].depthStencil = {1.f, 0};
+    clear_values[2].color = {0.f, 0.f, 0.f, 1.f};
+
+    b8 const use_secondaries = force_secondaries || (1 < thread_cnt);
+
+    // the slot of the frame is not in flight anymore, its multi-draw commands are rewritten for these draws
+    FrameContext & frame = _frames[frame_idx];
+    frame.multi_draw_cnt = 0;
+
+    if ((nullptr != frame.multi_draw_cmds) && (draws.size() <= MAX_MULTI_DRAW_COUNT))
+    {
+        for (usize draw_idx = 0; draw_idx != draws.size(); ++draw_idx)
+        {
+            DrawCmd const & draw = draws[draw_idx];
+            frame.multi_draw_cmds[draw_idx] = {draw.element_cnt, draw.instance_cnt, draw.mesh.first_index,
+                                               draw.mesh.vertex_offset, 0};
+        }
+
+        frame.multi_draw_cnt = numericConv<u32>(draws.size());
+    }
+
+    // the whole frame is timed, culling included
+    if (VK_NULL_HANDLE != frame.timestamp_pool)
+    {
+        vkCmdResetQueryPool(cmd_buffer, frame.timestamp_pool, 0, 2);
+        vkCmdWriteTimestamp(cmd_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, frame.timestamp_pool, 0);
+    }
+
+    // compute work cannot be recorded inside of the render pass
+    if (_settings.gpu_culling)
+    {
+        recordInstanceCulling(cmd_buffer, frame_idx, draws, CULL_PHASE_EARLY);
+    }
+
+    if (_settings.meshlet_culling)
+    {
+        recordMeshletCulling(cmd_buffer, frame_idx, draws);
+    }
+
+    VkRenderPassBeginInfo cmd_pass_begin_info = {};
+    cmd_pass_begin_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    cmd_pass_begin_info.renderPass = _vk_render_pass;
+    cmd_pass_begin_info.framebuffer = _vk_frame_buffers[img_idx];
+    cmd_pass_begin_info.renderArea.offset = {0, 0};
+    cmd_pass_begin_info.renderArea.extent = _vk_swapchain_ext;
+    cmd_pass_begin_info.clearValueCount = (u32)sbstd::size(clear_values);
+    cmd_pass_begin_info.pClearValues = sbstd::data(clear_values);
+    VkSubpassContents const subpass_contents =
+        use_secondaries ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS : VK_SUBPASS_CONTENTS_INLINE;
+
+    auto const recordSubpass = [&](u32 subpass, b8 depth_only) {
+        if (!use_secondaries)
+        {
+            recordDraws(cmd_buffer, frame_idx, draws, 0, CULL_PHASE_EARLY, depth_only);
+            return true;
+        }
+
+        // each batch of draws is recorded by a job in a secondary command buffer from its thread's pool
+        u64 const draw_cnt = draws.size();
+        _secondary_cmd_buffers.clear();
+        _secondary_cmd_buffers.resize(thread_cnt, VK_NULL_HANDLE);
+
+        _job_system.parallelFor(thread_cnt, 1, [&](u32 batch_begin, u32 batch_end) {
+            for (u32 batch_idx = batch_begin; batch_idx != batch_end; ++batch_idx)
+            {
+                usize const first_draw = numericConv<usize>(draw_cnt * batch_idx / thread_cnt);
+                usize const last_draw = numericConv<usize>(draw_cnt * (batch_idx + 1) / thread_cnt);
+
+                VkCommandBuffer const secondary_cmd_buffer = allocateSecondaryCommandBuffer(frame_idx);
+                if (VK_NULL_HANDLE == secondary_cmd_buffer)
+                {
+                    continue;
+                }
+
+                VkCommandBufferInheritanceInfo inheritance_info = {};
+                inheritance_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+                inheritance_info.renderPass = _vk_render_pass;
+                inheritance_info.subpass = subpass;
+                inheritance_info.framebuffer = _vk_frame_buffers[img_idx];
+
+                VkCommandBufferBeginInfo secondary_begin_info = {};
+                secondary_begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+                secondary_begin_info.flags =
+                    VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+                secondary_begin_info.pInheritanceInfo = &inheritance_info;
+                vkBeginCommandBuffer(secondary_cmd_buffer, &secondary_begin_info);
+
+                recordDraws(secondary_cmd_buffer, frame_idx, draws.subspan(first_draw, last_draw - first_draw),
+                            numericConv<u32>(first_draw), CULL_PHASE_EARLY, depth_only);
+
+                vkEndCommandBuffer(secondary_cmd_buffer);
+
+                _secondary_cmd_buffers[batch_idx] = secondary_cmd_buffer;
+            }
+        });
+
+        auto const missing_cmd_buffer =
+            sbstd::find(begin(_secondary_cmd_buffers), end(_secondary_cmd_buffers), VK_NULL_HANDLE);
+        if (missing_cmd_buffer != end(_secondary_cmd_buffers))
+        {
+            return false;
+        }
+
+        vkCmdExecuteCommands(cmd_buffer, numericConv<u32>(_secondary_cmd_buffers.size()),
+                             _secondary_cmd_buffers.data());
+        return true;
+    };
+
+    vkCmdBeginRenderPass(cmd_buffer, &cmd_pass_begin_info, subpass_contents);
+
+    b8 recorded = true;
+    if (0 != _vk_main_subpass)
+    {
+        // the prepass subpass stays empty while the depth prepass is toggled off
+        recorded = !_draw_depth_prepass || recordSubpass(0, true);
+        vkCmdNextSubpass(cmd_buffer, subpass_contents);
+    }
+
+    if (!recorded || !recordSubpass(_vk_main_subpass, false))
+    {
+        vkCmdEndRenderPass(cmd_buffer);
+        vkEndCommandBuffer(cmd_buffer);
+        return false;
+    }
+
+    vkCmdEndRenderPass(cmd_buffer);
+
+    if (_settings.occlusion_culling)
+    {
+        recordInstanceCulling(cmd_buffer, frame_idx, draws, CULL_PHASE_LATE);
+
+        // always recorded as it resolves the attachments to the swapchain image, it only has a few indirect draws
+        VkRenderPassBeginInfo late_pass_begin_info = cmd_pass_begin_info;
+        late_pass_begin_info.renderPass = _vk_late_render_pass;
+        late_pass_begin_info.clearValueCount = 0;
+        late_pass_begin_info.pClearValues = nullptr;
+        vkCmdBeginRenderPass(cmd_buffer, &late_pass_begin_info, VK_SUBPASS_CONTENTS_INLINE);
+
+        if (0 != _vk_main_subpass)
+        {
+            if (_draw_depth_prepass)
+            {
+                recordDraws(cmd_buffer, frame_idx, draws, 0, CULL_PHASE_LATE, true);
+            }
+
+            vkCmdNextSubpass(cmd_buffer, VK_SUBPASS_CONTENTS_INLINE);
+        }
+
+        recordDraws(cmd_buffer, frame_idx, draws, 0, CULL_PHASE_LATE);
+
+        vkCmdEndRenderPass(cmd_buffer);
+    }
+
+    if (VK_NULL_HANDLE != frame.timestamp_pool)
+    {
+        vkCmdWriteTimestamp(cmd_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, frame.timestamp_pool, 1);
+    }
+
+    vk_res = vkEndCommandBuffer(cmd_buffer);
+    if (VK_SUCCESS != vk_res)
+    {
+        sbLogE("Failed to end Vulkan command buffer recording (error = '{}')", getEnumValue(vk_res));
+        return false;
+    }
+
+    return true;
+}
+
+void VulkanApp::benchmarkCommandRecording()
+{
+    constexpr u32 DRAW_CNT = 20000;
+    constexpr u32 ITERATION_CNT = 50;
+    static_assert(DRAW_CNT > MAX_MULTI_DRAW_COUNT, "the draws would be merged instead of being recorded one by one");
+
+    // the same model drawn many times, only the recording cost matters here
+    DArray<DrawCmd> draws;
+    draws.resize(DRAW_CNT, {_model.mesh, _model.lods[0].index_cnt});
+
+    vkDeviceWaitIdle(_vk_device);
+
+    sbLogI("Command recording benchmark ({} draws, {} iterations):", DRAW_CNT, ITERATION_CNT);
+
+    f64 inline_ms = 0.;
+    u32 const max_thread_cnt = _job_system.getWorkerCount() + 1;
+
+    // the first run records inline, the next ones record secondary command buffers from 1 to max_thread_cnt threads
+    // so that the cost of the secondaries themselves shows up against the inline recording
+    for (u32 run_idx = 0; run_idx <= max_thread_cnt; ++run_idx)
+    {
+        b8 const use_secondaries = (0 != run_idx);
+        u32 const thread_cnt = sbstd::max(run_idx, 1U);
+        f64 total_ms = 0.;
+
+        for (u32 iter_idx = 0; iter_idx != ITERATION_CNT; ++iter_idx)
+        {
+            resetRecordingPools(_current_frame);
+
+            VkCommandBufferAllocateInfo alloc_info = {};
+            alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            alloc_info.commandPool = _vk_graphics_cmd_pool;
+            alloc_info.commandBufferCount = 1;
+            alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+
+            VkCommandBuffer cmd_buffer = VK_NULL_HANDLE;
+            if (VK_SUCCESS != vkAllocateCommandBuffers(_vk_device, &alloc_info, &cmd_buffer))
+            {
+                sbLogE("Failed to allocate benchmark command buffer");
+                return;
+            }
+
+            auto const start_time = std::chrono::high_resolution_clock::now();
+            b8 const recorded = recordFrame(cmd_buffer, _current_frame, 0, draws, thread_cnt,
+                                              VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT, use_secondaries);
+            auto const end_time = std::chrono::high_resolution_clock::now();
+
+            vkFreeCommandBuffers(_vk_device, _vk_graphics_cmd_pool, 1, &cmd_buffer);
+
+            if (!recorded)
+            {
+                sbLogE("Failed to record benchmark command buffer");
+                return;
+            }
+
+            total_ms += std::chrono::duration<f64, std::milli>(end_time - start_time).count();
+        }
+
+        f64 const avg_ms = total_ms / ITERATION_CNT;
+        if (!use_secondaries)
+        {
+            inline_ms = avg_ms;
+            sbLogI("\t- inline, 1 thread: {:.3f} ms", avg_ms);
+            continue;
+        }
+
+        sbLogI("\t- secondaries, {} thread(s): {:.3f} ms (x{:.2f})", thread_cnt, avg_ms, inline_ms / avg_ms);
+    }
+
+    resetRecordingPools(_current_frame);
+}
+
+void VulkanApp::benchmarkInflightFrames()
+{
+    constexpr u32 WARMUP_FRAME_CNT = 60;
+    constexpr u32 FRAME_CNT = 600;
+
+    using Clock = std::chrono::high_resolution_clock;
+
+    struct PendingFrame
+    {
+        u64 value;
+        Clock::time_point start_time;
+    };
+
+    u32 const initial_inflight_frame_cnt = _settings.inflight_frame_cnt;
+
+    sbLogI("Frames in flight benchmark ({} frames):", FRAME_CNT);
+
+    for (u32 inflight_frame_cnt = 1; inflight_frame_cnt <= MAX_INFLIGHT_FRAMES; ++inflight_frame_cnt)
+    {
+        if (!setInflightFrameCount(inflight_frame_cnt))
+        {
+            sbLogE("Failed to switch to {} frame(s) in flight", inflight_frame_cnt);
+            return;
+        }
+
+        for (u32 frame_idx = 0; frame_idx != WARMUP_FRAME_CNT; ++frame_idx)
+        {
+            render();
+            glfwPollEvents();
+        }
+
+        DArray<PendingFrame> pending_frames;
+        pending_frames.reserve(FRAME_CNT);
+        usize completed_frame_cnt = 0;
+        f64 total_latency_ms = 0.;
+
+        // latency is measured from the start of the CPU frame to the GPU completion, observed at the next frames
+        auto const gatherCompletedFrames = [&]() {
+            u64 const completed_value = _frame_scheduler.getCompletedValue();
+            auto const now = Clock::now();
+
+            while ((completed_frame_cnt != pending_frames.size()) &&
+                   (pending_frames[completed_frame_cnt].value <= completed_value))
+            {
+                total_latency_ms +=
+                    std::chrono::duration<f64, std::milli>(now - pending_frames[completed_frame_cnt].start_time)
+                        .count();
+                ++completed_frame_cnt;
+            }
+        };
+
+        auto const bench_start_time = Clock::now();
+
+        for (u32 frame_idx = 0; frame_idx != FRAME_CNT; ++frame_idx)
+        {
+            auto const frame_start_time = Clock::now();
+            u64 const submitted_value = _frame_scheduler.getSubmittedValue();
+
+            // a frame which only recreated the swapchain submitted nothing, its value goes to the next one
+            if (render() && (_frame_scheduler.getSubmittedValue() != submitted_value))
+            {
+                pending_frames.push_back({_frame_scheduler.getSubmittedValue(), frame_start_time});
+            }
+
+            gatherCompletedFrames();
+            glfwPollEvents();
+        }
+
+        auto const bench_end_time = Clock::now();
+
+        if (!pending_frames.empty())
+        {
+            _frame_scheduler.waitForValue(pending_frames.back().value);
+            gatherCompletedFrames();
+        }
+
+        f64 const frame_ms =
+            std::chrono::duration<f64, std::milli>(bench_end_time - bench_start_time).count() / FRAME_CNT;
+        f64 const latency_ms = (0 != completed_frame_cnt) ? (total_latency_ms / completed_frame_cnt) : 0.;
+
+        sbLogI("\t- {} frame(s) in flight: {:.3f} ms/frame ({:.1f} fps), latency {:.3f} ms, GPU lag {:.2f} frame(s)",
+               inflight_frame_cnt, frame_ms, 1000. / frame_ms, latency_ms, _frame_scheduler.getAverageGpuLag());
+    }
+
+    setInflightFrameCount(initial_inflight_frame_cnt);
+}
+
+void VulkanApp::benchmarkDepthPrepass()
+{
+    constexpr u32 WARMUP_FRAME_CNT = 60;
+    constexpr u32 FRAME_CNT = 600;
+
+    if (!_settings.depth_prepass || !_gpu_timestamps_supported)
+    {
+        sbLogW("Depth prepass benchmark skipped, it needs the depth prepass and GPU timestamps");
+        return;
+    }
+
+    b8 const initial_depth_prepass = isDepthPrepassEnabled();
+
+    sbLogI("Depth prepass benchmark ({} frames):", FRAME_CNT);
+
+    for (b8 const depth_prepass : {false, true})
+    {
+        setDepthPrepass(depth_prepass);
+
+        for (u32 frame_idx = 0; frame_idx != WARMUP_FRAME_CNT; ++frame_idx)
+        {
+            render();
+            glfwPollEvents();
+        }
+
+        // the frames are timed as their slot is reused, the last frames in flight are left out
+        _gpu_frame_time_total_ms = 0.;
+        _gpu_timed_frame_cnt = 0;
+
+        for (u32 frame_idx = 0; frame_idx != FRAME_CNT; ++frame_idx)
+        {
+            render();
+            glfwPollEvents();
+        }
+
+        f64 const gpu_frame_ms = (0 != _gpu_timed_frame_cnt) ? (_gpu_frame_time_total_ms / _gpu_timed_frame_cnt) : 0.;
+
+        // off still goes through the render pass of the depth prepass, its first subpass is left empty
+        sbLogI("\t- depth prepass {}: GPU {:.3f} ms/frame over {} frames", depth_prepass ? "on" : "off (empty subpass)",
+               gpu_frame_ms, _gpu_timed_frame_cnt);
+    }
+
+    setDepthPrepass(initial_depth_prepass);
+}
+
+void VulkanApp::benchmarkInstanceTransforms()
+{
+    constexpr u32 ITERATION_CNT = 100;
+
+    using Clock = std::chrono::high_resolution_clock;
+
+    u32 const instance_cnt = _settings.instance_cnt;
+
+    // the benchmark writes to the instance buffer of the current frame slot
+    vkDeviceWaitIdle(_vk_device);
+
+    glm::mat4 projection = glm::perspective(glm::radians(45.f), 16.f / 9.f, 0.1f, _instances.extent);
+    projection[1][1] *= -1.f;
+    glm::mat4 const view_proj = projection * getInstancedView(0.f);
+
+    sbLogI("Instance transforms benchmark ({} instances, {} transform kernel, {} culling kernel, {} iterations):",
+           instance_cnt, getTransformKernelName(), getCullingKernelName(), ITERATION_CNT);
+
+    glm::mat4 * transforms = _frames[_current_frame].instance_transforms;
+
+    // the instance buffers are device local with the GPU culling, the CPU path then writes to a scratch array
+    // one more matrix leaves room to align it like a mapped buffer for the non temporal stores
+    DArray<glm::mat4> scratch_transforms;
+    if (nullptr == transforms)
+    {
+        scratch_transforms.resize(instance_cnt + 1);
+        uintptr_t const scratch_addr = reinterpret_cast<uintptr_t>(scratch_transforms.data());
+        transforms = reinterpret_cast<glm::mat4 *>((scratch_addr + 63) & ~uintptr_t(63));
+    }
+
+    for (b8 frustum_culling : {false, true})
+    {
+        f64 single_thread_ns = 0.;
+
+        for (b8 use_job_system : {false, true})
+        {
+            u32 drawn_instance_cnt = 0;
+
+            auto const start_time = Clock::now();
+
+            for (u32 iter_idx = 0; iter_idx != ITERATION_CNT; ++iter_idx)
+            {
+                drawn_instance_cnt = updateInstanceTransforms(iter_idx * 0.01f, view_proj, instance_cnt,
+                                                              frustum_culling, false, transforms, use_job_system);
+            }
+
+            f64 const total_ns = std::chrono::duration<f64, std::nano>(Clock::now() - start_time).count();
+            f64 const instance_ns = total_ns / ((f64)ITERATION_CNT * instance_cnt);
+            if (!use_job_system)
+            {
+                single_thread_ns = instance_ns;
+            }
+
+            sbLogI("\t- {}, {}: {:.2f} ns/instance, {:.3f} ms/frame (x{:.2f}), {} instances drawn",
+                   frustum_culling ? "culling" : "no culling", use_job_system ? "job system" : "single thread",
+                   instance_ns, total_ns / (ITERATION_CNT * 1'000'000.), single_thread_ns / instance_ns,
+                   drawn_instance_cnt);
+        }
+    }
+
+    if (_occlusion_rasterizer.isInitialized())
+    {
+        sbLogI("\t- software occlusion culling, {} kernel, {} occluders at {}x{}:", getOcclusionKernelName(),
+               OCCLUDER_COUNT, OcclusionRasterizer::WIDTH, OcclusionRasterizer::HEIGHT);
+
+        for (b8 use_job_system : {false, true})
+        {
+            u32 drawn_instance_cnt = 0;
+            u32 occlusion_culled_cnt = 0;
+
+            // the occluders are picked by the previous update
+            updateInstanceTransforms(0.f, view_proj, instance_cnt, true, true, transforms, use_job_system);
+
+            auto const start_time = Clock::now();
+
+            for (u32 iter_idx = 0; iter_idx != ITERATION_CNT; ++iter_idx)
+            {
+                drawn_instance_cnt = updateInstanceTransforms(iter_idx * 0.01f, view_proj, instance_cnt, true, true,
+                                                              transforms, use_job_system, &occlusion_culled_cnt);
+            }
+
+            f64 const total_ms = std::chrono::duration<f64, std::milli>(Clock::now() - start_time).count();
+            sbLogI("\t\t- {}: {:.3f} ms/frame, {} instances occlusion culled, {} instances drawn",
+                   use_job_system ? "job system" : "single thread", total_ms / ITERATION_CNT, occlusion_culled_cnt,
+                   drawn_instance_cnt);
+        }
+    }
+
+    FrustumPlanes frustum_planes;
+    extractFrustumPlanes(&view_proj[0][0], frustum_planes);
+
+    u32 const group_cnt = (instance_cnt + INSTANCE_TRANSFORM_GROUP_SIZE - 1) / INSTANCE_TRANSFORM_GROUP_SIZE;
+
+    auto const start_time = Clock::now();
+
+    for (u32 iter_idx = 0; iter_idx != ITERATION_CNT; ++iter_idx)
+    {
+        _job_system.parallelFor(group_cnt, INSTANCE_TRANSFORM_BATCH_GROUP_CNT, [&](u32 group_begin, u32 group_end) {
+            u32 const first = group_begin * INSTANCE_TRANSFORM_GROUP_SIZE;
+            u32 const last = sbstd::min(group_end * INSTANCE_TRANSFORM_GROUP_SIZE, instance_cnt);
+            cullBoundingSpheres(_instance_bounds, frustum_planes, first, last, _visible_instances.data() + first);
+        });
+    }
+
+    f64 const cull_ms = std::chrono::duration<f64, std::milli>(Clock::now() - start_time).count() / ITERATION_CNT;
+    sbLogI("\t- culling only, job system: {:.3f} ms/frame", cull_ms);
+}
+
+void VulkanApp::benchmarkPresentModes()
+{
+    constexpr u32 WARMUP_FRAME_CNT = 60;
+    constexpr u32 FRAME_CNT = 300;
+    constexpr u64 PRESENT_WAIT_TIMEOUT_NS = 1'000'000'000;
+
+    using Clock = std::chrono::high_resolution_clock;
+
+    struct PendingFrame
+    {
+        u64 present_id;
+        Clock::time_point sample_time;
+    };
+
+    struct PresentModeDesc
+    {
+        VkPresentModeKHR mode;
+        b8 tearing;
+    };
+
+    // FIFO_RELAXED tears when a frame misses the vertical blank
+    PresentModeDesc const present_modes[] = {{VK_PRESENT_MODE_IMMEDIATE_KHR, true},
+                                             {VK_PRESENT_MODE_MAILBOX_KHR, false},
+                                             {VK_PRESENT_MODE_FIFO_KHR, false},
+                                             {VK_PRESENT_MODE_FIFO_RELAXED_KHR, true}};
+
+    VkPresentModeKHR const initial_present_mode = _next_frame.present_mode;
+    b8 const initial_pacing = _next_frame.low_latency_pacing;
+
+    // without VK_KHR_present_wait the latency stops at the GPU completion of the frame
+    sbLogI("Present modes benchmark ({} frames, {} swapchain images, latency from input sample to {}):", FRAME_CNT,
+           getSwapchainImageCount(), _present_wait_supported ? "present" : "GPU completion");
+
+    VkPresentModeKHR best_mode = VK_PRESENT_MODE_FIFO_KHR;
+    b8 best_pacing = false;
+    f64 best_latency_ms = 0.;
+
+    for (auto const & present_mode_desc : present_modes)
+    {
+        if (end(_vk_supported_present_modes) == sbstd::find(begin(_vk_supported_present_modes),
+                                                            end(_vk_supported_present_modes), present_mode_desc.mode))
+        {
+            sbLogI("\t- {}: not supported", getVkPresentModeName(present_mode_desc.mode));
+            continue;
+        }
+
+        setPresentMode(present_mode_desc.mode);
+
+        for (b8 const pacing : {false, true})
+        {
+            setLowLatencyPacing(pacing);
+
+            for (u32 frame_idx = 0; frame_idx != WARMUP_FRAME_CNT; ++frame_idx)
+            {
+                render();
+                glfwPollEvents();
+            }
+
+            DArray<PendingFrame> pending_frames;
+            pending_frames.reserve(FRAME_CNT);
+            usize completed_frame_cnt = 0;
+            f64 total_latency_ms = 0.;
+
+            // a frame is observed as presented at the first poll following the present, precise to a frame
+            auto const isFrameDone = [this](u64 frame_value, u64 timeout_ns) {
+                if (_present_wait_supported)
+                {
+                    return VK_SUCCESS == _vk_wait_for_present(_vk_device, _vk_swapchain, frame_value, timeout_ns);
+                }
+
+                return (0 == timeout_ns) ? (_frame_scheduler.getCompletedValue() >= frame_value)
+                                         : _frame_scheduler.waitForValue(frame_value);
+            };
+
+            auto const gatherCompletedFrames = [&](u64 timeout_ns) {
+                while ((completed_frame_cnt != pending_frames.size()) &&
+                       isFrameDone(pending_frames[completed_frame_cnt].present_id, timeout_ns))
+                {
+                    auto const sample_time = pending_frames[completed_frame_cnt].sample_time;
+                    total_latency_ms += std::chrono::duration<f64, std::milli>(Clock::now() - sample_time).count();
+                    ++completed_frame_cnt;
+                }
+            };
+
+            auto const bench_start_time = Clock::now();
+
+            for (u32 frame_idx = 0; frame_idx != FRAME_CNT; ++frame_idx)
+            {
+                u64 const submitted_value = _frame_scheduler.getSubmittedValue();
+
+                // a frame which only recreated the swapchain presents nothing, its present id goes to the next one
+                if (render() && (_frame_scheduler.getSubmittedValue() != submitted_value))
+                {
+                    pending_frames.push_back({_frame_scheduler.getSubmittedValue(), _input_sample_time});
+                }
+
+                gatherCompletedFrames(0);
+                glfwPollEvents();
+            }
+
+            auto const bench_end_time = Clock::now();
+
+            gatherCompletedFrames(PRESENT_WAIT_TIMEOUT_NS);
+
+            f64 const frame_ms =
+                std::chrono::duration<f64, std::milli>(bench_end_time - bench_start_time).count() / FRAME_CNT;
+            f64 const latency_ms = (0 != completed_frame_cnt) ? (total_latency_ms / completed_frame_cnt) : 0.;
+
+            sbLogI("\t- {}{}: {:.3f} ms/frame ({:.1f} fps), latency {:.3f} ms{}",
+                   getVkPresentModeName(present_mode_desc.mode), pacing ? " + pacing" : "", frame_ms, 1000. / frame_ms,
+                   latency_ms, present_mode_desc.tearing ? " (tearing)" : "");
+
+            if (!present_mode_desc.tearing && (0 != completed_frame_cnt) &&
+                ((0. == best_latency_ms) || (latency_ms < best_latency_ms)))
+            {
+                best_mode = present_mode_desc.mode;
+                best_pacing = pacing;
+                best_latency_ms = latency_ms;
+            }
+        }
+    }
 
-    _current_frame = (_current_frame + 1) % MAX_INFLIGHT_FRAMES;
+    sbLogI("Lowest latency present mode without tearing: {}{}", getVkPresentModeName(best_mode),
+           best_pacing ? " with low latency pacing" : "");
 
-    return true;
+    setPresentMode(initial_present_mode);
+    setLowLatencyPacing(initial_pacing);
 }
 
 b8 VulkanApp::loadModel()
 {
-    char model_abs_path[sb::LOCAL_PATH_MAX_LEN];
-
-    getWorkingDirectory(model_abs_path);
-    concatLocalPath(model_abs_path, "viking_room.obj");
-
     {
-        auto file_content = VFS::readFile("/viking_room.png", GHEAP);
-
-        if (file_content.size() == 0)
-        {
-            sbLogE("Failed to load test texture content");
-            return false;
-        }
+        DecodedImage & decoded_img = _decoded_images[DECODED_MODEL_TEXTURE];
+        _job_system.wait(decoded_img.counter);
 
-        int width, height, channel_cnt;
-        auto const pixels = stbi_load_from_memory(file_content.data(), (int)file_content.size(), &width, &height,
-                                                  &channel_cnt, STBI_rgb_alpha);
-
-        GHEAP.deallocate(file_content.data());
-
-        _model.mip_cnt = getMipLevelCount(width, height);
+        auto const pixels = decoded_img.pixels;
+        int const width = decoded_img.width;
+        int const height = decoded_img.height;
 
         if (nullptr == pixels)
         {
@@ -1859,6 +5466,8 @@ b8 VulkanApp::loadModel()
             return false;
         }
 
+        _model.mip_cnt = getMipLevelCount(width, height);
+
         VkDeviceSize const image_size = width * height * 4;
 
         VkBufferMem staging_buffer = {};
@@ -1879,6 +5488,7 @@ b8 VulkanApp::loadModel()
         vkUnmapMemory(_vk_device, staging_buffer.memory);
 
         stbi_image_free(pixels);
+        decoded_img.pixels = nullptr;
 
         vk_res = createVkImage(_vk_phys_device, _vk_device, width, height, _model.mip_cnt, VK_SAMPLE_COUNT_1_BIT,
                                VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL,
@@ -1925,95 +5535,136 @@ b8 VulkanApp::loadModel()
     }
 
     {
-        tinyobj::attrib_t model_attrs;
-        std::vector<tinyobj::shape_t> model_shapes;
-        std::vector<tinyobj::material_t> model_materials;
-        std::string error_str;
+        _job_system.wait(_model_geometry.counter);
+
+        DArray<glm::vec3> const & positions = _model_geometry.positions;
+        DArray<u32> const & indices = _model_geometry.indices;
 
-        if (!tinyobj::LoadObj(&model_attrs, &model_shapes, &model_materials, &error_str,
-                              sbstd::data(model_abs_path)))
+        if (indices.empty())
         {
-            sbLogE("Failed to load demo model : '{}'", error_str.c_str());
             return false;
         }
 
-        DArray<Vertex> vertices;
-        DArray<u32> indices;
+        _model.bounds = _model_geometry.bounds;
+        sbstd::copy(sbstd::begin(_model_geometry.lods), sbstd::end(_model_geometry.lods), _model.lods);
+        _model.lod_cnt = _model_geometry.lod_cnt;
 
-        sbAssert(model_shapes.size() == 1);
-
-        vertices.resize(model_attrs.vertices.size());
-        for (auto const & idx : model_shapes.front().mesh.indices)
+        for (u32 lod_idx = 1; lod_idx != _model.lod_cnt; ++lod_idx)
         {
-            Vertex & curr_vert = vertices[idx.vertex_index];
-            curr_vert.position = {
-                model_attrs.vertices[3 * idx.vertex_index + 0],
-                model_attrs.vertices[3 * idx.vertex_index + 1],
-                model_attrs.vertices[3 * idx.vertex_index + 2],
-            };
-
-            curr_vert.tex_coords = {model_attrs.texcoords[2 * idx.texcoord_index + 0],
-                                    1.f - model_attrs.texcoords[2 * idx.texcoord_index + 1]};
-
-            curr_vert.color = {1.f, 1.f, 1.f};
-
-            indices.push_back(idx.vertex_index);
+            MeshLod const & lod = _model.lods[lod_idx];
+            sbLogI("Model level of detail {}: {} triangle(s), error {:.4f}", lod_idx, lod.index_cnt / 3, lod.error);
         }
 
-        _model.idx_cnt = indices.size();
-        _model.vtx_cnt = vertices.size();
-
+        if (!_geometry_arena.addMesh(_vk_graphics_cmd_pool, _vk_graphics_queue, VERTEX_FORMAT_PACKED,
+                                     &positions.data()->x, _model_geometry.attributes.data(),
+                                     numericConv<u32>(positions.size()), indices.data(),
+                                     numericConv<u32>(indices.size()), &_model.mesh))
         {
-            VkDeviceSize const ib_size = indices.size() * sizeof(u32);
+            return false;
+        }
 
-            VkBufferMem final_ib_mem;
-            auto vk_res = createVkBuffer(_vk_phys_device, _vk_device, ib_size,
-                                         VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
-                                         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &final_ib_mem);
+        if (_settings.meshlet_culling)
+        {
+            DArray<Meshlet> const & meshlets = _model_geometry.meshlets;
+            VkDeviceSize const meshlets_size = meshlets.size() * sizeof(Meshlet);
 
+            auto vk_res = createVkBuffer(_vk_phys_device, _vk_device, meshlets_size,
+                                         VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &_model.meshlets);
             if (VK_SUCCESS != vk_res)
             {
-                sbLogE("Failed to create Vulkan final model IB (error = '{}')", getEnumValue(vk_res));
+                sbLogE("Failed to create Vulkan model meshlets buffer (error = '{}')", getEnumValue(vk_res));
                 return false;
             }
 
-            _model.ib = final_ib_mem;
-
-            vk_res = uploadVkBufferDataToDevice(_vk_phys_device, _vk_device, (void *)sbstd::data(indices), ib_size,
-                                                _vk_graphics_cmd_pool, _vk_graphics_queue, _model.ib.buffer);
+            vk_res = uploadVkBufferDataToDevice(_vk_phys_device, _vk_device, (void *)sbstd::data(meshlets),
+                                                meshlets_size, _vk_graphics_cmd_pool, _vk_graphics_queue,
+                                                _model.meshlets.buffer);
             if (VK_SUCCESS != vk_res)
             {
-                sbLogE("Failed to upload Vulkan model data (error = '{}')", getEnumValue(vk_res));
+                sbLogE("Failed to upload Vulkan model meshlets (error = '{}')", getEnumValue(vk_res));
                 return false;
             }
+
+            _model.meshlet_cnt = numericConv<u32>(meshlets.size());
+            sbLogI("Model baked into {} meshlet(s) of {:.1f} triangle(s) on average", _model.meshlet_cnt,
+                   _model.lods[0].index_cnt / (3.f * _model.meshlet_cnt));
         }
 
+        if (_settings.software_occlusion_culling)
         {
-            VkDeviceSize const vb_size = vertices.size() * sizeof(Vertex);
+            // the occluders are drawn with the positions of the full model, the rasterizer resolution is what is low
+            OccluderMesh occluder_mesh;
+            occluder_mesh.positions.assign(&positions.data()->x, &positions.data()->x + positions.size() * 3);
+            occluder_mesh.indices.assign(begin(indices), begin(indices) + _model.lods[0].index_cnt);
 
-            VkBufferMem final_vb_mem;
-            auto vk_res = createVkBuffer(_vk_phys_device, _vk_device, vb_size,
-                                         VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-                                         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &final_vb_mem);
+            _occlusion_rasterizer.initialize(sbstd::move(occluder_mesh));
+        }
 
-            if (VK_SUCCESS != vk_res)
-            {
-                sbLogE("Failed to create Vulkan final model VB (error = '{}')", getEnumValue(vk_res));
-                return false;
-            }
+        _model_geometry.positions.clear();
+        _model_geometry.attributes.clear();
+        _model_geometry.indices.clear();
+        _model_geometry.meshlets.clear();
+    }
 
-            _model.vb = final_vb_mem;
+    return true;
+}
 
-            vk_res = uploadVkBufferDataToDevice(_vk_phys_device, _vk_device, (void *)sbstd::data(vertices), vb_size,
-                                                _vk_graphics_cmd_pool, _vk_graphics_queue, _model.vb.buffer);
-            if (VK_SUCCESS != vk_res)
-            {
-                sbLogE("Failed to upload Vulkan model data (error = '{}')", getEnumValue(vk_res));
-                return false;
-            }
-        }
+void VulkanApp::startModelGeometryLoad()
+{
+    _job_system.submit([this]() { loadModelGeometry(&_model_geometry); }, &_model_geometry.counter);
+}
+
+b8 VulkanApp::loadModelGeometry(ModelGeometry * geometry)
+{
+    sbAssert(nullptr != geometry);
+
+    char model_abs_path[sb::LOCAL_PATH_MAX_LEN];
+
+    getWorkingDirectory(model_abs_path);
+    concatLocalPath(model_abs_path, "viking_room.obj");
+
+    tinyobj::attrib_t model_attrs;
+    std::vector<tinyobj::shape_t> model_shapes;
+    std::vector<tinyobj::material_t> model_materials;
+    std::string error_str;
+
+    if (!tinyobj::LoadObj(&model_attrs, &model_shapes, &model_materials, &error_str, sbstd::data(model_abs_path)))
+    {
+        sbLogE("Failed to load demo model : '{}'", error_str.c_str());
+        return false;
+    }
+
+    DArray<glm::vec3> & positions = geometry->positions;
+    DArray<PackedVertexAttributes> & attributes = geometry->attributes;
+    DArray<u32> & indices = geometry->indices;
+
+    sbAssert(model_shapes.size() == 1);
+
+    u32 const vtx_cnt = numericConv<u32>(model_attrs.vertices.size() / 3);
+    positions.resize(vtx_cnt);
+    attributes.resize(vtx_cnt);
+    for (auto const & idx : model_shapes.front().mesh.indices)
+    {
+        positions[idx.vertex_index] = {
+            model_attrs.vertices[3 * idx.vertex_index + 0],
+            model_attrs.vertices[3 * idx.vertex_index + 1],
+            model_attrs.vertices[3 * idx.vertex_index + 2],
+        };
+
+        glm::vec2 const tex_coords = {model_attrs.texcoords[2 * idx.texcoord_index + 0],
+                                      1.f - model_attrs.texcoords[2 * idx.texcoord_index + 1]};
+        attributes[idx.vertex_index] = {glm::packUnorm4x8(glm::vec4(1.f)), glm::packHalf2x16(tex_coords)};
+
+        indices.push_back(idx.vertex_index);
     }
 
+    f32 const * const position_data = &positions.data()->x;
+    geometry->bounds = computeMeshBounds(position_data, vtx_cnt, sizeof(glm::vec3));
+    buildMeshlets(position_data, vtx_cnt, sizeof(glm::vec3), indices, geometry->meshlets);
+    // the coarser levels follow the meshlets of the full model in the same IB
+    geometry->lod_cnt = buildMeshLods(position_data, vtx_cnt, sizeof(glm::vec3), indices, geometry->lods);
+
     return true;
 }
 
@@ -2026,27 +5677,102 @@ void VulkanApp::unloadModel()
 
     destroyVkImage(_vk_device, _model.image);
 
-    destroyVkBuffer(_vk_device, _model.ib);
-    destroyVkBuffer(_vk_device, _model.vb);
+    _geometry_arena.removeMesh(_model.mesh);
+    destroyVkBuffer(_vk_device, _model.meshlets);
+
+    _occlusion_rasterizer.terminate();
+    _occluder_cnt = 0;
 
     _model = {};
 }
 
-b8 VulkanApp::loadTestTexture()
+b8 VulkanApp::createGpuInstances()
 {
-    auto file_content = VFS::readFile("/texture.jpg", GHEAP);
+    u32 const instance_cnt = _settings.instance_cnt;
+
+    DArray<GpuInstance> gpu_instances(instance_cnt);
+    for (u32 instance_idx = 0; instance_idx != instance_cnt; ++instance_idx)
+    {
+        GpuInstance & gpu_instance = gpu_instances[instance_idx];
+        gpu_instance.position_scale = {_instances.pos_x[instance_idx], _instances.pos_y[instance_idx],
+                                       _instances.pos_z[instance_idx], _instances.scale[instance_idx]};
+        gpu_instance.bounding_sphere = {_instance_bounds.center_x[instance_idx],
+                                        _instance_bounds.center_y[instance_idx],
+                                        _instance_bounds.center_z[instance_idx], _instance_bounds.radius[instance_idx]};
+        gpu_instance.phase = {_instances.phase_cos[instance_idx], _instances.phase_sin[instance_idx], 0.f, 0.f};
+    }
+
+    VkDeviceSize const buffer_size = gpu_instances.size() * sizeof(GpuInstance);
+
+    auto vk_res = createVkBuffer(_vk_phys_device, _vk_device, buffer_size,
+                                 VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &_vk_gpu_instances);
+    if (VK_SUCCESS != vk_res)
+    {
+        sbLogE("Failed to create Vulkan GPU instance buffer (error = '{}')", getEnumValue(vk_res));
+        return false;
+    }
+
+    vk_res = uploadVkBufferDataToDevice(_vk_phys_device, _vk_device, (void *)sbstd::data(gpu_instances), buffer_size,
+                                        _vk_graphics_cmd_pool, _vk_graphics_queue, _vk_gpu_instances.buffer);
+    if (VK_SUCCESS != vk_res)
+    {
+        sbLogE("Failed to upload Vulkan GPU instances (error = '{}')", getEnumValue(vk_res));
+        return false;
+    }
 
-    if (file_content.size() == 0)
+    if (!_settings.occlusion_culling)
     {
-        sbLogE("Failed to load test texture content");
+        return true;
+    }
+
+    // nothing is visible before the first frame, the late phase of the first frame draws every visible instance
+    DArray<u32> const visibility(instance_cnt, 0);
+    VkDeviceSize const visibility_size = visibility.size() * sizeof(u32);
+
+    vk_res = createVkBuffer(_vk_phys_device, _vk_device, visibility_size,
+                            VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &_vk_instance_visibility);
+    if (VK_SUCCESS != vk_res)
+    {
+        sbLogE("Failed to create Vulkan instance visibility buffer (error = '{}')", getEnumValue(vk_res));
+        return false;
+    }
+
+    vk_res = uploadVkBufferDataToDevice(_vk_phys_device, _vk_device, (void *)sbstd::data(visibility), visibility_size,
+                                        _vk_graphics_cmd_pool, _vk_graphics_queue, _vk_instance_visibility.buffer);
+    if (VK_SUCCESS != vk_res)
+    {
+        sbLogE("Failed to upload Vulkan instance visibility (error = '{}')", getEnumValue(vk_res));
         return false;
     }
 
-    int width, height, channel_cnt;
-    auto const pixels = stbi_load_from_memory(file_content.data(), (int)file_content.size(), &width, &height,
-                                              &channel_cnt, STBI_rgb_alpha);
+    return true;
+}
+
+void VulkanApp::destroyGpuInstances()
+{
+    if (VK_NULL_HANDLE != _vk_gpu_instances.buffer)
+    {
+        destroyVkBuffer(_vk_device, _vk_gpu_instances);
+        _vk_gpu_instances = {};
+    }
+
+    if (VK_NULL_HANDLE != _vk_instance_visibility.buffer)
+    {
+        destroyVkBuffer(_vk_device, _vk_instance_visibility);
+        _vk_instance_visibility = {};
+    }
+}
+
+b8 VulkanApp::loadTestTexture()
+{
+    DecodedImage & decoded_img = _decoded_images[DECODED_TEST_TEXTURE];
+    _job_system.wait(decoded_img.counter);
 
-    GHEAP.deallocate(file_content.data());
+    auto const pixels = decoded_img.pixels;
+    int const width = decoded_img.width;
+    int const height = decoded_img.height;
 
     if (nullptr == pixels)
     {
@@ -2074,6 +5800,7 @@ b8 VulkanApp::loadTestTexture()
     vkUnmapMemory(_vk_device, staging_buffer.memory);
 
     stbi_image_free(pixels);
+    decoded_img.pixels = nullptr;
 
     vk_res =
         createVkImage(_vk_phys_device, _vk_device, width, height, 1, VK_SAMPLE_COUNT_1_BIT, VK_FORMAT_R8G8B8A8_SRGB,
@@ -2139,10 +5866,16 @@ b8 VulkanApp::createDepthImage()
         return false;
     }
 
-    VkResult vk_res = createVkImage(_vk_phys_device, _vk_device, _vk_swapchain_ext.width, _vk_swapchain_ext.height, 1,
-                                    _vk_sample_count, _vk_depth_fmt, VK_IMAGE_TILING_OPTIMAL,
-                                    VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-                                    &_vk_depth_image);
+    // the depth pyramid is built from the depth of the early render pass
+    VkImageUsageFlags depth_usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+    if (_settings.occlusion_culling)
+    {
+        depth_usage |= VK_IMAGE_USAGE_SAMPLED_BIT;
+    }
+
+    VkResult vk_res = createVkImage(_vk_phys_device, _vk_device, _vk_attachment_ext.width, _vk_attachment_ext.height, 1,
+                                    _vk_sample_count, _vk_depth_fmt, VK_IMAGE_TILING_OPTIMAL, depth_usage,
+                                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &_vk_depth_image);
     if (VK_SUCCESS != vk_res)
     {
         sbLogE("Failed to create depth buffer image (error = '{}')", getEnumValue(vk_res));
@@ -2169,6 +5902,16 @@ b8 VulkanApp::createDepthImage()
     return true;
 }
 
+b8 VulkanApp::createDepthPyramid()
+{
+    if (!_settings.occlusion_culling)
+    {
+        return true;
+    }
+
+    return _depth_pyramid.create(_vk_depth_image_view, _vk_attachment_ext, _vk_sample_count);
+}
+
 void VulkanApp::destroyDepthImage()
 {
     if (_vk_depth_image_view != VK_NULL_HANDLE)
@@ -2183,9 +5926,15 @@ void VulkanApp::destroyDepthImage()
 
 b8 VulkanApp::createColorImage()
 {
-    VkResult vk_res = createVkImage(_vk_phys_device, _vk_device, _vk_swapchain_ext.width, _vk_swapchain_ext.height, 1,
-                                    _vk_sample_count, _vk_swapchain_fmt, VK_IMAGE_TILING_OPTIMAL,
-                                    VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+    // with the occlusion culling, the late render pass draws on top of what the early one stored
+    VkImageUsageFlags color_usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+    if (!_settings.occlusion_culling)
+    {
+        color_usage |= VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+    }
+
+    VkResult vk_res = createVkImage(_vk_phys_device, _vk_device, _vk_attachment_ext.width, _vk_attachment_ext.height, 1,
+                                    _vk_sample_count, _vk_swapchain_fmt, VK_IMAGE_TILING_OPTIMAL, color_usage,
                                     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &_vk_color_image);
     if (VK_SUCCESS != vk_res)
     {
@@ -2238,7 +5987,244 @@ static void glfwFrameBufferResized(GLFWwindow * wnd, int width, int height)
     sample_app->notifyTargetFrameBufferResized({(u32)width, (u32)height});
 }
 
-int main()
+static void glfwWindowRefreshed(GLFWwindow * wnd)
+{
+    VulkanApp * sample_app = (VulkanApp *)glfwGetWindowUserPointer(wnd);
+    sbAssert(nullptr != sample_app);
+    sample_app->requestRedraw();
+}
+
+static void glfwKeyPressed(GLFWwindow * wnd, int key, int /*scancode*/, int action, int /*mods*/)
+{
+    if (GLFW_PRESS != action)
+    {
+        return;
+    }
+
+    VulkanApp * sample_app = (VulkanApp *)glfwGetWindowUserPointer(wnd);
+    sbAssert(nullptr != sample_app);
+
+    switch (key)
+    {
+        case GLFW_KEY_P:
+        {
+            sample_app->cyclePresentMode();
+            break;
+        }
+        case GLFW_KEY_SPACE:
+        {
+            sample_app->setAnimationEnabled(!sample_app->isAnimationEnabled());
+            break;
+        }
+        case GLFW_KEY_I:
+        {
+            // both modes sample the model texture so the descriptors stay valid
+            VulkanApp::DemoMode const demo_mode = sample_app->getDemoMode();
+            if ((VulkanApp::DemoMode::MODEL == demo_mode) || (VulkanApp::DemoMode::INSTANCED == demo_mode))
+            {
+                sample_app->setDemoMode((VulkanApp::DemoMode::MODEL == demo_mode) ? VulkanApp::DemoMode::INSTANCED
+                                                                                 : VulkanApp::DemoMode::MODEL);
+            }
+            break;
+        }
+        case GLFW_KEY_C:
+        {
+            sample_app->setFrustumCulling(!sample_app->isFrustumCullingEnabled());
+            sbLogI("Frustum culling {}", sample_app->isFrustumCullingEnabled() ? "enabled" : "disabled");
+            break;
+        }
+        case GLFW_KEY_O:
+        {
+            // the counts are the ones of the last frame culled before the toggle
+            VulkanApp::CullingStats const stats = sample_app->getCullingStats();
+            sample_app->setOcclusionCulling(!sample_app->isOcclusionCullingEnabled());
+            sbLogI("Occlusion culling {} ({} instance(s): {} frustum culled, {} occlusion culled, {} drawn, {} "
+                   "triangle(s))",
+                   sample_app->isOcclusionCullingEnabled() ? "enabled" : "disabled", stats.instance_cnt,
+                   stats.frustum_culled_cnt, stats.occlusion_culled_cnt, stats.drawn_cnt, stats.drawn_triangle_cnt);
+            break;
+        }
+        case GLFW_KEY_L:
+        {
+            sample_app->setLowLatencyPacing(!sample_app->isLowLatencyPacingEnabled());
+            sbLogI("Low latency pacing {}", sample_app->isLowLatencyPacingEnabled() ? "enabled" : "disabled");
+            break;
+        }
+        case GLFW_KEY_Z:
+        {
+            sample_app->setDepthPrepass(!sample_app->isDepthPrepassEnabled());
+            sbLogI("Depth prepass {}", sample_app->isDepthPrepassEnabled() ? "enabled" : "disabled");
+            break;
+        }
+        case GLFW_KEY_KP_ADD:
+        case GLFW_KEY_EQUAL:
+        {
+            sample_app->setSwapchainImageCount(sample_app->getSwapchainImageCount() + 1);
+            break;
+        }
+        case GLFW_KEY_KP_SUBTRACT:
+        case GLFW_KEY_MINUS:
+        {
+            // the swapchain clamps it to the minimum image count of the surface
+            sample_app->setSwapchainImageCount(sbstd::max(sample_app->getSwapchainImageCount(), 2U) - 1);
+            break;
+        }
+        default:
+        {
+            break;
+        }
+    }
+}
+
+enum class Benchmark
+{
+    NONE,
+    RECORDING,
+    INFLIGHT_FRAMES,
+    PRESENT_MODES,
+    INSTANCE_TRANSFORMS,
+    DEPTH_PREPASS
+};
+
+static VulkanApp::Settings parseSettings(int argc, char ** argv, VulkanApp::DemoMode & demo_mode,
+                                         Benchmark & benchmark)
+{
+    VulkanApp::Settings settings = {};
+    demo_mode = VulkanApp::DemoMode::MODEL;
+    benchmark = Benchmark::NONE;
+
+    for (int arg_idx = 1; arg_idx < argc; ++arg_idx)
+    {
+        std::string_view const arg = argv[arg_idx];
+        std::string_view const record_threads_opt = "--record-threads=";
+        std::string_view const inflight_frames_opt = "--inflight-frames=";
+        std::string_view const present_mode_opt = "--present-mode=";
+        std::string_view const swapchain_imgs_opt = "--swapchain-images=";
+        std::string_view const instances_opt = "--instances=";
+
+        if (arg.starts_with(record_threads_opt))
+        {
+            settings.recording_thread_cnt = (u32)sbstd::max(1, atoi(argv[arg_idx] + record_threads_opt.size()));
+        }
+        else if (arg.starts_with(inflight_frames_opt))
+        {
+            settings.inflight_frame_cnt = (u32)sbstd::max(1, atoi(argv[arg_idx] + inflight_frames_opt.size()));
+        }
+        else if (arg.starts_with(present_mode_opt))
+        {
+            std::string_view const mode_name = arg.substr(present_mode_opt.size());
+
+            VkPresentModeKHR const present_modes[] = {VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_MAILBOX_KHR,
+                                                      VK_PRESENT_MODE_FIFO_KHR, VK_PRESENT_MODE_FIFO_RELAXED_KHR};
+
+            auto const mode_iter = sbstd::find_if(begin(present_modes), end(present_modes), [mode_name](auto mode) {
+                return mode_name == getVkPresentModeName(mode);
+            });
+
+            if (mode_iter != end(present_modes))
+            {
+                settings.present_mode = *mode_iter;
+            }
+            else
+            {
+                sbLogW("Unknown present mode '{}'", mode_name);
+            }
+        }
+        else if (arg.starts_with(swapchain_imgs_opt))
+        {
+            settings.swapchain_img_cnt = (u32)sbstd::max(0, atoi(argv[arg_idx] + swapchain_imgs_opt.size()));
+        }
+        else if (arg.starts_with(instances_opt))
+        {
+            settings.instance_cnt = (u32)sbstd::max(1, atoi(argv[arg_idx] + instances_opt.size()));
+        }
+        else if ("--instanced" == arg)
+        {
+            demo_mode = VulkanApp::DemoMode::INSTANCED;
+        }
+        else if ("--low-latency" == arg)
+        {
+            settings.low_latency_pacing = true;
+        }
+        else if ("--on-demand" == arg)
+        {
+            settings.render_on_demand = true;
+        }
+        else if ("--no-animation" == arg)
+        {
+            settings.animate = false;
+        }
+        else if ("--render-thread" == arg)
+        {
+            settings.render_thread = true;
+        }
+        else if ("--present-thread" == arg)
+        {
+            settings.present_thread = true;
+        }
+        else if ("--no-culling" == arg)
+        {
+            settings.frustum_culling = false;
+        }
+        else if ("--gpu-culling" == arg)
+        {
+            settings.gpu_culling = true;
+        }
+        else if ("--occlusion-culling" == arg)
+        {
+            settings.occlusion_culling = true;
+        }
+        else if ("--software-occlusion-culling" == arg)
+        {
+            settings.software_occlusion_culling = true;
+        }
+        else if ("--meshlet-culling" == arg)
+        {
+            settings.meshlet_culling = true;
+        }
+        else if ("--lod-selection" == arg)
+        {
+            settings.lod_selection = true;
+        }
+        else if ("--depth-prepass" == arg)
+        {
+            settings.depth_prepass = true;
+        }
+        else if ("--no-cmd-reuse" == arg)
+        {
+            settings.reuse_cmd_buffers = false;
+        }
+        else if ("--benchmark=recording" == arg)
+        {
+            benchmark = Benchmark::RECORDING;
+        }
+        else if ("--benchmark=inflight" == arg)
+        {
+            benchmark = Benchmark::INFLIGHT_FRAMES;
+        }
+        else if ("--benchmark=present" == arg)
+        {
+            benchmark = Benchmark::PRESENT_MODES;
+        }
+        else if ("--benchmark=transforms" == arg)
+        {
+            benchmark = Benchmark::INSTANCE_TRANSFORMS;
+        }
+        else if ("--benchmark=prepass" == arg)
+        {
+            benchmark = Benchmark::DEPTH_PREPASS;
+            settings.depth_prepass = true;
+        }
+        else
+        {
+            sbLogW("Unknown command line argument '{}'", arg);
+        }
+    }
+
+    return settings;
+}
+
+int main(int argc, char ** argv)
 {
     char working_dir[LOCAL_PATH_MAX_LEN];
     getWorkingDirectory(working_dir);
@@ -2269,20 +6255,73 @@ int main()
         return EXIT_FAILURE;
     }
 
+    VulkanApp::DemoMode demo_mode = VulkanApp::DemoMode::MODEL;
+    Benchmark benchmark = Benchmark::NONE;
+    VulkanApp::Settings const app_settings = parseSettings(argc, argv, demo_mode, benchmark);
+
     VulkanApp sample_app;
 
     glfwSetFramebufferSizeCallback(wnd, &glfwFrameBufferResized);
+    glfwSetKeyCallback(wnd, &glfwKeyPressed);
+    glfwSetWindowRefreshCallback(wnd, &glfwWindowRefreshed);
     glfwSetWindowUserPointer(wnd, &sample_app);
 
-    if (sbDontExpect(!sample_app.initialize(true, wnd, VulkanApp::DemoMode::MODEL), "Failed to initialize sample app"))
+    if (sbDontExpect(!sample_app.initialize(true, wnd, demo_mode, app_settings),
+                     "Failed to initialize sample app"))
     {
         return EXIT_FAILURE;
     }
 
+    if (Benchmark::RECORDING == benchmark)
+    {
+        sample_app.benchmarkCommandRecording();
+    }
+    else if (Benchmark::INFLIGHT_FRAMES == benchmark)
+    {
+        sample_app.benchmarkInflightFrames();
+    }
+    else if (Benchmark::PRESENT_MODES == benchmark)
+    {
+        sample_app.benchmarkPresentModes();
+    }
+    else if (Benchmark::INSTANCE_TRANSFORMS == benchmark)
+    {
+        sample_app.benchmarkInstanceTransforms();
+    }
+    else if (Benchmark::DEPTH_PREPASS == benchmark)
+    {
+        sample_app.benchmarkDepthPrepass();
+    }
+
+    if (app_settings.present_thread)
+    {
+        sample_app.startPresentThread();
+    }
+
+    if (app_settings.render_thread)
+    {
+        sample_app.startRenderThread();
+    }
+
+    // wakes up now and then while idle even if no event is received
+    constexpr f64 IDLE_WAIT_TIMEOUT_S = 0.5;
+
     while (!glfwWindowShouldClose(wnd))
     {
-        sample_app.render();
-        glfwPollEvents();
+        if (sample_app.isMinimized())
+        {
+            // the frame buffer resize callback is called once restored
+            glfwWaitEvents();
+        }
+        else if (sample_app.needsRedraw())
+        {
+            sample_app.update();
+            glfwPollEvents();
+        }
+        else
+        {
+            glfwWaitEventsTimeout(IDLE_WAIT_TIMEOUT_S);
+        }
     }
 
     sample_app.terminate();
@@ -0,0 +1,513 @@
+#include "mesh_simplifier.h"
+
+#include <sb_core/error/error.h>
+#include <sb_core/conversion.h>
+
+#include <sb_std/algorithm>
+#include <sb_std/utility>
+
+#include <glm/vec3.hpp>
+#include <glm/geometric.hpp>
+
+namespace {
+
+constexpr sb::u32 INVALID_INDEX = ~0U;
+
+// the planes of the border edges weigh as much as a triangle this many times the squared edge length, so that the
+// outline of the open parts wears away last
+constexpr sb::f32 BORDER_WEIGHT = 10.f;
+
+// collapses of a pass relative to its candidate edges, before the costs are evaluated again
+constexpr sb::f32 PASS_COLLAPSE_RATIO = 0.1f;
+
+// seam vertices sharing a position, a position with more of them is never collapsed
+constexpr sb::u32 MAX_POSITION_VERTEX_COUNT = 8;
+
+// Sum of the squared distances to weighted planes, the error of a point is the weighted average distance
+struct Quadric
+{
+    sb::f32 a2 = 0.f;
+    sb::f32 b2 = 0.f;
+    sb::f32 c2 = 0.f;
+    sb::f32 d2 = 0.f;
+    sb::f32 ab = 0.f;
+    sb::f32 ac = 0.f;
+    sb::f32 ad = 0.f;
+    sb::f32 bc = 0.f;
+    sb::f32 bd = 0.f;
+    sb::f32 cd = 0.f;
+    sb::f32 weight = 0.f;
+
+    // 'normal' is normalized, the points p of the plane verify dot(normal, p) + d = 0
+    void addPlane(glm::vec3 const & normal, sb::f32 d, sb::f32 plane_weight)
+    {
+        a2 += normal.x * normal.x * plane_weight;
+        b2 += normal.y * normal.y * plane_weight;
+        c2 += normal.z * normal.z * plane_weight;
+        d2 += d * d * plane_weight;
+        ab += normal.x * normal.y * plane_weight;
+        ac += normal.x * normal.z * plane_weight;
+        ad += normal.x * d * plane_weight;
+        bc += normal.y * normal.z * plane_weight;
+        bd += normal.y * d * plane_weight;
+        cd += normal.z * d * plane_weight;
+        weight += plane_weight;
+    }
+
+    void add(Quadric const & other)
+    {
+        a2 += other.a2;
+        b2 += other.b2;
+        c2 += other.c2;
+        d2 += other.d2;
+        ab += other.ab;
+        ac += other.ac;
+        ad += other.ad;
+        bc += other.bc;
+        bd += other.bd;
+        cd += other.cd;
+        weight += other.weight;
+    }
+
+    // squared distance
+    sb::f32 evaluate(glm::vec3 const & p) const
+    {
+        if (0.f == weight)
+        {
+            return 0.f;
+        }
+
+        sb::f32 const sum = a2 * p.x * p.x + b2 * p.y * p.y + c2 * p.z * p.z + d2 +
+                            2.f * (ab * p.x * p.y + ac * p.x * p.z + bc * p.y * p.z + ad * p.x + bd * p.y + cd * p.z);
+
+        return sbstd::max(sum / weight, 0.f);
+    }
+};
+
+// Edge between two positions collapsed into one of them
+struct Collapse
+{
+    sb::u32 src_position;
+    sb::u32 dst_position;
+    sb::f32 cost;
+};
+
+glm::vec3 getVertexPosition(sb::f32 const * positions, sb::u32 stride, sb::u32 vtx_idx)
+{
+    sb::f32 const * const position =
+        reinterpret_cast<sb::f32 const *>(reinterpret_cast<sb::u8 const *>(positions) + vtx_idx * stride);
+    return glm::vec3(position[0], position[1], position[2]);
+}
+
+sb::u64 getEdgeKey(sb::u32 position_0, sb::u32 position_1)
+{
+    return ((sb::u64)sbstd::min(position_0, position_1) << 32) | sbstd::max(position_0, position_1);
+}
+
+} // namespace
+
+sb::f32 sb::simplifyMesh(f32 const * positions, u32 vtx_cnt, u32 stride, DArray<u32> const & indices,
+                         u32 target_index_cnt, DArray<u32> & simplified_indices)
+{
+    sbAssert(0 == (indices.size() % 3));
+
+    simplified_indices = indices;
+
+    if (indices.size() <= target_index_cnt)
+    {
+        return 0.f;
+    }
+
+    auto const getPosition = [positions, stride](u32 vtx_idx) {
+        return getVertexPosition(positions, stride, vtx_idx);
+    };
+
+    u32 const tri_cnt = numericConv<u32>(indices.size() / 3);
+    u32 const target_tri_cnt = target_index_cnt / 3;
+
+    // the collapses work on positions, identified by their first vertex, the vertices of a position are remapped
+    // together
+    DArray<u32> position_ids(vtx_cnt);
+    DArray<u32> position_vertices(vtx_cnt); // vertices sorted by position
+    DArray<u32> first_position_vertices(vtx_cnt, 0U); // index in position_vertices, for the position ids only
+    DArray<u32> position_vertex_cnts(vtx_cnt, 0U);
+    {
+        for (u32 vtx_idx = 0; vtx_idx != vtx_cnt; ++vtx_idx)
+        {
+            position_vertices[vtx_idx] = vtx_idx;
+        }
+
+        auto const isPositionLess = [&getPosition](u32 lhs_idx, u32 rhs_idx) {
+            glm::vec3 const lhs = getPosition(lhs_idx);
+            glm::vec3 const rhs = getPosition(rhs_idx);
+            return (lhs.x != rhs.x) ? (lhs.x < rhs.x) : ((lhs.y != rhs.y) ? (lhs.y < rhs.y) : (lhs.z < rhs.z));
+        };
+
+        // the first vertex of a position comes first
+        sbstd::sort(begin(position_vertices), end(position_vertices), [&isPositionLess](u32 lhs_idx, u32 rhs_idx) {
+            return isPositionLess(lhs_idx, rhs_idx) || (!isPositionLess(rhs_idx, lhs_idx) && (lhs_idx < rhs_idx));
+        });
+
+        u32 position_id = INVALID_INDEX;
+        for (u32 sorted_idx = 0; sorted_idx != vtx_cnt; ++sorted_idx)
+        {
+            u32 const vtx_idx = position_vertices[sorted_idx];
+            if ((INVALID_INDEX == position_id) || isPositionLess(position_id, vtx_idx))
+            {
+                position_id = vtx_idx;
+                first_position_vertices[position_id] = sorted_idx;
+            }
+
+            position_ids[vtx_idx] = position_id;
+            ++position_vertex_cnts[position_id];
+        }
+    }
+
+    DArray<u32> tri_indices = indices;
+    DArray<b8> alive_tris(tri_cnt, true);
+    u32 alive_tri_cnt = tri_cnt;
+
+    auto const getTriPosition = [&](u32 tri_idx, u32 corner_idx) {
+        return position_ids[tri_indices[tri_idx * 3 + corner_idx]];
+    };
+
+    // triangles of each position, the ones of a collapsed position move to the position it collapsed into
+    DArray<DArray<u32>> position_tris(vtx_cnt);
+    DArray<Quadric> quadrics(vtx_cnt);
+
+    // sorted edges of every triangle, the border edges are the ones of a single triangle
+    DArray<u64> edge_keys;
+    edge_keys.reserve(tri_cnt * 3);
+
+    for (u32 tri_idx = 0; tri_idx != tri_cnt; ++tri_idx)
+    {
+        for (u32 corner_idx = 0; corner_idx != 3; ++corner_idx)
+        {
+            position_tris[getTriPosition(tri_idx, corner_idx)].push_back(tri_idx);
+            edge_keys.push_back(getEdgeKey(getTriPosition(tri_idx, corner_idx),
+                                           getTriPosition(tri_idx, (corner_idx + 1) % 3)));
+        }
+    }
+
+    sbstd::sort(begin(edge_keys), end(edge_keys));
+
+    for (u32 tri_idx = 0; tri_idx != tri_cnt; ++tri_idx)
+    {
+        glm::vec3 const corners[3] = {getPosition(tri_indices[tri_idx * 3]), getPosition(tri_indices[tri_idx * 3 + 1]),
+                                      getPosition(tri_indices[tri_idx * 3 + 2])};
+        glm::vec3 normal = glm::cross(corners[1] - corners[0], corners[2] - corners[0]);
+        f32 const double_area = glm::length(normal);
+
+        if (0.f == double_area)
+        {
+            continue;
+        }
+
+        normal = normal / double_area;
+
+        for (u32 corner_idx = 0; corner_idx != 3; ++corner_idx)
+        {
+            u32 const position = getTriPosition(tri_idx, corner_idx);
+            quadrics[position].addPlane(normal, -glm::dot(normal, corners[0]), double_area * 0.5f);
+
+            u32 const next_corner_idx = (corner_idx + 1) % 3;
+            u32 const next_position = getTriPosition(tri_idx, next_corner_idx);
+            u64 const edge_key = getEdgeKey(position, next_position);
+            auto const edge_range = sbstd::equal_range(begin(edge_keys), end(edge_keys), edge_key);
+
+            if (1 == (edge_range.second - edge_range.first))
+            {
+                glm::vec3 const edge = corners[next_corner_idx] - corners[corner_idx];
+                glm::vec3 const border_normal = glm::normalize(glm::cross(edge, normal));
+                f32 const border_d = -glm::dot(border_normal, corners[corner_idx]);
+                f32 const border_weight = glm::dot(edge, edge) * BORDER_WEIGHT;
+
+                quadrics[position].addPlane(border_normal, border_d, border_weight);
+                quadrics[next_position].addPlane(border_normal, border_d, border_weight);
+            }
+        }
+    }
+
+    // vertex of each vertex of the collapsed position, in the position it collapses into
+    u32 remap_src[MAX_POSITION_VERTEX_COUNT];
+    u32 remap_dst[MAX_POSITION_VERTEX_COUNT];
+    u32 remap_cnt = 0;
+
+    // every vertex of the source position has to be connected to a vertex of the destination, through the triangles
+    // removed by the collapse, and none of the triangles left can flip
+    auto const prepareCollapse = [&](u32 src_position, u32 dst_position) {
+        if (MAX_POSITION_VERTEX_COUNT < position_vertex_cnts[src_position])
+        {
+            return false;
+        }
+
+        remap_cnt = 0;
+        glm::vec3 const dst_pos = getPosition(dst_position);
+
+        for (u32 const tri_idx : position_tris[src_position])
+        {
+            if (!alive_tris[tri_idx])
+            {
+                continue;
+            }
+
+            u32 src_corner_idx = INVALID_INDEX;
+            u32 dst_corner_idx = INVALID_INDEX;
+            for (u32 corner_idx = 0; corner_idx != 3; ++corner_idx)
+            {
+                u32 const position = getTriPosition(tri_idx, corner_idx);
+                src_corner_idx = (src_position == position) ? corner_idx : src_corner_idx;
+                dst_corner_idx = (dst_position == position) ? corner_idx : dst_corner_idx;
+            }
+
+            if (INVALID_INDEX == dst_corner_idx)
+            {
+                // the triangle stays, with the destination position instead of the source one
+                glm::vec3 const corners[3] = {getPosition(tri_indices[tri_idx * 3]),
+                                              getPosition(tri_indices[tri_idx * 3 + 1]),
+                                              getPosition(tri_indices[tri_idx * 3 + 2])};
+                glm::vec3 moved_corners[3] = {corners[0], corners[1], corners[2]};
+                moved_corners[src_corner_idx] = dst_pos;
+
+                glm::vec3 const normal = glm::cross(corners[1] - corners[0], corners[2] - corners[0]);
+                glm::vec3 const moved_normal =
+                    glm::cross(moved_corners[1] - moved_corners[0], moved_corners[2] - moved_corners[0]);
+
+                if (glm::dot(normal, moved_normal) <= 0.f)
+                {
+                    return false;
+                }
+
+                continue;
+            }
+
+            u32 const src_vtx = tri_indices[tri_idx * 3 + src_corner_idx];
+            u32 const dst_vtx = tri_indices[tri_idx * 3 + dst_corner_idx];
+
+            u32 remap_idx = 0;
+            while ((remap_idx != remap_cnt) && (remap_src[remap_idx] != src_vtx))
+            {
+                ++remap_idx;
+            }
+
+            if (remap_idx == remap_cnt)
+            {
+                remap_src[remap_cnt] = src_vtx;
+                remap_dst[remap_cnt] = dst_vtx;
+                ++remap_cnt;
+            }
+            else if (remap_dst[remap_idx] != dst_vtx)
+            {
+                // the seam of the source vertex does not follow the edge
+                return false;
+            }
+        }
+
+        // the vertices of the source position which do not touch the edge would be left behind
+        for (u32 const tri_idx : position_tris[src_position])
+        {
+            if (!alive_tris[tri_idx])
+            {
+                continue;
+            }
+
+            for (u32 corner_idx = 0; corner_idx != 3; ++corner_idx)
+            {
+                u32 const vtx_idx = tri_indices[tri_idx * 3 + corner_idx];
+                if ((src_position == position_ids[vtx_idx]) &&
+                    (sbstd::find(remap_src, remap_src + remap_cnt, vtx_idx) == (remap_src + remap_cnt)))
+                {
+                    return false;
+                }
+            }
+        }
+
+        return 0 != remap_cnt;
+    };
+
+    auto const applyCollapse = [&](u32 src_position, u32 dst_position) {
+        DArray<u32> & dst_tris = position_tris[dst_position];
+
+        for (u32 const tri_idx : position_tris[src_position])
+        {
+            if (!alive_tris[tri_idx])
+            {
+                continue;
+            }
+
+            b8 touches_dst = false;
+            for (u32 corner_idx = 0; corner_idx != 3; ++corner_idx)
+            {
+                touches_dst = touches_dst || (dst_position == getTriPosition(tri_idx, corner_idx));
+            }
+
+            if (touches_dst)
+            {
+                alive_tris[tri_idx] = false;
+                --alive_tri_cnt;
+                continue;
+            }
+
+            for (u32 corner_idx = 0; corner_idx != 3; ++corner_idx)
+            {
+                u32 & vtx_idx = tri_indices[tri_idx * 3 + corner_idx];
+                for (u32 remap_idx = 0; remap_idx != remap_cnt; ++remap_idx)
+                {
+                    vtx_idx = (remap_src[remap_idx] == vtx_idx) ? remap_dst[remap_idx] : vtx_idx;
+                }
+            }
+
+            dst_tris.push_back(tri_idx);
+        }
+
+        position_tris[src_position].clear();
+        quadrics[dst_position].add(quadrics[src_position]);
+    };
+
+    // largest distance an original vertex of each position moved along the collapses
+    DArray<f32> position_errors(vtx_cnt, 0.f);
+    f32 max_error = 0.f;
+
+    DArray<Collapse> collapses;
+    DArray<b8> locked_positions(vtx_cnt, false);
+
+    while (alive_tri_cnt > target_tri_cnt)
+    {
+        // edges of the triangles left, each collapsed in the direction of least error
+        edge_keys.clear();
+        for (u32 tri_idx = 0; tri_idx != tri_cnt; ++tri_idx)
+        {
+            if (!alive_tris[tri_idx])
+            {
+                continue;
+            }
+
+            for (u32 corner_idx = 0; corner_idx != 3; ++corner_idx)
+            {
+                edge_keys.push_back(getEdgeKey(getTriPosition(tri_idx, corner_idx),
+                                               getTriPosition(tri_idx, (corner_idx + 1) % 3)));
+            }
+        }
+
+        sbstd::sort(begin(edge_keys), end(edge_keys));
+        edge_keys.erase(sbstd::unique(begin(edge_keys), end(edge_keys)), end(edge_keys));
+
+        collapses.clear();
+        for (u64 const edge_key : edge_keys)
+        {
+            u32 const position_0 = (u32)(edge_key >> 32);
+            u32 const position_1 = (u32)(edge_key & 0xFFFFFFFFU);
+
+            Quadric edge_quadric = quadrics[position_0];
+            edge_quadric.add(quadrics[position_1]);
+
+            f32 const cost_0_to_1 = edge_quadric.evaluate(getPosition(position_1));
+            f32 const cost_1_to_0 = edge_quadric.evaluate(getPosition(position_0));
+
+            collapses.push_back((cost_0_to_1 <= cost_1_to_0) ? Collapse{position_0, position_1, cost_0_to_1}
+                                                              : Collapse{position_1, position_0, cost_1_to_0});
+        }
+
+        sbstd::sort(begin(collapses), end(collapses),
+                    [](Collapse const & lhs, Collapse const & rhs) { return lhs.cost < rhs.cost; });
+
+        // the positions touched by a collapse wait for the next pass, whose costs include it
+        sbstd::fill(begin(locked_positions), end(locked_positions), false);
+
+        u32 const max_applied_cnt = sbstd::max(1U, (u32)(collapses.size() * PASS_COLLAPSE_RATIO));
+        u32 applied_cnt = 0;
+
+        for (Collapse const & collapse : collapses)
+        {
+            if ((applied_cnt == max_applied_cnt) || (alive_tri_cnt <= target_tri_cnt))
+            {
+                break;
+            }
+
+            if (locked_positions[collapse.src_position] || locked_positions[collapse.dst_position])
+            {
+                continue;
+            }
+
+            // the reverse direction may be valid when the cheapest one is not, the seams only collapse along
+            // themselves
+            u32 src_position = collapse.src_position;
+            u32 dst_position = collapse.dst_position;
+
+            if (!prepareCollapse(src_position, dst_position))
+            {
+                sbstd::swap(src_position, dst_position);
+
+                if (!prepareCollapse(src_position, dst_position))
+                {
+                    continue;
+                }
+            }
+
+            applyCollapse(src_position, dst_position);
+            locked_positions[src_position] = true;
+            locked_positions[dst_position] = true;
+
+            // the quadric cost only orders the collapses, it averages the distances to the planes instead of bounding
+            // them
+            f32 const collapse_error =
+                position_errors[src_position] + glm::length(getPosition(dst_position) - getPosition(src_position));
+            position_errors[dst_position] = sbstd::max(position_errors[dst_position], collapse_error);
+            max_error = sbstd::max(max_error, position_errors[dst_position]);
+            ++applied_cnt;
+        }
+
+        if (0 == applied_cnt)
+        {
+            break;
+        }
+    }
+
+    simplified_indices.clear();
+    simplified_indices.reserve(alive_tri_cnt * 3);
+
+    for (u32 tri_idx = 0; tri_idx != tri_cnt; ++tri_idx)
+    {
+        if (alive_tris[tri_idx])
+        {
+            simplified_indices.push_back(tri_indices[tri_idx * 3]);
+            simplified_indices.push_back(tri_indices[tri_idx * 3 + 1]);
+            simplified_indices.push_back(tri_indices[tri_idx * 3 + 2]);
+        }
+    }
+
+    return max_error;
+}
+
+sb::u32 sb::buildMeshLods(f32 const * positions, u32 vtx_cnt, u32 stride, DArray<u32> & indices,
+                          MeshLod (&lods)[MAX_MESH_LOD_COUNT])
+{
+    lods[0] = {0, numericConv<u32>(indices.size()), 0.f};
+    u32 lod_cnt = 1;
+
+    DArray<u32> prev_indices = indices;
+    DArray<u32> lod_indices;
+
+    for (; lod_cnt != MAX_MESH_LOD_COUNT; ++lod_cnt)
+    {
+        MeshLod const & prev_lod = lods[lod_cnt - 1];
+        u32 const target_index_cnt = (prev_lod.index_cnt / 6) * 3;
+
+        f32 const error = simplifyMesh(positions, vtx_cnt, stride, prev_indices, target_index_cnt, lod_indices);
+
+        if ((lod_indices.size() * 10) > (prev_lod.index_cnt * 9))
+        {
+            break;
+        }
+
+        // the errors of the successive simplifications add up
+        lods[lod_cnt] = {numericConv<u32>(indices.size()), numericConv<u32>(lod_indices.size()),
+                         prev_lod.error + error};
+
+        indices.insert(end(indices), begin(lod_indices), end(lod_indices));
+
+        prev_indices = sbstd::move(lod_indices);
+    }
+
+    return lod_cnt;
+}
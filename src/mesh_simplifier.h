@@ -0,0 +1,34 @@
+#pragma once
+
+#include <sb_core/core.h>
+#include <sb_core/container/dynamic_array.h>
+
+namespace sb {
+
+// Range of the index buffer of a mesh drawn at a level of detail, every level shares the vertices of the mesh
+struct MeshLod
+{
+    u32 first_index;
+    u32 index_cnt;
+    // object space bound of the distance between the level and the full resolution mesh, 0 for the first level
+    f32 error;
+};
+
+static constexpr u32 MAX_MESH_LOD_COUNT = 5;
+
+// Quadric error edge collapse of the triangles of 'indices' into 'simplified_indices', which only references the
+// existing vertices, until at most 'target_index_cnt' indices are left or no collapse is possible anymore
+// Vertices sharing a position, along UV seams, are collapsed together so that the seams stay closed
+// 'positions' points to the position of the first vertex, 'stride' is the vertex size in bytes
+// Returns the largest object space distance an original vertex moved along the collapses as the error of the
+// simplified triangles
+f32 simplifyMesh(f32 const * positions, u32 vtx_cnt, u32 stride, DArray<u32> const & indices, u32 target_index_cnt,
+                 DArray<u32> & simplified_indices);
+
+// Appends the coarser levels of the triangles of 'indices' to it, halving the triangle count at each level, and fills
+// 'lods' with the range of each level, the first one being the triangles of 'indices'
+// Stops early once a level cannot drop a tenth of the triangles of the previous one, returns the level count
+u32 buildMeshLods(f32 const * positions, u32 vtx_cnt, u32 stride, DArray<u32> & indices,
+                  MeshLod (&lods)[MAX_MESH_LOD_COUNT]);
+
+} // namespace sb
@@ -0,0 +1,363 @@
+#include "meshlets.h"
+
+#include <sb_core/error/error.h>
+#include <sb_core/conversion.h>
+
+#include <sb_std/algorithm>
+#include <sb_std/utility>
+
+#include <glm/geometric.hpp>
+
+#include <cmath>
+
+namespace {
+
+constexpr sb::u32 INVALID_INDEX = ~0U;
+
+// unconnected triangles searched for the closest one once a meshlet has no neighbour left, bounds the build cost
+constexpr sb::u32 DISJOINT_SEARCH_WINDOW = 512;
+
+// triangles whose normal is further than ~37 degrees from the average of the meshlet are left to another one, the
+// meshlets get smaller but their normal cone is narrow enough for the backface culling
+constexpr sb::f32 MIN_NORMAL_DP = 0.8f;
+
+// cost of the normal deviation in vertices, below one vertex so that it only breaks the ties between neighbours
+constexpr sb::f32 CONE_WEIGHT = 1.f;
+
+// below that cosine, the normals of the cluster spread over more than ~85 degrees and no viewpoint sees its back only
+constexpr sb::f32 MIN_CONE_SPREAD_COS = 0.1f;
+
+glm::vec3 getVertexPosition(sb::f32 const * positions, sb::u32 stride, sb::u32 vtx_idx)
+{
+    sb::f32 const * const position =
+        reinterpret_cast<sb::f32 const *>(reinterpret_cast<sb::u8 const *>(positions) + vtx_idx * stride);
+    return glm::vec3(position[0], position[1], position[2]);
+}
+
+// Sphere centered on the box of the vertices and cone of the normals of the meshlet triangles
+void computeMeshletBounds(sb::f32 const * positions, sb::u32 stride, sb::u32 const * indices, sb::Meshlet & meshlet)
+{
+    auto const getPosition = [positions, stride](sb::u32 vtx_idx) {
+        return getVertexPosition(positions, stride, vtx_idx);
+    };
+
+    sb::u32 const first_index = meshlet.first_index;
+    sb::u32 const last_index = first_index + meshlet.index_cnt;
+
+    glm::vec3 aabb_min = getPosition(indices[first_index]);
+    glm::vec3 aabb_max = aabb_min;
+
+    for (sb::u32 idx = first_index + 1; idx != last_index; ++idx)
+    {
+        glm::vec3 const position = getPosition(indices[idx]);
+        aabb_min = glm::min(aabb_min, position);
+        aabb_max = glm::max(aabb_max, position);
+    }
+
+    glm::vec3 const center = (aabb_min + aabb_max) * 0.5f;
+
+    sb::f32 max_dist_sqr = 0.f;
+    glm::vec3 normal_sum = glm::vec3(0.f);
+
+    for (sb::u32 idx = first_index; idx != last_index; idx += 3)
+    {
+        glm::vec3 const corners[3] = {getPosition(indices[idx]), getPosition(indices[idx + 1]),
+                                      getPosition(indices[idx + 2])};
+
+        for (glm::vec3 const & corner : corners)
+        {
+            max_dist_sqr = sbstd::max(max_dist_sqr, glm::dot(corner - center, corner - center));
+        }
+
+        // degenerate triangles are never rasterized so they do not widen the cone
+        glm::vec3 const normal = glm::cross(corners[1] - corners[0], corners[2] - corners[0]);
+        sb::f32 const normal_len = glm::length(normal);
+        if (0.f != normal_len)
+        {
+            normal_sum += normal / normal_len;
+        }
+    }
+
+    meshlet.center = center;
+    meshlet.radius = std::sqrt(max_dist_sqr);
+    meshlet.cone_apex = center;
+    meshlet.cone_cutoff = 1.f;
+    meshlet.cone_axis = glm::vec3(0.f);
+
+    sb::f32 const normal_sum_len = glm::length(normal_sum);
+    if (0.f == normal_sum_len)
+    {
+        return;
+    }
+
+    glm::vec3 const axis = normal_sum / normal_sum_len;
+
+    sb::f32 min_dp = 1.f;
+    for (sb::u32 idx = first_index; idx != last_index; idx += 3)
+    {
+        glm::vec3 const corner = getPosition(indices[idx]);
+        glm::vec3 const normal =
+            glm::cross(getPosition(indices[idx + 1]) - corner, getPosition(indices[idx + 2]) - corner);
+        sb::f32 const normal_len = glm::length(normal);
+        if (0.f != normal_len)
+        {
+            min_dp = sbstd::min(min_dp, glm::dot(normal / normal_len, axis));
+        }
+    }
+
+    if (min_dp <= MIN_CONE_SPREAD_COS)
+    {
+        return;
+    }
+
+    // the apex is moved back along the axis until it is behind the plane of every triangle, any viewpoint in the
+    // cone behind the apex then sees the back of all of them
+    sb::f32 max_t = 0.f;
+    for (sb::u32 idx = first_index; idx != last_index; idx += 3)
+    {
+        glm::vec3 const corner = getPosition(indices[idx]);
+        glm::vec3 const normal =
+            glm::cross(getPosition(indices[idx + 1]) - corner, getPosition(indices[idx + 2]) - corner);
+        sb::f32 const normal_len = glm::length(normal);
+        if (0.f == normal_len)
+        {
+            continue;
+        }
+
+        glm::vec3 const unit_normal = normal / normal_len;
+        // dot(unit_normal, axis) >= min_dp > 0
+        max_t = sbstd::max(max_t, glm::dot(center - corner, unit_normal) / glm::dot(axis, unit_normal));
+    }
+
+    meshlet.cone_apex = center - axis * max_t;
+    // the normals span acos(min_dp) around the axis, the views facing their back span 90 degrees less
+    meshlet.cone_cutoff = std::sqrt(1.f - min_dp * min_dp);
+    meshlet.cone_axis = axis;
+}
+
+} // namespace
+
+void sb::buildMeshlets(f32 const * positions, u32 vtx_cnt, u32 stride, DArray<u32> & indices,
+                       DArray<Meshlet> & meshlets)
+{
+    sbAssert(0 == (indices.size() % 3));
+
+    meshlets.clear();
+
+    u32 const tri_cnt = numericConv<u32>(indices.size() / 3);
+    if (0 == tri_cnt)
+    {
+        return;
+    }
+
+    // vertices split along UV seams share their position, the triangles are neighbours through the position
+    // position_ids[v] is the first vertex with the position of v
+    DArray<u32> position_ids(vtx_cnt);
+    {
+        DArray<u32> sorted_vertices(vtx_cnt);
+        for (u32 vtx_idx = 0; vtx_idx != vtx_cnt; ++vtx_idx)
+        {
+            sorted_vertices[vtx_idx] = vtx_idx;
+        }
+
+        auto const isPositionLess = [positions, stride](u32 lhs_idx, u32 rhs_idx) {
+            glm::vec3 const lhs = getVertexPosition(positions, stride, lhs_idx);
+            glm::vec3 const rhs = getVertexPosition(positions, stride, rhs_idx);
+            return (lhs.x != rhs.x) ? (lhs.x < rhs.x) : ((lhs.y != rhs.y) ? (lhs.y < rhs.y) : (lhs.z < rhs.z));
+        };
+
+        // the first vertex of a position comes first
+        sbstd::sort(begin(sorted_vertices), end(sorted_vertices), [&isPositionLess](u32 lhs_idx, u32 rhs_idx) {
+            return isPositionLess(lhs_idx, rhs_idx) || (!isPositionLess(rhs_idx, lhs_idx) && (lhs_idx < rhs_idx));
+        });
+
+        u32 position_id = INVALID_INDEX;
+        for (u32 const vtx_idx : sorted_vertices)
+        {
+            if ((INVALID_INDEX == position_id) || isPositionLess(position_id, vtx_idx))
+            {
+                position_id = vtx_idx;
+            }
+
+            position_ids[vtx_idx] = position_id;
+        }
+    }
+
+    // triangles of each position, first_adj_tris[p] to first_adj_tris[p + 1] in adj_tris
+    DArray<u32> first_adj_tris(vtx_cnt + 1, 0U);
+    for (u32 const vtx_idx : indices)
+    {
+        ++first_adj_tris[position_ids[vtx_idx] + 1];
+    }
+
+    for (u32 vtx_idx = 0; vtx_idx != vtx_cnt; ++vtx_idx)
+    {
+        first_adj_tris[vtx_idx + 1] += first_adj_tris[vtx_idx];
+    }
+
+    DArray<u32> adj_tris(indices.size());
+    {
+        DArray<u32> adj_tri_cnts(vtx_cnt, 0U);
+        for (u32 idx = 0; idx != indices.size(); ++idx)
+        {
+            u32 const position_id = position_ids[indices[idx]];
+            adj_tris[first_adj_tris[position_id] + adj_tri_cnts[position_id]++] = idx / 3;
+        }
+    }
+
+    // unit normal and centroid of each triangle, a zero normal for the degenerate ones
+    DArray<glm::vec3> tri_normals(tri_cnt);
+    DArray<glm::vec3> tri_centroids(tri_cnt);
+    for (u32 tri_idx = 0; tri_idx != tri_cnt; ++tri_idx)
+    {
+        glm::vec3 const corners[3] = {getVertexPosition(positions, stride, indices[tri_idx * 3]),
+                                      getVertexPosition(positions, stride, indices[tri_idx * 3 + 1]),
+                                      getVertexPosition(positions, stride, indices[tri_idx * 3 + 2])};
+        glm::vec3 const normal = glm::cross(corners[1] - corners[0], corners[2] - corners[0]);
+        f32 const normal_len = glm::length(normal);
+
+        tri_normals[tri_idx] = (0.f != normal_len) ? normal / normal_len : glm::vec3(0.f);
+        tri_centroids[tri_idx] = (corners[0] + corners[1] + corners[2]) / 3.f;
+    }
+
+    DArray<u32> meshlet_indices;
+    meshlet_indices.reserve(indices.size());
+
+    DArray<b8> emitted_tris(tri_cnt, false);
+    // meshlet the vertex has last been added to, so that the vertices of the current one are found without a search
+    DArray<u32> vtx_meshlets(vtx_cnt, INVALID_INDEX);
+
+    u32 meshlet_vertices[MESHLET_MAX_VERTEX_COUNT];
+    u32 seed_tri = 0;
+
+    while (true)
+    {
+        // the next meshlet starts from the first triangle left, in the order of the original index buffer
+        while ((seed_tri != tri_cnt) && emitted_tris[seed_tri])
+        {
+            ++seed_tri;
+        }
+
+        if (seed_tri == tri_cnt)
+        {
+            break;
+        }
+
+        u32 const meshlet_idx = numericConv<u32>(meshlets.size());
+        u32 meshlet_vtx_cnt = 0;
+        u32 meshlet_tri_cnt = 0;
+        glm::vec3 meshlet_vtx_sum = glm::vec3(0.f);
+        glm::vec3 meshlet_normal_sum = glm::vec3(0.f);
+
+        auto const getNormalDp = [&](u32 tri_idx) {
+            f32 const normal_sum_len = glm::length(meshlet_normal_sum);
+            return (0.f != normal_sum_len) ? glm::dot(tri_normals[tri_idx], meshlet_normal_sum) / normal_sum_len : 1.f;
+        };
+
+        auto const getNewVertexCount = [&](u32 tri_idx) {
+            u32 new_vtx_cnt = 0;
+            for (u32 corner_idx = 0; corner_idx != 3; ++corner_idx)
+            {
+                new_vtx_cnt += (meshlet_idx != vtx_meshlets[indices[tri_idx * 3 + corner_idx]]) ? 1 : 0;
+            }
+            return new_vtx_cnt;
+        };
+
+        u32 next_tri = seed_tri;
+
+        while (INVALID_INDEX != next_tri)
+        {
+            for (u32 corner_idx = 0; corner_idx != 3; ++corner_idx)
+            {
+                u32 const vtx_idx = indices[next_tri * 3 + corner_idx];
+                if (meshlet_idx != vtx_meshlets[vtx_idx])
+                {
+                    vtx_meshlets[vtx_idx] = meshlet_idx;
+                    meshlet_vertices[meshlet_vtx_cnt++] = vtx_idx;
+                    meshlet_vtx_sum += getVertexPosition(positions, stride, vtx_idx);
+                }
+
+                meshlet_indices.push_back(vtx_idx);
+            }
+
+            emitted_tris[next_tri] = true;
+            meshlet_normal_sum += tri_normals[next_tri];
+            ++meshlet_tri_cnt;
+
+            next_tri = INVALID_INDEX;
+            if (MESHLET_MAX_TRIANGLE_COUNT == meshlet_tri_cnt)
+            {
+                break;
+            }
+
+            // grows with the cheapest neighbour
+            f32 best_cost = 0.f;
+            for (u32 meshlet_vtx_idx = 0; meshlet_vtx_idx != meshlet_vtx_cnt; ++meshlet_vtx_idx)
+            {
+                u32 const position_id = position_ids[meshlet_vertices[meshlet_vtx_idx]];
+                for (u32 adj_idx = first_adj_tris[position_id]; adj_idx != first_adj_tris[position_id + 1]; ++adj_idx)
+                {
+                    u32 const tri_idx = adj_tris[adj_idx];
+                    if (emitted_tris[tri_idx])
+                    {
+                        continue;
+                    }
+
+                    u32 const new_vtx_cnt = getNewVertexCount(tri_idx);
+                    f32 const normal_dp = getNormalDp(tri_idx);
+                    if ((MESHLET_MAX_VERTEX_COUNT < (meshlet_vtx_cnt + new_vtx_cnt)) || (normal_dp < MIN_NORMAL_DP))
+                    {
+                        continue;
+                    }
+
+                    // the fewer vertices a triangle adds and the closer its normal is to the meshlet ones, the better
+                    f32 const cost = (f32)new_vtx_cnt + CONE_WEIGHT * (1.f - normal_dp);
+                    if ((INVALID_INDEX == next_tri) || (cost < best_cost))
+                    {
+                        next_tri = tri_idx;
+                        best_cost = cost;
+                    }
+                }
+            }
+
+            if ((INVALID_INDEX != next_tri) || (MESHLET_MAX_VERTEX_COUNT < (meshlet_vtx_cnt + 3)))
+            {
+                continue;
+            }
+
+            // models are often made of many small pieces, the meshlet carries on with the closest unconnected one
+            glm::vec3 const meshlet_centroid = meshlet_vtx_sum / (f32)meshlet_vtx_cnt;
+            f32 best_dist_sqr = 0.f;
+
+            for (u32 tri_idx = seed_tri, last_tri = sbstd::min(seed_tri + DISJOINT_SEARCH_WINDOW, tri_cnt);
+                 tri_idx != last_tri; ++tri_idx)
+            {
+                if (emitted_tris[tri_idx] || (getNormalDp(tri_idx) < MIN_NORMAL_DP))
+                {
+                    continue;
+                }
+
+                glm::vec3 const offset = tri_centroids[tri_idx] - meshlet_centroid;
+                f32 const dist_sqr = glm::dot(offset, offset);
+
+                if ((INVALID_INDEX == next_tri) || (dist_sqr < best_dist_sqr))
+                {
+                    next_tri = tri_idx;
+                    best_dist_sqr = dist_sqr;
+                }
+            }
+        }
+
+        Meshlet & meshlet = meshlets.emplace_back();
+        meshlet = {};
+        meshlet.first_index = numericConv<u32>(meshlet_indices.size()) - meshlet_tri_cnt * 3;
+        meshlet.index_cnt = meshlet_tri_cnt * 3;
+    }
+
+    indices = sbstd::move(meshlet_indices);
+
+    for (Meshlet & meshlet : meshlets)
+    {
+        computeMeshletBounds(positions, stride, indices.data(), meshlet);
+    }
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <sb_core/core.h>
+#include <sb_core/container/dynamic_array.h>
+
+#include <glm/vec3.hpp>
+
+namespace sb {
+
+// Cluster of neighbour triangles stored as a contiguous range of the index buffer, laid out as the std430 meshlet
+// read by cull_meshlets.comp
+// The cluster faces away from a camera at p when dot(normalize(cone_apex - p), cone_axis) >= cone_cutoff
+struct Meshlet
+{
+    glm::vec3 center;
+    f32 radius;
+    glm::vec3 cone_apex;
+    f32 cone_cutoff; // 1 when the normals spread too much for the cone to ever cull the cluster
+    glm::vec3 cone_axis;
+    u32 first_index;
+    u32 index_cnt;
+    u32 padding[3];
+};
+
+static_assert(64 == sizeof(Meshlet), "Meshlet has to match the std430 layout of cull_meshlets.comp");
+
+static constexpr u32 MESHLET_MAX_VERTEX_COUNT = 64;
+static constexpr u32 MESHLET_MAX_TRIANGLE_COUNT = 124;
+
+// Reorders the triangles of 'indices' so that each meshlet is a contiguous index range and fills 'meshlets'
+// A meshlet grows from its first triangle with the neighbours adding the fewest vertices and whose normal stays close
+// to the meshlet ones, up to the max counts, then carries on with the closest unconnected triangles
+// 'positions' points to the position of the first vertex, 'stride' is the vertex size in bytes
+void buildMeshlets(f32 const * positions, u32 vtx_cnt, u32 stride, DArray<u32> & indices, DArray<Meshlet> & meshlets);
+
+} // namespace sb
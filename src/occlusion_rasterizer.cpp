@@ -0,0 +1,643 @@
+#include "occlusion_rasterizer.h"
+#include "simd.h"
+
+#include <sb_core/error/error.h>
+#include <sb_core/conversion.h>
+
+#include <sb_std/algorithm>
+#include <sb_std/iterator>
+#include <sb_std/utility>
+
+#include <cmath>
+#include <limits>
+
+namespace {
+
+// the triangles and boxes with a vertex closer to the eye are not projected
+constexpr sb::f32 NEAR_W = 1e-4f;
+constexpr sb::f32 FAR_DEPTH = 1.f;
+
+constexpr sb::u32 WIDTH = sb::OcclusionRasterizer::WIDTH;
+constexpr sb::u32 HEIGHT = sb::OcclusionRasterizer::HEIGHT;
+constexpr sb::u32 TILE_WIDTH = sb::OcclusionRasterizer::TILE_WIDTH;
+constexpr sb::u32 TILE_HEIGHT = sb::OcclusionRasterizer::TILE_HEIGHT;
+constexpr sb::u32 TILE_COLUMN_COUNT = sb::OcclusionRasterizer::TILE_COLUMN_COUNT;
+constexpr sb::u32 TILE_ROW_COUNT = sb::OcclusionRasterizer::TILE_ROW_COUNT;
+constexpr sb::u32 EDGE_KIND_BITS = 2;
+constexpr sb::u32 EDGE_KIND_MASK = (1U << EDGE_KIND_BITS) - 1;
+
+enum EdgeKind : sb::u32
+{
+    EDGE_LEFT,
+    EDGE_RIGHT,
+    EDGE_HORIZONTAL
+};
+
+// Screen space rectangle and nearest depth of a box, in pixels
+struct ProjectedBox
+{
+    sb::f32 min_x;
+    sb::f32 max_x;
+    sb::f32 min_y;
+    sb::f32 max_y;
+    sb::f32 min_depth;
+};
+
+// Tiles touched by the rectangle of a box, false when it is outside of the buffer
+struct TileRect
+{
+    sb::u32 first_column;
+    sb::u32 last_column;
+    sb::u32 first_row;
+    sb::u32 last_row;
+};
+
+sb::b8 getTileRect(ProjectedBox const & box, TileRect & rect)
+{
+    if ((box.max_x < 0.f) || (box.min_x >= (sb::f32)WIDTH) || (box.max_y < 0.f) || (box.min_y >= (sb::f32)HEIGHT))
+    {
+        return false;
+    }
+
+    auto const toTile = [](sb::f32 coord, sb::u32 tile_size, sb::u32 tile_cnt) {
+        return sbstd::min((sb::u32)sbstd::max(coord, 0.f) / tile_size, tile_cnt - 1);
+    };
+
+    rect.first_column = toTile(box.min_x, TILE_WIDTH, TILE_COLUMN_COUNT);
+    rect.last_column = toTile(box.max_x, TILE_WIDTH, TILE_COLUMN_COUNT);
+    rect.first_row = toTile(box.min_y, TILE_HEIGHT, TILE_ROW_COUNT);
+    rect.last_row = toTile(box.max_y, TILE_HEIGHT, TILE_ROW_COUNT);
+
+    return true;
+}
+
+// Pixel columns [starts[i], ends[i]) covered by the row i of the tile row, each edge bounds a side of the rows
+void computeRowSpansScalar(sb::f32 const * edge_slopes, sb::f32 const * edge_offsets, sb::u32 edge_kinds,
+                           sb::u32 tile_row, sb::s32 * starts, sb::s32 * ends)
+{
+    for (sb::u32 row_idx = 0; row_idx != TILE_HEIGHT; ++row_idx)
+    {
+        sb::f32 const y = (sb::f32)(tile_row * TILE_HEIGHT + row_idx) + 0.5f;
+
+        sb::f32 left = 0.f;
+        sb::f32 right = (sb::f32)WIDTH;
+
+        for (sb::u32 edge_idx = 0; edge_idx != 3; ++edge_idx)
+        {
+            sb::f32 const x = edge_slopes[edge_idx] * y + edge_offsets[edge_idx];
+
+            switch ((edge_kinds >> (edge_idx * EDGE_KIND_BITS)) & EDGE_KIND_MASK)
+            {
+                case EDGE_LEFT:
+                {
+                    left = sbstd::max(left, x);
+                    break;
+                }
+                case EDGE_RIGHT:
+                {
+                    right = sbstd::min(right, x);
+                    break;
+                }
+                default: // EDGE_HORIZONTAL
+                {
+                    right = (x < 0.f) ? 0.f : right;
+                    break;
+                }
+            }
+        }
+
+        left = sbstd::min(left, (sb::f32)WIDTH);
+        right = sbstd::max(right, 0.f);
+
+        // pixels whose center is inside
+        starts[row_idx] = (sb::s32)std::ceil(left - 0.5f);
+        ends[row_idx] = (sb::s32)std::floor(right - 0.5f) + 1;
+    }
+}
+
+void computeTileMaskScalar(sb::s32 const * starts, sb::s32 const * ends, sb::u32 tile_column, sb::u32 * mask)
+{
+    sb::s32 const tile_x = (sb::s32)(tile_column * TILE_WIDTH);
+
+    for (sb::u32 row_idx = 0; row_idx != TILE_HEIGHT; ++row_idx)
+    {
+        sb::s32 const start = sbstd::clamp(starts[row_idx] - tile_x, 0, (sb::s32)TILE_WIDTH);
+        sb::s32 const end = sbstd::clamp(ends[row_idx] - tile_x, 0, (sb::s32)TILE_WIDTH);
+
+        sb::u32 const start_mask = (start < (sb::s32)TILE_WIDTH) ? (~0U >> start) : 0U;
+        sb::u32 const end_mask = (end < (sb::s32)TILE_WIDTH) ? (~0U >> end) : 0U;
+        mask[row_idx] = start_mask & ~end_mask;
+    }
+}
+
+sb::b8 projectBoxScalar(sb::f32 const * view_proj, sb::f32 const (&box_min)[3], sb::f32 const (&box_max)[3],
+                        ProjectedBox & box)
+{
+    constexpr sb::f32 max_float = std::numeric_limits<sb::f32>::max();
+    box = {max_float, -max_float, max_float, -max_float, max_float};
+
+    for (sb::u32 corner_idx = 0; corner_idx != 8; ++corner_idx)
+    {
+        sb::f32 const x = (0 != (corner_idx & 1)) ? box_max[0] : box_min[0];
+        sb::f32 const y = (0 != (corner_idx & 2)) ? box_max[1] : box_min[1];
+        sb::f32 const z = (0 != (corner_idx & 4)) ? box_max[2] : box_min[2];
+
+        sb::f32 clip[4];
+        for (sb::u32 row_idx = 0; row_idx != 4; ++row_idx)
+        {
+            clip[row_idx] = view_proj[row_idx] * x + view_proj[4 + row_idx] * y + view_proj[8 + row_idx] * z +
+                            view_proj[12 + row_idx];
+        }
+
+        if (clip[3] < NEAR_W)
+        {
+            return false;
+        }
+
+        sb::f32 const inv_w = 1.f / clip[3];
+        sb::f32 const screen_x = (clip[0] * inv_w * 0.5f + 0.5f) * (sb::f32)WIDTH;
+        sb::f32 const screen_y = (clip[1] * inv_w * 0.5f + 0.5f) * (sb::f32)HEIGHT;
+
+        box.min_x = sbstd::min(box.min_x, screen_x);
+        box.max_x = sbstd::max(box.max_x, screen_x);
+        box.min_y = sbstd::min(box.min_y, screen_y);
+        box.max_y = sbstd::max(box.max_y, screen_y);
+        box.min_depth = sbstd::min(box.min_depth, clip[2] * inv_w);
+    }
+
+    return true;
+}
+
+sb::b8 isBoxOccludedScalar(sb::f32 const * ref_depths, sb::f32 const * view_proj, sb::f32 const (&box_min)[3],
+                           sb::f32 const (&box_max)[3])
+{
+    ProjectedBox box;
+    TileRect rect;
+    if (!projectBoxScalar(view_proj, box_min, box_max, box) || !getTileRect(box, rect))
+    {
+        return false;
+    }
+
+    for (sb::u32 tile_row = rect.first_row; tile_row <= rect.last_row; ++tile_row)
+    {
+        for (sb::u32 tile_column = rect.first_column; tile_column <= rect.last_column; ++tile_column)
+        {
+            if (box.min_depth <= ref_depths[tile_row * TILE_COLUMN_COUNT + tile_column])
+            {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+#if SB_SIMD_X64
+
+// The 8 rows of the tile row are the 8 lanes
+SB_TARGET_AVX2 void computeRowSpansAvx2(sb::f32 const * edge_slopes, sb::f32 const * edge_offsets,
+                                        sb::u32 edge_kinds, sb::u32 tile_row, sb::s32 * starts, sb::s32 * ends)
+{
+    __m256 const y = _mm256_add_ps(_mm256_set_ps(7.5f, 6.5f, 5.5f, 4.5f, 3.5f, 2.5f, 1.5f, 0.5f),
+                                   _mm256_set1_ps((sb::f32)(tile_row * TILE_HEIGHT)));
+    __m256 const zero = _mm256_setzero_ps();
+    __m256 const width = _mm256_set1_ps((sb::f32)WIDTH);
+    __m256 const half = _mm256_set1_ps(0.5f);
+
+    __m256 left = zero;
+    __m256 right = width;
+
+    for (sb::u32 edge_idx = 0; edge_idx != 3; ++edge_idx)
+    {
+        __m256 const x =
+            _mm256_fmadd_ps(_mm256_set1_ps(edge_slopes[edge_idx]), y, _mm256_set1_ps(edge_offsets[edge_idx]));
+
+        switch ((edge_kinds >> (edge_idx * EDGE_KIND_BITS)) & EDGE_KIND_MASK)
+        {
+            case EDGE_LEFT:
+            {
+                left = _mm256_max_ps(left, x);
+                break;
+            }
+            case EDGE_RIGHT:
+            {
+                right = _mm256_min_ps(right, x);
+                break;
+            }
+            default: // EDGE_HORIZONTAL
+            {
+                right = _mm256_blendv_ps(right, zero, _mm256_cmp_ps(x, zero, _CMP_LT_OQ));
+                break;
+            }
+        }
+    }
+
+    left = _mm256_min_ps(left, width);
+    right = _mm256_max_ps(right, zero);
+
+    __m256i const start = _mm256_cvtps_epi32(_mm256_ceil_ps(_mm256_sub_ps(left, half)));
+    __m256i const end =
+        _mm256_add_epi32(_mm256_cvtps_epi32(_mm256_floor_ps(_mm256_sub_ps(right, half))), _mm256_set1_epi32(1));
+
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(starts), start);
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(ends), end);
+}
+
+// The variable shifts give 0 for shift counts of 32, the rows starting or ending past the tile need no special case
+SB_TARGET_AVX2 void computeTileMaskAvx2(sb::s32 const * starts, sb::s32 const * ends, sb::u32 tile_column,
+                                        sb::u32 * mask)
+{
+    __m256i const tile_x = _mm256_set1_epi32((sb::s32)(tile_column * TILE_WIDTH));
+    __m256i const zero = _mm256_setzero_si256();
+    __m256i const tile_width = _mm256_set1_epi32((sb::s32)TILE_WIDTH);
+    __m256i const ones = _mm256_set1_epi32(-1);
+
+    __m256i const start = _mm256_min_epi32(
+        _mm256_max_epi32(_mm256_sub_epi32(_mm256_loadu_si256(reinterpret_cast<__m256i const *>(starts)), tile_x),
+                         zero),
+        tile_width);
+    __m256i const end = _mm256_min_epi32(
+        _mm256_max_epi32(_mm256_sub_epi32(_mm256_loadu_si256(reinterpret_cast<__m256i const *>(ends)), tile_x),
+                         zero),
+        tile_width);
+
+    __m256i const row_masks = _mm256_andnot_si256(_mm256_srlv_epi32(ones, end), _mm256_srlv_epi32(ones, start));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(mask), row_masks);
+}
+
+SB_TARGET_AVX2 inline __m256 reduceMinAvx2(__m256 values)
+{
+    values = _mm256_min_ps(values, _mm256_permute2f128_ps(values, values, 1));
+    values = _mm256_min_ps(values, _mm256_shuffle_ps(values, values, _MM_SHUFFLE(1, 0, 3, 2)));
+    return _mm256_min_ps(values, _mm256_shuffle_ps(values, values, _MM_SHUFFLE(2, 3, 0, 1)));
+}
+
+SB_TARGET_AVX2 inline __m256 reduceMaxAvx2(__m256 values)
+{
+    values = _mm256_max_ps(values, _mm256_permute2f128_ps(values, values, 1));
+    values = _mm256_max_ps(values, _mm256_shuffle_ps(values, values, _MM_SHUFFLE(1, 0, 3, 2)));
+    return _mm256_max_ps(values, _mm256_shuffle_ps(values, values, _MM_SHUFFLE(2, 3, 0, 1)));
+}
+
+// The 8 corners of the box are the 8 lanes, then the tiles of a tile row are the 8 lanes
+SB_TARGET_AVX2 sb::b8 isBoxOccludedAvx2(sb::f32 const * ref_depths, sb::f32 const * view_proj,
+                                        sb::f32 const (&box_min)[3], sb::f32 const (&box_max)[3])
+{
+    __m256 const x = _mm256_blend_ps(_mm256_set1_ps(box_min[0]), _mm256_set1_ps(box_max[0]), 0b10101010);
+    __m256 const y = _mm256_blend_ps(_mm256_set1_ps(box_min[1]), _mm256_set1_ps(box_max[1]), 0b11001100);
+    __m256 const z = _mm256_blend_ps(_mm256_set1_ps(box_min[2]), _mm256_set1_ps(box_max[2]), 0b11110000);
+
+    __m256 clip[4];
+    for (sb::u32 row_idx = 0; row_idx != 4; ++row_idx)
+    {
+        clip[row_idx] = _mm256_fmadd_ps(
+            _mm256_set1_ps(view_proj[row_idx]), x,
+            _mm256_fmadd_ps(_mm256_set1_ps(view_proj[4 + row_idx]), y,
+                            _mm256_fmadd_ps(_mm256_set1_ps(view_proj[8 + row_idx]), z,
+                                            _mm256_set1_ps(view_proj[12 + row_idx]))));
+    }
+
+    if (0 != _mm256_movemask_ps(_mm256_cmp_ps(clip[3], _mm256_set1_ps(NEAR_W), _CMP_LT_OQ)))
+    {
+        return false;
+    }
+
+    __m256 const inv_w = _mm256_div_ps(_mm256_set1_ps(1.f), clip[3]);
+    __m256 const half_width = _mm256_set1_ps(0.5f * (sb::f32)WIDTH);
+    __m256 const half_height = _mm256_set1_ps(0.5f * (sb::f32)HEIGHT);
+    __m256 const screen_x = _mm256_fmadd_ps(_mm256_mul_ps(clip[0], inv_w), half_width, half_width);
+    __m256 const screen_y = _mm256_fmadd_ps(_mm256_mul_ps(clip[1], inv_w), half_height, half_height);
+    __m256 const depth = _mm256_mul_ps(clip[2], inv_w);
+
+    ProjectedBox box;
+    box.min_x = _mm256_cvtss_f32(reduceMinAvx2(screen_x));
+    box.max_x = _mm256_cvtss_f32(reduceMaxAvx2(screen_x));
+    box.min_y = _mm256_cvtss_f32(reduceMinAvx2(screen_y));
+    box.max_y = _mm256_cvtss_f32(reduceMaxAvx2(screen_y));
+    box.min_depth = _mm256_cvtss_f32(reduceMinAvx2(depth));
+
+    TileRect rect;
+    if (!getTileRect(box, rect))
+    {
+        return false;
+    }
+
+    sb::u32 const column_mask = ((2U << rect.last_column) - 1) & ~((1U << rect.first_column) - 1);
+    __m256 const min_depth = _mm256_set1_ps(box.min_depth);
+
+    for (sb::u32 tile_row = rect.first_row; tile_row <= rect.last_row; ++tile_row)
+    {
+        __m256 const row_depths = _mm256_loadu_ps(ref_depths + tile_row * TILE_COLUMN_COUNT);
+        sb::u32 const occluded_mask = (sb::u32)_mm256_movemask_ps(_mm256_cmp_ps(row_depths, min_depth, _CMP_LT_OQ));
+
+        if (column_mask != (occluded_mask & column_mask))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+#endif
+
+enum class OcclusionKernel
+{
+    SCALAR,
+    AVX2
+};
+
+OcclusionKernel getOcclusionKernel()
+{
+#if SB_SIMD_X64
+    return sb::isAvx2Supported() ? OcclusionKernel::AVX2 : OcclusionKernel::SCALAR;
+#else
+    return OcclusionKernel::SCALAR;
+#endif
+}
+
+} // namespace
+
+void sb::OcclusionRasterizer::initialize(OccluderMesh && mesh)
+{
+    sbAssert(0 == (mesh.indices.size() % 3));
+
+    _mesh = sbstd::move(mesh);
+    _triangles.resize(MAX_OCCLUDER_COUNT * (_mesh.indices.size() / 3));
+    _occluder_cnt = 0;
+
+    clearTiles(0, TILE_ROW_COUNT);
+}
+
+void sb::OcclusionRasterizer::terminate()
+{
+    _mesh = {};
+    _triangles = {};
+    _occluder_cnt = 0;
+}
+
+void sb::OcclusionRasterizer::beginFrame(u32 occluder_cnt)
+{
+    _occluder_cnt = sbstd::min(occluder_cnt, MAX_OCCLUDER_COUNT);
+    sbstd::fill(sbstd::begin(_triangle_cnts), sbstd::end(_triangle_cnts), 0U);
+}
+
+void sb::OcclusionRasterizer::setupOccluder(u32 occluder_idx, f32 const * mvp)
+{
+    sbAssert(occluder_idx < _occluder_cnt);
+
+    u32 const tri_cnt = numericConv<u32>(_mesh.indices.size() / 3);
+    Triangle * const triangles = _triangles.data() + occluder_idx * tri_cnt;
+    u32 setup_cnt = 0;
+
+    for (u32 tri_idx = 0; tri_idx != tri_cnt; ++tri_idx)
+    {
+        // x and y in pixels, y pointing down like the framebuffer, and the clip space depth
+        f32 screen[3][3];
+        b8 in_front = true;
+
+        for (u32 vtx_idx = 0; (vtx_idx != 3) && in_front; ++vtx_idx)
+        {
+            f32 const * const position = &_mesh.positions[_mesh.indices[tri_idx * 3 + vtx_idx] * 3];
+
+            f32 clip[4];
+            for (u32 row_idx = 0; row_idx != 4; ++row_idx)
+            {
+                clip[row_idx] = mvp[row_idx] * position[0] + mvp[4 + row_idx] * position[1] +
+                                mvp[8 + row_idx] * position[2] + mvp[12 + row_idx];
+            }
+
+            in_front = (clip[3] >= NEAR_W);
+
+            f32 const inv_w = 1.f / clip[3];
+            screen[vtx_idx][0] = (clip[0] * inv_w * 0.5f + 0.5f) * (f32)WIDTH;
+            screen[vtx_idx][1] = (clip[1] * inv_w * 0.5f + 0.5f) * (f32)HEIGHT;
+            screen[vtx_idx][2] = clip[2] * inv_w;
+        }
+
+        if (!in_front)
+        {
+            continue;
+        }
+
+        // front faces are counter clockwise for Vulkan, which makes them clockwise with y pointing down
+        f32 area = (screen[1][0] - screen[0][0]) * (screen[2][1] - screen[0][1]) -
+                   (screen[1][1] - screen[0][1]) * (screen[2][0] - screen[0][0]);
+        if (area >= 0.f)
+        {
+            continue;
+        }
+
+        // counter clockwise from here on, the edge functions are then positive inside
+        sbstd::swap(screen[1], screen[2]);
+        area = -area;
+
+        f32 const min_x = sbstd::min({screen[0][0], screen[1][0], screen[2][0]});
+        f32 const max_x = sbstd::max({screen[0][0], screen[1][0], screen[2][0]});
+        f32 const min_y = sbstd::min({screen[0][1], screen[1][1], screen[2][1]});
+        f32 const max_y = sbstd::max({screen[0][1], screen[1][1], screen[2][1]});
+
+        if ((max_x < 0.f) || (min_x >= (f32)WIDTH) || (max_y < 0.f) || (min_y >= (f32)HEIGHT))
+        {
+            continue;
+        }
+
+        Triangle & tri = triangles[setup_cnt++];
+
+        tri.first_column = (u8)(sbstd::max(min_x, 0.f) / (f32)TILE_WIDTH);
+        tri.last_column = (u8)(sbstd::min(max_x, (f32)(WIDTH - 1)) / (f32)TILE_WIDTH);
+        tri.first_row = (u8)(sbstd::max(min_y, 0.f) / (f32)TILE_HEIGHT);
+        tri.last_row = (u8)(sbstd::min(max_y, (f32)(HEIGHT - 1)) / (f32)TILE_HEIGHT);
+
+        tri.edge_kinds = 0;
+        for (u32 edge_idx = 0; edge_idx != 3; ++edge_idx)
+        {
+            f32 const (&from)[3] = screen[edge_idx];
+            f32 const (&to)[3] = screen[(edge_idx + 1) % 3];
+
+            // a * x + b * y + c >= 0 inside
+            f32 const a = from[1] - to[1];
+            f32 const b = to[0] - from[0];
+            f32 const c = (to[1] - from[1]) * from[0] - (to[0] - from[0]) * from[1];
+
+            u32 kind = EDGE_HORIZONTAL;
+            if (0.f == a)
+            {
+                tri.edge_slope[edge_idx] = b;
+                tri.edge_offset[edge_idx] = c;
+            }
+            else
+            {
+                kind = (a > 0.f) ? EDGE_LEFT : EDGE_RIGHT;
+                tri.edge_slope[edge_idx] = -b / a;
+                tri.edge_offset[edge_idx] = -c / a;
+            }
+
+            tri.edge_kinds |= kind << (edge_idx * EDGE_KIND_BITS);
+        }
+
+        f32 const dx1 = screen[1][0] - screen[0][0];
+        f32 const dy1 = screen[1][1] - screen[0][1];
+        f32 const dz1 = screen[1][2] - screen[0][2];
+        f32 const dx2 = screen[2][0] - screen[0][0];
+        f32 const dy2 = screen[2][1] - screen[0][1];
+        f32 const dz2 = screen[2][2] - screen[0][2];
+
+        tri.depth_dx = (dz1 * dy2 - dz2 * dy1) / area;
+        tri.depth_dy = (dz2 * dx1 - dz1 * dx2) / area;
+        tri.depth_offset = screen[0][2] - tri.depth_dx * screen[0][0] - tri.depth_dy * screen[0][1];
+        tri.depth_max = sbstd::max({screen[0][2], screen[1][2], screen[2][2]});
+    }
+
+    _triangle_cnts[occluder_idx] = setup_cnt;
+}
+
+void sb::OcclusionRasterizer::rasterize(u32 first_row, u32 last_row)
+{
+    sbAssert((first_row <= last_row) && (last_row <= TILE_ROW_COUNT));
+
+    clearTiles(first_row, last_row);
+
+    u32 const tri_cnt = numericConv<u32>(_mesh.indices.size() / 3);
+
+    // the occluders are drawn in the order they were picked, the nearest first, which keeps the working layers tight
+    for (u32 occluder_idx = 0; occluder_idx != _occluder_cnt; ++occluder_idx)
+    {
+        Triangle const * const triangles = _triangles.data() + occluder_idx * tri_cnt;
+
+        for (u32 tri_idx = 0; tri_idx != _triangle_cnts[occluder_idx]; ++tri_idx)
+        {
+            Triangle const & tri = triangles[tri_idx];
+
+            if ((tri.last_row >= first_row) && (tri.first_row < last_row))
+            {
+                rasterizeTriangle(tri, sbstd::max<u32>(tri.first_row, first_row),
+                                  sbstd::min<u32>(tri.last_row, last_row - 1));
+            }
+        }
+    }
+}
+
+sb::u32 sb::OcclusionRasterizer::cullOccludedSpheres(BoundingSpheres const & spheres, f32 const * view_proj,
+                                                     u32 * indices, u32 idx_cnt) const
+{
+#if SB_SIMD_X64
+    auto const isBoxOccluded = (OcclusionKernel::AVX2 == getOcclusionKernel()) ? isBoxOccludedAvx2
+                                                                                : isBoxOccludedScalar;
+#else
+    auto const isBoxOccluded = isBoxOccludedScalar;
+#endif
+
+    u32 visible_cnt = 0;
+
+    for (u32 idx = 0; idx != idx_cnt; ++idx)
+    {
+        u32 const sphere_idx = indices[idx];
+        f32 const radius = spheres.radius[sphere_idx];
+        f32 const box_min[3] = {spheres.center_x[sphere_idx] - radius, spheres.center_y[sphere_idx] - radius,
+                                spheres.center_z[sphere_idx] - radius};
+        f32 const box_max[3] = {spheres.center_x[sphere_idx] + radius, spheres.center_y[sphere_idx] + radius,
+                                spheres.center_z[sphere_idx] + radius};
+
+        if (!isBoxOccluded(_tile_ref_depths, view_proj, box_min, box_max))
+        {
+            indices[visible_cnt++] = sphere_idx;
+        }
+    }
+
+    return visible_cnt;
+}
+
+void sb::OcclusionRasterizer::clearTiles(u32 first_row, u32 last_row)
+{
+    u32 const first_tile = first_row * TILE_COLUMN_COUNT;
+    u32 const last_tile = last_row * TILE_COLUMN_COUNT;
+
+    sbstd::fill(_tile_ref_depths + first_tile, _tile_ref_depths + last_tile, FAR_DEPTH);
+    sbstd::fill(_tile_work_depths + first_tile, _tile_work_depths + last_tile, 0.f);
+    sbstd::fill(&_tile_masks[first_tile][0], &_tile_masks[last_tile][0], 0U);
+}
+
+void sb::OcclusionRasterizer::rasterizeTriangle(Triangle const & tri, u32 first_row, u32 last_row)
+{
+#if SB_SIMD_X64
+    b8 const use_avx2 = (OcclusionKernel::AVX2 == getOcclusionKernel());
+    auto const computeRowSpans = use_avx2 ? computeRowSpansAvx2 : computeRowSpansScalar;
+    auto const computeTileMask = use_avx2 ? computeTileMaskAvx2 : computeTileMaskScalar;
+#else
+    auto const computeRowSpans = computeRowSpansScalar;
+    auto const computeTileMask = computeTileMaskScalar;
+#endif
+
+    for (u32 tile_row = first_row; tile_row <= last_row; ++tile_row)
+    {
+        // the spans of the rows do not depend on the tile column
+        s32 starts[TILE_HEIGHT];
+        s32 ends[TILE_HEIGHT];
+        computeRowSpans(tri.edge_slope, tri.edge_offset, tri.edge_kinds, tile_row, starts, ends);
+
+        // the farthest corner of the tile bounds the depth of the triangle over the tile
+        f32 const corner_y = (f32)(tile_row * TILE_HEIGHT + ((tri.depth_dy > 0.f) ? TILE_HEIGHT : 0));
+
+        for (u32 tile_column = tri.first_column; tile_column <= tri.last_column; ++tile_column)
+        {
+            u32 mask[TILE_HEIGHT];
+            computeTileMask(starts, ends, tile_column, mask);
+
+            f32 const corner_x = (f32)(tile_column * TILE_WIDTH + ((tri.depth_dx > 0.f) ? TILE_WIDTH : 0));
+            f32 const tile_depth =
+                sbstd::min(tri.depth_dx * corner_x + tri.depth_dy * corner_y + tri.depth_offset, tri.depth_max);
+
+            updateTile(tile_row * TILE_COLUMN_COUNT + tile_column, mask, tile_depth);
+        }
+    }
+}
+
+void sb::OcclusionRasterizer::updateTile(u32 tile_idx, u32 const * tri_mask, f32 tri_depth)
+{
+    f32 & ref_depth = _tile_ref_depths[tile_idx];
+    f32 & work_depth = _tile_work_depths[tile_idx];
+    u32 (&mask)[TILE_HEIGHT] = _tile_masks[tile_idx];
+
+    u32 tri_bits = 0;
+    for (u32 row_idx = 0; row_idx != TILE_HEIGHT; ++row_idx)
+    {
+        tri_bits |= tri_mask[row_idx];
+    }
+
+    // nothing covered, or behind what the tile already guarantees
+    if ((0 == tri_bits) || (tri_depth >= ref_depth))
+    {
+        return;
+    }
+
+    // the working layer is dropped when the triangle is closer to the reference layer, the merged layer would
+    // otherwise be pushed back to the depth of the triangle
+    if ((tri_depth - work_depth) > (ref_depth - tri_depth))
+    {
+        sbstd::fill(sbstd::begin(mask), sbstd::end(mask), 0U);
+        work_depth = 0.f;
+    }
+
+    u32 full_bits = ~0U;
+    for (u32 row_idx = 0; row_idx != TILE_HEIGHT; ++row_idx)
+    {
+        mask[row_idx] |= tri_mask[row_idx];
+        full_bits &= mask[row_idx];
+    }
+
+    work_depth = sbstd::max(work_depth, tri_depth);
+
+    // once the whole tile is covered the working layer becomes the reference one
+    if (~0U == full_bits)
+    {
+        ref_depth = work_depth;
+        work_depth = 0.f;
+        sbstd::fill(sbstd::begin(mask), sbstd::end(mask), 0U);
+    }
+}
+
+char const * sb::getOcclusionKernelName()
+{
+    return (OcclusionKernel::AVX2 == getOcclusionKernel()) ? "AVX2" : "scalar";
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include "culling.h"
+
+#include <sb_core/core.h>
+#include <sb_core/container/dynamic_array.h>
+
+namespace sb {
+
+// Object space triangles drawn for each occluder, the triangles the GPU culls as back faces are skipped as well
+struct OccluderMesh
+{
+    DArray<f32> positions; // xyz of each vertex
+    DArray<u32> indices;
+};
+
+// Conservative depth buffer of a few occluders drawn at low resolution on the CPU, in the spirit of masked software
+// occlusion culling: the buffer is split in tiles of 32x8 pixels which each keep a coverage mask of one bit per pixel
+// and two depth layers instead of a depth per pixel
+// Depths are [0, 1] clip space depths, the farthest depth of a tile is only lowered once its mask is full
+class OcclusionRasterizer
+{
+public:
+    static constexpr u32 WIDTH = 256;
+    static constexpr u32 HEIGHT = 144;
+    static constexpr u32 TILE_WIDTH = 32; // one bit per pixel of a tile row
+    static constexpr u32 TILE_HEIGHT = 8; // one SIMD lane per tile row
+    static constexpr u32 TILE_COLUMN_COUNT = WIDTH / TILE_WIDTH;
+    static constexpr u32 TILE_ROW_COUNT = HEIGHT / TILE_HEIGHT;
+    static constexpr u32 MAX_OCCLUDER_COUNT = 16;
+
+    static_assert(8 == TILE_COLUMN_COUNT, "The depths of a row of tiles are tested as a single AVX2 vector");
+
+    OcclusionRasterizer() = default;
+    ~OcclusionRasterizer() = default;
+
+    OcclusionRasterizer(OcclusionRasterizer const &) = delete;
+    OcclusionRasterizer & operator=(OcclusionRasterizer const &) = delete;
+
+    // Every occluder is drawn with 'mesh'
+    void initialize(OccluderMesh && mesh);
+    void terminate();
+
+    b8 isInitialized() const
+    {
+        return !_mesh.indices.empty();
+    }
+
+    // Forgets the occluders of the previous frame, 'occluder_cnt' is clamped to MAX_OCCLUDER_COUNT
+    void beginFrame(u32 occluder_cnt);
+
+    // Projects the mesh with the column major 'mvp' and keeps the front facing triangles touching the buffer
+    // Distinct occluders may be set up concurrently, the triangles crossing the near plane are dropped
+    void setupOccluder(u32 occluder_idx, f32 const * mvp);
+
+    // Clears then draws the occluders in the tile rows [first_row, last_row), once all of them are set up
+    // Disjoint row ranges may be drawn concurrently
+    void rasterize(u32 first_row, u32 last_row);
+
+    // Compacts 'indices' to the spheres whose bounding box is not behind the occluders and returns their count
+    // 'view_proj' is the column major matrix the occluders were set up with, the spheres are world space
+    u32 cullOccludedSpheres(BoundingSpheres const & spheres, f32 const * view_proj, u32 * indices,
+                            u32 idx_cnt) const;
+
+private:
+    static constexpr u32 TILE_COUNT = TILE_COLUMN_COUNT * TILE_ROW_COUNT;
+
+    // Screen space triangle, the edge functions are positive inside of it
+    struct Triangle
+    {
+        // x of an edge at the row y is slope * y + offset, the row is outside of a horizontal edge when
+        // slope * y + offset < 0
+        f32 edge_slope[3];
+        f32 edge_offset[3];
+        u32 edge_kinds; // 2 bits per edge, whether it bounds the left or the right of the rows, or is horizontal
+        // plane of the depth, z = depth_dx * x + depth_dy * y + depth_offset
+        f32 depth_dx;
+        f32 depth_dy;
+        f32 depth_offset;
+        f32 depth_max; // farthest vertex
+        u8 first_column;
+        u8 last_column;
+        u8 first_row;
+        u8 last_row;
+    };
+
+    void clearTiles(u32 first_row, u32 last_row);
+    // Rows in [first_row, last_row], both within the rows of the triangle
+    void rasterizeTriangle(Triangle const & tri, u32 first_row, u32 last_row);
+    void updateTile(u32 tile_idx, u32 const * tri_mask, f32 tri_depth);
+
+    OccluderMesh _mesh;
+    // MAX_OCCLUDER_COUNT slots of one triangle per mesh triangle, each occluder only fills the start of its slot
+    DArray<Triangle> _triangles;
+    u32 _triangle_cnts[MAX_OCCLUDER_COUNT] = {};
+    u32 _occluder_cnt = 0;
+
+    // bits of the pixels covered by the working layer, bit 31 for the leftmost pixel of each row of the tile
+    alignas(32) u32 _tile_masks[TILE_COUNT][TILE_HEIGHT] = {};
+    // farthest depth of the whole tile
+    alignas(32) f32 _tile_ref_depths[TILE_COUNT] = {};
+    // farthest depth of the pixels of the working layer
+    alignas(32) f32 _tile_work_depths[TILE_COUNT] = {};
+};
+
+// Name of the SIMD kernel of the OcclusionRasterizer, picked once from the CPU features
+char const * getOcclusionKernelName();
+
+} // namespace sb
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <sb_core/core.h>
+
+#if defined(_M_X64) || defined(_M_AMD64) || defined(__x86_64__)
+#    define SB_SIMD_X64 1
+#    include <immintrin.h>
+#    if defined(_MSC_VER) && !defined(__clang__)
+#        include <intrin.h>
+// MSVC accepts AVX2 intrinsics in any function, AVX2 code paths are only taken once isAvx2Supported() returned true
+#        define SB_TARGET_AVX2
+#    else
+#        define SB_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#    endif
+#else
+#    define SB_SIMD_X64 0
+#endif
+
+#if defined(__aarch64__) || defined(_M_ARM64)
+#    define SB_SIMD_NEON 1
+#    include <arm_neon.h>
+#else
+#    define SB_SIMD_NEON 0
+#endif
+
+namespace sb {
+
+#if SB_SIMD_X64
+
+// AVX2 and FMA are not part of the x64 baseline, the CPU and the OS support are only checked once
+inline b8 isAvx2Supported()
+{
+    static b8 const avx2_supported = []() -> b8 {
+#    if defined(_MSC_VER) && !defined(__clang__)
+        int cpu_info[4] = {};
+        __cpuid(cpu_info, 0);
+        if (cpu_info[0] < 7)
+        {
+            return false;
+        }
+
+        __cpuid(cpu_info, 1);
+        b8 const has_fma = 0 != (cpu_info[2] & (1 << 12));
+        // the OS has to save the YMM registers on context switches
+        b8 const has_ymm_state = (0 != (cpu_info[2] & (1 << 27))) && (0x6 == (_xgetbv(0) & 0x6));
+
+        __cpuidex(cpu_info, 7, 0);
+        b8 const has_avx2 = 0 != (cpu_info[1] & (1 << 5));
+
+        return has_fma && has_ymm_state && has_avx2;
+#    else
+        return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#    endif
+    }();
+
+    return avx2_supported;
+}
+
+#endif
+
+} // namespace sb
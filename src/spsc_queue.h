@@ -0,0 +1,77 @@
+#pragma once
+
+#include <sb_core/core.h>
+
+#include <atomic>
+
+namespace sb {
+
+// Bounded lock-free queue between a single producer thread and a single consumer thread
+template <typename T, u32 CAPACITY>
+class SpscQueue
+{
+    static_assert(0 == (CAPACITY & (CAPACITY - 1)), "Capacity must be a power of two");
+
+public:
+    SpscQueue() = default;
+    ~SpscQueue() = default;
+
+    SpscQueue(SpscQueue const &) = delete;
+    SpscQueue & operator=(SpscQueue const &) = delete;
+
+    // Producer side, returns false when the queue is full
+    b8 push(T const & item)
+    {
+        u32 const tail = _tail.load(std::memory_order_relaxed);
+
+        if ((tail - _head.load(std::memory_order_acquire)) == CAPACITY)
+        {
+            return false;
+        }
+
+        _items[tail & INDEX_MASK] = item;
+        _tail.store(tail + 1, std::memory_order_release);
+        _tail.notify_one();
+
+        return true;
+    }
+
+    // Consumer side, returns false when the queue is empty
+    b8 pop(T & item)
+    {
+        u32 const head = _head.load(std::memory_order_relaxed);
+
+        if (head == _tail.load(std::memory_order_acquire))
+        {
+            return false;
+        }
+
+        item = _items[head & INDEX_MASK];
+        _head.store(head + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    // Blocks the consumer until the queue is not empty
+    void waitForPush() const
+    {
+        u32 const head = _head.load(std::memory_order_relaxed);
+        u32 tail = _tail.load(std::memory_order_acquire);
+
+        while (head == tail)
+        {
+            _tail.wait(tail, std::memory_order_acquire);
+            tail = _tail.load(std::memory_order_acquire);
+        }
+    }
+
+private:
+    static constexpr u32 INDEX_MASK = CAPACITY - 1;
+
+    // indices wrap around and are only masked when accessing the items
+    alignas(64) std::atomic<u32> _head = 0;
+    alignas(64) std::atomic<u32> _tail = 0;
+    T _items[CAPACITY] = {};
+};
+
+} // namespace sb
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <sb_core/core.h>
+
+#include <atomic>
+#include <chrono>
+#include <semaphore>
+
+namespace sb {
+
+// Lock-free handoff of the latest value from a single producer thread to a single consumer thread
+// The producer and the consumer each own a buffer and swap it with the shared one, the producer never waits
+// on the consumer and a value published while the consumer is busy replaces the one it has not acquired yet
+template <typename T>
+class TripleBuffer
+{
+public:
+    TripleBuffer() = default;
+    ~TripleBuffer() = default;
+
+    TripleBuffer(TripleBuffer const &) = delete;
+    TripleBuffer & operator=(TripleBuffer const &) = delete;
+
+    // Producer side, the buffer is handed over to the consumer on publish()
+    T & getWriteBuffer()
+    {
+        return _buffers[_write_idx];
+    }
+
+    void publish()
+    {
+        u32 const prev_state = _shared_state.exchange(_write_idx | PUBLISHED_BIT, std::memory_order_acq_rel);
+        _write_idx = prev_state & INDEX_MASK;
+        _shared_state.notify_all();
+        _publish_sem.release();
+    }
+
+    // Blocks the producer until the consumer acquired the last published value
+    void waitForConsumption() const
+    {
+        u32 state = _shared_state.load(std::memory_order_acquire);
+        while (0 != (state & PUBLISHED_BIT))
+        {
+            _shared_state.wait(state, std::memory_order_acquire);
+            state = _shared_state.load(std::memory_order_acquire);
+        }
+    }
+
+    // Consumer side, returns true when a new value has been published since the last call
+    // getReadBuffer() then refers to it, otherwise it still refers to the previous value
+    b8 acquire()
+    {
+        if (0 == (_shared_state.load(std::memory_order_relaxed) & PUBLISHED_BIT))
+        {
+            return false;
+        }
+
+        u32 const prev_state = _shared_state.exchange(_read_idx, std::memory_order_acq_rel);
+        _read_idx = prev_state & INDEX_MASK;
+        _shared_state.notify_all();
+
+        return true;
+    }
+
+    T const & getReadBuffer() const
+    {
+        return _buffers[_read_idx];
+    }
+
+    // Blocks the consumer until a new value is published
+    void waitForPublish() const
+    {
+        u32 state = _shared_state.load(std::memory_order_acquire);
+        while (0 == (state & PUBLISHED_BIT))
+        {
+            _shared_state.wait(state, std::memory_order_acquire);
+            state = _shared_state.load(std::memory_order_acquire);
+        }
+    }
+
+    // Same as waitForPublish() but gives up after the timeout, returns whether a new value is published
+    template <typename Rep, typename Period>
+    b8 waitForPublish(std::chrono::duration<Rep, Period> timeout)
+    {
+        auto const deadline = std::chrono::steady_clock::now() + timeout;
+
+        // the semaphore also counts the values acquired without waiting, the state is checked after each token
+        while (0 == (_shared_state.load(std::memory_order_acquire) & PUBLISHED_BIT))
+        {
+            if (!_publish_sem.try_acquire_until(deadline))
+            {
+                return 0 != (_shared_state.load(std::memory_order_acquire) & PUBLISHED_BIT);
+            }
+        }
+
+        return true;
+    }
+
+private:
+    static constexpr u32 INDEX_MASK = 0x3;
+    static constexpr u32 PUBLISHED_BIT = 0x4;
+
+    T _buffers[3] = {};
+    u32 _write_idx = 0;
+    u32 _read_idx = 1;
+    // index of the shared buffer and whether it holds a value the consumer has not acquired yet
+    std::atomic<u32> _shared_state = 2;
+    // released on each publish for the timed wait, atomic waits have no timeout
+    std::counting_semaphore<> _publish_sem{0};
+};
+
+} // namespace sb
@@ -138,6 +138,23 @@ sb::VkSurfaceSwapChainProperties sb::getVkSurfaceSwapChainProperties(VkPhysicalD
     return props;
 }
 
+char const * sb::getVkPresentModeName(VkPresentModeKHR present_mode)
+{
+    switch (present_mode)
+    {
+        case VK_PRESENT_MODE_IMMEDIATE_KHR:
+            return "IMMEDIATE";
+        case VK_PRESENT_MODE_MAILBOX_KHR:
+            return "MAILBOX";
+        case VK_PRESENT_MODE_FIFO_KHR:
+            return "FIFO";
+        case VK_PRESENT_MODE_FIFO_RELAXED_KHR:
+            return "FIFO_RELAXED";
+        default:
+            return "UNKNOWN";
+    }
+}
+
 VkResult sb::createVkShaderModule(VkDevice device, sbstd::span<u8 const> byte_code, VkShaderModule * shader_module)
 {
     sbAssert(nullptr != shader_module);
@@ -288,13 +305,13 @@ void sb::copyVkBufferToImage(VkDevice device, VkCommandPool cmd_pool, VkQueue cm
 }
 
 void sb::copyVkBuffer(VkDevice device, VkCommandPool cmd_pool, VkQueue cmd_queue, VkBuffer src_buffer,
-                      VkBuffer dst_buffer, VkDeviceSize buffer_size)
+                      VkBuffer dst_buffer, VkDeviceSize buffer_size, VkDeviceSize dst_offset)
 {
     VkCommandBuffer cmd_buffer = beginVkSingleTimeCommandBuffer(device, cmd_pool);
 
     VkBufferCopy copy_region = {};
     copy_region.srcOffset = 0;
-    copy_region.dstOffset = 0;
+    copy_region.dstOffset = dst_offset;
     copy_region.size = buffer_size;
 
     vkCmdCopyBuffer(cmd_buffer, src_buffer, dst_buffer, 1, &copy_region);
@@ -321,7 +338,7 @@ void sb::destroyVkBuffer(VkDevice device, VkBufferMem buffer_mem)
 
 VkResult sb::uploadVkBufferDataToDevice(VkPhysicalDevice phys_device, VkDevice device, void * data,
                                         VkDeviceSize buffer_size, VkCommandPool cmd_pool, VkQueue cmd_queue,
-                                        VkBuffer dst_buffer)
+                                        VkBuffer dst_buffer, VkDeviceSize dst_offset)
 {
     VkBufferMem staging_mem;
     auto vk_res =
@@ -338,7 +355,7 @@ VkResult sb::uploadVkBufferDataToDevice(VkPhysicalDevice phys_device, VkDevice d
     memcpy(buffer_data, data, buffer_size);
     vkUnmapMemory(device, staging_mem.memory);
 
-    copyVkBuffer(device, cmd_pool, cmd_queue, staging_mem.buffer, dst_buffer, buffer_size);
+    copyVkBuffer(device, cmd_pool, cmd_queue, staging_mem.buffer, dst_buffer, buffer_size, dst_offset);
 
     vkFreeMemory(device, staging_mem.memory, nullptr);
     vkDestroyBuffer(device, staging_mem.buffer, nullptr);
@@ -60,6 +60,8 @@ b32 checkDeviceExtensionsSupport(VkPhysicalDevice phys_device, sbstd::span<char
 
 VkSurfaceSwapChainProperties getVkSurfaceSwapChainProperties(VkPhysicalDevice phys_device, VkSurfaceKHR surface);
 
+char const * getVkPresentModeName(VkPresentModeKHR present_mode);
+
 u32 findVkDeviceMemoryTypeIndex(VkPhysicalDevice device, u32 possible_types, VkMemoryPropertyFlags property_flags);
 
 VkResult createVkBuffer(VkPhysicalDevice phys_device, VkDevice device, VkDeviceSize size,
@@ -70,14 +72,15 @@ VkResult createVkImage(VkPhysicalDevice phys_device, VkDevice device, uint32_t w
 void destroyVkImage(VkDevice device, VkImageMem image_mem);
 
 void copyVkBuffer(VkDevice device, VkCommandPool cmd_pool, VkQueue cmd_quue, VkBuffer src_buffer, VkBuffer dst_buffer,
-                  VkDeviceSize buffer_size);
+                  VkDeviceSize buffer_size, VkDeviceSize dst_offset = 0);
 
 void copyVkBufferToImage(VkDevice device, VkCommandPool cmd_pool, VkQueue cmd_quue, VkBuffer src_buffer, VkImage dst_image, VkExtent3D img_extents);
 
 
+// 'buffer_size' bytes of 'data' are written at 'dst_offset' in the buffer
 VkResult uploadVkBufferDataToDevice(VkPhysicalDevice phys_device, VkDevice device, void * data,
                                     VkDeviceSize buffer_size, VkCommandPool cmd_pool, VkQueue cmd_quue,
-                                    VkBuffer dst_buffer);
+                                    VkBuffer dst_buffer, VkDeviceSize dst_offset = 0);
 
 VkCommandBuffer beginVkSingleTimeCommandBuffer(VkDevice device, VkCommandPool cmd_pool);
 void endVkSingleTimeCommandBuffer(VkDevice device, VkCommandPool cmd_pool, VkQueue queue, VkCommandBuffer cmd_buffer);